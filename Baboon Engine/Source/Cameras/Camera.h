@@ -28,6 +28,8 @@ public:
    glm::mat4 GetViewProjMatrix()const { return m_UBOCamera.proj * m_UBOCamera.view; }
 	const glm::vec3& GetPosition()const { return m_UBOCamera.camPos; }
 	const glm::vec3& GetForward()const { return m_CamForward; }
+  float GetNear()const { return m_Near; }
+  float GetFar()const { return m_Far; }
 
 
 	
@@ -49,6 +49,17 @@ void CameraManager::FetchShadowsUBO(Buffer& buffer)
     buffer.update((void*)&m_UboShadows, sizeof(UBOShadows));
 }
 
+void CameraManager::GetShadowViewProjs(std::vector<glm::mat4>& o_ViewProjs) const
+{
+    o_ViewProjs.clear();
+    for (auto& camera : m_Cameras)
+    {
+        ShadowCamera* shadowCam = dynamic_cast<ShadowCamera*>(camera.second);
+        if (shadowCam)
+            o_ViewProjs.push_back(shadowCam->GetViewProjMatrix());
+    }
+}
+
 
 
 void CameraManager::OnWindowResize(int width, int height)
@@ -35,6 +35,7 @@ public:
 	
 
   void FetchShadowsUBO(Buffer& buffer) ;
+  void GetShadowViewProjs(std::vector<glm::mat4>& o_ViewProjs) const;//Same order as the shadows UBO
   UBOShadows& GetShadowsUBO() { return m_UboShadows; }
 
 	
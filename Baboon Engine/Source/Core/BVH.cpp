@@ -0,0 +1,466 @@
+#define NOMINMAX
+#include "BVH.h"
+#include "FrustumCuller.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#define BVH_NO_PARENT UINT32_MAX
+#define BVH_STACK_SIZE 128 //Traversal stack, the build caps the depth so it always fits
+#define BVH_MAX_DEPTH (BVH_STACK_SIZE - 1) //Nodes this deep become leaves whatever their size, a traversal never stacks more than depth + 1 nodes
+
+struct BVHBuildContext
+{
+    const glm::vec3* m_Min;
+    const glm::vec3* m_Max;
+    const glm::vec3* m_Centroids;//Doubled, only compared against each other
+    BVHNode* m_Nodes;
+    uint32_t* m_Parents;
+    ModelHandle* m_References;
+    std::atomic<uint32_t> m_NodeCount{ 0 };
+};
+
+struct BVHBin
+{
+    glm::vec3 m_Min{ FLT_MAX };
+    glm::vec3 m_Max{ -FLT_MAX };
+    uint32_t m_Count = 0;
+};
+
+static float halfArea(const glm::vec3& i_Min, const glm::vec3& i_Max)
+{
+    const glm::vec3 extent = i_Max - i_Min;
+    return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+struct BVHSubtree { uint32_t m_Node; uint32_t m_Depth; };
+
+//Splits the node if the SAH says so, nodes at or under the subtree size are left for the workers when o_Deferred is given
+static void subdivide(BVHBuildContext& io_Context, uint32_t i_Node, uint32_t i_Depth, std::vector<BVHSubtree>* o_Deferred)
+{
+    BVHNode& node = io_Context.m_Nodes[i_Node];
+    const uint32_t first = node.m_LeftOrFirst;
+    const uint32_t count = node.m_Count;
+    ModelHandle* references = io_Context.m_References + first;
+
+    glm::vec3 centroidMin(FLT_MAX);
+    glm::vec3 centroidMax(-FLT_MAX);
+    node.m_Min = glm::vec3(FLT_MAX);
+    node.m_Max = glm::vec3(-FLT_MAX);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const glm::vec3& boxMin = io_Context.m_Min[references[i]];
+        const glm::vec3& boxMax = io_Context.m_Max[references[i]];
+        node.m_Min = glm::min(node.m_Min, boxMin);
+        node.m_Max = glm::max(node.m_Max, boxMax);
+        const glm::vec3& centroid = io_Context.m_Centroids[references[i]];
+        centroidMin = glm::min(centroidMin, centroid);
+        centroidMax = glm::max(centroidMax, centroid);
+    }
+    if (count <= 1 || i_Depth >= BVH_MAX_DEPTH)
+        return;
+    if (o_Deferred && count <= BVH_PARALLEL_SUBTREE_SIZE)
+    {
+        o_Deferred->push_back({ i_Node, i_Depth });
+        return;
+    }
+
+    //Binned SAH over the three axes
+    int bestAxis = -1;
+    uint32_t bestSplit = 0;
+    float bestCost = FLT_MAX;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const float extent = centroidMax[axis] - centroidMin[axis];
+        if (extent <= 0.0f)
+            continue;
+
+        BVHBin bins[BVH_BINS];
+        const float scale = BVH_BINS / extent;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const ModelHandle model = references[i];
+            const int bin = std::min(BVH_BINS - 1, (int)((io_Context.m_Centroids[model][axis] - centroidMin[axis]) * scale));
+            bins[bin].m_Min = glm::min(bins[bin].m_Min, io_Context.m_Min[model]);
+            bins[bin].m_Max = glm::max(bins[bin].m_Max, io_Context.m_Max[model]);
+            bins[bin].m_Count++;
+        }
+
+        //Left side costs swept forwards, the right side ones backwards while looking for the best split
+        float leftCost[BVH_BINS - 1];
+        glm::vec3 sweepMin(FLT_MAX);
+        glm::vec3 sweepMax(-FLT_MAX);
+        uint32_t sweepCount = 0;
+        for (int split = 0; split < BVH_BINS - 1; split++)
+        {
+            sweepCount += bins[split].m_Count;
+            sweepMin = glm::min(sweepMin, bins[split].m_Min);
+            sweepMax = glm::max(sweepMax, bins[split].m_Max);
+            leftCost[split] = sweepCount ? sweepCount * halfArea(sweepMin, sweepMax) : 0.0f;
+        }
+        sweepMin = glm::vec3(FLT_MAX);
+        sweepMax = glm::vec3(-FLT_MAX);
+        sweepCount = 0;
+        for (int split = BVH_BINS - 1; split > 0; split--)
+        {
+            sweepCount += bins[split].m_Count;
+            sweepMin = glm::min(sweepMin, bins[split].m_Min);
+            sweepMax = glm::max(sweepMax, bins[split].m_Max);
+            const float cost = leftCost[split - 1] + (sweepCount ? sweepCount * halfArea(sweepMin, sweepMax) : 0.0f);
+            if (sweepCount > 0 && sweepCount < count && cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    //One traversal step against testing every box of the node
+    const float splitCost = 1.0f + bestCost / std::max(halfArea(node.m_Min, node.m_Max), FLT_MIN);
+    if (count <= BVH_MAX_LEAF_SIZE && (bestAxis < 0 || splitCost >= (float)count))
+        return;
+
+    uint32_t leftCount = 0;
+    if (bestAxis >= 0)
+    {
+        const float scale = BVH_BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+        const float splitMin = centroidMin[bestAxis];
+        const glm::vec3* centroids = io_Context.m_Centroids;
+        ModelHandle* middle = std::partition(references, references + count, [=](ModelHandle model) {
+            const int bin = std::min(BVH_BINS - 1, (int)((centroids[model][bestAxis] - splitMin) * scale));
+            return bin < (int)bestSplit;
+        });
+        leftCount = static_cast<uint32_t>(middle - references);
+    }
+    if (leftCount == 0 || leftCount == count)
+        leftCount = count / 2;//Every centroid in the same spot, any split is as good
+
+    const uint32_t left = io_Context.m_NodeCount.fetch_add(2);
+    io_Context.m_Nodes[left].m_LeftOrFirst = first;
+    io_Context.m_Nodes[left].m_Count = leftCount;
+    io_Context.m_Nodes[left + 1].m_LeftOrFirst = first + leftCount;
+    io_Context.m_Nodes[left + 1].m_Count = count - leftCount;
+    io_Context.m_Parents[left] = i_Node;
+    io_Context.m_Parents[left + 1] = i_Node;
+    node.m_LeftOrFirst = left;
+    node.m_Count = 0;
+
+    subdivide(io_Context, left, i_Depth + 1, o_Deferred);
+    subdivide(io_Context, left + 1, i_Depth + 1, o_Deferred);
+}
+
+void BVH::build(const glm::vec3* i_Min, const glm::vec3* i_Max, uint32_t i_NModels, const BVHParallelFor& i_ParallelFor)
+{
+    clear();
+    if (i_NModels == 0)
+        return;
+
+    m_References.resize(i_NModels);
+    std::vector<glm::vec3> centroids(i_NModels);
+    for (uint32_t i = 0; i < i_NModels; i++)
+    {
+        m_References[i] = i;
+        centroids[i] = i_Min[i] + i_Max[i];
+    }
+    m_Nodes.resize(2 * i_NModels);//A binary tree with a model or more per leaf never needs more
+    m_Parents.resize(2 * i_NModels);
+
+    BVHBuildContext context;
+    context.m_Min = i_Min;
+    context.m_Max = i_Max;
+    context.m_Centroids = centroids.data();
+    context.m_Nodes = m_Nodes.data();
+    context.m_Parents = m_Parents.data();
+    context.m_References = m_References.data();
+    context.m_NodeCount = 1;
+    m_Nodes[0].m_LeftOrFirst = 0;
+    m_Nodes[0].m_Count = i_NModels;
+    m_Parents[0] = BVH_NO_PARENT;
+
+    //The top of the tree on this thread, then every subtree left on its own
+    std::vector<BVHSubtree> subtrees;
+    subdivide(context, 0, 0, i_ParallelFor ? &subtrees : nullptr);
+    if (!subtrees.empty())
+    {
+        i_ParallelFor(static_cast<uint32_t>(subtrees.size()), [&](uint32_t i) {
+            subdivide(context, subtrees[i].m_Node, subtrees[i].m_Depth, nullptr);
+        });
+    }
+    m_Nodes.resize(context.m_NodeCount);
+    m_Parents.resize(context.m_NodeCount);
+
+    m_LeafOfModel.resize(i_NModels);
+    for (uint32_t node = 0; node < m_Nodes.size(); node++)
+    {
+        for (uint32_t i = 0; i < m_Nodes[node].m_Count; i++)
+            m_LeafOfModel[m_References[m_Nodes[node].m_LeftOrFirst + i]] = node;
+    }
+}
+
+void BVH::clear()
+{
+    m_Nodes.clear();
+    m_Parents.clear();
+    m_References.clear();
+    m_LeafOfModel.clear();
+}
+
+void BVH::refitLeaf(uint32_t i_Node, const glm::vec3* i_Min, const glm::vec3* i_Max)
+{
+    BVHNode& node = m_Nodes[i_Node];
+    node.m_Min = glm::vec3(FLT_MAX);
+    node.m_Max = glm::vec3(-FLT_MAX);
+    for (uint32_t i = 0; i < node.m_Count; i++)
+    {
+        node.m_Min = glm::min(node.m_Min, i_Min[m_References[node.m_LeftOrFirst + i]]);
+        node.m_Max = glm::max(node.m_Max, i_Max[m_References[node.m_LeftOrFirst + i]]);
+    }
+}
+
+void BVH::refit(const glm::vec3* i_Min, const glm::vec3* i_Max, const ModelHandle* i_Moved, size_t i_NMoved)
+{
+    if (m_Nodes.empty() || i_NMoved == 0)
+        return;
+
+    //Past some point walking up from every leaf costs more than one backwards pass over the whole tree
+    if (i_NMoved > m_Nodes.size() / 8)
+    {
+        for (size_t node = m_Nodes.size(); node-- > 0;)
+        {
+            BVHNode& current = m_Nodes[node];
+            if (current.m_Count)
+            {
+                refitLeaf(static_cast<uint32_t>(node), i_Min, i_Max);
+                continue;
+            }
+            const BVHNode& left = m_Nodes[current.m_LeftOrFirst];
+            const BVHNode& right = m_Nodes[current.m_LeftOrFirst + 1];
+            current.m_Min = glm::min(left.m_Min, right.m_Min);
+            current.m_Max = glm::max(left.m_Max, right.m_Max);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < i_NMoved; i++)
+    {
+        uint32_t node = m_LeafOfModel[i_Moved[i]];
+        refitLeaf(node, i_Min, i_Max);
+        //Up until a parent doesn't change, everything above it is already right
+        for (node = m_Parents[node]; node != BVH_NO_PARENT; node = m_Parents[node])
+        {
+            BVHNode& current = m_Nodes[node];
+            const BVHNode& left = m_Nodes[current.m_LeftOrFirst];
+            const BVHNode& right = m_Nodes[current.m_LeftOrFirst + 1];
+            const glm::vec3 newMin = glm::min(left.m_Min, right.m_Min);
+            const glm::vec3 newMax = glm::max(left.m_Max, right.m_Max);
+            if (newMin == current.m_Min && newMax == current.m_Max)
+                break;
+            current.m_Min = newMin;
+            current.m_Max = newMax;
+        }
+    }
+}
+
+//Slab test, entry distance of the ray into the box or FLT_MAX if it misses. Starting inside gives a negative entry
+static float rayBoxEntry(const glm::vec3& i_Origin, const glm::vec3& i_InvDirection, const glm::vec3& i_Min, const glm::vec3& i_Max)
+{
+    const glm::vec3 t0 = (i_Min - i_Origin) * i_InvDirection;
+    const glm::vec3 t1 = (i_Max - i_Origin) * i_InvDirection;
+    const glm::vec3 tNear = glm::min(t0, t1);
+    const glm::vec3 tFar = glm::max(t0, t1);
+    const float entry = std::max(tNear.x, std::max(tNear.y, tNear.z));
+    const float exit = std::min(tFar.x, std::min(tFar.y, tFar.z));
+    return exit >= std::max(entry, 0.0f) ? entry : FLT_MAX;
+}
+
+bool BVH::raycast(const glm::vec3& i_Origin, const glm::vec3& i_Direction, const glm::vec3* i_Min, const glm::vec3* i_Max, ModelHandle& o_Model, float& o_Distance) const
+{
+    if (m_Nodes.empty())
+        return false;
+
+    const glm::vec3 invDirection = 1.0f / i_Direction;//Infinities for axis aligned rays are fine with the slab test
+    float closest = FLT_MAX;
+    ModelHandle hit = MODEL_HANDLE_NONE;
+
+    uint32_t stack[BVH_STACK_SIZE];
+    uint32_t stackSize = 0;
+    if (rayBoxEntry(i_Origin, invDirection, m_Nodes[0].m_Min, m_Nodes[0].m_Max) != FLT_MAX)
+        stack[stackSize++] = 0;
+    while (stackSize)
+    {
+        const BVHNode& node = m_Nodes[stack[--stackSize]];
+        if (node.m_Count)
+        {
+            for (uint32_t i = 0; i < node.m_Count; i++)
+            {
+                const ModelHandle model = m_References[node.m_LeftOrFirst + i];
+                const float entry = rayBoxEntry(i_Origin, invDirection, i_Min[model], i_Max[model]);
+                if (entry >= 0.0f && entry < closest)
+                {
+                    closest = entry;
+                    hit = model;
+                }
+            }
+            continue;
+        }
+
+        //Nearest child goes on top, whatever starts past the closest hit so far is skipped
+        uint32_t children[2] = { node.m_LeftOrFirst, node.m_LeftOrFirst + 1 };
+        float entries[2];
+        for (int c = 0; c < 2; c++)
+            entries[c] = std::max(rayBoxEntry(i_Origin, invDirection, m_Nodes[children[c]].m_Min, m_Nodes[children[c]].m_Max), 0.0f);
+        if (entries[0] < entries[1])
+        {
+            std::swap(entries[0], entries[1]);
+            std::swap(children[0], children[1]);
+        }
+        assert(stackSize + 2 <= BVH_STACK_SIZE && "BVH deeper than BVH_MAX_DEPTH");
+        for (int c = 0; c < 2; c++)
+        {
+            if (entries[c] < closest)
+                stack[stackSize++] = children[c];
+        }
+    }
+
+    if (hit == MODEL_HANDLE_NONE)
+        return false;
+    o_Model = hit;
+    o_Distance = closest;
+    return true;
+}
+
+template<typename Visitor>
+void BVH::visitSubtree(uint32_t i_Node, Visitor&& i_Visit) const
+{
+    uint32_t stack[BVH_STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = i_Node;
+    while (stackSize)
+    {
+        const BVHNode& node = m_Nodes[stack[--stackSize]];
+        if (node.m_Count)
+        {
+            for (uint32_t i = 0; i < node.m_Count; i++)
+                i_Visit(m_References[node.m_LeftOrFirst + i]);
+            continue;
+        }
+        assert(stackSize + 2 <= BVH_STACK_SIZE && "BVH deeper than BVH_MAX_DEPTH");
+        stack[stackSize++] = node.m_LeftOrFirst;
+        stack[stackSize++] = node.m_LeftOrFirst + 1;
+    }
+}
+
+//Every node carries the planes it still straddles, the ones its parent was fully inside of aren't tested again
+template<typename Visitor>
+void BVH::visitFrustum(const glm::mat4& i_ViewProj, const glm::vec3* i_Min, const glm::vec3* i_Max, uint8_t i_Planes, Visitor&& i_Visit) const
+{
+    if (m_Nodes.empty())
+        return;
+
+    glm::vec4 planes[6];
+    FrustumCuller::extractPlanes(i_ViewProj, planes);
+    glm::vec3 absNormals[6];
+    for (int p = 0; p < 6; p++)
+        absNormals[p] = glm::abs(glm::vec3(planes[p]));
+
+    //0 outside, 1 straddling, 2 inside, o_Planes loses the planes the box is fully inside of
+    auto classify = [&](const glm::vec3& i_BoxMin, const glm::vec3& i_BoxMax, uint8_t& io_Planes) {
+        const glm::vec3 center = (i_BoxMax + i_BoxMin) * 0.5f;
+        const glm::vec3 extents = (i_BoxMax - i_BoxMin) * 0.5f;
+        for (int p = 0; p < 6; p++)
+        {
+            if (!(io_Planes & (1 << p)))
+                continue;
+            const float distance = glm::dot(glm::vec3(planes[p]), center) + planes[p].w;
+            const float radius = glm::dot(absNormals[p], extents);
+            if (distance + radius < 0.0f)
+                return 0;
+            if (distance - radius >= 0.0f)
+                io_Planes &= ~(1 << p);
+        }
+        return io_Planes ? 1 : 2;
+    };
+
+    struct Entry { uint32_t m_Node; uint8_t m_Planes; };
+    Entry stack[BVH_STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = { 0, i_Planes };
+    while (stackSize)
+    {
+        Entry entry = stack[--stackSize];
+        const BVHNode& node = m_Nodes[entry.m_Node];
+        const int result = classify(node.m_Min, node.m_Max, entry.m_Planes);
+        if (result == 0)
+            continue;
+        if (result == 2)
+        {
+            visitSubtree(entry.m_Node, i_Visit);
+            continue;
+        }
+        if (node.m_Count)
+        {
+            for (uint32_t i = 0; i < node.m_Count; i++)
+            {
+                const ModelHandle model = m_References[node.m_LeftOrFirst + i];
+                uint8_t modelPlanes = entry.m_Planes;
+                if (classify(i_Min[model], i_Max[model], modelPlanes) != 0)
+                    i_Visit(model);
+            }
+            continue;
+        }
+        assert(stackSize + 2 <= BVH_STACK_SIZE && "BVH deeper than BVH_MAX_DEPTH");
+        stack[stackSize++] = { node.m_LeftOrFirst, entry.m_Planes };
+        stack[stackSize++] = { node.m_LeftOrFirst + 1, entry.m_Planes };
+    }
+}
+
+void BVH::queryFrustum(const glm::mat4& i_ViewProj, const glm::vec3* i_Min, const glm::vec3* i_Max, std::vector<ModelHandle>& o_Models) const
+{
+    o_Models.clear();
+    visitFrustum(i_ViewProj, i_Min, i_Max, 0x3f, [&o_Models](ModelHandle model) { o_Models.push_back(model); });
+}
+
+void BVH::markFrustum(const glm::mat4& i_ViewProj, const glm::vec3* i_Min, const glm::vec3* i_Max, uint8_t i_Bit, uint8_t* io_Masks, bool i_NoNearPlane) const
+{
+    const uint8_t planes = i_NoNearPlane ? 0x3f & ~(1 << FRUSTUM_NEAR_PLANE) : 0x3f;
+    visitFrustum(i_ViewProj, i_Min, i_Max, planes, [=](ModelHandle model) { io_Masks[model] |= i_Bit; });
+}
+
+void BVH::queryAABB(const AABB& i_Box, const glm::vec3* i_Min, const glm::vec3* i_Max, std::vector<ModelHandle>& o_Models) const
+{
+    o_Models.clear();
+    if (m_Nodes.empty())
+        return;
+
+    const glm::vec3 boxMin = i_Box.get_min();
+    const glm::vec3 boxMax = i_Box.get_max();
+    auto overlaps = [&](const glm::vec3& i_OtherMin, const glm::vec3& i_OtherMax) {
+        return glm::all(glm::lessThanEqual(boxMin, i_OtherMax)) && glm::all(glm::lessThanEqual(i_OtherMin, boxMax));
+    };
+
+    uint32_t stack[BVH_STACK_SIZE];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize)
+    {
+        const BVHNode& node = m_Nodes[stack[--stackSize]];
+        if (!overlaps(node.m_Min, node.m_Max))
+            continue;
+        if (node.m_Count)
+        {
+            for (uint32_t i = 0; i < node.m_Count; i++)
+            {
+                const ModelHandle model = m_References[node.m_LeftOrFirst + i];
+                if (overlaps(i_Min[model], i_Max[model]))
+                    o_Models.push_back(model);
+            }
+            continue;
+        }
+        assert(stackSize + 2 <= BVH_STACK_SIZE && "BVH deeper than BVH_MAX_DEPTH");
+        stack[stackSize++] = node.m_LeftOrFirst;
+        stack[stackSize++] = node.m_LeftOrFirst + 1;
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "Renderer/Common/GLMInclude.h"
+#include "ModelStore.h"
+#include "aabb.h"
+#include <vector>
+#include <functional>
+#include <stdint.h>
+
+#define BVH_BINS 12 //SAH candidates per axis
+#define BVH_MAX_LEAF_SIZE 8 //Nodes up to this many models become leaves when splitting them doesn't pay off
+#define BVH_PARALLEL_SUBTREE_SIZE 4096 //The top of the tree is built on the calling thread, subtrees this small go to the workers
+
+//Runs the job for every index in [0, count), in parallel if it can
+typedef std::function<void(uint32_t, const std::function<void(uint32_t)>&)> BVHParallelFor;
+
+struct BVHNode
+{
+    glm::vec3 m_Min;
+    uint32_t m_LeftOrFirst;//First child (the second one goes right after it), or first model reference of a leaf
+    glm::vec3 m_Max;
+    uint32_t m_Count;//Models in a leaf, 0 for inner nodes
+};
+
+/**
+ * @brief Bounding volume hierarchy over the world boxes of the model store
+ *
+ * Built top down with binned SAH. Children are always allocated after their parent, so walking the nodes backwards is a
+ * valid bottom up order for a full refit, while a few moved models only walk from their leaf up to the root.
+ * Queries write model handles, the tree doesn't keep any pointer to the store.
+ */
+class BVH
+{
+public:
+    void build(const glm::vec3* i_Min, const glm::vec3* i_Max, uint32_t i_NModels, const BVHParallelFor& i_ParallelFor = nullptr);
+    void clear();
+
+    //Bounds of the given models changed, i_Min and i_Max are the same arrays the tree was built from
+    void refit(const glm::vec3* i_Min, const glm::vec3* i_Max, const ModelHandle* i_Moved, size_t i_NMoved);
+
+    /**
+     * @brief Closest model box hit by the ray
+     * @details Boxes around the ray origin are ignored, from inside a room every box around it would be hit at distance zero
+     * @return false if nothing was hit
+     */
+    bool raycast(const glm::vec3& i_Origin, const glm::vec3& i_Direction, const glm::vec3* i_Min, const glm::vec3* i_Max, ModelHandle& o_Model, float& o_Distance) const;
+
+    //Models whose box is at least partially inside the frustum, whole subtrees inside it go in without testing their boxes
+    void queryFrustum(const glm::mat4& i_ViewProj, const glm::vec3* i_Min, const glm::vec3* i_Max, std::vector<ModelHandle>& o_Models) const;
+    //Same as queryFrustum, writing i_Bit into the mask of the models found instead of listing them. Shadow views skip the near
+    //plane so casters between the light and it aren't lost
+    void markFrustum(const glm::mat4& i_ViewProj, const glm::vec3* i_Min, const glm::vec3* i_Max, uint8_t i_Bit, uint8_t* io_Masks, bool i_NoNearPlane = false) const;
+    void queryAABB(const AABB& i_Box, const glm::vec3* i_Min, const glm::vec3* i_Max, std::vector<ModelHandle>& o_Models) const;
+
+    uint32_t getModelCount() const { return static_cast<uint32_t>(m_References.size()); }
+    uint32_t getNodeCount() const { return static_cast<uint32_t>(m_Nodes.size()); }
+
+private:
+    std::vector<BVHNode> m_Nodes;//Root first
+    std::vector<uint32_t> m_Parents;
+    std::vector<ModelHandle> m_References;//Leaves point at ranges of this
+    std::vector<uint32_t> m_LeafOfModel;
+
+    void refitLeaf(uint32_t i_Node, const glm::vec3* i_Min, const glm::vec3* i_Max);
+    template<typename Visitor> void visitFrustum(const glm::mat4& i_ViewProj, const glm::vec3* i_Min, const glm::vec3* i_Max, uint8_t i_Planes, Visitor&& i_Visit) const;
+    template<typename Visitor> void visitSubtree(uint32_t i_Node, Visitor&& i_Visit) const;
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstring>
+#include <stdint.h>
+
+//Helpers to (de)serialize small variable sized blobs of the on disk caches (SceneCache, ShaderCache)
+inline void writeString(std::vector<uint8_t>& o_Blob, const std::string& i_String)
+{
+    uint32_t length = static_cast<uint32_t>(i_String.size());
+    o_Blob.insert(o_Blob.end(), (const uint8_t*)&length, (const uint8_t*)&length + sizeof(length));
+    o_Blob.insert(o_Blob.end(), i_String.begin(), i_String.end());
+}
+
+template <class T>
+inline void writeValue(std::vector<uint8_t>& o_Blob, const T& i_Value)
+{
+    o_Blob.insert(o_Blob.end(), (const uint8_t*)&i_Value, (const uint8_t*)&i_Value + sizeof(T));
+}
+
+//Reads past the end leave m_Valid false and return default values, check it once at the end
+struct BlobReader
+{
+    const uint8_t* m_Data;
+    size_t m_Size;
+    size_t m_Position = 0;
+    bool m_Valid = true;
+
+    template <class T>
+    T read()
+    {
+        T value{};
+        if (m_Position + sizeof(T) > m_Size)
+        {
+            m_Valid = false;
+            return value;
+        }
+        std::memcpy(&value, m_Data + m_Position, sizeof(T));
+        m_Position += sizeof(T);
+        return value;
+    }
+    std::string readString()
+    {
+        uint32_t length = read<uint32_t>();
+        if (!m_Valid || m_Position + length > m_Size)
+        {
+            m_Valid = false;
+            return std::string();
+        }
+        std::string value((const char*)m_Data + m_Position, length);
+        m_Position += length;
+        return value;
+    }
+};
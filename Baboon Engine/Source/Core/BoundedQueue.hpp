@@ -0,0 +1,53 @@
+#pragma once
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+
+//Fixed capacity producer/consumer queue. Producers block while the queue is full so a fast stage can't run too far ahead of a slow one
+template <class T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : m_Capacity(capacity > 0 ? capacity : 1) {}
+
+    //Blocks while full, returns false if the queue got closed
+    bool push(T&& item)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_NotFull.wait(lock, [this] { return m_Queue.size() < m_Capacity || m_Closed; });
+        if (m_Closed)
+            return false;
+        m_Queue.push(std::move(item));
+        m_NotEmpty.notify_one();
+        return true;
+    }
+
+    //Blocks while empty, returns false once the queue is closed and drained
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_NotEmpty.wait(lock, [this] { return !m_Queue.empty() || m_Closed; });
+        if (m_Queue.empty())
+            return false;
+        item = std::move(m_Queue.front());
+        m_Queue.pop();
+        m_NotFull.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Closed = true;
+        m_NotEmpty.notify_all();
+        m_NotFull.notify_all();
+    }
+
+private:
+    size_t m_Capacity;
+    bool m_Closed{ false };
+    std::queue<T> m_Queue;
+    std::mutex m_Mutex;
+    std::condition_variable m_NotEmpty;
+    std::condition_variable m_NotFull;
+};
@@ -0,0 +1,198 @@
+#define NOMINMAX
+#include "FrustumCuller.h"
+#include "ParallelJobs.h"
+#include <algorithm>
+#include <cmath>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+//Plane coefficients of one view laid out for the box test: normal, its absolute value for the box extents, and distance
+struct CullPlanes
+{
+    float m_N[6][3];
+    float m_AbsN[6][3];
+    float m_D[6];
+};
+
+void FrustumCuller::extractPlanes(const glm::mat4& i_ViewProj, glm::vec4 o_Planes[6])
+{
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(i_ViewProj[0][i], i_ViewProj[1][i], i_ViewProj[2][i], i_ViewProj[3][i]);
+
+    o_Planes[0] = rows[3] + rows[0];
+    o_Planes[1] = rows[3] - rows[0];
+    o_Planes[2] = rows[3] + rows[1];
+    o_Planes[3] = rows[3] - rows[1];
+    o_Planes[4] = rows[3] + rows[2];//-w < z, looser than the 0 < z of vulkan depth so it holds for both conventions
+    o_Planes[5] = rows[3] - rows[2];
+}
+
+//Center distance and box radius scale the same with the plane, so they don't need normalizing
+static void toCullPlanes(const glm::mat4& i_ViewProj, bool i_NoNearPlane, CullPlanes& o_Planes)
+{
+    glm::vec4 planes[6];
+    FrustumCuller::extractPlanes(i_ViewProj, planes);
+    if (i_NoNearPlane)
+        planes[FRUSTUM_NEAR_PLANE] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);//Every box is in front of it
+    for (int p = 0; p < 6; p++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            o_Planes.m_N[p][c] = planes[p][c];
+            o_Planes.m_AbsN[p][c] = std::abs(planes[p][c]);
+        }
+        o_Planes.m_D[p] = planes[p].w;
+    }
+}
+
+static bool boxOutside(const CullPlanes& i_Planes, const glm::vec3& i_Min, const glm::vec3& i_Max)
+{
+    const glm::vec3 center = (i_Max + i_Min) * 0.5f;
+    const glm::vec3 extents = (i_Max - i_Min) * 0.5f;
+    for (int p = 0; p < 6; p++)
+    {
+        const float distance = i_Planes.m_N[p][0] * center.x + i_Planes.m_N[p][1] * center.y + i_Planes.m_N[p][2] * center.z + i_Planes.m_D[p];
+        const float radius = i_Planes.m_AbsN[p][0] * extents.x + i_Planes.m_AbsN[p][1] * extents.y + i_Planes.m_AbsN[p][2] * extents.z;
+        if (distance + radius < 0.0f)
+            return true;
+    }
+    return false;
+}
+
+//Culls models [i_Begin, i_End) against every view, the wide loop takes the boxes a register at a time and the tail goes scalar
+static void cullRange(const glm::vec3* i_Min, const glm::vec3* i_Max, const CullPlanes* i_Views, uint32_t i_NViews, uint8_t* o_Masks, uint32_t i_Begin, uint32_t i_End)
+{
+    uint32_t model = i_Begin;
+#if defined(__AVX__)
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 zero = _mm256_setzero_ps();
+    for (; model + 8 <= i_End; model += 8)
+    {
+        const glm::vec3* mn = i_Min + model;
+        const glm::vec3* mx = i_Max + model;
+        const __m256 minX = _mm256_setr_ps(mn[0].x, mn[1].x, mn[2].x, mn[3].x, mn[4].x, mn[5].x, mn[6].x, mn[7].x);
+        const __m256 minY = _mm256_setr_ps(mn[0].y, mn[1].y, mn[2].y, mn[3].y, mn[4].y, mn[5].y, mn[6].y, mn[7].y);
+        const __m256 minZ = _mm256_setr_ps(mn[0].z, mn[1].z, mn[2].z, mn[3].z, mn[4].z, mn[5].z, mn[6].z, mn[7].z);
+        const __m256 maxX = _mm256_setr_ps(mx[0].x, mx[1].x, mx[2].x, mx[3].x, mx[4].x, mx[5].x, mx[6].x, mx[7].x);
+        const __m256 maxY = _mm256_setr_ps(mx[0].y, mx[1].y, mx[2].y, mx[3].y, mx[4].y, mx[5].y, mx[6].y, mx[7].y);
+        const __m256 maxZ = _mm256_setr_ps(mx[0].z, mx[1].z, mx[2].z, mx[3].z, mx[4].z, mx[5].z, mx[6].z, mx[7].z);
+        const __m256 centerX = _mm256_mul_ps(_mm256_add_ps(maxX, minX), half);
+        const __m256 centerY = _mm256_mul_ps(_mm256_add_ps(maxY, minY), half);
+        const __m256 centerZ = _mm256_mul_ps(_mm256_add_ps(maxZ, minZ), half);
+        const __m256 extentX = _mm256_mul_ps(_mm256_sub_ps(maxX, minX), half);
+        const __m256 extentY = _mm256_mul_ps(_mm256_sub_ps(maxY, minY), half);
+        const __m256 extentZ = _mm256_mul_ps(_mm256_sub_ps(maxZ, minZ), half);
+
+        uint8_t masks[8] = {};
+        for (uint32_t v = 0; v < i_NViews; v++)
+        {
+            const CullPlanes& planes = i_Views[v];
+            __m256 outside = zero;
+            for (int p = 0; p < 6; p++)
+            {
+                __m256 distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.m_N[p][0]), centerX), _mm256_set1_ps(planes.m_D[p]));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.m_N[p][1]), centerY));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.m_N[p][2]), centerZ));
+                __m256 radius = _mm256_mul_ps(_mm256_set1_ps(planes.m_AbsN[p][0]), extentX);
+                radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_set1_ps(planes.m_AbsN[p][1]), extentY));
+                radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_set1_ps(planes.m_AbsN[p][2]), extentZ));
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_LT_OQ));
+            }
+            const int outsideBits = _mm256_movemask_ps(outside);
+            for (int lane = 0; lane < 8; lane++)
+            {
+                if (!(outsideBits & (1 << lane)))
+                    masks[lane] |= 1 << v;
+            }
+        }
+        for (int lane = 0; lane < 8; lane++)
+            o_Masks[model + lane] = masks[lane];
+    }
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    for (; model + 4 <= i_End; model += 4)
+    {
+        const glm::vec3* mn = i_Min + model;
+        const glm::vec3* mx = i_Max + model;
+        const __m128 minX = _mm_setr_ps(mn[0].x, mn[1].x, mn[2].x, mn[3].x);
+        const __m128 minY = _mm_setr_ps(mn[0].y, mn[1].y, mn[2].y, mn[3].y);
+        const __m128 minZ = _mm_setr_ps(mn[0].z, mn[1].z, mn[2].z, mn[3].z);
+        const __m128 maxX = _mm_setr_ps(mx[0].x, mx[1].x, mx[2].x, mx[3].x);
+        const __m128 maxY = _mm_setr_ps(mx[0].y, mx[1].y, mx[2].y, mx[3].y);
+        const __m128 maxZ = _mm_setr_ps(mx[0].z, mx[1].z, mx[2].z, mx[3].z);
+        const __m128 centerX = _mm_mul_ps(_mm_add_ps(maxX, minX), half);
+        const __m128 centerY = _mm_mul_ps(_mm_add_ps(maxY, minY), half);
+        const __m128 centerZ = _mm_mul_ps(_mm_add_ps(maxZ, minZ), half);
+        const __m128 extentX = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+        const __m128 extentY = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+        const __m128 extentZ = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+
+        uint8_t masks[4] = {};
+        for (uint32_t v = 0; v < i_NViews; v++)
+        {
+            const CullPlanes& planes = i_Views[v];
+            __m128 outside = zero;
+            for (int p = 0; p < 6; p++)
+            {
+                __m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.m_N[p][0]), centerX), _mm_set1_ps(planes.m_D[p]));
+                distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.m_N[p][1]), centerY));
+                distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.m_N[p][2]), centerZ));
+                __m128 radius = _mm_mul_ps(_mm_set1_ps(planes.m_AbsN[p][0]), extentX);
+                radius = _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(planes.m_AbsN[p][1]), extentY));
+                radius = _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(planes.m_AbsN[p][2]), extentZ));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+            }
+            const int outsideBits = _mm_movemask_ps(outside);
+            for (int lane = 0; lane < 4; lane++)
+            {
+                if (!(outsideBits & (1 << lane)))
+                    masks[lane] |= 1 << v;
+            }
+        }
+        for (int lane = 0; lane < 4; lane++)
+            o_Masks[model + lane] = masks[lane];
+    }
+#endif
+    for (; model < i_End; model++)
+    {
+        uint8_t mask = 0;
+        for (uint32_t v = 0; v < i_NViews; v++)
+        {
+            if (!boxOutside(i_Views[v], i_Min[model], i_Max[model]))
+                mask |= 1 << v;
+        }
+        o_Masks[model] = mask;
+    }
+}
+
+void FrustumCuller::cull(const ModelStore& i_Models, const glm::mat4* i_ViewProjs, uint32_t i_NViews, uint8_t i_NoNearPlaneViews, std::vector<uint8_t>& o_Masks, ThreadPool* i_ThreadPool)
+{
+    const uint32_t nModels = i_Models.size();
+    o_Masks.resize(nModels);
+    if (nModels == 0)
+        return;
+
+    const uint32_t nViews = (std::min)(i_NViews, (uint32_t)FRUSTUM_CULL_MAX_VIEWS);
+    CullPlanes views[FRUSTUM_CULL_MAX_VIEWS];
+    for (uint32_t v = 0; v < nViews; v++)
+        toCullPlanes(i_ViewProjs[v], (i_NoNearPlaneViews >> v) & 1, views[v]);
+
+    const glm::vec3* boundsMin = i_Models.getBoundsMin();
+    const glm::vec3* boundsMax = i_Models.getBoundsMax();
+    uint8_t* masks = o_Masks.data();
+
+    //Ranges are multiples of 8 so no two of them share a register load
+    const uint32_t nRanges = (std::max)(1u, nModels / FRUSTUM_CULL_MODELS_PER_JOB);
+    const uint32_t rangeSize = ((nModels + nRanges - 1) / nRanges + 7) & ~7u;
+    runJobs(i_ThreadPool, nRanges, [&](uint32_t i_Range) {
+        const uint32_t begin = i_Range * rangeSize;
+        const uint32_t end = (std::min)(nModels, begin + rangeSize);
+        if (begin < end)
+            cullRange(boundsMin, boundsMax, views, nViews, masks, begin, end);
+    });
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "Renderer/Common/GLMInclude.h"
+#include "ModelStore.h"
+#include <vector>
+#include <stdint.h>
+
+class ThreadPool;
+
+#define FRUSTUM_CULL_MAX_VIEWS 8 //One visibility bit per view in the output masks
+#define FRUSTUM_CULL_MODELS_PER_JOB 2048 //Below this many models per worker the whole cull runs on the calling thread
+#define FRUSTUM_NEAR_PLANE 4 //Index of the near plane out of extractPlanes
+
+/**
+ * @brief Tests the world boxes of the model store against up to FRUSTUM_CULL_MAX_VIEWS frustums
+ *
+ * Boxes go 8 at a time with AVX, 4 with SSE, straight off the store min/max arrays. Big stores get split in contiguous
+ * ranges over the given thread pool, every range writes its own part of the masks so there is nothing to merge.
+ */
+class FrustumCuller
+{
+public:
+    /**
+     * @brief Bit v of o_Masks[model] is set when the model box is at least partially inside the frustum of i_ViewProjs[v]
+     * @param i_NViews Up to FRUSTUM_CULL_MAX_VIEWS, the rest are ignored
+     * @param i_NoNearPlaneViews Bit v drops the near plane of view v, shadow casters between the light and its near plane still cast
+     * @param i_ThreadPool Shared pool the big stores are split over, null culls everything on the calling thread
+     */
+    void cull(const ModelStore& i_Models, const glm::mat4* i_ViewProjs, uint32_t i_NViews, uint8_t i_NoNearPlaneViews, std::vector<uint8_t>& o_Masks, ThreadPool* i_ThreadPool = nullptr);
+
+    //Gribb-Hartmann, world space planes out of a view projection, normals pointing inside. Not normalized
+    static void extractPlanes(const glm::mat4& i_ViewProj, glm::vec4 o_Planes[6]);
+};
@@ -113,6 +113,12 @@ void Material::Init(std::string i_sMaterialName, std::vector<std::pair<std::stri
     m_MaterialIndex = materialIndex;
 }
 
+const char* Material::GetTextureSlotName(uint32_t i_Slot)
+{
+    static const char* textureSlots[MATERIAL_TEXTURE_SLOTS] = { "baseTexture", "opacityTexture", "specularTexture", "normalTexture" };
+    return textureSlots[i_Slot];
+}
+
 Texture* Material::GetTextureByName(std::string name)
 {
     Texture* tex;
@@ -72,8 +72,11 @@ struct MaterialParameters {
   glm::vec4 m_Ambient;
   glm::vec4 m_Diffuse;
   glm::vec4 m_Specular;
+  glm::ivec4 m_Textures;//Bindless array indices of the base, opacity, specular and normal textures, -1 when missing
 };
 #define MAX_MATERIALS 128
+#define MATERIAL_TEXTURE_SLOTS 4 //Base, opacity, specular and normal, the order of m_Textures and of the has*Texture constant ids of geo.frag and transparent.frag
+#define BINDLESS_MAX_TEXTURES 1024 //Size of the scene texture array, the device needs at least this many update after bind samplers per stage
 struct   alignas(16) UBOMaterial
 {
   MaterialParameters m_Materials[MAX_MATERIALS];
@@ -90,6 +93,7 @@ public:
 		return m_sMaterialName;
 	}
   Texture* GetTextureByName(std::string name );
+  static const char* GetTextureSlotName(uint32_t i_Slot);//Texture name of a slot, i_Slot < MATERIAL_TEXTURE_SLOTS
 
   bool isTransparent() { return m_IsTransparent; }
   uint8_t getMaterialIndex() { return m_MaterialIndex; }
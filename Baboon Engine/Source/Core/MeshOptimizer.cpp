@@ -0,0 +1,536 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+float MeshOptimizer::ComputeACMR(const uint32_t* i_Indices, uint32_t i_NIndices, uint32_t i_NVertices, uint32_t i_CacheSize)
+{
+    if (i_NIndices < 3)
+        return 0.0f;
+
+    //FIFO cache simulated with timestamps, a vertex is in the cache if it got in less than i_CacheSize misses ago
+    std::vector<uint32_t> cacheTime(i_NVertices, 0);
+    uint32_t misses = 0;
+    for (uint32_t i = 0; i < i_NIndices; i++)
+    {
+        uint32_t v = i_Indices[i];
+        if (cacheTime[v] == 0 || misses - cacheTime[v] >= i_CacheSize)
+        {
+            misses++;
+            cacheTime[v] = misses;
+        }
+    }
+    return static_cast<float>(misses) / (i_NIndices / 3);
+}
+
+namespace
+{
+    //Vertex -> triangles using it, packed as offsets into a single array
+    struct TriangleAdjacency
+    {
+        std::vector<uint32_t> m_Offsets;
+        std::vector<uint32_t> m_Counts;
+        std::vector<uint32_t> m_Triangles;
+
+        TriangleAdjacency(const uint32_t* i_Indices, uint32_t i_NIndices, uint32_t i_NVertices) :
+            m_Offsets(i_NVertices + 1, 0),
+            m_Counts(i_NVertices, 0),
+            m_Triangles(i_NIndices)
+        {
+            for (uint32_t i = 0; i < i_NIndices; i++)
+                m_Counts[i_Indices[i]]++;
+            for (uint32_t v = 0; v < i_NVertices; v++)
+                m_Offsets[v + 1] = m_Offsets[v] + m_Counts[v];
+
+            std::vector<uint32_t> fill(m_Offsets.begin(), m_Offsets.end() - 1);
+            for (uint32_t i = 0; i < i_NIndices; i++)
+                m_Triangles[fill[i_Indices[i]]++] = i / 3;
+        }
+    };
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32_t* io_Indices, uint32_t i_NIndices, uint32_t i_NVertices, uint32_t i_CacheSize)
+{
+    const uint32_t nTriangles = i_NIndices / 3;
+    if (nTriangles == 0 || i_NVertices == 0)
+        return;
+
+    TriangleAdjacency adjacency(io_Indices, i_NIndices, i_NVertices);
+    std::vector<uint32_t> liveTriangles = adjacency.m_Counts;
+    std::vector<uint32_t> cacheTime(i_NVertices, 0);
+    std::vector<bool> emitted(nTriangles, false);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(i_NIndices);
+
+    uint32_t timestamp = i_CacheSize + 1;
+    uint32_t cursor = 0;
+    int64_t fanning = 0;
+
+    auto skipDeadEnd = [&]() -> int64_t {
+        while (!deadEnds.empty())
+        {
+            uint32_t d = deadEnds.back();
+            deadEnds.pop_back();
+            if (liveTriangles[d] > 0)
+                return d;
+        }
+        while (cursor < i_NVertices)
+        {
+            if (liveTriangles[cursor] > 0)
+                return cursor;
+            cursor++;
+        }
+        return -1;
+    };
+
+    while (fanning >= 0)
+    {
+        candidates.clear();
+        for (uint32_t a = adjacency.m_Offsets[fanning]; a < adjacency.m_Offsets[fanning + 1]; a++)
+        {
+            uint32_t t = adjacency.m_Triangles[a];
+            if (emitted[t])
+                continue;
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                uint32_t v = io_Indices[t * 3 + c];
+                output.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (timestamp - cacheTime[v] > i_CacheSize)
+                    cacheTime[v] = timestamp++;
+            }
+            emitted[t] = true;
+        }
+
+        //Next fanning vertex: the candidate that stays longest in the cache once its remaining triangles are emitted
+        int64_t next = -1;
+        uint32_t bestPriority = 0;
+        for (uint32_t v : candidates)
+        {
+            if (liveTriangles[v] == 0)
+                continue;
+            uint32_t priority = 0;
+            if (timestamp - cacheTime[v] + 2 * liveTriangles[v] <= i_CacheSize)
+                priority = timestamp - cacheTime[v];
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+        fanning = next >= 0 ? next : skipDeadEnd();
+    }
+
+    std::copy(output.begin(), output.end(), io_Indices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(uint32_t* io_Indices, uint32_t i_NIndices, const glm::vec3* i_Positions, uint32_t i_NVertices, uint32_t i_CacheSize)
+{
+    const uint32_t nTriangles = i_NIndices / 3;
+    if (nTriangles < 2)
+        return;
+
+    //Cluster boundaries where the cache order restarts (every vertex of the triangle misses), moving whole clusters around
+    //keeps the vertex cache efficiency of the input
+    std::vector<uint32_t> clusterStarts;
+    std::vector<uint32_t> cacheTime(i_NVertices, 0);
+    uint32_t misses = 0;
+    for (uint32_t t = 0; t < nTriangles; t++)
+    {
+        uint32_t triangleMisses = 0;
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            uint32_t v = io_Indices[t * 3 + c];
+            if (cacheTime[v] == 0 || misses - cacheTime[v] >= i_CacheSize)
+            {
+                misses++;
+                triangleMisses++;
+                cacheTime[v] = misses;
+            }
+        }
+        if (t == 0 || triangleMisses == 3)
+            clusterStarts.push_back(t);
+    }
+    if (clusterStarts.size() < 2)
+        return;
+
+    struct Cluster
+    {
+        uint32_t m_Start;
+        uint32_t m_End;
+        glm::vec3 m_Centroid{ 0.0f };
+        glm::vec3 m_Normal{ 0.0f };
+        float m_SortKey = 0.0f;
+    };
+    std::vector<Cluster> clusters(clusterStarts.size());
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        Cluster& cluster = clusters[c];
+        cluster.m_Start = clusterStarts[c];
+        cluster.m_End = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : nTriangles;
+
+        float clusterArea = 0.0f;
+        for (uint32_t t = cluster.m_Start; t < cluster.m_End; t++)
+        {
+            const glm::vec3& p0 = i_Positions[io_Indices[t * 3]];
+            const glm::vec3& p1 = i_Positions[io_Indices[t * 3 + 1]];
+            const glm::vec3& p2 = i_Positions[io_Indices[t * 3 + 2]];
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);//Length is twice the area, good enough as a weight
+            float area = glm::length(normal);
+            cluster.m_Centroid += (p0 + p1 + p2) * (area / 3.0f);
+            cluster.m_Normal += normal;
+            clusterArea += area;
+        }
+        meshCentroid += cluster.m_Centroid;
+        meshArea += clusterArea;
+        if (clusterArea > 0.0f)
+            cluster.m_Centroid /= clusterArea;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    //Clusters on the outside facing out are the likely occluders, draw them first
+    for (auto& cluster : clusters)
+    {
+        float normalLength = glm::length(cluster.m_Normal);
+        cluster.m_SortKey = normalLength > 0.0f ? glm::dot(cluster.m_Centroid - meshCentroid, cluster.m_Normal / normalLength) : 0.0f;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.m_SortKey > b.m_SortKey; });
+
+    std::vector<uint32_t> output;
+    output.reserve(i_NIndices);
+    for (auto& cluster : clusters)
+        output.insert(output.end(), io_Indices + cluster.m_Start * 3, io_Indices + cluster.m_End * 3);
+    std::copy(output.begin(), output.end(), io_Indices);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(uint32_t* io_Indices, uint32_t i_NIndices, uint32_t i_NVertices, std::vector<uint32_t>& o_Remap)
+{
+    const uint32_t unassigned = UINT32_MAX;
+    o_Remap.assign(i_NVertices, unassigned);
+
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < i_NIndices; i++)
+    {
+        uint32_t& remapped = o_Remap[io_Indices[i]];
+        if (remapped == unassigned)
+            remapped = next++;
+        io_Indices[i] = remapped;
+    }
+    for (auto& remapped : o_Remap)
+    {
+        if (remapped == unassigned)
+            remapped = next++;
+    }
+}
+
+namespace
+{
+    //Sum of squared distances to a set of planes, stored as the symmetric 4x4 matrix upper half
+    struct Quadric
+    {
+        double m_A00 = 0, m_A01 = 0, m_A02 = 0, m_A11 = 0, m_A12 = 0, m_A22 = 0;
+        double m_B0 = 0, m_B1 = 0, m_B2 = 0, m_C = 0;
+        double m_Weight = 0;
+
+        void addPlane(const glm::vec3& n, float d, float weight)
+        {
+            m_A00 += weight * n.x * n.x; m_A01 += weight * n.x * n.y; m_A02 += weight * n.x * n.z;
+            m_A11 += weight * n.y * n.y; m_A12 += weight * n.y * n.z; m_A22 += weight * n.z * n.z;
+            m_B0 += weight * n.x * d; m_B1 += weight * n.y * d; m_B2 += weight * n.z * d;
+            m_C += weight * d * d;
+            m_Weight += weight;
+        }
+        void add(const Quadric& q)
+        {
+            m_A00 += q.m_A00; m_A01 += q.m_A01; m_A02 += q.m_A02; m_A11 += q.m_A11; m_A12 += q.m_A12; m_A22 += q.m_A22;
+            m_B0 += q.m_B0; m_B1 += q.m_B1; m_B2 += q.m_B2; m_C += q.m_C;
+            m_Weight += q.m_Weight;
+        }
+        //Weighted mean squared distance of p to the planes
+        double error(const glm::vec3& p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double e = m_A00 * x * x + 2 * m_A01 * x * y + 2 * m_A02 * x * z + m_A11 * y * y + 2 * m_A12 * y * z + m_A22 * z * z
+                + 2 * (m_B0 * x + m_B1 * y + m_B2 * z) + m_C;
+            return m_Weight > 0 ? std::max(e, 0.0) / m_Weight : 0.0;
+        }
+    };
+
+    struct Collapse
+    {
+        uint32_t m_From;
+        uint32_t m_To;
+        double m_Error;
+    };
+}
+
+float MeshOptimizer::Simplify(const uint32_t* i_Indices, uint32_t i_NIndices, const glm::vec3* i_Positions, uint32_t i_NVertices,
+    uint32_t i_TargetIndexCount, std::vector<uint32_t>& o_Indices)
+{
+    o_Indices.assign(i_Indices, i_Indices + i_NIndices);
+    if (i_NIndices <= i_TargetIndexCount || i_NVertices == 0)
+        return 0.0f;
+
+    //Vertices sharing a position (seams) get locked, sorting keeps this deterministic
+    std::vector<bool> locked(i_NVertices, false);
+    {
+        std::vector<uint32_t> order(i_NVertices);
+        for (uint32_t v = 0; v < i_NVertices; v++)
+            order[v] = v;
+        auto less = [&](uint32_t a, uint32_t b) {
+            const glm::vec3& pa = i_Positions[a];
+            const glm::vec3& pb = i_Positions[b];
+            if (pa.x != pb.x) return pa.x < pb.x;
+            if (pa.y != pb.y) return pa.y < pb.y;
+            if (pa.z != pb.z) return pa.z < pb.z;
+            return a < b;
+        };
+        std::sort(order.begin(), order.end(), less);
+        for (uint32_t i = 1; i < i_NVertices; i++)
+        {
+            if (i_Positions[order[i]] == i_Positions[order[i - 1]])
+                locked[order[i]] = locked[order[i - 1]] = true;
+        }
+    }
+
+    //Border edges (used by a single triangle) lock both ends
+    {
+        std::vector<uint64_t> edges;
+        edges.reserve(i_NIndices);
+        for (uint32_t i = 0; i < i_NIndices; i += 3)
+        {
+            for (uint32_t e = 0; e < 3; e++)
+            {
+                uint32_t a = i_Indices[i + e];
+                uint32_t b = i_Indices[i + (e + 1) % 3];
+                edges.push_back((uint64_t)std::min(a, b) << 32 | std::max(a, b));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size();)
+        {
+            size_t j = i;
+            while (j < edges.size() && edges[j] == edges[i])
+                j++;
+            if (j - i == 1)
+            {
+                locked[edges[i] >> 32] = true;
+                locked[edges[i] & 0xffffffff] = true;
+            }
+            i = j;
+        }
+    }
+
+    std::vector<Quadric> quadrics(i_NVertices);
+    for (uint32_t i = 0; i < i_NIndices; i += 3)
+    {
+        const glm::vec3& p0 = i_Positions[i_Indices[i]];
+        const glm::vec3& p1 = i_Positions[i_Indices[i + 1]];
+        const glm::vec3& p2 = i_Positions[i_Indices[i + 2]];
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(normal);
+        if (area <= 0.0f)
+            continue;
+        normal /= area;
+        float d = -glm::dot(normal, p0);
+        for (uint32_t c = 0; c < 3; c++)
+            quadrics[i_Indices[i + c]].addPlane(normal, d, area);
+    }
+
+    double maxError = 0.0;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(i_NVertices);
+    std::vector<bool> touched(i_NVertices);
+    while (o_Indices.size() > i_TargetIndexCount)
+    {
+        const uint32_t nIndices = static_cast<uint32_t>(o_Indices.size());
+        TriangleAdjacency adjacency(o_Indices.data(), nIndices, i_NVertices);
+
+        collapses.clear();
+        for (uint32_t i = 0; i < nIndices; i += 3)
+        {
+            for (uint32_t e = 0; e < 3; e++)
+            {
+                uint32_t a = o_Indices[i + e];
+                uint32_t b = o_Indices[i + (e + 1) % 3];
+                Quadric q = quadrics[a];
+                q.add(quadrics[b]);
+                if (!locked[a])
+                    collapses.push_back({ a, b, q.error(i_Positions[b]) });
+                if (!locked[b])
+                    collapses.push_back({ b, a, q.error(i_Positions[a]) });
+            }
+        }
+        if (collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) {
+            if (x.m_Error != y.m_Error) return x.m_Error < y.m_Error;
+            if (x.m_From != y.m_From) return x.m_From < y.m_From;
+            return x.m_To < y.m_To;
+        });
+
+        //Independent collapses only, so the flip test done against the current mesh stays valid for the whole pass
+        for (uint32_t v = 0; v < i_NVertices; v++)
+            remap[v] = v;
+        std::fill(touched.begin(), touched.end(), false);
+        const uint32_t trianglesToRemove = (nIndices - i_TargetIndexCount) / 3;
+        uint32_t removed = 0;
+        for (const Collapse& collapse : collapses)
+        {
+            if (removed >= trianglesToRemove)
+                break;
+            uint32_t a = collapse.m_From;
+            uint32_t b = collapse.m_To;
+            if (touched[a] || touched[b])
+                continue;
+
+            //Reject collapses that flip or degenerate any triangle around a that survives
+            bool valid = true;
+            uint32_t shared = 0;
+            for (uint32_t t = adjacency.m_Offsets[a]; t < adjacency.m_Offsets[a + 1] && valid; t++)
+            {
+                const uint32_t* tri = &o_Indices[adjacency.m_Triangles[t] * 3];
+                if (tri[0] == b || tri[1] == b || tri[2] == b)
+                {
+                    shared++;
+                    continue;
+                }
+                glm::vec3 p[3], q[3];
+                for (uint32_t c = 0; c < 3; c++)
+                {
+                    p[c] = i_Positions[tri[c]];
+                    q[c] = tri[c] == a ? i_Positions[b] : p[c];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                if (glm::dot(before, after) <= 0.0f)
+                    valid = false;
+            }
+            if (!valid || shared == 0)
+                continue;
+
+            remap[a] = b;
+            quadrics[b].add(quadrics[a]);
+            maxError = std::max(maxError, collapse.m_Error);
+            removed += shared;
+            for (uint32_t t = adjacency.m_Offsets[a]; t < adjacency.m_Offsets[a + 1]; t++)
+            {
+                const uint32_t* tri = &o_Indices[adjacency.m_Triangles[t] * 3];
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+            }
+        }
+        if (removed == 0)
+            break;
+
+        //Apply the pass and drop the triangles that collapsed
+        uint32_t write = 0;
+        for (uint32_t i = 0; i < nIndices; i += 3)
+        {
+            uint32_t a = remap[o_Indices[i]];
+            uint32_t b = remap[o_Indices[i + 1]];
+            uint32_t c = remap[o_Indices[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            o_Indices[write++] = a;
+            o_Indices[write++] = b;
+            o_Indices[write++] = c;
+        }
+        o_Indices.resize(write);
+    }
+    return static_cast<float>(std::sqrt(maxError));
+}
+
+//Bounding sphere and normal cone of the triangles [i_Start, i_Start + i_NIndices), cone test as in meshoptimizer: the cluster
+//is backfacing for every triangle when dot(center - eye, axis) >= cutoff * |center - eye| + radius
+static Meshlet computeMeshletBounds(const uint32_t* i_Indices, uint32_t i_Start, uint32_t i_NIndices, const glm::vec3* i_Positions)
+{
+    glm::vec3 boundsMin(FLT_MAX);
+    glm::vec3 boundsMax(-FLT_MAX);
+    glm::vec3 normalSum(0.0f);
+    std::vector<glm::vec3> normals;
+    normals.reserve(i_NIndices / 3);
+    for (uint32_t i = i_Start; i < i_Start + i_NIndices; i += 3)
+    {
+        const glm::vec3& p0 = i_Positions[i_Indices[i]];
+        const glm::vec3& p1 = i_Positions[i_Indices[i + 1]];
+        const glm::vec3& p2 = i_Positions[i_Indices[i + 2]];
+        boundsMin = glm::min(boundsMin, glm::min(p0, glm::min(p1, p2)));
+        boundsMax = glm::max(boundsMax, glm::max(p0, glm::max(p1, p2)));
+
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if (length > 0.0f)
+        {
+            normals.push_back(normal / length);
+            normalSum += normals.back();
+        }
+    }
+
+    Meshlet meshlet;
+    meshlet.m_IndicesMeshStart = i_Start;
+    meshlet.m_NIndices = i_NIndices;
+    meshlet.m_Center = (boundsMin + boundsMax) * 0.5f;
+    meshlet.m_Radius = 0.0f;
+    for (uint32_t i = i_Start; i < i_Start + i_NIndices; i++)
+        meshlet.m_Radius = (std::max)(meshlet.m_Radius, glm::length(i_Positions[i_Indices[i]] - meshlet.m_Center));
+
+    float axisLength = glm::length(normalSum);
+    meshlet.m_ConeAxis = axisLength > 0.0f ? normalSum / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+    float minDot = axisLength > 0.0f ? 1.0f : -1.0f;
+    for (auto& normal : normals)
+        minDot = (std::min)(minDot, glm::dot(normal, meshlet.m_ConeAxis));
+
+    //Cones wider than about 84 degrees are close to never culled, don't bother
+    meshlet.m_ConeCutoff = minDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+    return meshlet;
+}
+
+void MeshOptimizer::BuildMeshlets(const uint32_t* i_Indices, uint32_t i_NIndices, const glm::vec3* i_Positions, uint32_t i_NVertices, std::vector<Meshlet>& o_Meshlets,
+    uint32_t i_MaxVertices, uint32_t i_MaxTriangles)
+{
+    //Last meshlet a vertex was counted in, so the unique vertex count of the open meshlet is a lookup per index
+    std::vector<uint32_t> vertexMeshlet(i_NVertices, UINT32_MAX);
+    uint32_t meshletIndex = 0;
+    uint32_t meshletStart = 0;
+    uint32_t meshletVertices = 0;
+
+    for (uint32_t i = 0; i + 2 < i_NIndices; i += 3)
+    {
+        uint32_t newVertices = 0;
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            uint32_t v = i_Indices[i + corner];
+            bool repeated = vertexMeshlet[v] == meshletIndex || (corner > 0 && v == i_Indices[i]) || (corner > 1 && v == i_Indices[i + 1]);
+            newVertices += repeated ? 0 : 1;
+        }
+
+        if (meshletVertices + newVertices > i_MaxVertices || (i - meshletStart) / 3 >= i_MaxTriangles)
+        {
+            o_Meshlets.push_back(computeMeshletBounds(i_Indices, meshletStart, i - meshletStart, i_Positions));
+            meshletIndex++;
+            meshletStart = i;
+            meshletVertices = 0;
+            newVertices = 0;
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                uint32_t v = i_Indices[i + corner];
+                newVertices += (corner > 0 && v == i_Indices[i]) || (corner > 1 && v == i_Indices[i + 1]) ? 0 : 1;
+            }
+        }
+
+        for (uint32_t corner = 0; corner < 3; corner++)
+            vertexMeshlet[i_Indices[i + corner]] = meshletIndex;
+        meshletVertices += newVertices;
+    }
+
+    uint32_t end = i_NIndices / 3 * 3;
+    if (end > meshletStart)
+        o_Meshlets.push_back(computeMeshletBounds(i_Indices, meshletStart, end - meshletStart, i_Positions));
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "Renderer/Common/GLMInclude.h"
+#include "Renderer/Common/Mesh.h"
+#include <vector>
+#include <stdint.h>
+
+#define MESH_OPTIMIZER_CACHE_SIZE 16 //Post transform cache entries we optimize and measure for, FIFO
+#define MESH_OPTIMIZER_MESHLET_VERTICES 64
+#define MESH_OPTIMIZER_MESHLET_TRIANGLES 124
+
+/**
+ * @brief Import time index and vertex reordering for triangle lists
+ *
+ * Everything works on a single mesh range with mesh local indices and is deterministic (no hashing, no threads inside), so
+ * the result can be baked and different meshes can be processed in parallel. Typical order is vertex cache, then overdraw,
+ * then vertex fetch since the last one only renames vertices.
+ */
+class MeshOptimizer
+{
+public:
+    //Average cache miss ratio: transformed vertices per triangle with a FIFO cache, 0.5 is about the best possible, 3 the worst
+    static float ComputeACMR(const uint32_t* i_Indices, uint32_t i_NIndices, uint32_t i_NVertices, uint32_t i_CacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+
+    //Tipsify (Sander, Nehab, Barczak 2007) triangle reordering, in place
+    static void OptimizeVertexCache(uint32_t* io_Indices, uint32_t i_NIndices, uint32_t i_NVertices, uint32_t i_CacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+
+    /**
+     * @brief Splits a cache optimized index list into clusters at the cache restarts and sorts them so outward facing ones draw first
+     * @param i_Positions Mesh local positions, indexed by i_Indices
+     */
+    static void OptimizeOverdraw(uint32_t* io_Indices, uint32_t i_NIndices, const glm::vec3* i_Positions, uint32_t i_NVertices, uint32_t i_CacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+
+    /**
+     * @brief Renames vertices in order of first use so fetches walk memory linearly
+     * @param o_Remap Old vertex index -> new one, apply it to every vertex stream with RemapStream. Unused vertices go last
+     */
+    static void OptimizeVertexFetch(uint32_t* io_Indices, uint32_t i_NIndices, uint32_t i_NVertices, std::vector<uint32_t>& o_Remap);
+
+    /**
+     * @brief Quadric error simplification by edge collapse, vertices only ever collapse onto existing ones so the result indexes the same vertices
+     * @param i_TargetIndexCount Stops once the index count is at or below it, or when nothing else can collapse
+     * @return Geometric error of the result in position units (square root of the worst collapse quadric error)
+     *
+     * Vertices on open borders or sharing their position with another vertex (uv and normal seams) are locked so the
+     * simplified mesh never opens cracks.
+     */
+    static float Simplify(const uint32_t* i_Indices, uint32_t i_NIndices, const glm::vec3* i_Positions, uint32_t i_NVertices,
+        uint32_t i_TargetIndexCount, std::vector<uint32_t>& o_Indices);
+
+    /**
+     * @brief Cuts the index list in runs of consecutive triangles touching at most i_MaxVertices different vertices
+     * @param o_Meshlets Appended to, index starts are relative to i_Indices. Run it after the cache optimization so the runs are compact
+     */
+    static void BuildMeshlets(const uint32_t* i_Indices, uint32_t i_NIndices, const glm::vec3* i_Positions, uint32_t i_NVertices, std::vector<Meshlet>& o_Meshlets,
+        uint32_t i_MaxVertices = MESH_OPTIMIZER_MESHLET_VERTICES, uint32_t i_MaxTriangles = MESH_OPTIMIZER_MESHLET_TRIANGLES);
+
+    template <typename T>
+    static void RemapStream(T* io_Stream, const std::vector<uint32_t>& i_Remap)
+    {
+        std::vector<T> original(io_Stream, io_Stream + i_Remap.size());
+        for (size_t v = 0; v < i_Remap.size(); v++)
+            io_Stream[i_Remap[v]] = original[v];
+    }
+};
@@ -5,13 +5,13 @@
 #include <Core/ServiceLocator.h>
 #include "Core/Scene.h"
 
-Model::Model(const Mesh& i_Mesh, MeshView meshView, Scene& parentScene,  std::string name ):
-    m_Mesh(i_Mesh),
-    m_MeshView(meshView),
+Model::Model(ModelStore& i_Store, ModelHandle i_Handle, Scene& parentScene,  std::string name ):
+    m_Store(i_Store),
+    m_Handle(i_Handle),
+    m_Lods{ i_Store.getMeshViewIndex(i_Handle) },
     m_ParentScene(parentScene),
     m_Name(name)
 {
-    m_AABB.reset();
     m_Translation = glm::vec3(0.0);
     m_Scale = glm::vec3(1.0);
     m_Rotation = glm::quat();
@@ -20,7 +20,8 @@ Model::Model(const Mesh& i_Mesh, MeshView meshView, Scene& parentScene,  std::st
 void Model::SetMaterial(Material* i_Mat)
 {
     m_Material = i_Mat;
-    m_InstanceUniforms.matId = i_Mat->getMaterialIndex();
+    m_Store.setMaterialIndex(m_Handle, i_Mat->getMaterialIndex());
+    m_Store.setFlag(m_Handle, ModelFlag_Transparent, i_Mat->isTransparent());
     computeShaderVariant();
 }
 
@@ -34,36 +35,33 @@ glm::vec3 Model::GetRotation()
 void Model::Rotate(const glm::vec3& i_Eulers)
 {
     m_Rotation = glm::quat(glm::radians(i_Eulers));
-    m_Dirty = true;
-    m_ParentScene.SetDirty();//All this dirty stuff can be improved with a tree and the models hanging from the Scene root node propagating dirty upwards
+    SetDirty();
 
 }
 void Model::Translate(const glm::vec3& i_TranslateVec)
 {
   m_Translation = i_TranslateVec;
-  m_Dirty = true;
-  m_ParentScene.SetDirty();
+  SetDirty();
 
 }
 
 void Model::Scale(const glm::vec3& i_ScaleVec)
 {
   m_Scale = i_ScaleVec;
-  m_Dirty = true;
-  m_ParentScene.SetDirty();
+  SetDirty();
 
 }
 
 
 void Model::SetTransform(glm::mat4 transformMat)
 {
-    m_InstanceUniforms.model = transformMat;
+    m_LocalMatrix = transformMat;
     glm::vec3 skew;
     glm::vec4 persp;
     glm::decompose(transformMat, m_Scale, m_Rotation, m_Translation, skew, persp);
+    m_Translation = -m_Translation;//Stored negated, see computeModelMatrix
 
-    m_Dirty = true;
-    m_ParentScene.SetDirty();
+    SetDirty();
     
 }
 
@@ -74,10 +72,9 @@ void Model::computeModelMatrix()
     scaleMatrix = glm::scale(scaleMatrix, m_Scale);
     glm::mat4 translationMatrix;
     translationMatrix = glm::translate(translationMatrix, -m_Translation);
-    m_InstanceUniforms.model = translationMatrix * rotationMatrix * scaleMatrix;
+    m_LocalMatrix = translationMatrix * rotationMatrix * scaleMatrix;
 
     //ServiceLocator::GetRenderer()->SceneDirty();//TODO:: do this better, again, listener? scene traversals?
-    updateAABB();
     m_Dirty = false;
 }
 
@@ -85,29 +82,81 @@ void Model::computeModelMatrix()
 
 
 
+//Moved models queue themselves in the scene once, the next update recomputes their transforms
+void Model::SetDirty()
+{
+    if (m_Dirty)
+        return;
+    m_Dirty = true;
+    m_ParentScene.SetModelDirty(*this);
+}
+
 void Model::computeShaderVariant()
 {
 
     if (m_Material != nullptr)
     {
-        for (auto& texture : *m_Material->getTextures())
+        //Bindless materials pick their textures by index at runtime, one variant for all of them.
+        //Otherwise which textures a material has is a specialization constant set when drawing, still one shader for all of them
+        if (ServiceLocator::GetRenderer()->SupportsBindlessTextures())
         {
-            std::string tex_name = texture.first;
-            std::transform(tex_name.begin(), tex_name.end(), tex_name.begin(), ::toupper);
-
-            m_Variant.add_define("HAS_" + tex_name);
+            m_Variant.add_define("BINDLESS_TEXTURES");
         }
-        m_Mesh.computeShaderVariant(m_Variant);
+        GetMesh().computeShaderVariant(m_Variant);
     }
+    m_Store.setVariantKey(m_Handle, m_ParentScene.GetVariantKey(m_Variant));
 
 }
 void Model::updateAABB()
 {
-     
-    const uint32_t* indices = m_Mesh.GetIndicesData() + m_MeshView.m_IndicesMeshStart;
-    const glm::vec3* verticesPos = m_Mesh.GetPositionsData() + m_MeshView.m_VerticesMeshStart;
-    
-    m_AABB.reset();//TODO: Do I have to do all this everytime I transform? is going thru the mesh necessr?
-    m_AABB.update(verticesPos, m_MeshView.m_NVertices, indices, m_MeshView.m_NIndices);
-    m_AABB.transform(m_InstanceUniforms.model);
-}
\ No newline at end of file
+    m_Store.updateWorldBounds(&m_Handle, 1);
+}
+
+void Model::SetLods(const std::vector<uint32_t>& i_Lods)
+{
+    if (i_Lods.empty())
+        return;
+    m_Lods = i_Lods;
+    m_CurrentLod = 0;
+    m_Store.setMeshViewIndex(m_Handle, m_Lods[0]);
+    const MeshView& fullDetail = m_Store.getMeshView(m_Lods[0]).m_View;
+    m_Store.setLocalAABB(m_Handle, AABB(fullDetail.m_BoundsMin, fullDetail.m_BoundsMax));//The box shouldn't change with the level of detail
+}
+
+bool Model::selectLod(const glm::vec3& i_CameraPos, float i_ProjScale, float i_PixelError)
+{
+    if (m_Lods.size() < 2)
+        return false;
+
+    //Coarsest level within the threshold, and coarsest one far enough under it to switch to
+    uint32_t refineTo = 0;
+    uint32_t coarsenTo = 0;
+    float distance = glm::length(glm::clamp(i_CameraPos, m_Store.getBoundsMin()[m_Handle], m_Store.getBoundsMax()[m_Handle]) - i_CameraPos);
+    if (distance > 0.0f)
+    {
+        //Errors are in model space, the biggest axis scale bounds what the transform does to them
+        const glm::mat4& model = m_Store.getWorldMatrix(m_Handle);
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        float pixelsPerUnit = i_ProjScale * scale / distance;
+        for (uint32_t lod = 1; lod < m_Lods.size(); lod++)
+        {
+            float pixels = m_Store.getMeshView(m_Lods[lod]).m_View.m_LodError * pixelsPerUnit;
+            if (pixels <= i_PixelError)
+                refineTo = lod;
+            if (pixels <= i_PixelError * (1.0f - SCENE_LOD_HYSTERESIS))
+                coarsenTo = lod;
+        }
+    }
+
+    uint32_t lod = m_CurrentLod;
+    if (lod > refineTo)
+        lod = refineTo;
+    else if (lod < coarsenTo)
+        lod = coarsenTo;
+    if (lod == m_CurrentLod)
+        return false;
+
+    m_CurrentLod = lod;
+    m_Store.setMeshViewIndex(m_Handle, m_Lods[lod]);
+    return true;
+}
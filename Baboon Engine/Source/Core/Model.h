@@ -3,15 +3,19 @@
 #include "Renderer\Common\Mesh.h"
 #include "Core\Material.h"
 #include "aabb.h"
+#include "ModelStore.h"
 #include <glm/gtc/quaternion.hpp> 
 #include <glm/gtx/quaternion.hpp>
 
 
 class Scene;
 
-struct alignas(16) InstanceUBO {
+//One element of the per frame instance buffer, everything the vertex shaders need per model, read at gl_InstanceIndex
+struct InstanceUBO {
 	glm::mat4 model;
-  uint8_t matId;
+	glm::vec4 positionOffset;//Dequantization of the mesh view drawn, only read for compact vertices
+	glm::vec4 positionScale;
+	glm::vec4 info;//x material index, passed on to the fragment shader
 };
 
 
@@ -19,10 +23,12 @@ struct alignas(16) InstanceUBO {
 class Model
 {
 public:
-  Model(const Mesh& mesh, MeshView meshView, Scene& parent, std::string name = " ");
+  //The hot data lives in i_Store under i_Handle, already added with the full detail view
+  Model(ModelStore& i_Store, ModelHandle i_Handle, Scene& parent, std::string name = " ");
  
 
-	const Mesh& GetMesh()const { return m_Mesh; }
+  ModelHandle GetHandle() const { return m_Handle; }
+	const Mesh& GetMesh()const { return *m_Store.getDrawView(m_Handle).m_Mesh; }
 
   void SetMaterial(Material* i_Mat);
 	Material* GetMaterial()const { return m_Material; }
@@ -39,32 +45,53 @@ public:
   glm::vec3 GetRotation();
 
 
-  bool IsVisible() { return true; }//TODO: implement visibility check here
+  bool IsVisible() const { return m_Store.hasFlag(m_Handle, ModelFlag_Visible); }//Main camera, as of the last Scene::Update
 
 
-  const glm::mat4& getModelMatrix()const { return m_InstanceUniforms.model; }
-  const InstanceUBO& getInstanceUBO()const { return m_InstanceUniforms; }
-  const AABB& getAABB() { return m_AABB; }
+  const glm::mat4& getModelMatrix()const { return m_Store.getWorldMatrix(m_Handle); }
+  AABB getAABB() const { return m_Store.getWorldAABB(m_Handle); }
+  const AABB& getLocalAABB() const { return m_Store.getLocalAABB(m_Handle); }
 
   const ShaderVariant& getShaderVariant()const { return m_Variant; }
-  void updateAABB();
-  void computeModelMatrix();
-
-  const uint32_t GetIndexStartPosition() const { return m_MeshView.m_IndicesMeshStart; }
-  const uint32_t GetVertexStartPosition() const { return m_MeshView.m_VerticesMeshStart; }
-  const uint32_t GetNIndices() const { return m_MeshView.m_NIndices; }
+  void updateAABB();//Single model version, Scene::Update does every moved model in one batch
+  void computeModelMatrix();//Local matrix out of translation, rotation and scale, the scene graph turns it into the world one
+  const glm::mat4& getLocalMatrix() const { return m_LocalMatrix; }
+
+  //Scene graph node carrying the model transform
+  void SetNode(uint32_t i_Node) { m_Node = i_Node; }
+  uint32_t GetNode() const { return m_Node; }
+
+  const uint32_t GetIndexStartPosition() const { return GetMeshView().m_IndicesMeshStart; }//Arena offsets, ready for the draw call
+  const uint32_t GetVertexStartPosition() const { return GetMeshView().m_VerticesMeshStart; }
+  const uint32_t GetNIndices() const { return GetMeshView().m_NIndices; }
+  const MeshView& GetMeshView() const { return m_Store.getDrawView(m_Handle).m_View; }
+  PositionDequantization getPositionDequantization() const { return Mesh::GetPositionDequantization(GetMeshView()); }
+
+  //Store mesh views, level 0 is the full detail view and the rest are simplified versions of it with increasing error
+  void SetLods(const std::vector<uint32_t>& i_Lods);
+  uint32_t GetLodCount() const { return static_cast<uint32_t>(m_Lods.size()); }
+  uint32_t GetCurrentLod() const { return m_CurrentLod; }
+  uint32_t GetLodView(uint32_t i_Lod) const { return m_Lods[i_Lod]; }
+
+  /**
+   * @brief Picks the coarsest level whose error stays under i_PixelError on screen, with some hysteresis against popping
+   * @param i_ProjScale Pixels covered by one world unit at distance one
+   * @return true if the level changed
+   */
+  bool selectLod(const glm::vec3& i_CameraPos, float i_ProjScale, float i_PixelError);
   const std::string& getName()const { return m_Name; }
-  void SetSelection(bool select) { m_Selected = select; }
+  void SetSelection(bool select) { m_Store.setFlag(m_Handle, ModelFlag_Selected, select); }
 
   bool GetDirty() { return m_Dirty; }
-  void SetDirty() { m_Dirty = true; }
+  void SetDirty();
 private:
    
   std::string m_Name;
-	const Mesh& m_Mesh;
-  bool m_Selected = false;
+  ModelStore& m_Store;
+  ModelHandle m_Handle;
   
-  MeshView m_MeshView;
+  std::vector<uint32_t> m_Lods;//Store mesh views, the one being drawn is the store mesh view index
+  uint32_t m_CurrentLod = 0;
 
 	Material* m_Material = nullptr;
   ShaderVariant m_Variant;
@@ -72,16 +99,14 @@ private:
 
   bool m_Dirty = false;
 
-  AABB m_AABB;
-  Scene& m_ParentScene; //To be replaced by the tree hierarchy
+  Scene& m_ParentScene;
+  uint32_t m_Node = 0;
+  glm::mat4 m_LocalMatrix;
 
   glm::vec3 m_Translation;
   glm::vec3 m_Scale;
   glm::quat m_Rotation;
 
-	InstanceUBO m_InstanceUniforms;
-	int m_iInstanceUniformIndex;
-
   void computeShaderVariant();
   
 };
@@ -0,0 +1,66 @@
+#include "ModelStore.h"
+
+uint32_t ModelStore::addMeshView(const Mesh& i_Mesh, const MeshView& i_View)
+{
+    ModelMeshView view;
+    view.m_Mesh = &i_Mesh;
+    view.m_View = i_View;
+    m_MeshViews.push_back(view);
+    return static_cast<uint32_t>(m_MeshViews.size() - 1);
+}
+
+ModelHandle ModelStore::addModel(uint32_t i_MeshView, uint32_t i_MaterialIndex, uint8_t i_Flags)
+{
+    const MeshView& view = m_MeshViews[i_MeshView].m_View;
+    m_WorldMatrices.push_back(glm::mat4(1.0f));
+    m_BoundsMin.push_back(view.m_BoundsMin);
+    m_BoundsMax.push_back(view.m_BoundsMax);
+    m_LocalBounds.push_back(AABB(view.m_BoundsMin, view.m_BoundsMax));
+    m_MaterialIndices.push_back(i_MaterialIndex);
+    m_MeshViewIndices.push_back(i_MeshView);
+    m_Flags.push_back(i_Flags);
+    m_VariantKeys.push_back(0);
+    return static_cast<ModelHandle>(m_Flags.size() - 1);
+}
+
+void ModelStore::clear()
+{
+    m_MeshViews.clear();
+    m_WorldMatrices.clear();
+    m_BoundsMin.clear();
+    m_BoundsMax.clear();
+    m_LocalBounds.clear();
+    m_MaterialIndices.clear();
+    m_MeshViewIndices.clear();
+    m_Flags.clear();
+    m_VariantKeys.clear();
+}
+
+void ModelStore::setFlag(ModelHandle i_Model, ModelFlags i_Flag, bool i_Value)
+{
+    if (i_Value)
+        m_Flags[i_Model] |= i_Flag;
+    else
+        m_Flags[i_Model] &= ~i_Flag;
+}
+
+void ModelStore::updateWorldBounds(const ModelHandle* i_Models, size_t i_Count)
+{
+    if (i_Count == 0)
+        return;
+
+    m_ScratchLocal.resize(i_Count);
+    m_ScratchTransforms.resize(i_Count);
+    m_ScratchWorld.resize(i_Count);
+    for (size_t i = 0; i < i_Count; i++)
+    {
+        m_ScratchLocal[i] = m_LocalBounds[i_Models[i]];
+        m_ScratchTransforms[i] = m_WorldMatrices[i_Models[i]];
+    }
+    AABB::transformBatch(m_ScratchLocal.data(), m_ScratchTransforms.data(), m_ScratchWorld.data(), i_Count);
+    for (size_t i = 0; i < i_Count; i++)
+    {
+        m_BoundsMin[i_Models[i]] = m_ScratchWorld[i].get_min();
+        m_BoundsMax[i_Models[i]] = m_ScratchWorld[i].get_max();
+    }
+}
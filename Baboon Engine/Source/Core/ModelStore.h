@@ -0,0 +1,91 @@
+#pragma once
+#include "Renderer/Common/GLMInclude.h"
+#include "Renderer/Common/Mesh.h"
+#include "aabb.h"
+#include <vector>
+#include <stdint.h>
+
+//Index of a model in every ModelStore array. Models are only ever added and all of them go away with the scene, so it never moves
+typedef uint32_t ModelHandle;
+#define MODEL_HANDLE_NONE UINT32_MAX
+
+enum ModelFlags : uint8_t
+{
+    ModelFlag_Transparent = 1 << 0,
+    ModelFlag_Selected = 1 << 1,
+    ModelFlag_Visible = 1 << 2,//Inside the main camera frustum
+    ModelFlag_ShadowVisible = 1 << 3,//Inside the frustum of at least one shadow camera
+    ModelFlag_Occluder = 1 << 4,//Rasterized into the occlusion culling depth buffer
+    ModelFlag_Instanced = 1 << 5//Drawn in an instanced run of its opaque or transparent queue, whole, without cluster culling
+};
+
+//A drawable range of a mesh, shared by every model (and level of detail) pointing at it
+struct ModelMeshView
+{
+    const Mesh* m_Mesh = nullptr;
+    MeshView m_View;//Arena relative
+};
+
+/**
+ * @brief Per model data the frame touches, one contiguous array per field
+ *
+ * Batching, culling and command recording walk these arrays by handle instead of going through the Model objects, which keep
+ * what only the editor and the loading code care about (name, translation/rotation/scale, levels of detail, shader variant).
+ * The mesh view index picks the level of detail being drawn, switching levels is just rewriting it.
+ */
+class ModelStore
+{
+public:
+    uint32_t addMeshView(const Mesh& i_Mesh, const MeshView& i_View);
+    uint32_t getMeshViewCount() const { return static_cast<uint32_t>(m_MeshViews.size()); }
+    const ModelMeshView& getMeshView(uint32_t i_View) const { return m_MeshViews[i_View]; }
+
+    //Local bounds come from the view, the world ones stay equal to them until the first transform update
+    ModelHandle addModel(uint32_t i_MeshView, uint32_t i_MaterialIndex, uint8_t i_Flags);
+    void clear();
+    uint32_t size() const { return static_cast<uint32_t>(m_Flags.size()); }
+
+    const glm::mat4* getWorldMatrices() const { return m_WorldMatrices.data(); }
+    const glm::vec3* getBoundsMin() const { return m_BoundsMin.data(); }
+    const glm::vec3* getBoundsMax() const { return m_BoundsMax.data(); }
+    const uint32_t* getMaterialIndices() const { return m_MaterialIndices.data(); }
+    const uint32_t* getMeshViewIndices() const { return m_MeshViewIndices.data(); }
+    const uint8_t* getFlags() const { return m_Flags.data(); }
+    const uint16_t* getVariantKeys() const { return m_VariantKeys.data(); }
+
+    const glm::mat4& getWorldMatrix(ModelHandle i_Model) const { return m_WorldMatrices[i_Model]; }
+    void setWorldMatrix(ModelHandle i_Model, const glm::mat4& i_World) { m_WorldMatrices[i_Model] = i_World; }
+    AABB getWorldAABB(ModelHandle i_Model) const { return AABB(m_BoundsMin[i_Model], m_BoundsMax[i_Model]); }
+    const AABB& getLocalAABB(ModelHandle i_Model) const { return m_LocalBounds[i_Model]; }
+    void setLocalAABB(ModelHandle i_Model, const AABB& i_Local) { m_LocalBounds[i_Model] = i_Local; }
+    uint32_t getMaterialIndex(ModelHandle i_Model) const { return m_MaterialIndices[i_Model]; }
+    void setMaterialIndex(ModelHandle i_Model, uint32_t i_MaterialIndex) { m_MaterialIndices[i_Model] = i_MaterialIndex; }
+    uint32_t getMeshViewIndex(ModelHandle i_Model) const { return m_MeshViewIndices[i_Model]; }
+    void setMeshViewIndex(ModelHandle i_Model, uint32_t i_View) { m_MeshViewIndices[i_Model] = i_View; }
+    //Small per scene id of the model shader variant, what the render queue sorts pipelines by
+    uint16_t getVariantKey(ModelHandle i_Model) const { return m_VariantKeys[i_Model]; }
+    void setVariantKey(ModelHandle i_Model, uint16_t i_Key) { m_VariantKeys[i_Model] = i_Key; }
+    const ModelMeshView& getDrawView(ModelHandle i_Model) const { return m_MeshViews[m_MeshViewIndices[i_Model]]; }
+    bool hasFlag(ModelHandle i_Model, ModelFlags i_Flag) const { return (m_Flags[i_Model] & i_Flag) != 0; }
+    void setFlag(ModelHandle i_Model, ModelFlags i_Flag, bool i_Value);
+
+    //World bounds of the given models out of their local ones and current world matrix, in one AABB::transformBatch call
+    void updateWorldBounds(const ModelHandle* i_Models, size_t i_Count);
+
+private:
+    std::vector<ModelMeshView> m_MeshViews;
+
+    std::vector<glm::mat4> m_WorldMatrices;
+    std::vector<glm::vec3> m_BoundsMin;
+    std::vector<glm::vec3> m_BoundsMax;
+    std::vector<AABB> m_LocalBounds;//Full detail level, levels of detail don't change the box
+    std::vector<uint32_t> m_MaterialIndices;
+    std::vector<uint32_t> m_MeshViewIndices;
+    std::vector<uint8_t> m_Flags;
+    std::vector<uint16_t> m_VariantKeys;
+
+    //Scratch for updateWorldBounds, kept around so moving things every frame doesn't allocate
+    std::vector<AABB> m_ScratchLocal;
+    std::vector<glm::mat4> m_ScratchTransforms;
+    std::vector<AABB> m_ScratchWorld;
+};
@@ -0,0 +1,310 @@
+#define NOMINMAX
+#include "OcclusionCuller.h"
+#include "ParallelJobs.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+OcclusionCuller::OcclusionCuller()
+{
+    uint32_t width = OCCLUSION_BUFFER_WIDTH;
+    uint32_t height = OCCLUSION_BUFFER_HEIGHT;
+    m_Levels.emplace_back(width * height, 0.0f);
+    while (width > 1 || height > 1)
+    {
+        width = (std::max)(1u, width / 2);
+        height = (std::max)(1u, height / 2);
+        m_Levels.emplace_back(width * height, 0.0f);
+    }
+}
+
+void OcclusionCuller::cull(const ModelStore& i_Models, const glm::mat4& i_ViewProj, const std::vector<OcclusionOccluder>& i_Occluders, uint8_t i_Bit, std::vector<uint8_t>& io_Masks, ThreadPool* i_ThreadPool)
+{
+    auto rasterStart = std::chrono::high_resolution_clock::now();
+    m_ViewProj = i_ViewProj;
+    m_Stats = OcclusionStats();
+
+    setupTriangles(i_Models, i_Occluders, i_Bit, io_Masks);
+    runJobs(i_ThreadPool, OCCLUSION_BUFFER_HEIGHT / OCCLUSION_BAND_HEIGHT, [this](uint32_t band) { rasterizeBand(band); });
+    buildHierarchy();
+    m_Stats.m_Triangles = static_cast<uint32_t>(m_Triangles.size());
+
+    auto testStart = std::chrono::high_resolution_clock::now();
+    m_Stats.m_RasterMicroseconds = std::chrono::duration<float, std::micro>(testStart - rasterStart).count();
+
+    //Nothing went into the depth buffer, nothing can be behind it
+    if (!m_Triangles.empty())
+    {
+        const uint32_t nModels = i_Models.size();
+        const glm::vec3* boundsMin = i_Models.getBoundsMin();
+        const glm::vec3* boundsMax = i_Models.getBoundsMax();
+        const uint32_t nJobs = (std::max)(1u, nModels / OCCLUSION_MODELS_PER_JOB);
+        const uint32_t jobSize = (nModels + nJobs - 1) / nJobs;
+        std::vector<uint32_t> tested(nJobs, 0);
+        std::vector<uint32_t> occluded(nJobs, 0);
+        uint8_t* masks = io_Masks.data();
+        runJobs(i_ThreadPool, nJobs, [&](uint32_t job) {
+            const uint32_t end = (std::min)(nModels, (job + 1) * jobSize);
+            for (ModelHandle model = job * jobSize; model < end; model++)
+            {
+                if (!(masks[model] & i_Bit) || m_Rasterized[model])
+                    continue;
+                tested[job]++;
+                if (isOccluded(boundsMin[model], boundsMax[model]))
+                {
+                    masks[model] &= ~i_Bit;
+                    occluded[job]++;
+                }
+            }
+        });
+        for (uint32_t job = 0; job < nJobs; job++)
+        {
+            m_Stats.m_Tested += tested[job];
+            m_Stats.m_Occluded += occluded[job];
+        }
+    }
+    m_Stats.m_TestMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - testStart).count();
+}
+
+//Clip space triangles of every occluder inside the view, until the triangle budget runs out
+void OcclusionCuller::setupTriangles(const ModelStore& i_Models, const std::vector<OcclusionOccluder>& i_Occluders, uint8_t i_Bit, const std::vector<uint8_t>& i_Masks)
+{
+    m_Triangles.clear();
+    m_Rasterized.assign(i_Models.size(), 0);
+    for (const OcclusionOccluder& occluder : i_Occluders)
+    {
+        if (!(i_Masks[occluder.m_Model] & i_Bit))
+            continue;
+
+        //The store views are arena relative, the CPU copies of the mesh are indexed from the start of the mesh
+        const ModelMeshView& meshView = i_Models.getMeshView(occluder.m_MeshView);
+        const MeshView& view = meshView.m_View;
+        const GeometryAllocation& geometry = meshView.m_Mesh->GetGeometry();
+        const uint32_t* indices = meshView.m_Mesh->GetIndicesData() + (view.m_IndicesMeshStart - geometry.m_IndexOffset);
+        const glm::vec3* positions = meshView.m_Mesh->GetPositionsData() + (view.m_VerticesMeshStart - geometry.m_VertexOffset);
+        if (m_Triangles.size() + view.m_NIndices / 3 > OCCLUSION_MAX_TRIANGLES)
+            continue;//A smaller one further down the list may still fit
+
+        const glm::mat4 modelViewProj = m_ViewProj * i_Models.getWorldMatrix(occluder.m_Model);
+        m_ClipVertices.resize(view.m_NVertices);
+        for (uint32_t vertex = 0; vertex < view.m_NVertices; vertex++)
+            m_ClipVertices[vertex] = modelViewProj * glm::vec4(positions[vertex], 1.0f);
+        for (uint32_t index = 0; index + 2 < view.m_NIndices; index += 3)
+            addTriangle(m_ClipVertices[indices[index]], m_ClipVertices[indices[index + 1]], m_ClipVertices[indices[index + 2]]);
+
+        m_Rasterized[occluder.m_Model] = 1;
+        m_Stats.m_Occluders++;
+    }
+}
+
+//Clips against the near plane (z = 0 in vulkan clip space), the part in front of it would project through the camera
+void OcclusionCuller::addTriangle(const glm::vec4& i_A, const glm::vec4& i_B, const glm::vec4& i_C)
+{
+    const glm::vec4 input[3] = { i_A, i_B, i_C };
+    glm::vec4 clipped[4];
+    int nClipped = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        const glm::vec4& current = input[i];
+        const glm::vec4& next = input[(i + 1) % 3];
+        if (current.z >= 0.0f)
+            clipped[nClipped++] = current;
+        if ((current.z >= 0.0f) != (next.z >= 0.0f))
+            clipped[nClipped++] = current + (next - current) * (current.z / (current.z - next.z));
+    }
+    if (nClipped < 3)
+        return;
+
+    float x[4], y[4], depth[4];
+    for (int i = 0; i < nClipped; i++)
+    {
+        const float invW = 1.0f / clipped[i].w;
+        x[i] = (clipped[i].x * invW * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH;
+        y[i] = (clipped[i].y * invW * 0.5f + 0.5f) * OCCLUSION_BUFFER_HEIGHT;
+        depth[i] = 1.0f - clipped[i].z * invW;
+    }
+
+    //Fan out of the clipped polygon, one triangle or two
+    for (int fan = 1; fan + 1 < nClipped; fan++)
+    {
+        const int v[3] = { 0, fan, fan + 1 };
+        const float area = (x[v[1]] - x[v[0]]) * (y[v[2]] - y[v[0]]) - (x[v[2]] - x[v[0]]) * (y[v[1]] - y[v[0]]);
+        if (std::abs(area) < 1e-6f)
+            continue;
+
+        //Pixels whose center falls inside the bounds
+        OcclusionTriangle triangle;
+        const float minX = (std::min)(x[v[0]], (std::min)(x[v[1]], x[v[2]]));
+        const float maxX = (std::max)(x[v[0]], (std::max)(x[v[1]], x[v[2]]));
+        const float minY = (std::min)(y[v[0]], (std::min)(y[v[1]], y[v[2]]));
+        const float maxY = (std::max)(y[v[0]], (std::max)(y[v[1]], y[v[2]]));
+        triangle.m_MinX = (int32_t)(std::max)(0.0f, std::ceil(minX - 0.5f));
+        triangle.m_MaxX = (int32_t)(std::min)((float)OCCLUSION_BUFFER_WIDTH - 1.0f, std::floor(maxX - 0.5f));
+        triangle.m_MinY = (int32_t)(std::max)(0.0f, std::ceil(minY - 0.5f));
+        triangle.m_MaxY = (int32_t)(std::min)((float)OCCLUSION_BUFFER_HEIGHT - 1.0f, std::floor(maxY - 0.5f));
+        if (triangle.m_MinX > triangle.m_MaxX || triangle.m_MinY > triangle.m_MaxY)
+            continue;
+
+        //Edge k goes from vertex k to the next one, flipped for clockwise triangles so the inside is always positive
+        const float sign = area > 0.0f ? 1.0f : -1.0f;
+        for (int edge = 0; edge < 3; edge++)
+        {
+            const int a = v[edge];
+            const int b = v[(edge + 1) % 3];
+            triangle.m_Edges[edge][0] = -(y[b] - y[a]) * sign;
+            triangle.m_Edges[edge][1] = (x[b] - x[a]) * sign;
+            triangle.m_Edges[edge][2] = ((y[b] - y[a]) * x[a] - (x[b] - x[a]) * y[a]) * sign;
+        }
+
+        const float dx1 = x[v[1]] - x[v[0]], dy1 = y[v[1]] - y[v[0]], dd1 = depth[v[1]] - depth[v[0]];
+        const float dx2 = x[v[2]] - x[v[0]], dy2 = y[v[2]] - y[v[0]], dd2 = depth[v[2]] - depth[v[0]];
+        triangle.m_Depth[0] = (dd1 * dy2 - dd2 * dy1) / area;
+        triangle.m_Depth[1] = (dx1 * dd2 - dx2 * dd1) / area;
+        triangle.m_Depth[2] = depth[v[0]] - triangle.m_Depth[0] * x[v[0]] - triangle.m_Depth[1] * y[v[0]];
+        m_Triangles.push_back(triangle);
+    }
+}
+
+//Clears the band rows and keeps the nearest (largest reversed) depth of every triangle crossing them, at pixel centers
+void OcclusionCuller::rasterizeBand(uint32_t i_Band)
+{
+    float* depthBuffer = m_Levels[0].data();
+    const int32_t rowStart = i_Band * OCCLUSION_BAND_HEIGHT;
+    const int32_t rowEnd = rowStart + OCCLUSION_BAND_HEIGHT - 1;
+    std::fill(depthBuffer + rowStart * OCCLUSION_BUFFER_WIDTH, depthBuffer + (rowEnd + 1) * OCCLUSION_BUFFER_WIDTH, 0.0f);
+
+    for (const OcclusionTriangle& triangle : m_Triangles)
+    {
+        const int32_t minY = (std::max)(triangle.m_MinY, rowStart);
+        const int32_t maxY = (std::min)(triangle.m_MaxY, rowEnd);
+        for (int32_t y = minY; y <= maxY; y++)
+        {
+            const float centerY = y + 0.5f;
+            float rowEdge[3];
+            for (int edge = 0; edge < 3; edge++)
+                rowEdge[edge] = triangle.m_Edges[edge][1] * centerY + triangle.m_Edges[edge][2];
+            const float rowDepth = triangle.m_Depth[1] * centerY + triangle.m_Depth[2];
+            float* row = depthBuffer + y * OCCLUSION_BUFFER_WIDTH;
+            int32_t x = triangle.m_MinX;
+#if defined(__AVX__)
+            const __m256 laneCenters = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+            const __m256 zero = _mm256_setzero_ps();
+            for (x &= ~7; x <= triangle.m_MaxX; x += 8)
+            {
+                const __m256 centerX = _mm256_add_ps(_mm256_set1_ps((float)x), laneCenters);
+                __m256 inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.m_Edges[0][0]), centerX), _mm256_set1_ps(rowEdge[0])), zero, _CMP_GE_OQ);
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.m_Edges[1][0]), centerX), _mm256_set1_ps(rowEdge[1])), zero, _CMP_GE_OQ));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.m_Edges[2][0]), centerX), _mm256_set1_ps(rowEdge[2])), zero, _CMP_GE_OQ));
+                if (!_mm256_movemask_ps(inside))
+                    continue;
+                const __m256 depth = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(triangle.m_Depth[0]), centerX), _mm256_set1_ps(rowDepth));
+                const __m256 current = _mm256_loadu_ps(row + x);
+                _mm256_storeu_ps(row + x, _mm256_blendv_ps(current, _mm256_max_ps(current, depth), inside));
+            }
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+            const __m128 laneCenters = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            const __m128 zero = _mm_setzero_ps();
+            for (x &= ~3; x <= triangle.m_MaxX; x += 4)
+            {
+                const __m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), laneCenters);
+                __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.m_Edges[0][0]), centerX), _mm_set1_ps(rowEdge[0])), zero);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.m_Edges[1][0]), centerX), _mm_set1_ps(rowEdge[1])), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.m_Edges[2][0]), centerX), _mm_set1_ps(rowEdge[2])), zero));
+                if (!_mm_movemask_ps(inside))
+                    continue;
+                const __m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.m_Depth[0]), centerX), _mm_set1_ps(rowDepth));
+                const __m128 current = _mm_loadu_ps(row + x);
+                const __m128 nearest = _mm_max_ps(current, depth);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+            }
+#endif
+            for (; x <= triangle.m_MaxX; x++)
+            {
+                const float centerX = x + 0.5f;
+                if (triangle.m_Edges[0][0] * centerX + rowEdge[0] < 0.0f ||
+                    triangle.m_Edges[1][0] * centerX + rowEdge[1] < 0.0f ||
+                    triangle.m_Edges[2][0] * centerX + rowEdge[2] < 0.0f)
+                    continue;
+                row[x] = (std::max)(row[x], triangle.m_Depth[0] * centerX + rowDepth);
+            }
+        }
+    }
+}
+
+//Every level keeps the farthest depth (smallest reversed one) of the 2x2 block under it
+void OcclusionCuller::buildHierarchy()
+{
+    uint32_t width = OCCLUSION_BUFFER_WIDTH;
+    uint32_t height = OCCLUSION_BUFFER_HEIGHT;
+    for (size_t level = 1; level < m_Levels.size(); level++)
+    {
+        const float* source = m_Levels[level - 1].data();
+        float* destination = m_Levels[level].data();
+        const uint32_t levelWidth = (std::max)(1u, width / 2);
+        const uint32_t levelHeight = (std::max)(1u, height / 2);
+        for (uint32_t y = 0; y < levelHeight; y++)
+        {
+            const uint32_t y0 = (std::min)(y * 2, height - 1);
+            const uint32_t y1 = (std::min)(y * 2 + 1, height - 1);
+            for (uint32_t x = 0; x < levelWidth; x++)
+            {
+                const uint32_t x0 = (std::min)(x * 2, width - 1);
+                const uint32_t x1 = (std::min)(x * 2 + 1, width - 1);
+                destination[y * levelWidth + x] = (std::min)((std::min)(source[y0 * width + x0], source[y0 * width + x1]),
+                    (std::min)(source[y1 * width + x0], source[y1 * width + x1]));
+            }
+        }
+        width = levelWidth;
+        height = levelHeight;
+    }
+}
+
+bool OcclusionCuller::isOccluded(const glm::vec3& i_Min, const glm::vec3& i_Max) const
+{
+    float minX = OCCLUSION_BUFFER_WIDTH, maxX = 0.0f;
+    float minY = OCCLUSION_BUFFER_HEIGHT, maxY = 0.0f;
+    float nearest = 0.0f;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        const glm::vec4 clip = m_ViewProj * glm::vec4(corner & 1 ? i_Max.x : i_Min.x, corner & 2 ? i_Max.y : i_Min.y, corner & 4 ? i_Max.z : i_Min.z, 1.0f);
+        if (clip.z < 0.0f || clip.w <= 0.0f)
+            return false;//Crossing the near plane, the camera is right next to it
+        const float invW = 1.0f / clip.w;
+        const float x = (clip.x * invW * 0.5f + 0.5f) * OCCLUSION_BUFFER_WIDTH;
+        const float y = (clip.y * invW * 0.5f + 0.5f) * OCCLUSION_BUFFER_HEIGHT;
+        minX = (std::min)(minX, x);
+        maxX = (std::max)(maxX, x);
+        minY = (std::min)(minY, y);
+        maxY = (std::max)(maxY, y);
+        nearest = (std::max)(nearest, 1.0f - clip.z * invW);
+    }
+
+    //Every pixel the rectangle touches, not only the ones whose center it covers
+    const int32_t x0 = (int32_t)(std::max)(0.0f, std::floor(minX));
+    const int32_t x1 = (int32_t)(std::min)((float)OCCLUSION_BUFFER_WIDTH - 1.0f, std::floor(maxX));
+    const int32_t y0 = (int32_t)(std::max)(0.0f, std::floor(minY));
+    const int32_t y1 = (int32_t)(std::min)((float)OCCLUSION_BUFFER_HEIGHT - 1.0f, std::floor(maxY));
+    if (x0 > x1 || y0 > y1)
+        return false;
+
+    //First level where the rectangle spans at most 4x4 texels
+    uint32_t level = 0;
+    while (level + 1 < m_Levels.size() && ((x1 >> level) - (x0 >> level) > 3 || (y1 >> level) - (y0 >> level) > 3))
+        level++;
+    const uint32_t levelWidth = (std::max)(1u, (uint32_t)OCCLUSION_BUFFER_WIDTH >> level);
+    const float* depth = m_Levels[level].data();
+    for (int32_t y = y0 >> level; y <= (y1 >> level); y++)
+    {
+        for (int32_t x = x0 >> level; x <= (x1 >> level); x++)
+        {
+            if (depth[y * levelWidth + x] <= nearest)
+                return false;
+        }
+    }
+    return true;
+}
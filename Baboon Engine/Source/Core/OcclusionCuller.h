@@ -0,0 +1,80 @@
+#pragma once
+#include "Renderer/Common/GLMInclude.h"
+#include "ModelStore.h"
+#include <vector>
+#include <stdint.h>
+
+class ThreadPool;
+
+#define OCCLUSION_BUFFER_WIDTH 256 //Software depth buffer, a multiple of 4 so rows go a whole SIMD register at a time
+#define OCCLUSION_BUFFER_HEIGHT 128
+#define OCCLUSION_BAND_HEIGHT 16 //Rows per rasterization job, every band owns its rows so no two threads write the same pixel
+#define OCCLUSION_MAX_TRIANGLES 65536 //Occluder triangles rasterized per cull, occluders past the budget are tested like any other model
+#define OCCLUSION_MODELS_PER_JOB 1024 //Below this many models per worker the occludee tests run on the calling thread
+
+//Model whose triangles go into the depth buffer, the mesh view is its full detail one so the depth is never in front of the real surface
+struct OcclusionOccluder
+{
+    ModelHandle m_Model;
+    uint32_t m_MeshView;
+};
+
+//Results of the last cull
+struct OcclusionStats
+{
+    uint32_t m_Occluders = 0;//Rasterized, the ones outside the frustum don't count
+    uint32_t m_Triangles = 0;
+    uint32_t m_Tested = 0;
+    uint32_t m_Occluded = 0;
+    float m_RasterMicroseconds = 0.0f;
+    float m_TestMicroseconds = 0.0f;
+};
+
+//Screen space triangle ready for the band loops: edge functions positive inside, depth as a plane, pixel bounds
+struct OcclusionTriangle
+{
+    float m_Edges[3][3];//A, B, C of A * x + B * y + C per edge
+    float m_Depth[3];//Same for the depth plane
+    int32_t m_MinX, m_MaxX, m_MinY, m_MaxY;
+};
+
+/**
+ * @brief Occlusion culling against a low resolution depth buffer rasterized on the CPU
+ *
+ * Big occluders (picked by the scene) get their triangles rasterized into a OCCLUSION_BUFFER_WIDTH x
+ * OCCLUSION_BUFFER_HEIGHT depth buffer, in horizontal bands spread over the given thread pool. Depth is stored
+ * reversed (1 - z, far is 0) so the hierarchy built on top of it keeps the minimum of every 2x2 block, the farthest occluder
+ * depth of the region. A model is occluded when the nearest corner of its box is behind that depth over the whole screen
+ * rectangle of the box. Nothing here touches the gpu, it works the same headless or on a software device.
+ */
+class OcclusionCuller
+{
+public:
+    OcclusionCuller();
+
+    /**
+     * @brief Clears i_Bit in the masks of the models hidden behind the occluders, for the view i_ViewProj
+     * @details Only occluders with i_Bit set are rasterized, in list order until OCCLUSION_MAX_TRIANGLES. Rasterized
+     * occluders are never tested themselves, their own box would be tested against their own depth
+     * @param i_ThreadPool Shared pool the bands and tests are split over, null runs everything on the calling thread
+     */
+    void cull(const ModelStore& i_Models, const glm::mat4& i_ViewProj, const std::vector<OcclusionOccluder>& i_Occluders, uint8_t i_Bit, std::vector<uint8_t>& io_Masks, ThreadPool* i_ThreadPool = nullptr);
+
+    //Against the depth of the last cull
+    bool isOccluded(const glm::vec3& i_Min, const glm::vec3& i_Max) const;
+
+    const OcclusionStats& getStats() const { return m_Stats; }
+
+private:
+    glm::mat4 m_ViewProj;
+    std::vector<OcclusionTriangle> m_Triangles;
+    std::vector<std::vector<float>> m_Levels;//Level 0 is the depth buffer, each one after it half the size
+    std::vector<uint8_t> m_Rasterized;//Per model, set for the occluders of the last cull
+    std::vector<glm::vec4> m_ClipVertices;//Scratch for the occluder being set up
+    OcclusionStats m_Stats;
+
+    void setupTriangles(const ModelStore& i_Models, const std::vector<OcclusionOccluder>& i_Occluders, uint8_t i_Bit, const std::vector<uint8_t>& i_Masks);
+    void addTriangle(const glm::vec4& i_A, const glm::vec4& i_B, const glm::vec4& i_C);
+    void rasterizeBand(uint32_t i_Band);
+    void buildHierarchy();
+};
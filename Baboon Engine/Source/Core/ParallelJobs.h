@@ -0,0 +1,35 @@
+#pragma once
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <stdint.h>
+
+//Every thread of the pool from i_FirstThread on plus the calling one pull jobs until there are none left, no pool runs them all
+//on the calling thread. Only the threads given work are waited on, so a pool job can call it skipping its own thread (the scene
+//loading one is threads[0] of the loader pool). Returns how many threads took part
+inline uint32_t runJobs(ThreadPool* i_ThreadPool, uint32_t i_NJobs, const std::function<void(uint32_t)>& i_Job, uint32_t i_FirstThread = 0)
+{
+    if (!i_ThreadPool || i_NJobs < 2)
+    {
+        for (uint32_t i = 0; i < i_NJobs; i++)
+            i_Job(i);
+        return 1;
+    }
+
+    std::atomic<uint32_t> next{ 0 };
+    auto loop = [&]() {
+        for (uint32_t i = next++; i < i_NJobs; i = next++)
+            i_Job(i);
+    };
+    std::vector<Thread*> workers;
+    for (size_t thread = i_FirstThread; thread < i_ThreadPool->threads.size() && workers.size() + 1 < i_NJobs; thread++)
+    {
+        workers.push_back(i_ThreadPool->threads[thread].get());
+        workers.back()->addJob(loop);
+    }
+    loop();
+    for (auto worker : workers)
+        worker->wait();
+    return static_cast<uint32_t>(workers.size() + 1);
+}
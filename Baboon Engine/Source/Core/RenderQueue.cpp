@@ -0,0 +1,171 @@
+#define NOMINMAX
+#include "RenderQueue.h"
+#include "ParallelJobs.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#define RENDER_KEY_PASS_SHIFT 62
+#define RENDER_KEY_VARIANT_BITS 10
+#define RENDER_KEY_MATERIAL_BITS 12
+#define RENDER_KEY_MESH_BITS 16
+#define RENDER_KEY_DEPTH_BITS 24
+#define RENDER_KEY_STATE_BITS (RENDER_KEY_VARIANT_BITS + RENDER_KEY_MATERIAL_BITS)
+#define RENDER_KEY_MASK(bits) ((1ull << (bits)) - 1)
+
+//Positive floats sort like their bit patterns, dropping the low mantissa bits keeps about 5 significant digits
+static uint64_t quantizeDepth(float i_Depth)
+{
+    uint32_t bits;
+    i_Depth = (std::max)(i_Depth, 0.0f);
+    memcpy(&bits, &i_Depth, sizeof(bits));
+    return bits >> (31 - RENDER_KEY_DEPTH_BITS);
+}
+
+RenderSortKey RenderQueue::makeKey(RenderQueuePass i_Pass, uint32_t i_Variant, uint32_t i_Material, uint32_t i_MeshView, float i_Depth)
+{
+    assert(i_Variant <= RENDER_KEY_MASK(RENDER_KEY_VARIANT_BITS) && "Shader variant key out of the sort key bits");
+    assert(i_Material <= RENDER_KEY_MASK(RENDER_KEY_MATERIAL_BITS) && "Material index out of the sort key bits");
+    const uint64_t state = ((uint64_t)(i_Variant & RENDER_KEY_MASK(RENDER_KEY_VARIANT_BITS)) << RENDER_KEY_MATERIAL_BITS) |
+        (i_Material & RENDER_KEY_MASK(RENDER_KEY_MATERIAL_BITS));
+    const uint64_t mesh = i_MeshView & RENDER_KEY_MASK(RENDER_KEY_MESH_BITS);
+    const uint64_t depth = quantizeDepth(i_Depth);
+    const uint64_t pass = (uint64_t)i_Pass << RENDER_KEY_PASS_SHIFT;
+    if (i_Pass == RenderQueuePass::Transparent)
+        return pass | ((~depth & RENDER_KEY_MASK(RENDER_KEY_DEPTH_BITS)) << (RENDER_KEY_STATE_BITS + RENDER_KEY_MESH_BITS)) | (state << RENDER_KEY_MESH_BITS) | mesh;
+    return pass | (state << (RENDER_KEY_DEPTH_BITS + RENDER_KEY_MESH_BITS)) | (depth << RENDER_KEY_MESH_BITS) | mesh;
+}
+
+uint32_t RenderQueue::getState(RenderSortKey i_Key)
+{
+    if (getPass(i_Key) == RenderQueuePass::Transparent)
+        return (uint32_t)((i_Key >> RENDER_KEY_MESH_BITS) & RENDER_KEY_MASK(RENDER_KEY_STATE_BITS));
+    return (uint32_t)((i_Key >> (RENDER_KEY_DEPTH_BITS + RENDER_KEY_MESH_BITS)) & RENDER_KEY_MASK(RENDER_KEY_STATE_BITS));
+}
+
+RenderQueuePass RenderQueue::getPass(RenderSortKey i_Key)
+{
+    return (RenderQueuePass)(i_Key >> RENDER_KEY_PASS_SHIFT);
+}
+
+uint32_t RenderQueue::getInstanceRunEnd(uint32_t i_Begin, uint32_t i_End, const uint32_t* i_MeshViews) const
+{
+    const uint32_t state = getState(m_Items[i_Begin].m_Key);
+    const uint32_t meshView = i_MeshViews[m_Items[i_Begin].m_Model];
+    uint32_t end = i_Begin + 1;
+    while (end < i_End && i_MeshViews[m_Items[end].m_Model] == meshView && getState(m_Items[end].m_Key) == state)
+        end++;
+    return end;
+}
+
+void RenderQueue::sort(ThreadPool* i_ThreadPool)
+{
+    const uint32_t nItems = size();
+    if (nItems < 2)
+        return;
+
+    //Digits every key shares don't move anything, most passes get skipped (the pass bits always, often the state ones)
+    uint64_t differentBits = 0;
+    for (const RenderQueueItem& item : m_Items)
+        differentBits |= item.m_Key ^ m_Items[0].m_Key;
+    if (differentBits == 0)
+        return;
+
+    const uint32_t nBuckets = 1u << RENDER_QUEUE_RADIX_BITS;
+    const uint32_t maxJobs = i_ThreadPool ? static_cast<uint32_t>(i_ThreadPool->threads.size()) + 1 : 1;
+    const uint32_t nJobs = (std::max)(1u, (std::min)(maxJobs, nItems / RENDER_QUEUE_ITEMS_PER_JOB));
+    const uint32_t jobSize = (nItems + nJobs - 1) / nJobs;
+    m_Scratch.resize(nItems);
+    m_Histograms.resize(nJobs * nBuckets);
+
+    for (uint32_t shift = 0; shift < 64; shift += RENDER_QUEUE_RADIX_BITS)
+    {
+        if (!((differentBits >> shift) & (nBuckets - 1)))
+            continue;
+
+        //Every job counts its chunk, the prefix sum goes bucket major so equal digits keep their chunk (and so item) order
+        std::fill(m_Histograms.begin(), m_Histograms.end(), 0);
+        runJobs(i_ThreadPool, nJobs, [&](uint32_t job) {
+            uint32_t* histogram = m_Histograms.data() + job * nBuckets;
+            const uint32_t end = (std::min)(nItems, (job + 1) * jobSize);
+            for (uint32_t item = job * jobSize; item < end; item++)
+                histogram[(m_Items[item].m_Key >> shift) & (nBuckets - 1)]++;
+        });
+        uint32_t offset = 0;
+        for (uint32_t bucket = 0; bucket < nBuckets; bucket++)
+        {
+            for (uint32_t job = 0; job < nJobs; job++)
+            {
+                const uint32_t count = m_Histograms[job * nBuckets + bucket];
+                m_Histograms[job * nBuckets + bucket] = offset;
+                offset += count;
+            }
+        }
+        runJobs(i_ThreadPool, nJobs, [&](uint32_t job) {
+            uint32_t* offsets = m_Histograms.data() + job * nBuckets;
+            const uint32_t end = (std::min)(nItems, (job + 1) * jobSize);
+            for (uint32_t item = job * jobSize; item < end; item++)
+                m_Scratch[offsets[(m_Items[item].m_Key >> shift) & (nBuckets - 1)]++] = m_Items[item];
+        });
+        m_Items.swap(m_Scratch);
+    }
+}
+
+//A stable counting sort of every state run by group, groups numbered in the order their nearest item comes
+void RenderQueue::groupInstances()
+{
+    const uint32_t nItems = size();
+    if (nItems < 2)
+        return;
+    if (m_GroupOfMesh.empty())
+        m_GroupOfMesh.assign(1u << RENDER_KEY_MESH_BITS, UINT32_MAX);
+    m_Scratch.resize(nItems);
+    m_ItemGroups.resize(nItems);
+    for (uint32_t begin = 0; begin < nItems;)
+    {
+        const uint32_t state = getState(m_Items[begin].m_Key);
+        uint32_t end = begin + 1;
+        while (end < nItems && getState(m_Items[end].m_Key) == state)
+            end++;
+
+        m_GroupOffsets.clear();
+        for (uint32_t item = begin; item < end; item++)
+        {
+            uint32_t& group = m_GroupOfMesh[m_Items[item].m_Key & RENDER_KEY_MASK(RENDER_KEY_MESH_BITS)];
+            if (group == UINT32_MAX)
+            {
+                group = static_cast<uint32_t>(m_GroupOffsets.size());
+                m_GroupOffsets.push_back(0);
+            }
+            m_ItemGroups[item] = group;
+            m_GroupOffsets[group]++;
+        }
+        uint32_t offset = begin;
+        for (uint32_t& groupOffset : m_GroupOffsets)
+        {
+            const uint32_t count = groupOffset;
+            groupOffset = offset;
+            offset += count;
+        }
+        for (uint32_t item = begin; item < end; item++)
+            m_Scratch[m_GroupOffsets[m_ItemGroups[item]]++] = m_Items[item];
+        for (uint32_t item = begin; item < end; item++)
+            m_GroupOfMesh[m_Items[item].m_Key & RENDER_KEY_MASK(RENDER_KEY_MESH_BITS)] = UINT32_MAX;
+        begin = end;
+    }
+    m_Items.swap(m_Scratch);
+}
+
+void RenderQueue::split(uint32_t i_NRanges, std::vector<RenderDrawRange>& o_Ranges) const
+{
+    o_Ranges.clear();
+    const uint32_t nItems = size();
+    const uint32_t nRanges = (std::min)((std::max)(1u, i_NRanges), nItems);
+    uint32_t begin = 0;
+    for (uint32_t range = 0; range < nRanges; range++)
+    {
+        const uint32_t end = static_cast<uint32_t>((uint64_t)nItems * (range + 1) / nRanges);
+        o_Ranges.push_back({ begin, end });
+        begin = end;
+    }
+}
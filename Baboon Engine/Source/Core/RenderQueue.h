@@ -0,0 +1,86 @@
+#pragma once
+#include "ModelStore.h"
+#include <vector>
+#include <stdint.h>
+
+class ThreadPool;
+
+typedef uint64_t RenderSortKey;
+
+#define RENDER_QUEUE_ITEMS_PER_JOB 4096 //Below this many items per worker the radix sort runs on the calling thread
+#define RENDER_QUEUE_RADIX_BITS 8 //Key bits sorted per pass, 8 passes for a whole key at most
+
+//Passes sorting the same way share a layout, see RenderQueue::makeKey
+enum class RenderQueuePass : uint8_t
+{
+    Opaque = 0,
+    Transparent = 1,
+    Shadow = 2
+};
+
+struct RenderQueueItem
+{
+    RenderSortKey m_Key;
+    ModelHandle m_Model;
+};
+
+//Contiguous items [m_Begin, m_End) of a queue, recorded by one thread
+struct RenderDrawRange
+{
+    uint32_t m_Begin;
+    uint32_t m_End;
+};
+
+/**
+ * @brief Flat list of draws sorted by a 64 bit key, one queue per pass
+ *
+ * Opaque and shadow keys go pass | pipeline variant | material | depth | mesh view, so state changes are as rare as they can be
+ * and draws sharing state go front to back, the mesh view only breaks ties. groupInstances then gathers the instancing runs
+ * without touching the key. Transparent keys put the inverted depth right after the pass, back to front across materials
+ * since blending needs it. Sorting is a LSD radix sort skipping the digits every key shares, split in
+ * contiguous chunks over a thread pool when the queue is big enough.
+ */
+class RenderQueue
+{
+public:
+    void clear() { m_Items.clear(); }
+    void push(RenderSortKey i_Key, ModelHandle i_Model) { m_Items.push_back({ i_Key, i_Model }); }
+    void sort(ThreadPool* i_ThreadPool = nullptr);
+    //After sort, opaque and shadow queues only. Every item of a state run moves up to the nearest one with its mesh view, so
+    //a mesh view is one instanced draw per state and the runs stay front to back by their nearest instance
+    void groupInstances();
+
+    //About the same number of items per range, at most i_NRanges of them
+    void split(uint32_t i_NRanges, std::vector<RenderDrawRange>& o_Ranges) const;
+
+    uint32_t size() const { return static_cast<uint32_t>(m_Items.size()); }
+    bool empty() const { return m_Items.empty(); }
+    const RenderQueueItem& operator[](uint32_t i_Item) const { return m_Items[i_Item]; }
+    const std::vector<RenderQueueItem>& getItems() const { return m_Items; }
+
+    /**
+     * @param i_Variant Up to 10 bits, pipeline/shader variant key. Asserted, an alias would draw with another pipeline
+     * @param i_Material Up to 12 bits, asserted too
+     * @param i_MeshView Up to 16 bits, only a tie break so higher ones just lose it
+     * @param i_Depth Distance to the camera, only the top 24 bits of the (positive) float are kept
+     */
+    static RenderSortKey makeKey(RenderQueuePass i_Pass, uint32_t i_Variant, uint32_t i_Material, uint32_t i_MeshView, float i_Depth);
+    //Variant and material bits of the key, two items with the same state draw with the same pipeline and material push constants
+    static uint32_t getState(RenderSortKey i_Key);
+    static RenderQueuePass getPass(RenderSortKey i_Key);
+
+    /**
+     * @brief End of the run of items starting at i_Begin with the same state and the same mesh view, at most i_End
+     * @details A run is one instanced draw. Mesh views come from the store (i_MeshViews by model handle) rather than the key,
+     * a level of detail switch after the sort changes them without a new key
+     */
+    uint32_t getInstanceRunEnd(uint32_t i_Begin, uint32_t i_End, const uint32_t* i_MeshViews) const;
+
+private:
+    std::vector<RenderQueueItem> m_Items;
+    std::vector<RenderQueueItem> m_Scratch;//Radix sort ping pong
+    std::vector<uint32_t> m_Histograms;//Per job, (1 << RENDER_QUEUE_RADIX_BITS) buckets each
+    std::vector<uint32_t> m_GroupOfMesh;//groupInstances scratch: by key mesh view, its group in the state run being grouped
+    std::vector<uint32_t> m_GroupOffsets;
+    std::vector<uint32_t> m_ItemGroups;
+};
@@ -5,12 +5,19 @@
 
 #include <glm/gtc/type_ptr.hpp>
 #include "Core\ServiceLocator.h"
+#include "Core\SceneCache.h"
+#include "Core\BoundedQueue.hpp"
+#include "Core\MeshOptimizer.h"
+#include "Core\ParallelJobs.h"
+#include <atomic>
+#include <functional>
 #include "Renderer\Common\Buffer.h"
 #include <chrono>
 #include <cstdlib>
 #include <cstdio>
 
 #include <limits>
+#include <algorithm>
 
 #include "assimp\Importer.hpp"
 #include "assimp\DefaultLogger.hpp"
@@ -110,11 +117,24 @@ void Scene::Free()
 
   renderer->WaitToDestroy();
 	
-  m_OpaqueModels.clear();
-  m_TransparentModels.clear();
-  m_OpaqueBatch.clear();
-  m_TransparentBatch.clear();
+  m_OpaqueQueue.clear();
+  m_TransparentQueue.clear();
+  m_ShadowQueue.clear();
+  m_VariantKeys.clear();
+  m_VisibleOpaque.clear();
+  m_VisibleTransparent.clear();
+  m_VisibleShadow.clear();
+  m_CulledViews.clear();
+  m_VisibilityStats = SceneVisibilityStats();
+  m_VisibilityDirty = true;
 	m_Models.clear();
+  m_ModelStore.clear();
+  m_BVH.clear();
+  m_Occluders.clear();
+  m_SelectedModel = MODEL_HANDLE_NONE;
+  m_SceneGraph.clear();
+  m_NodeModels.clear();
+  m_DirtyModels.clear();
 
   for (auto material : m_Materials)
   {
@@ -134,134 +154,316 @@ void Scene::Free()
       delete texture;
   }
   m_Textures.clear();
-	
-	renderer->DeleteInstancedUniformBuffer();
 
 
 
   m_DirLightCount = 0;
-  m_SpotLightCount = 0;
-  m_PointLightCount = 0;
+  m_SpotLights.clear();
+  m_PointLights.clear();
 
 	m_bIsInit = false;
 }
 
-void Scene::prepareBatches()
+void Scene::prepareRenderQueues()
 {
-    /*for (auto& model : m_Models)
+    auto queueStart = std::chrono::high_resolution_clock::now();
+    buildRenderQueue(m_OpaqueQueue, RenderQueuePass::Opaque, m_VisibleOpaque);
+    buildRenderQueue(m_TransparentQueue, RenderQueuePass::Transparent, m_VisibleTransparent);
+    buildRenderQueue(m_ShadowQueue, RenderQueuePass::Shadow, m_VisibleShadow);
+    markInstancedModels();
+    m_VisibilityStats.m_QueueMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - queueStart).count();
+}
+
+//One key per visible model out of the model store arrays, depth is the distance from the camera to the box center
+void Scene::buildRenderQueue(RenderQueue& o_Queue, RenderQueuePass i_Pass, const std::vector<ModelHandle>& i_Visible)
+{
+    o_Queue.clear();
+    const glm::vec3 cameraPos = ServiceLocator::GetCameraManager()->GetCamera("mainCamera")->GetPosition();
+    const uint32_t* materials = m_ModelStore.getMaterialIndices();
+    const uint32_t* meshViews = m_ModelStore.getMeshViewIndices();
+    const uint16_t* variants = m_ModelStore.getVariantKeys();
+    const glm::vec3* boundsMin = m_ModelStore.getBoundsMin();
+    const glm::vec3* boundsMax = m_ModelStore.getBoundsMax();
+    for (ModelHandle model : i_Visible)
     {
-        if (model->IsVisible())
+        const float depth = glm::length(cameraPos - (boundsMin[model] + boundsMax[model]) * 0.5f);
+        if (i_Pass == RenderQueuePass::Shadow)
         {
-            if (model->GetMaterial()->isTransparent())
-            {
+            //The shadow pipeline only changes with the vertex layout and doesn't read materials
+            const uint32_t compact = m_ModelStore.getDrawView(model).m_Mesh->GetLayout() == VertexLayout::Compact ? 1 : 0;
+            o_Queue.push(RenderQueue::makeKey(i_Pass, compact, 0, meshViews[model], depth), model);
+        }
+        else
+        {
+            o_Queue.push(RenderQueue::makeKey(i_Pass, variants[model], materials[model], meshViews[model], depth), model);
+        }
+    }
+    o_Queue.sort(ServiceLocator::GetJobPool());
+    if (i_Pass != RenderQueuePass::Transparent)
+        o_Queue.groupInstances();
+}
 
+//Flags the models the subpasses will draw in runs of two or more (see Subpass::recordQueue) so the cluster culler skips them,
+//an instanced draw takes the whole mesh view. Shadow runs only count for the stats, shadows are never cluster culled
+void Scene::markInstancedModels()
+{
+    const uint32_t* meshViews = m_ModelStore.getMeshViewIndices();
+    m_VisibilityStats.m_Draws = 0;
+    m_VisibilityStats.m_InstancedDraws = 0;
+    m_VisibilityStats.m_InstancedModels = 0;
+    for (const RenderQueue* queue : { &m_OpaqueQueue, &m_TransparentQueue, &m_ShadowQueue })
+    {
+        const bool flag = queue != &m_ShadowQueue;
+        for (uint32_t begin = 0; begin < queue->size();)
+        {
+            const uint32_t end = queue->getInstanceRunEnd(begin, queue->size(), meshViews);
+            m_VisibilityStats.m_Draws++;
+            if (end - begin > 1)
+            {
+                m_VisibilityStats.m_InstancedDraws++;
+                m_VisibilityStats.m_InstancedModels += end - begin;
             }
-            else
+            if (flag)
             {
-
+                for (uint32_t item = begin; item < end; item++)
+                    m_ModelStore.setFlag((*queue)[item].m_Model, ModelFlag_Instanced, end - begin > 1);
             }
+            begin = end;
         }
-
-    }*/
-    getBatches(m_OpaqueBatch, BatchType::BatchType_Opaque);
-    getBatches(m_TransparentBatch, BatchType::BatchType_Transparent);
+    }
 }
 
-void  Scene::getBatches(std::vector<RenderBatch>& batchList, BatchType batchType)//TODO: Don't do this sorting every frame. Only when relevant stuff changes. Probably can get away doing it onSceneLoad
+//Keys are handed out in order of first use, a scene would need over a thousand distinct variants to run out of key bits
+uint16_t Scene::GetVariantKey(const ShaderVariant& i_Variant)
 {
-    batchList.clear();
-    auto camera = ServiceLocator::GetCameraManager()->GetCamera("mainCamera");
+    auto it = m_VariantKeys.find(i_Variant.get_id());
+    if (it != m_VariantKeys.end())
+        return it->second;
+    const uint16_t key = static_cast<uint16_t>(m_VariantKeys.size());
+    m_VariantKeys.emplace(i_Variant.get_id(), key);
+    return key;
+}
+
+
 
-    auto& listToBatch = batchType == BatchType::BatchType_Opaque ? m_OpaqueModels : m_TransparentModels;
 
-    std::multimap<const std::string, std::reference_wrapper<Model>> sortedByMaterial;
-    for (Model& model : listToBatch)
+
+void Scene::SelectModel(glm::vec2 clickPoint)
+{
+    if (!m_bIsInit)
+        return;
+    auto pickStart = std::chrono::high_resolution_clock::now();
+
+    //The projection already flips y, so pixel and clip space y go the same way
+    RendererAbstract* renderer = ServiceLocator::GetRenderer();
+    const glm::vec2 ndc = 2.0f * clickPoint / glm::vec2(renderer->GetMainRTWidth(), renderer->GetMainRTHeight()) - 1.0f;
+    const glm::mat4 inverseViewProj = glm::inverse(ServiceLocator::GetCameraManager()->GetCamera("mainCamera")->GetViewProjMatrix());
+    glm::vec4 nearPoint = inverseViewProj * glm::vec4(ndc, 0.0f, 1.0f);
+    glm::vec4 farPoint = inverseViewProj * glm::vec4(ndc, 1.0f, 1.0f);
+    nearPoint /= nearPoint.w;
+    farPoint /= farPoint.w;
+
+    if (m_SelectedModel != MODEL_HANDLE_NONE)
+        m_Models[m_SelectedModel]->SetSelection(false);
+    m_SelectedModel = MODEL_HANDLE_NONE;
+    float distance;
+    if (m_BVH.raycast(glm::vec3(nearPoint), glm::normalize(glm::vec3(farPoint - nearPoint)), m_ModelStore.getBoundsMin(), m_ModelStore.getBoundsMax(), m_SelectedModel, distance))
     {
-        sortedByMaterial.insert(std::pair(model.GetMaterial()->GetMaterialName(), std::ref(model)));
+        m_Models[m_SelectedModel]->SetSelection(true);
+        LOGINFO("Selected model: " + m_Models[m_SelectedModel]->getName() + " at distance " + std::to_string(distance));
     }
+    m_VisibilityStats.m_PickMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - pickStart).count();
+}
 
-    for (auto material : m_Materials)
+void Scene::Update()
+{
+    if (!m_bIsInit)
+        return;
+    if (m_bIsDirty)
     {
-        bool needsInsertion = (batchType == BatchType::BatchType_Transparent && material->isTransparent()) || (batchType == BatchType::BatchType_Opaque && !material->isTransparent());
-        if(!needsInsertion)
-            continue;
-        batchList.emplace_back(RenderBatch());
-        RenderBatch* batch = &batchList.back();
-        batch->m_MaterialIndex = material->getMaterialIndex();
-        batch->m_BatchType = batchType;
-        batch->m_Name = std::string("batch_") + material->GetMaterialName();
-        auto byMaterial = sortedByMaterial.equal_range(material->GetMaterialName());//retrieve the whole list of models using that material
-        for (auto it = byMaterial.first; it != byMaterial.second; ++it)
+        if (m_BVH.getModelCount() != m_ModelStore.size())
+            buildBVH(nullptr);//Models added after the load, boxes from the editor are few enough to rebuild on this thread
+        if (updateTransforms() || m_QueuesDirty)
         {
-            Model& model = it->second;
-            float distance = glm::length(camera->GetPosition() - model.getAABB().get_center());
-           
-            batch->m_ModelsByDistance.emplace(distance, model);
+            m_VisibilityDirty = true;//Models moved, the recorded draws have to change even if the visible lists don't
+            m_LodsDirty = true;
+            m_QueuesDirty = false;
         }
-          
-       
+
+        m_bIsDirty = false;
     }
-    if(s_DefaultMaterial && ((s_DefaultMaterial->isTransparent() && batchType == BatchType::BatchType_Transparent)|| (!s_DefaultMaterial->isTransparent() && batchType == BatchType::BatchType_Opaque)))
+    if (updateVisibility())
     {
-        batchList.emplace_back(RenderBatch());
-        RenderBatch* batch = &batchList.back();
-        batch->m_BatchType = batchType;
-
-        batch->m_Name = std::string("batch_") + s_DefaultMaterial->GetMaterialName();
-        auto byMaterial = sortedByMaterial.equal_range(s_DefaultMaterial->GetMaterialName());//retrieve the whole list of models using that material
-        for (auto it = byMaterial.first; it != byMaterial.second; ++it)
-        {
-            Model& model = it->second;
-            float distance = glm::length(camera->GetPosition() - model.getAABB().get_center());
-     
-            batch->m_ModelsByDistance.emplace(distance,model);
-        }
+        ServiceLocator::GetSceneManager()->GetSubject().Notify(Subject::Message::SCENEDIRTY);
+        prepareRenderQueues();//Reordering geometry
     }
-
+    updateLods();
 }
 
+//Frustum culls every model against the main camera and the shadow cameras when any of them or the scene moved, and splits the
+//survivors into the per pass visible lists. Returns true when the render queues have to be rebuilt
+bool Scene::updateVisibility()
+{
+    auto cameraManager = ServiceLocator::GetCameraManager();
+    cameraManager->GetShadowViewProjs(m_CullViews);
+    if (m_CullViews.size() > FRUSTUM_CULL_MAX_VIEWS - 1)
+        m_CullViews.resize(FRUSTUM_CULL_MAX_VIEWS - 1);
+    m_CullViews.insert(m_CullViews.begin(), cameraManager->GetCamera("mainCamera")->GetViewProjMatrix());
+    if (!m_VisibilityDirty && m_CullViews == m_CulledViews)
+        return false;
+
+    bool changed = m_VisibilityDirty;
+    m_VisibilityDirty = false;
+    m_CulledViews.swap(m_CullViews);
+
+    //Big scenes skip whole subtrees out of (or fully inside) the frustum, small ones are faster testing every box with SIMD.
+    //Shadow views have no near plane, casters between the light and it still throw shadows into the view
+    auto cullStart = std::chrono::high_resolution_clock::now();
+    const uint32_t nViews = static_cast<uint32_t>(m_CulledViews.size());
+    m_VisibilityStats.m_CulledWithBVH = m_ModelStore.size() >= SCENE_BVH_CULL_MIN_MODELS && m_BVH.getModelCount() == m_ModelStore.size();
+    if (m_VisibilityStats.m_CulledWithBVH)
+    {
+        m_VisibilityMasks.assign(m_ModelStore.size(), 0);
+        for (uint32_t view = 0; view < nViews; view++)
+            m_BVH.markFrustum(m_CulledViews[view], m_ModelStore.getBoundsMin(), m_ModelStore.getBoundsMax(), static_cast<uint8_t>(1 << view), m_VisibilityMasks.data(), view > 0);
+    }
+    else
+    {
+        const uint8_t shadowViews = static_cast<uint8_t>(((1 << nViews) - 1) & ~1);
+        m_FrustumCuller.cull(m_ModelStore, m_CulledViews.data(), nViews, shadowViews, m_VisibilityMasks, ServiceLocator::GetJobPool());
+    }
+    m_VisibilityStats.m_CullMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - cullStart).count();
 
+    //What survived the main camera frustum goes through the occlusion culler, shadow views keep everything they see
+    m_VisibilityStats.m_Occlusion = OcclusionStats();
+    if (m_OcclusionCulling && !m_Occluders.empty())
+    {
+        m_OcclusionCuller.cull(m_ModelStore, m_CulledViews[0], m_Occluders, 1, m_VisibilityMasks, ServiceLocator::GetJobPool());
+        m_VisibilityStats.m_Occlusion = m_OcclusionCuller.getStats();
+    }
 
+    //Lists are rewritten in place and compared on the way, a camera move that leaves them as they were costs no queue rebuild
+    const uint32_t nModels = m_ModelStore.size();
+    uint32_t nOpaque = 0;
+    uint32_t nTransparent = 0;
+    uint32_t nShadow = 0;
+    auto append = [&changed](std::vector<ModelHandle>& io_List, uint32_t& io_Count, ModelHandle i_Model) {
+        if (io_Count < io_List.size())
+        {
+            changed |= io_List[io_Count] != i_Model;
+            io_List[io_Count] = i_Model;
+        }
+        else
+        {
+            changed = true;
+            io_List.push_back(i_Model);
+        }
+        io_Count++;
+    };
+    for (ModelHandle model = 0; model < nModels; model++)
+    {
+        const uint8_t mask = m_VisibilityMasks[model];
+        const bool visible = (mask & 1) != 0;
+        const bool shadowVisible = (mask & ~1) != 0;
+        m_ModelStore.setFlag(model, ModelFlag_Visible, visible);
+        m_ModelStore.setFlag(model, ModelFlag_ShadowVisible, shadowVisible);
+        if (m_ModelStore.hasFlag(model, ModelFlag_Transparent))
+        {
+            if (visible)
+                append(m_VisibleTransparent, nTransparent, model);
+        }
+        else
+        {
+            if (visible)
+                append(m_VisibleOpaque, nOpaque, model);
+            if (shadowVisible)
+                append(m_VisibleShadow, nShadow, model);
+        }
+    }
+    changed |= nOpaque != m_VisibleOpaque.size() || nTransparent != m_VisibleTransparent.size() || nShadow != m_VisibleShadow.size();
+    m_VisibleOpaque.resize(nOpaque);
+    m_VisibleTransparent.resize(nTransparent);
+    m_VisibleShadow.resize(nShadow);
+
+    m_VisibilityStats.m_Models = nModels;
+    m_VisibilityStats.m_OpaqueVisible = nOpaque;
+    m_VisibilityStats.m_TransparentVisible = nTransparent;
+    m_VisibilityStats.m_ShadowVisible = nShadow;
+    m_VisibilityStats.m_ShadowViews = static_cast<uint32_t>(m_CulledViews.size() - 1);
+    return changed;
+}
 
+void Scene::SetModelDirty(Model& i_Model)
+{
+    m_DirtyModels.push_back(&i_Model);
+    m_bIsDirty = true;
+}
 
-void Scene::SelectModel(glm::vec2 clickPoint)
+//Dirty models push their local transform into the graph, one pass over the graph brings every world transform under them up
+//to date and the boxes of the models that moved are recomputed in one batch
+bool Scene::updateTransforms()
 {
-    glm::vec3 worldPoint;
-    for (auto& model : m_Models)
+    for (Model* model : m_DirtyModels)
     {
-        const AABB& box = model->getAABB();
-        if (box.pointInside(worldPoint))//TODO: WE NEED A RAY NOT A POINT!
+        model->computeModelMatrix();
+        m_SceneGraph.setLocalTransform(model->GetNode(), model->getLocalMatrix());
+    }
+    m_DirtyModels.clear();
+
+    m_SceneGraph.update(m_ChangedNodes);
+    m_MovedModels.clear();
+    for (uint32_t node : m_ChangedNodes)
+    {
+        const ModelHandle model = m_NodeModels[node];
+        if (model != MODEL_HANDLE_NONE)
         {
-            model->SetSelection(true);
-            
+            m_ModelStore.setWorldMatrix(model, m_SceneGraph.getWorldTransform(node));
+            m_MovedModels.push_back(model);
         }
-        model->SetSelection(false);
     }
+    if (m_MovedModels.empty())
+        return false;
+
+    m_ModelStore.updateWorldBounds(m_MovedModels.data(), m_MovedModels.size());
+    if (m_BVH.getModelCount() == m_ModelStore.size())
+        m_BVH.refit(m_ModelStore.getBoundsMin(), m_ModelStore.getBoundsMax(), m_MovedModels.data(), m_MovedModels.size());
+    return true;
 }
 
-void Scene::Update()
+void Scene::SetOccluder(Model& i_Model, bool i_Occluder)
 {
-    if (!m_bIsInit)
-        return;
-    if (!m_bIsDirty)
-        return;
-    bool hasBeenNotified = false;
-    for (auto& model : m_Models)
+    m_ModelStore.setFlag(i_Model.GetHandle(), ModelFlag_Occluder, i_Occluder);
+    collectOccluders();
+    m_VisibilityDirty = true;
+}
+
+//Occluders are drawn into the depth buffer with their full detail view. A simplified one can bulge in front of the real surface
+//and hide models that are actually visible, the triangle budget skips the occluders it can't afford instead
+void Scene::collectOccluders()
+{
+    m_Occluders.clear();
+    for (ModelHandle model = 0; model < m_ModelStore.size(); model++)
     {
-        if (model->GetDirty())
-        {
-            model->computeModelMatrix();
-            if(!hasBeenNotified)
-            {
-                ServiceLocator::GetSceneManager()->GetSubject().Notify(Subject::Message::SCENEDIRTY);
-                hasBeenNotified = true;
-            }
-        }
+        if (!m_ModelStore.hasFlag(model, ModelFlag_Occluder))
+            continue;
+        const Model& occluder = *m_Models[model];
+        const uint32_t view = occluder.GetLodCount() > 0 ? occluder.GetLodView(0) : m_ModelStore.getMeshViewIndex(model);
+        m_Occluders.push_back({ model, view });
     }
-    if(hasBeenNotified)
-        prepareBatches();//Reordering geometry
 
-    m_bIsDirty = false;
+    const glm::vec3* boundsMin = m_ModelStore.getBoundsMin();
+    const glm::vec3* boundsMax = m_ModelStore.getBoundsMax();
+    std::stable_sort(m_Occluders.begin(), m_Occluders.end(), [boundsMin, boundsMax](const OcclusionOccluder& a, const OcclusionOccluder& b) {
+        return glm::distance(boundsMin[a.m_Model], boundsMax[a.m_Model]) > glm::distance(boundsMin[b.m_Model], boundsMax[b.m_Model]);
+    });
+}
+
+void Scene::buildBVH(const BVHParallelFor& i_ParallelFor)
+{
+    auto buildStart = std::chrono::high_resolution_clock::now();
+    m_BVH.build(m_ModelStore.getBoundsMin(), m_ModelStore.getBoundsMax(), m_ModelStore.size(), i_ParallelFor);
+    const float buildUs = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - buildStart).count();
+    LOGINFO("BVH: " + std::to_string(m_BVH.getNodeCount()) + " nodes over " + std::to_string(m_BVH.getModelCount()) + " models built in " + std::to_string(buildUs) + " us");
 }
 
 
@@ -283,6 +485,7 @@ void Scene::setLightColor(size_t index,glm::vec3 color)
 
 void Scene::updateLightsBuffer()
 {
+    m_DeferredLights.counts = glm::uvec4(static_cast<uint32_t>(m_DirLightCount), 0, 0, 0);
     m_LightsUniformBuffer->update(&m_DeferredLights, sizeof(UBODeferredLights));
     ServiceLocator::GetCameraManager()->GetSubject().Notify(Subject::LIGHTDIRTY, this);
 
@@ -301,7 +504,15 @@ void Scene::DoLightUI(Light& light, std::string& lightName)
     if (GUI::ImguiVec3Controller(lPos, labelsTrans))
     {
       //setLightPosition(i, lPos);
-      light.lightPos = glm::vec4(lPos.x, lPos.y, lPos.z, 0.0);
+      light.lightPos = glm::vec4(lPos.x, lPos.y, lPos.z, light.lightPos.w);
+      bUpdateLightsBuffer = true;
+    }
+
+    float radius = light.lightPos.w;
+    const char* labelRadius = "Radius";
+    if (radius > 0.0f && GUI::ImguiFloatSlider(radius, labelRadius, 0.1f, 100.0f))//Dir lights have none
+    {
+      light.lightPos.w = radius;
       bUpdateLightsBuffer = true;
     }
 
@@ -341,9 +552,9 @@ void Scene::DoLightsUI(bool* pOpen)
 
         if (ImGui::TreeNode("Lights"))
         {
-            for (int i = 0; i <m_PointLightCount; i++)
+            for (int i = 0; i < m_PointLights.size(); i++)
             {
-                auto& light = m_DeferredLights.pointLights[i];
+                auto& light = m_PointLights[i];
                 std::string lightName = "PointLight" + std::to_string(i);
                 if (ImGui::TreeNode((void*)(intptr_t)i, "%s", lightName.c_str()))
                 {
@@ -352,11 +563,11 @@ void Scene::DoLightsUI(bool* pOpen)
                 }
                
             }
-            for (int i = 0; i < m_SpotLightCount; i++)
+            for (int i = 0; i < m_SpotLights.size(); i++)
             {
-              auto& light = m_DeferredLights.spotLights[i];
+              auto& light = m_SpotLights[i];
               std::string lightName = "SpotLight" + std::to_string(i);
-              if (ImGui::TreeNode((void*)(intptr_t)(i +m_PointLightCount) , "%s", lightName.c_str()))
+              if (ImGui::TreeNode((void*)(intptr_t)(i + m_PointLights.size()) , "%s", lightName.c_str()))
               {
                 DoLightUI(light, lightName);
                 ImGui::TreePop();
@@ -367,7 +578,7 @@ void Scene::DoLightsUI(bool* pOpen)
             {
               auto& light = m_DeferredLights.dirLights[i];
               std::string lightName = "DirLight" + std::to_string(i);
-              if (ImGui::TreeNode((void*)(intptr_t)(i + m_PointLightCount + m_SpotLightCount), "%s", lightName.c_str()))
+              if (ImGui::TreeNode((void*)(intptr_t)(i + m_PointLights.size() + m_SpotLights.size()), "%s", lightName.c_str()))
               {
                 DoLightUI(light, lightName);
                 ImGui::TreePop();
@@ -381,6 +592,12 @@ void Scene::DoLightsUI(bool* pOpen)
         {
             createLight(ServiceLocator::GetCameraManager()->GetCamera("mainCamera")->GetPosition(),glm::vec3(1.0f),0.01f,LightType::LightType_Point);
         }
+        ImGui::SameLine();
+        if (ImGui::Button("Scatter lights!"))
+        {
+            scatterPointLights(SCENE_LIGHT_SCATTER_COUNT);
+        }
+        ImGui::Text("%zu point lights, %zu spot lights", m_PointLights.size(), m_SpotLights.size());
     }
     ImGui::End();
 
@@ -410,23 +627,35 @@ void Scene::createLight(const glm::vec3& position, const glm::vec3& color,float
     updateLightsBuffer();
 }
 
+void Scene::scatterPointLights(uint32_t i_Count)
+{
+  const glm::vec3 min = m_SceneAABB.get_min();
+  const glm::vec3 size = m_SceneAABB.get_max() - min;
+  auto random = []() { return static_cast<float>(std::rand()) / RAND_MAX; };
+  m_PointLights.reserve(m_PointLights.size() + i_Count);
+  for (uint32_t i = 0; i < i_Count; i++)
+  {
+    const glm::vec3 position = min + size * glm::vec3(random(), random(), random());
+    const glm::vec3 color = glm::vec3(random(), random(), random());
+    createPointLight(position, color, 0.5f);
+  }
+  updateLightsBuffer();
+}
+
 void Scene::createPointLight(const glm::vec3& position, const glm::vec3& color, float attenuation)
 {
-  if (m_PointLightCount >= MAX_DEFERRED_POINT_LIGHTS)
-    return;
-  m_DeferredLights.pointLights[m_PointLightCount].lightPos = glm::vec4(position.x, position.y, position.z, 0.0);
-  m_DeferredLights.pointLights[m_PointLightCount].lightColor = glm::vec4(color.r, color.g, color.b, attenuation);
-  m_PointLightCount++;
+  Light light;
+  light.lightPos = glm::vec4(position.x, position.y, position.z, SCENE_LIGHT_DEFAULT_RADIUS);
+  light.lightColor = glm::vec4(color.r, color.g, color.b, attenuation);
+  m_PointLights.push_back(light);
 
 }
 void Scene::createSpotLight(const glm::vec3& position, const glm::vec3& color, float attenuation)
 {
-  if (m_SpotLightCount >= MAX_DEFERRED_SPOT_LIGHTS)
-    return;
-
-  m_DeferredLights.spotLights[m_SpotLightCount].lightPos = glm::vec4(position.x, position.y, position.z, 0.0);
-  m_DeferredLights.spotLights[m_SpotLightCount].lightColor = glm::vec4(color.r, color.g, color.b, attenuation);
-  m_SpotLightCount++;
+  Light light;
+  light.lightPos = glm::vec4(position.x, position.y, position.z, SCENE_LIGHT_DEFAULT_RADIUS);
+  light.lightColor = glm::vec4(color.r, color.g, color.b, attenuation);
+  m_SpotLights.push_back(light);
 }
 void Scene::createDirLight(const glm::vec3& position, const glm::vec3& color)
 {
@@ -459,6 +688,14 @@ Material* Scene::createMaterial(std::string i_sMaterialName, std::vector<std::pa
   m_Materials[matIndex]->Init(i_sMaterialName, i_Textures, isTransparent, &m_MaterialParametersUBO.m_Materials[matIndex], matIndex);
   Material* mat = m_Materials[matIndex];
 
+  //Textures past the bindless array are never written to it, those slots sample nothing rather than out of bounds
+  for (uint32_t slot = 0; slot < MATERIAL_TEXTURE_SLOTS; slot++)
+  {
+    auto textureIt = std::find(m_Textures.begin(), m_Textures.end(), mat->GetTextureByName(Material::GetTextureSlotName(slot)));
+    const size_t textureIndex = textureIt - m_Textures.begin();
+    m_MaterialParametersUBO.m_Materials[matIndex].m_Textures[slot] = textureIt != m_Textures.end() && textureIndex < BINDLESS_MAX_TEXTURES ? static_cast<int>(textureIndex) : -1;
+  }
+
   if (updateBuffer)
     updateMaterialsBuffer();
 
@@ -480,10 +717,19 @@ Material* Scene::createMaterial(std::string i_sMaterialName, std::vector<std::pa
          s_BoxMesh->setData(descriptions,s_VerticesBox, s_IndicesBox, &s_ColorsBox);
      }
          
-     MeshView meshView{ 0,s_IndicesBox.size(),0,s_VerticesBox.size(),-1 };
-
-     m_Models.emplace_back(std::make_unique<Model>(*s_BoxMesh, meshView,*this, "Box!!"));
+     MeshView meshView = s_BoxMesh->toArenaView({ 0,(uint32_t)s_IndicesBox.size(),0,(uint32_t)s_VerticesBox.size(),(uint32_t)-1 });
+     AABB boxBounds;
+     boxBounds.update(s_VerticesBox, s_IndicesBox);
+     meshView.m_BoundsMin = boxBounds.get_min();
+     meshView.m_BoundsMax = boxBounds.get_max();
+
+     const uint32_t view = m_ModelStore.addMeshView(*s_BoxMesh, meshView);
+     const ModelHandle handle = m_ModelStore.addModel(view, 0, 0);//Material set below
+     m_Models.emplace_back(std::make_unique<Model>(m_ModelStore, handle, *this, "Box!!"));
      auto& model = m_Models.back();
+     const uint32_t node = m_SceneGraph.addNode(SCENE_GRAPH_NO_PARENT, glm::mat4(1.0f));
+     m_NodeModels.push_back(handle);
+     model->SetNode(node);
      if (s_DefaultMaterial == nullptr)
      {
          
@@ -492,17 +738,8 @@ Material* Scene::createMaterial(std::string i_sMaterialName, std::vector<std::pa
      }
      model->SetMaterial(s_DefaultMaterial);
 
-     //if (m_Materials[0].isTransparent())
-     //{
-         m_TransparentModels.push_back(*model);
-     //}
-     //else
-     //{
-         //m_OpaqueModels.push_back(*model);
-     //}
-
      glm::mat4 transform;
-     transform = glm::translate(transform, -position);
+     transform = glm::translate(transform, position);
      model->SetTransform(transform);
 
     
@@ -548,6 +785,11 @@ void Scene::DoModelsUI(bool* pOpen)
                         model->Scale(scale);
                         
                     }
+                    bool occluder = m_ModelStore.hasFlag(model->GetHandle(), ModelFlag_Occluder);
+                    if (ImGui::Checkbox("Occluder", &occluder))
+                    {
+                        SetOccluder(*model, occluder);
+                    }
                     if (ImGui::Button("Goto.."))
                     {
                         ServiceLocator::GetCameraManager()->GetCamera("mainCamera")->CenterAt(model->getAABB().get_center());
@@ -559,6 +801,10 @@ void Scene::DoModelsUI(bool* pOpen)
             }
             ImGui::TreePop();
         }
+        if (m_SelectedModel != MODEL_HANDLE_NONE)
+        {
+            ImGui::Text("Selected: %s", m_Models[m_SelectedModel]->getName().c_str());
+        }
         if (ImGui::Button("Create Box!"))
         {
             createBox(ServiceLocator::GetCameraManager()->GetCamera("mainCamera")->GetPosition());
@@ -571,59 +817,223 @@ void Scene::DoModelsUI(bool* pOpen)
 void myCallback(const char* msg, char* userData) {
     LOGINFO(msg);
 }
-void Scene::loadAssets(const std::string i_ScenePath)
+static const uint32_t s_ImportFlags = aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace;
+
+static float elapsedMs(std::chrono::high_resolution_clock::time_point start)
 {
+    return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
 
-	const aiScene* aScene;
+//Scene loading jobs go to the loader pool past threads[0], the thread running the load, which takes jobs too instead of just waiting
+#define SCENE_LOAD_FIRST_WORKER 1
 
-  LOGINFO("\n-----------------Attempting to open scene : "+ i_ScenePath + "-----------------------");
+//Texture decoding stage of the scene loader. Every thread pool worker except the one running the load decodes images
+//and hands them over to the loading thread through a bounded queue, so decoding image N+1 overlaps with uploading image N
+#define MAX_DECODED_IMAGES_IN_FLIGHT 4
 
-	Assimp::Importer Importer;
-  aiString supported;
-  Importer.GetExtensionList(supported);
+struct DecodedImage
+{
+    uint32_t m_Index = 0;
+    unsigned char* m_Pixels = nullptr;
+    int m_Width = 0;
+    int m_Height = 0;
+};
 
-  
-  Assimp::DefaultLogger::create("", Assimp::Logger::VERBOSE, aiDefaultLogStream_STDOUT);
+class TextureDecodePipeline
+{
+public:
+    TextureDecodePipeline(const std::vector<BakedMaterial>& i_Materials, const std::string& i_SceneTexturesPath) :
+        m_TexturesPath(i_SceneTexturesPath),
+        m_Queue(MAX_DECODED_IMAGES_IN_FLIGHT)
+    {
+        for (auto& material : i_Materials)
+        {
+            for (auto& textureRef : material.m_Textures)
+            {
+                std::string fileName = i_SceneTexturesPath + textureRef.second;
+                if (m_FileIndices.emplace(fileName, static_cast<uint32_t>(m_Files.size())).second)//Avoid decoding the same texture more than once
+                    m_Files.push_back(fileName);
+            }
+        }
+    }
+    ~TextureDecodePipeline()
+    {
+        m_Queue.close();
+        for (auto worker : m_Workers)
+            worker->wait();
+        DecodedImage image;
+        while (m_Queue.pop(image))
+            stbi_image_free(image.m_Pixels);
+    }
 
-  int flags =   aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace;
-	aScene = Importer.ReadFile(i_ScenePath, flags);//TODO: Iterate filesystem and read all .obj files
+    void start()
+    {
+        //threads[0] is the one running the scene load
+        auto& threads = ServiceLocator::GetThreadPool()->threads;
+        for (size_t i = 1; i < threads.size() && i <= m_Files.size(); i++)
+        {
+            m_Workers.push_back(threads[i].get());
+            threads[i]->addJob([this] { decodeLoop(); });
+        }
+    }
 
-	if (aScene == nullptr)
-		throw std::runtime_error("Scene model not found, I will handle this properly at some point shouldn't just break!");
+    bool pop(DecodedImage& o_Image)
+    {
+        if (m_Workers.empty())//No workers available, decode on demand in the calling thread
+        {
+            uint32_t index = m_NextImage++;
+            if (index >= m_Files.size())
+                return false;
+            o_Image = decode(index);
+            return true;
+        }
+        return m_Queue.pop(o_Image);
+    }
+
+    size_t getImageCount() const { return m_Files.size(); }
+    size_t getWorkerCount() const { return m_Workers.size(); }
+    uint32_t getImageIndex(const std::string& i_TextureRef) const { return m_FileIndices.at(m_TexturesPath + i_TextureRef); }
+    float getDecodeTime() const { return m_DecodeTimeUs / 1000.0f; }
+
+private:
+    DecodedImage decode(uint32_t i_Index)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        DecodedImage image;
+        image.m_Index = i_Index;
+        int texChannels;
+        image.m_Pixels = stbi_load(m_Files[i_Index].c_str(), &image.m_Width, &image.m_Height, &texChannels, STBI_rgb_alpha);
+        if (image.m_Pixels == nullptr)
+        {
+            // todo : separate pipeline and layout
+            image.m_Pixels = stbi_load("Textures/baboon.jpg", &image.m_Width, &image.m_Height, &texChannels, STBI_rgb_alpha);
+        }
+        m_DecodeTimeUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+        return image;
+    }
+
+    void decodeLoop()
+    {
+        while (true)
+        {
+            uint32_t index = m_NextImage++;
+            if (index >= m_Files.size())
+                return;
+            DecodedImage image = decode(index);
+            if (!m_Queue.push(DecodedImage(image)))//Pipeline got torn down
+            {
+                stbi_image_free(image.m_Pixels);
+                return;
+            }
+        }
+    }
+
+    std::string m_TexturesPath;
+    std::vector<std::string> m_Files;
+    std::unordered_map<std::string, uint32_t> m_FileIndices;
+    BoundedQueue<DecodedImage> m_Queue;
+    std::vector<Thread*> m_Workers;
+    std::atomic<uint32_t> m_NextImage{ 0 };
+    std::atomic<int64_t> m_DecodeTimeUs{ 0 };
+};
+
+void Scene::loadAssets(const std::string i_ScenePath)
+{
+  auto loadStart = std::chrono::high_resolution_clock::now();
+  m_LoadTimings = SceneLoadTimings();
+
+  LOGINFO("\n-----------------Attempting to open scene : "+ i_ScenePath + "-----------------------");
 
- 
-  Assimp::DefaultLogger::kill();
-	
 	std::string iRootScenePath = i_ScenePath.substr(0, i_ScenePath.find_last_of("\\/")) + "\\";
-	
 
   m_MaterialsUniformBuffer = ServiceLocator::GetRenderer()->CreateStaticUniformBuffer(&m_MaterialParametersUBO, sizeof(UBOMaterial));
   createMaterial("BackgroundMaterial", nullptr, false, glm::vec4(0.0f), glm::vec4(0.4f), glm::vec4(0.0f), false);//TODO: Material list has to be empty before loadmaterials if not the index stored in the mesh is invalid
-	loadMaterials(aScene, iRootScenePath);
-  
 
+  m_SceneBoundMin = glm::vec3(std::numeric_limits<float>::max());
+  m_SceneBoundMax = glm::vec3(std::numeric_limits<float>::min());
+
+  //Parse stage: baked scene if there is an up to date one, assimp otherwise
+  SceneCache cache;
+  SceneBakeData bakeData;
+  bool fromCache = cache.Open(i_ScenePath, s_ImportFlags);
+  if (fromCache)
+    LOGINFO("Loading baked scene: " + SceneCache::GetCachePath(i_ScenePath));
+  else
+    importScene(i_ScenePath, bakeData);
+  const std::vector<BakedMaterial>& materials = fromCache ? cache.GetMaterials() : bakeData.m_Materials;
+  m_LoadTimings.m_Parse = elapsedMs(loadStart);
+
+  //Decode stage runs on the worker threads from here on, overlapping with everything below
+  TextureDecodePipeline textureDecoder(materials, iRootScenePath);
+  textureDecoder.start();
+
+  if (!fromCache)
+  {
+    auto bakeStart = std::chrono::high_resolution_clock::now();
+    SceneCache::Write(i_ScenePath, s_ImportFlags, bakeData);
+    m_LoadTimings.m_CacheWrite = elapsedMs(bakeStart);
+  }
+
+  //Upload stage, geometry first (baked streams go straight from the mapped file) then textures as they get decoded
+  auto meshStart = std::chrono::high_resolution_clock::now();
+  if (fromCache)
+    createMeshes(cache.GetStreams(), cache.GetMeshViews(), cache.GetMeshViewCount(), cache.GetMeshlets(), cache.GetMeshletCount());
+  else
+    createMeshes(bakeData.getStreams(), bakeData.m_MeshViews.data(), static_cast<uint32_t>(bakeData.m_MeshViews.size()),
+      bakeData.m_Meshlets.data(), static_cast<uint32_t>(bakeData.m_Meshlets.size()));
+  m_LoadTimings.m_MeshUpload = elapsedMs(meshStart);
+
+  createMaterials(materials, textureDecoder);
   updateMaterialsBuffer();
+  createModels(fromCache ? cache.GetNodes() : bakeData.m_Nodes);
+  cache.Close();
 
-	loadMeshes(aScene);
+  //Uploads went out in batches while we were busy, only block on whatever is still in flight
+  auto uploadWaitStart = std::chrono::high_resolution_clock::now();
+  ServiceLocator::GetRenderer()->WaitForUploads();
+  m_LoadTimings.m_UploadWait = elapsedMs(uploadWaitStart);
 
-  m_SceneBoundMin = glm::vec3(std::numeric_limits<float>::max());
-  m_SceneBoundMax = glm::vec3(std::numeric_limits<float>::min());
-  loadSceneRecursive(aScene->mRootNode);
   m_SceneAABB = AABB(m_SceneBoundMin, m_SceneBoundMax);
 
-
-  
-  
   m_LightsUniformBuffer = ServiceLocator::GetRenderer()->CreateStaticUniformBuffer(&m_DeferredLights, sizeof(UBODeferredLights));
+
+  m_LoadTimings.m_Decode = textureDecoder.getDecodeTime();
+  m_LoadTimings.m_Total = elapsedMs(loadStart);
+  LOGINFO("Scene load timings (ms): parse " + std::to_string(m_LoadTimings.m_Parse) +
+    " (mesh optimize " + std::to_string(m_LoadTimings.m_MeshOptimize) + ", lod generation " + std::to_string(m_LoadTimings.m_LodGenerate) + ")" +
+    " | cache write " + std::to_string(m_LoadTimings.m_CacheWrite) +
+    " | mesh upload " + std::to_string(m_LoadTimings.m_MeshUpload) +
+    " | texture decode " + std::to_string(m_LoadTimings.m_Decode) + " (" + std::to_string(textureDecoder.getImageCount()) + " images, " + std::to_string(textureDecoder.getWorkerCount()) + " threads)" +
+    " | texture upload " + std::to_string(m_LoadTimings.m_TextureUpload) +
+    " | waiting for decode " + std::to_string(m_LoadTimings.m_DecodeStall) +
+    " | waiting for gpu uploads " + std::to_string(m_LoadTimings.m_UploadWait) +
+    " | total " + std::to_string(m_LoadTimings.m_Total));
+}
+
+void Scene::importScene(const std::string i_ScenePath, SceneBakeData& o_BakeData)
+{
+	const aiScene* aScene;
+
+	Assimp::Importer Importer;
+  aiString supported;
+  Importer.GetExtensionList(supported);
+
   
-  
+  Assimp::DefaultLogger::create("", Assimp::Logger::VERBOSE, aiDefaultLogStream_STDOUT);
 
+	aScene = Importer.ReadFile(i_ScenePath, s_ImportFlags);//TODO: Iterate filesystem and read all .obj files
 
- 
+	if (aScene == nullptr)
+		throw std::runtime_error("Scene model not found, I will handle this properly at some point shouldn't just break!");
 
-  //Only need this during creation
-  m_MeshMap.clear();
  
+  Assimp::DefaultLogger::kill();
+
+	loadMaterials(aScene, o_BakeData.m_Materials);
+	loadMeshes(aScene, o_BakeData);
+  optimizeMeshes(o_BakeData);
+  generateLods(o_BakeData);
+  loadSceneRecursive(aScene->mRootNode, SCENE_GRAPH_NO_PARENT, o_BakeData.m_Nodes);
 }
 
 const char* fromAiTexureTypesToShaderName(aiTextureType texType)
@@ -667,33 +1077,25 @@ const char* fromAiTexureTypesToShaderName(aiTextureType texType)
 }
 
 
-void Scene::loadMaterials(const aiScene* i_aScene, const std::string i_SceneTexturesPath)
+void Scene::loadMaterials(const aiScene* i_aScene, std::vector<BakedMaterial>& o_Materials)
 {
-	RendererAbstract* renderer = ServiceLocator::GetRenderer();
-  std::unordered_map<std::string, Texture*> fileNameImages;//Map to avoid loading the same texture more than once
 	int numberOfMaterialsInScene =i_aScene->mNumMaterials;
-	//m_Materials.resize(numberOfMaterialsInScene);
 
 	for (int i = 0; i < numberOfMaterialsInScene; i++)
 	{
+    o_Materials.emplace_back();
+    BakedMaterial& bakedMaterial = o_Materials.back();
 
-    std::vector<std::pair<std::string,Texture*>> texturesInMaterial;
 		aiMaterial* pMaterial = i_aScene->mMaterials[i];
 		aiString matName;
 		pMaterial->Get(AI_MATKEY_NAME, matName);
-
-    LOGINFO("\n Creating material: " + matName.C_Str());
+    bakedMaterial.m_Name = std::string(matName.C_Str());
 
     float opacity;
     pMaterial->Get(AI_MATKEY_OPACITY, opacity);
-    bool isTransparent = opacity < 1.0f || pMaterial->GetTextureCount(aiTextureType_OPACITY);
+    bakedMaterial.m_Transparent = opacity < 1.0f || pMaterial->GetTextureCount(aiTextureType_OPACITY);
 
 		aiString texturefile;
-		// Diffuse
-		unsigned char* pPixels = nullptr;
-		int width, height;
-		int texChannels;
-		
     int aiTexureTypes = aiTextureType_UNKNOWN - 1;
    
     for (int i = 0; i < aiTexureTypes; i++)
@@ -704,39 +1106,8 @@ void Scene::loadMaterials(const aiScene* i_aScene, const std::string i_SceneText
 
         if (pMaterial->GetTextureCount(texType) > 0)
         {
-            Texture* texture = nullptr;
             pMaterial->GetTexture(texType, 0, &texturefile);
-            std::string fileName = i_SceneTexturesPath + std::string(texturefile.C_Str());
-            auto texIterator = fileNameImages.find(fileName);
-            if (texIterator != fileNameImages.end())
-            {
-                texture = fileNameImages[fileName];
-            }
-            else
-            {
-                
-                LOGINFO("\n Loading image: " + fileName);
-
-                pPixels = stbi_load(fileName.c_str(), &width, &height, &texChannels, STBI_rgb_alpha);
-
-                if (pPixels == nullptr)
-                {
-
-                    // todo : separate pipeline and layout
-                    pPixels = stbi_load("Textures/baboon.jpg", &width, &height, &texChannels, STBI_rgb_alpha);
-                }
-                if (pPixels == nullptr)
-                    throw std::runtime_error("Texture not found, I will handle this properly at some point shouldn't just break!");
-
-                texture = renderer->CreateTexture((void*)pPixels, width, height);
-                m_Textures.push_back(texture);
-                fileNameImages[fileName] = texture;
-                stbi_image_free(pPixels);
-            }
-            if (texture)
-            {
-                texturesInMaterial.push_back({ fromAiTexureTypesToShaderName(texType),texture });
-            }
+            bakedMaterial.m_Textures.push_back({ fromAiTexureTypesToShaderName(texType), std::string(texturefile.C_Str()) });
         }
     }
     aiColor3D diffuse, ambient, specular;
@@ -746,28 +1117,66 @@ void Scene::loadMaterials(const aiScene* i_aScene, const std::string i_SceneText
     pMaterial->Get(AI_MATKEY_COLOR_SPECULAR, specular);
     pMaterial->Get(AI_MATKEY_SHININESS, shininess);
 
-
-		createMaterial(std::string(matName.C_Str()),&texturesInMaterial,isTransparent,glm::vec4(diffuse.r, diffuse.g, diffuse.b,0.0), glm::vec4(ambient.r,ambient.g,ambient.b,0.0), glm::vec4(specular.r,specular.g,specular.b, shininess),false);//false for not updating the buffer here we do it manually when all the scene materials ready
+    bakedMaterial.m_Diffuse = glm::vec4(diffuse.r, diffuse.g, diffuse.b, 0.0);
+    bakedMaterial.m_Ambient = glm::vec4(ambient.r, ambient.g, ambient.b, 0.0);
+    bakedMaterial.m_Specular = glm::vec4(specular.r, specular.g, specular.b, shininess);
 	}
 }
 
-void Scene::loadMeshes(const aiScene* i_aScene)
+void Scene::createMaterials(const std::vector<BakedMaterial>& i_Materials, TextureDecodePipeline& i_TextureDecoder)
 {
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec3> colors;
-    std::vector<glm::vec2> texCoords;
-    std::vector<glm::vec3> normals;
-    std::vector<glm::vec3> tangents;
-    std::vector<glm::vec3> biTangents;
-    std::vector<uint32_t>  indices;
-    std::unordered_map<std::string, AttributeDescription> descriptions;
-    AttributeDescription avec3{ VK_FORMAT_R32G32B32_SFLOAT,12,0 };
-    AttributeDescription avec2{ VK_FORMAT_R32G32_SFLOAT,8,0 };
-    descriptions.emplace("inPosition", avec3);
+	RendererAbstract* renderer = ServiceLocator::GetRenderer();
 
-  m_Meshes.emplace_back(std::make_unique<Mesh>());
-  Mesh& mesh = *m_Meshes.back();
-  
+  //Upload textures in whatever order they come out of the decoders
+  std::vector<Texture*> textures(i_TextureDecoder.getImageCount(), nullptr);
+  bool textureMissing = false;
+  for (size_t i = 0; i < textures.size(); i++)
+  {
+    DecodedImage image;
+    auto waitStart = std::chrono::high_resolution_clock::now();
+    if (!i_TextureDecoder.pop(image))
+      break;
+    m_LoadTimings.m_DecodeStall += elapsedMs(waitStart);
+
+    if (image.m_Pixels == nullptr)
+    {
+      textureMissing = true;
+      continue;
+    }
+    auto uploadStart = std::chrono::high_resolution_clock::now();
+    textures[image.m_Index] = renderer->CreateTexture((void*)image.m_Pixels, image.m_Width, image.m_Height);
+    stbi_image_free(image.m_Pixels);
+    m_LoadTimings.m_TextureUpload += elapsedMs(uploadStart);
+  }
+  for (auto texture : textures)
+  {
+    if (texture)
+      m_Textures.push_back(texture);
+  }
+  if (textureMissing)
+    throw std::runtime_error("Texture not found, I will handle this properly at some point shouldn't just break!");
+
+	for (auto& bakedMaterial : i_Materials)
+	{
+    std::vector<std::pair<std::string,Texture*>> texturesInMaterial;
+
+    LOGINFO("\n Creating material: " + bakedMaterial.m_Name);
+
+    for (auto& textureRef : bakedMaterial.m_Textures)
+    {
+        Texture* texture = textures[i_TextureDecoder.getImageIndex(textureRef.second)];
+        if (texture)
+        {
+            texturesInMaterial.push_back({ textureRef.first,texture });
+        }
+    }
+
+		createMaterial(bakedMaterial.m_Name,&texturesInMaterial,bakedMaterial.m_Transparent,bakedMaterial.m_Diffuse, bakedMaterial.m_Ambient, bakedMaterial.m_Specular,false);//false for not updating the buffer here we do it manually when all the scene materials ready
+	}
+}
+
+void Scene::loadMeshes(const aiScene* i_aScene, SceneBakeData& o_BakeData)
+{
 	int numberOfMeshesInScene = i_aScene->mNumMeshes;
 
 
@@ -778,58 +1187,35 @@ void Scene::loadMeshes(const aiScene* i_aScene)
 		aiMesh *aMesh = i_aScene->mMeshes[i];
 
 		bool hasUV = aMesh->HasTextureCoords(0);
-    if (hasUV)
-        descriptions.emplace("inTexCoord", avec2);
 		bool hasColor = aMesh->HasVertexColors(0);
-    if (hasUV)
-        descriptions.emplace("inColor", avec3);
 		bool hasNormals = aMesh->HasNormals();
-    if (hasUV)
-        descriptions.emplace("inNormal", avec3);
     bool hasTangentsAndBitangents = aMesh->HasTangentsAndBitangents();
-    if (hasUV)
-    {
-        descriptions.emplace("inTangent", avec3);
-        descriptions.emplace("inBiTangent", avec3);
-    }
-        
-
-
-    
-
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
 
 		for (uint32_t v = 0; v < aMesh->mNumVertices; v++)
 		{
-        positions.push_back(glm::vec3(aMesh->mVertices[v].x, aMesh->mVertices[v].y, aMesh->mVertices[v].z));
+        o_BakeData.m_Positions.push_back(glm::vec3(aMesh->mVertices[v].x, aMesh->mVertices[v].y, aMesh->mVertices[v].z));
+        boundsMin = glm::min(boundsMin, o_BakeData.m_Positions.back());
+        boundsMax = glm::max(boundsMax, o_BakeData.m_Positions.back());
 
         if (hasColor)
         {
-            colors.push_back(glm::make_vec3(&aMesh->mColors[0][v].r));
+            o_BakeData.m_Colors.push_back(glm::make_vec3(&aMesh->mColors[0][v].r));
         }
         if (hasUV)
         {
-            texCoords.push_back(glm::vec2(aMesh->mTextureCoords[0][v].x, 1.0f - aMesh->mTextureCoords[0][v].y));
+            o_BakeData.m_TexCoords.push_back(glm::vec2(aMesh->mTextureCoords[0][v].x, 1.0f - aMesh->mTextureCoords[0][v].y));
         }
         if (hasNormals)
         {
-            normals.push_back(glm::make_vec3(&aMesh->mNormals[v].x));
+            o_BakeData.m_Normals.push_back(glm::make_vec3(&aMesh->mNormals[v].x));
         }
         if (hasTangentsAndBitangents)
         {
-            tangents.push_back(glm::make_vec3(&aMesh->mTangents[v].x));
-            biTangents.push_back(glm::make_vec3(&aMesh->mBitangents[v].x));
+            o_BakeData.m_Tangents.push_back(glm::make_vec3(&aMesh->mTangents[v].x));
+            o_BakeData.m_BiTangents.push_back(glm::make_vec3(&aMesh->mBitangents[v].x));
         }
-
-
-
-			/*Vertex vertex;
-			vertex.pos = glm::vec3(aMesh->mVertices[v].x, aMesh->mVertices[v].y, aMesh->mVertices[v].z);
-			vertex.texCoord = hasUV ? glm::vec2(aMesh->mTextureCoords[0][v].x, 1.0f - aMesh->mTextureCoords[0][v].y) : glm::vec2(0.0f);
-			vertex.normal = hasNormals ? glm::make_vec3(&aMesh->mNormals[v].x) : glm::vec3(0.0f);
-      vertex.tangent = hasTangentsAndBitangents ? glm::make_vec3(&aMesh->mTangents[v].x) : glm::vec3(0.0f);
-      vertex.biTangent = hasTangentsAndBitangents ? glm::make_vec3(&aMesh->mBitangents[v].x) : glm::vec3(0.0f);
-			vertex.color = hasColor ? glm::make_vec3(&aMesh->mColors[0][v].r) : glm::vec3(1.0f);
-      mesh.pushVertex(vertex);*/
 		}
 		
 
@@ -843,77 +1229,287 @@ void Scene::loadMeshes(const aiScene* i_aScene)
 			}
 			for (uint32_t j = 0; j < pFace->mNumIndices; j++)
 			{
-          //mesh.pushIndex(pFace->mIndices[j]);
-          indices.push_back(pFace->mIndices[j]);
+          o_BakeData.m_Indices.push_back(pFace->mIndices[j]);
 				  iNIndices++;
 			}
 		}
 
-    m_MeshMap.emplace(i, MeshWithView(&mesh, { iCurrentIndex, iNIndices, iVertexGeneralCount, aMesh->mNumVertices,aMesh->mMaterialIndex+1 }));//TODO: This material index is offset 1 because of background material, not ideal..
-    
-  
-    
-
+    o_BakeData.m_MeshViews.push_back({ iCurrentIndex, iNIndices, iVertexGeneralCount, aMesh->mNumVertices,aMesh->mMaterialIndex+1 });//TODO: This material index is offset 1 because of background material, not ideal..
+    if (aMesh->mNumVertices > 0)
+    {
+        o_BakeData.m_MeshViews.back().m_BoundsMin = boundsMin;
+        o_BakeData.m_MeshViews.back().m_BoundsMax = boundsMax;
+    }
 
 		iCurrentIndex += iNIndices;
 		iVertexGeneralCount += aMesh->mNumVertices;
 	}
+}
 
-  mesh.setData(descriptions,positions, indices, &colors, &texCoords, &normals, &tangents, &biTangents);
-  
+//Vertex cache, overdraw and vertex fetch ordering for every mesh view, then its meshlets out of the final triangle order. Views own
+//disjoint index and vertex ranges so they are spread over the thread pool, each one is optimized on its own so the result doesn't depend on scheduling
+void Scene::optimizeMeshes(SceneBakeData& io_BakeData)
+{
+  auto optimizeStart = std::chrono::high_resolution_clock::now();
+
+  const uint32_t nViews = static_cast<uint32_t>(io_BakeData.m_MeshViews.size());
+  std::vector<float> missesBefore(nViews, 0.0f);
+  std::vector<float> missesAfter(nViews, 0.0f);
+  std::vector<std::vector<Meshlet>> viewMeshlets(nViews);
+  //Same rule as SceneBakeData::getStreams, a stream not covering every vertex is dropped at upload so it isn't remapped either
+  const size_t nVertices = io_BakeData.m_Positions.size();
+  const bool remapColors = io_BakeData.m_Colors.size() == nVertices;
+  const bool remapTexCoords = io_BakeData.m_TexCoords.size() == nVertices;
+  const bool remapNormals = io_BakeData.m_Normals.size() == nVertices;
+  const bool remapTangents = io_BakeData.m_Tangents.size() == nVertices;
+  const bool remapBiTangents = io_BakeData.m_BiTangents.size() == nVertices;
+
+  uint32_t nThreads = runJobs(ServiceLocator::GetThreadPool(), nViews, [&](uint32_t viewIndex) {
+      const MeshView& view = io_BakeData.m_MeshViews[viewIndex];
+      if (view.m_NIndices < 3 || view.m_NVertices == 0)
+        return;
+      uint32_t* indices = io_BakeData.m_Indices.data() + view.m_IndicesMeshStart;
+      const uint32_t vertexStart = view.m_VerticesMeshStart;
+      const float nTriangles = static_cast<float>(view.m_NIndices / 3);
+
+      missesBefore[viewIndex] = MeshOptimizer::ComputeACMR(indices, view.m_NIndices, view.m_NVertices) * nTriangles;
+      MeshOptimizer::OptimizeVertexCache(indices, view.m_NIndices, view.m_NVertices);
+      MeshOptimizer::OptimizeOverdraw(indices, view.m_NIndices, io_BakeData.m_Positions.data() + vertexStart, view.m_NVertices);
+      std::vector<uint32_t> remap;
+      MeshOptimizer::OptimizeVertexFetch(indices, view.m_NIndices, view.m_NVertices, remap);
+      missesAfter[viewIndex] = MeshOptimizer::ComputeACMR(indices, view.m_NIndices, view.m_NVertices) * nTriangles;
+
+      MeshOptimizer::RemapStream(io_BakeData.m_Positions.data() + vertexStart, remap);
+      if (remapColors)
+        MeshOptimizer::RemapStream(io_BakeData.m_Colors.data() + vertexStart, remap);
+      if (remapTexCoords)
+        MeshOptimizer::RemapStream(io_BakeData.m_TexCoords.data() + vertexStart, remap);
+      if (remapNormals)
+        MeshOptimizer::RemapStream(io_BakeData.m_Normals.data() + vertexStart, remap);
+      if (remapTangents)
+        MeshOptimizer::RemapStream(io_BakeData.m_Tangents.data() + vertexStart, remap);
+      if (remapBiTangents)
+        MeshOptimizer::RemapStream(io_BakeData.m_BiTangents.data() + vertexStart, remap);
+
+      MeshOptimizer::BuildMeshlets(indices, view.m_NIndices, io_BakeData.m_Positions.data() + vertexStart, view.m_NVertices, viewMeshlets[viewIndex]);
+      for (auto& meshlet : viewMeshlets[viewIndex])
+        meshlet.m_IndicesMeshStart += view.m_IndicesMeshStart;
+  }, SCENE_LOAD_FIRST_WORKER);
+
+  //Appended in view order, same as the levels of detail
+  io_BakeData.m_Meshlets.clear();
+  for (uint32_t i = 0; i < nViews; i++)
+  {
+    io_BakeData.m_MeshViews[i].m_FirstMeshlet = static_cast<uint32_t>(io_BakeData.m_Meshlets.size());
+    io_BakeData.m_MeshViews[i].m_NMeshlets = static_cast<uint32_t>(viewMeshlets[i].size());
+    io_BakeData.m_Meshlets.insert(io_BakeData.m_Meshlets.end(), viewMeshlets[i].begin(), viewMeshlets[i].end());
+  }
+
+  float totalBefore = 0.0f;
+  float totalAfter = 0.0f;
+  float totalTriangles = 0.0f;
+  for (uint32_t i = 0; i < nViews; i++)
+  {
+    totalBefore += missesBefore[i];
+    totalAfter += missesAfter[i];
+    totalTriangles += static_cast<float>(io_BakeData.m_MeshViews[i].m_NIndices / 3);
+  }
+  m_LoadTimings.m_MeshOptimize = elapsedMs(optimizeStart);
+  if (totalTriangles > 0.0f)
+  {
+    LOGINFO("Mesh optimization: ACMR " + std::to_string(totalBefore / totalTriangles) + " -> " + std::to_string(totalAfter / totalTriangles) +
+      ", " + std::to_string(io_BakeData.m_Meshlets.size()) + " meshlets (" + std::to_string(nViews) + " meshes, " + std::to_string(nThreads) + " threads, " +
+      std::to_string(m_LoadTimings.m_MeshOptimize) + " ms)");
+  }
 }
 
-glm::mat4 getNodeTransformation(const aiNode* i_Node, glm::mat4 mat)
+//Simplified levels for every view big enough, each one built from the previous level. They go at the end of the index
+//buffer and the view list, appended in view order so the baked layout doesn't depend on which thread did what
+void Scene::generateLods(SceneBakeData& io_BakeData)
 {
-    if (i_Node->mParent)
-        return getNodeTransformation(i_Node->mParent, mat * glm::mat4(i_Node->mParent->mTransformation[0][0]));
-    else
-        return mat ;
+  auto lodStart = std::chrono::high_resolution_clock::now();
+
+  const uint32_t nViews = static_cast<uint32_t>(io_BakeData.m_MeshViews.size());
+  std::vector<std::vector<std::vector<uint32_t>>> lodIndices(nViews);
+  std::vector<std::vector<float>> lodErrors(nViews);
+
+  uint32_t nThreads = runJobs(ServiceLocator::GetThreadPool(), nViews, [&](uint32_t viewIndex) {
+      const MeshView& view = io_BakeData.m_MeshViews[viewIndex];
+      if (view.m_NIndices / 3 < SCENE_LOD_MIN_TRIANGLES)
+        return;
+
+      const uint32_t* indices = io_BakeData.m_Indices.data() + view.m_IndicesMeshStart;
+      const glm::vec3* positions = io_BakeData.m_Positions.data() + view.m_VerticesMeshStart;
+      std::vector<uint32_t> previous(indices, indices + view.m_NIndices);
+      float error = 0.0f;
+      for (uint32_t level = 0; level < SCENE_LOD_LEVELS; level++)
+      {
+        std::vector<uint32_t> simplified;
+        uint32_t target = static_cast<uint32_t>(previous.size() / 6 * 3);
+        error += MeshOptimizer::Simplify(previous.data(), static_cast<uint32_t>(previous.size()), positions, view.m_NVertices, target, simplified);
+        if (simplified.size() < 3 || simplified.size() > previous.size() * 85 / 100)//Locked seams and borders, not worth another level
+          break;
+
+        MeshOptimizer::OptimizeVertexCache(simplified.data(), static_cast<uint32_t>(simplified.size()), view.m_NVertices);
+        lodIndices[viewIndex].push_back(simplified);
+        lodErrors[viewIndex].push_back(error);
+        previous = std::move(simplified);
+      }
+  }, SCENE_LOAD_FIRST_WORKER);
+
+  uint32_t nLevels = 0;
+  uint32_t nMeshes = 0;
+  for (uint32_t viewIndex = 0; viewIndex < nViews; viewIndex++)
+  {
+    if (lodIndices[viewIndex].empty())
+      continue;
+    nMeshes++;
+
+    MeshView& view = io_BakeData.m_MeshViews[viewIndex];
+    view.m_FirstLod = static_cast<uint32_t>(io_BakeData.m_MeshViews.size());
+    view.m_NLods = static_cast<uint32_t>(lodIndices[viewIndex].size());
+    MeshView lodView = view;
+    lodView.m_FirstLod = 0;
+    lodView.m_NLods = 0;
+    lodView.m_FirstMeshlet = 0;//Levels are drawn whole, their triangles don't match the meshlets
+    lodView.m_NMeshlets = 0;
+    for (size_t level = 0; level < lodIndices[viewIndex].size(); level++)
+    {
+      auto& levelIndices = lodIndices[viewIndex][level];
+      lodView.m_IndicesMeshStart = static_cast<uint32_t>(io_BakeData.m_Indices.size());
+      lodView.m_NIndices = static_cast<uint32_t>(levelIndices.size());
+      lodView.m_LodError = lodErrors[viewIndex][level];
+      io_BakeData.m_Indices.insert(io_BakeData.m_Indices.end(), levelIndices.begin(), levelIndices.end());
+      io_BakeData.m_MeshViews.push_back(lodView);//Invalidates view, not used past this point
+      nLevels++;
+    }
+  }
+
+  m_LoadTimings.m_LodGenerate = elapsedMs(lodStart);
+  LOGINFO("LOD generation: " + std::to_string(nLevels) + " levels for " + std::to_string(nMeshes) + " of " + std::to_string(nViews) + " meshes (" +
+    std::to_string(nThreads) + " threads, " + std::to_string(m_LoadTimings.m_LodGenerate) + " ms)");
 }
-void Scene::loadSceneRecursive(const aiNode* i_Node)
+
+//Picks the level of detail of every model for the main camera, only when the camera or the scene moved
+void Scene::updateLods()
+{
+  auto camera = ServiceLocator::GetCameraManager()->GetCamera("mainCamera");
+  const glm::mat4 viewProj = camera->GetViewProjMatrix();
+  if (!m_LodsDirty && viewProj == m_LodViewProj)
+    return;
+  m_LodViewProj = viewProj;
+  m_LodsDirty = false;
+
+  //Pixels covered by one unit at distance one
+  const float projScale = std::abs(camera->GetProjMatrix()[1][1]) * 0.5f * ServiceLocator::GetRenderer()->GetMainRTHeight();
+  const float pixelError = SCENE_LOD_PIXEL_ERROR * std::exp2(m_LodBias);
+
+  bool changed = false;
+  m_ModelsPerLod.assign(SCENE_LOD_LEVELS + 1, 0);
+  for (auto& model : m_Models)
+  {
+    changed |= model->selectLod(camera->GetPosition(), projScale, pixelError);
+    m_ModelsPerLod[model->GetCurrentLod()]++;
+  }
+
+  if (changed)
+  {
+    markInstancedModels();//Runs go by the mesh view being drawn
+    ServiceLocator::GetSceneManager()->GetSubject().Notify(Subject::Message::SCENEDIRTY);
+  }
+}
+
+void Scene::createMeshes(const MeshStreams& i_Streams, const MeshView* i_MeshViews, uint32_t i_NMeshViews, const Meshlet* i_Meshlets, uint32_t i_NMeshlets)
+{
+  const VertexLayout layout = SCENE_COMPACT_VERTICES ? VertexLayout::Compact : VertexLayout::Full;
+
+  m_Meshes.emplace_back(std::make_unique<Mesh>());
+  Mesh& mesh = *m_Meshes.back();
+  mesh.setData(Mesh::describeStreams(i_Streams, layout), i_Streams, layout, i_MeshViews, i_NMeshViews);
+  mesh.setMeshlets(i_Meshlets, i_NMeshlets);
+
+  m_FirstBakedView = m_ModelStore.getMeshViewCount();
+  for (uint32_t i = 0; i < i_NMeshViews; i++)
+  {
+    m_ModelStore.addMeshView(mesh, mesh.toArenaView(i_MeshViews[i]));
+  }
+}
+
+//Pre-order, so parents always come before their children which is the order the scene graph wants
+void Scene::loadSceneRecursive(const aiNode* i_Node, uint32_t i_Parent, std::vector<BakedNode>& o_Nodes)
 {
     LOGINFO("Loading node: " + std::string(i_Node->mName.C_Str()));
-    if (i_Node->mNumMeshes)
+    BakedNode node;
+    node.m_Name = std::string(i_Node->mName.C_Str());
+    node.m_Parent = i_Parent;
+    node.m_Transform = glm::transpose(glm::make_mat4(&i_Node->mTransformation.a1));//Assimp matrices are row major
+    node.m_MeshIndex = i_Node->mNumMeshes == 1 ? i_Node->mMeshes[0] : BAKED_NODE_NO_MESH;
+    const uint32_t nodeIndex = static_cast<uint32_t>(o_Nodes.size());
+    o_Nodes.push_back(node);
+
+    //Nodes with more than one mesh get a child per mesh so every model still has a node of its own
+    for (uint32_t i = 0; i < i_Node->mNumMeshes && i_Node->mNumMeshes > 1; i++)
     {
-        assert(i_Node->mNumMeshes == 1,"WOOPS, What we do with more than one mesh per node");
-        for (int i = 0;i< i_Node->mNumMeshes;i++)//TODO: What happens for nodes with more than one mesh :/
-        {
-            auto meshWithView = m_MeshMap[i_Node->mMeshes[i]];
-            m_Models.emplace_back(std::make_unique<Model>(*meshWithView.first, meshWithView.second,*this, std::string(i_Node->mName.C_Str())));
-            auto& model = m_Models.back();
-            model->SetMaterial(m_Materials[meshWithView.second.m_MaterialIndex]);
+        BakedNode meshNode;
+        meshNode.m_Name = node.m_Name + "_" + std::to_string(i);
+        meshNode.m_Parent = nodeIndex;
+        meshNode.m_Transform = glm::mat4(1.0f);
+        meshNode.m_MeshIndex = i_Node->mMeshes[i];
+        o_Nodes.push_back(meshNode);
+    }
+    for (uint32_t i = 0; i < i_Node->mNumChildren; i++)
+    {
+        loadSceneRecursive(i_Node->mChildren[i], nodeIndex, o_Nodes);
+    }
+}
 
-            if (m_Materials[meshWithView.second.m_MaterialIndex]->isTransparent())
-            {
-                m_TransparentModels.push_back(*model);
-            }
-            else
-            {
-                m_OpaqueModels.push_back(*model);
-            }
+void Scene::createModels(const std::vector<BakedNode>& i_Nodes)
+{
+    m_SceneGraph.clear();
+    m_NodeModels.assign(i_Nodes.size(), MODEL_HANDLE_NONE);
+    for (auto& node : i_Nodes)
+    {
+        const uint32_t graphNode = m_SceneGraph.addNode(node.m_Parent, node.m_Transform);
+        if (node.m_MeshIndex == BAKED_NODE_NO_MESH)
+            continue;
 
-            glm::mat4 transform = getNodeTransformation(i_Node, glm::mat4(i_Node->mTransformation[0][0]));//Recursing up to get the right hierarchical transform. If we have a tree we won't need this
-            glm::mat4 checkIdentity = glm::mat4();
-            if (transform != checkIdentity)
-                LOGINFO("LLAFALW");
-           
-            model->SetTransform(transform);
-            //////////
-            model->computeModelMatrix();
-            model->updateAABB();//Set transform handles this normally but we need the AABBs for computing the scene AABB
-            model->SetDirty();
-            ////////
-            m_SceneBoundMin = glm::min(m_SceneBoundMin, model->getAABB().get_min());
-            m_SceneBoundMax = glm::max(m_SceneBoundMax, model->getAABB().get_max());
-           
-        }
-       
+        const uint32_t view = m_FirstBakedView + node.m_MeshIndex;
+        const MeshView& meshView = m_ModelStore.getMeshView(view).m_View;
+        const ModelHandle handle = m_ModelStore.addModel(view, meshView.m_MaterialIndex, 0);
+        m_Models.emplace_back(std::make_unique<Model>(m_ModelStore, handle, *this, node.m_Name));
+        auto& model = m_Models.back();
+        model->SetMaterial(m_Materials[meshView.m_MaterialIndex]);
+
+        std::vector<uint32_t> lods{ view };
+        for (uint32_t lod = 0; lod < meshView.m_NLods; lod++)
+            lods.push_back(m_FirstBakedView + meshView.m_FirstLod + lod);
+        model->SetLods(lods);
+
+        model->SetNode(graphNode);
+        model->SetTransform(node.m_Transform);
+        m_NodeModels[graphNode] = handle;
     }
-    for (int i = 0; i < i_Node->mNumChildren; i++)
+
+    //World transforms and boxes now, we need them for the scene AABB. Render queues get built on the first update
+    updateTransforms();
+    buildBVH([](uint32_t i_Count, const std::function<void(uint32_t)>& i_Job) { runJobs(ServiceLocator::GetThreadPool(), i_Count, i_Job, SCENE_LOAD_FIRST_WORKER); });
+    m_QueuesDirty = true;
+    const glm::vec3* boundsMin = m_ModelStore.getBoundsMin();
+    const glm::vec3* boundsMax = m_ModelStore.getBoundsMax();
+    for (ModelHandle model = 0; model < m_ModelStore.size(); model++)
     {
-        const aiNode* child = i_Node->mChildren[i];
-        loadSceneRecursive(child);
+        m_SceneBoundMin = glm::min(m_SceneBoundMin, boundsMin[model]);
+        m_SceneBoundMax = glm::max(m_SceneBoundMax, boundsMax[model]);
     }
+
+    const float minOccluderSize = glm::distance(m_SceneBoundMin, m_SceneBoundMax) * SCENE_OCCLUDER_MIN_SIZE;
+    for (ModelHandle model = 0; model < m_ModelStore.size(); model++)
+    {
+        if (!m_ModelStore.hasFlag(model, ModelFlag_Transparent) && glm::distance(boundsMin[model], boundsMax[model]) >= minOccluderSize)
+            m_ModelStore.setFlag(model, ModelFlag_Occluder, true);
+    }
+    collectOccluders();
+    LOGINFO("Occlusion culling: " + std::to_string(m_Occluders.size()) + " occluders out of " + std::to_string(m_ModelStore.size()) + " models");
 }
 
 std::string BasicFileOpen()
@@ -959,6 +1555,13 @@ SceneManager::SceneManager()
         }
 
 
+        //Clicks the UI didn't take pick a model
+        if (ImGui::IsMouseClicked(0) && !ImGui::GetIO().WantCaptureMouse)
+        {
+            const ImVec2 mousePos = ImGui::GetIO().MousePos;
+            GetCurrentScene()->SelectModel(glm::vec2(mousePos.x, mousePos.y));
+        }
+
         if(bLightsMenu)
             GetCurrentScene()->DoLightsUI(&bLightsMenu);
         if (bModelsMenu)
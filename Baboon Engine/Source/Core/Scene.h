@@ -6,24 +6,43 @@
 #include <map>
 #include <functional>
 #include "Observer.h"
+#include "SceneGraph.h"
+#include "FrustumCuller.h"
+#include "BVH.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
 
 
 struct aiScene;
 struct aiNode;
 class SceneManager;
+struct SceneBakeData;
+struct BakedMaterial;
+struct BakedNode;
+class TextureDecodePipeline;
 
-#define MAX_DEFERRED_POINT_LIGHTS 15
-#define MAX_DEFERRED_SPOT_LIGHTS 15
 #define MAX_DEFERRED_DIR_LIGHTS 2
+#define SCENE_LIGHT_DEFAULT_RADIUS 10.0f //Point and spot lights have no effect past their radius, that's what lets them be binned in clusters
+#define SCENE_LIGHT_SCATTER_COUNT 1024 //Point lights added at random spots of the scene box by the lights window stress button
+
+#define SCENE_COMPACT_VERTICES 1 //Imported scenes go to the gpu quantized (see VertexLayout::Compact), 0 for full precision floats
+
+#define SCENE_LOD_LEVELS 4 //Simplified levels generated on import on top of the full detail one, each with about half the triangles
+#define SCENE_LOD_MIN_TRIANGLES 256 //Meshes smaller than this don't get levels
+#define SCENE_LOD_PIXEL_ERROR 1.0f //Screen space error (in pixels) a level can show before a finer one is picked, scaled by 2^bias
+#define SCENE_LOD_HYSTERESIS 0.25f //A coarser level has to be this much under the error threshold before we switch to it
+
+#define SCENE_BVH_CULL_MIN_MODELS 4096 //From this many models on the frustum cull walks the BVH instead of testing every box
+#define SCENE_OCCLUDER_MIN_SIZE 0.1f //Opaque models with a box diagonal at least this fraction of the scene one become occluders
 
 struct alignas(16)Light {
-    glm::vec4 lightPos;
-    glm::vec4 lightColor;
+    glm::vec4 lightPos;//w is the radius for point and spot lights
+    glm::vec4 lightColor;//w is the attenuation
 };
+//Point and spot lights aren't here, they go to a storage buffer binned per frame (see LightClusters)
 struct alignas(16) UBODeferredLights
 {
-    Light pointLights[MAX_DEFERRED_POINT_LIGHTS];
-    Light spotLights[MAX_DEFERRED_SPOT_LIGHTS];
+    glm::uvec4 counts;//x dir lights, a count rather than a shader define so adding lights never compiles anything
     Light dirLights[MAX_DEFERRED_DIR_LIGHTS];
 } ;
 enum class LightType {
@@ -32,15 +51,37 @@ enum class LightType {
     LightType_Directional = 2
 };
 
-enum class BatchType {
-    BatchType_Opaque = 0,
-    BatchType_Transparent = 1
+//Per stage timings of the last load, in milliseconds. Decode is the time spent by all the decoding threads together
+struct SceneLoadTimings
+{
+    float m_Parse = 0.0f;
+    float m_MeshOptimize = 0.0f;//Part of the parse, only when importing
+    float m_LodGenerate = 0.0f;//Same
+    float m_CacheWrite = 0.0f;
+    float m_MeshUpload = 0.0f;
+    float m_Decode = 0.0f;
+    float m_TextureUpload = 0.0f;
+    float m_DecodeStall = 0.0f;
+    float m_UploadWait = 0.0f;
+    float m_Total = 0.0f;
 };
-struct RenderBatch {
-    BatchType m_BatchType;
-    std::string m_Name;
-    uint8_t m_MaterialIndex;
-    std::multimap<float, std::reference_wrapper<Model>> m_ModelsByDistance;
+
+//Frustum culling results of the last update, shadow casters are tested against every shadow camera
+struct SceneVisibilityStats
+{
+    uint32_t m_Models = 0;
+    uint32_t m_OpaqueVisible = 0;
+    uint32_t m_TransparentVisible = 0;
+    uint32_t m_ShadowVisible = 0;
+    uint32_t m_ShadowViews = 0;
+    float m_CullMicroseconds = 0.0f;
+    bool m_CulledWithBVH = false;
+    float m_PickMicroseconds = 0.0f;//Last SelectModel raycast
+    OcclusionStats m_Occlusion;//Main camera only, the visible counts above are what it left
+    float m_QueueMicroseconds = 0.0f;//Key building and sorting of the three render queues
+    uint32_t m_Draws = 0;//Draw calls of the three queues once the instanced runs are merged
+    uint32_t m_InstancedDraws = 0;//Runs of two or more models
+    uint32_t m_InstancedModels = 0;//Models in those runs
 };
 
 class Scene{
@@ -58,7 +99,9 @@ public:
 	const size_t GetIndicesSize() { return sizeof(m_Indices[0]) * m_Indices.size(); }
 
   
+  //Picks the closest model box under the given main render target pixel, MODEL_HANDLE_NONE if there is none
   void SelectModel(glm::vec2 clickPoint);
+  ModelHandle GetSelectedModel() const { return m_SelectedModel; }
   void Update();
 	
 
@@ -66,20 +109,29 @@ public:
 
   Buffer* getLightsUniformBuffer() const { return m_LightsUniformBuffer; }
   Buffer* getMaterialsUniformBuffer() const { return m_MaterialsUniformBuffer; }
+  const std::vector<Texture*>& GetTextures() const { return m_Textures; }
 
 	std::vector <std::unique_ptr<Model>>* GetModels() { return &m_Models; }
-  std::vector <std::reference_wrapper<Model>>* GetOpaqueModels() { return &m_OpaqueModels; }
-  std::vector < std::reference_wrapper<Model>>* GetTransparentModels() { return &m_TransparentModels; }
+  Model& GetModel(ModelHandle i_Model) { return *m_Models[i_Model]; }//Editor side, the render path goes through GetModelStore
+  const ModelStore& GetModelStore() const { return m_ModelStore; }
+  const BVH& GetBVH() const { return m_BVH; }//Over the model store world boxes, refitted as models move
+  Material* GetMaterial(uint32_t i_MaterialIndex) const { return m_Materials[i_MaterialIndex]; }
 	
   
-  std::vector<RenderBatch>& GetTransparentBatches() { return m_TransparentBatch; }
-  std::vector<RenderBatch>& GetOpaqueBatches() { return m_OpaqueBatch; }
+  const RenderQueue& GetTransparentQueue() const { return m_TransparentQueue; }
+  const RenderQueue& GetOpaqueQueue() const { return m_OpaqueQueue; }
+  const RenderQueue& GetShadowQueue() const { return m_ShadowQueue; }//Opaque models seen by a shadow camera
+  uint16_t GetVariantKey(const ShaderVariant& i_Variant);
+  const SceneVisibilityStats& GetVisibilityStats() const { return m_VisibilityStats; }
   const AABB& getSceneAABB()const { return m_SceneAABB; }
+  const SceneLoadTimings& getLoadTimings()const { return m_LoadTimings; }
 
   //const Light& getLight(size_t index)const { return m_DeferredLights.lights[index]; }
   size_t getDirLightCount() { return m_DirLightCount; }
-  size_t getSpotLightCount() { return m_SpotLightCount; }
-  size_t getPointLightCount() { return m_PointLightCount; }
+  size_t getSpotLightCount() { return m_SpotLights.size(); }
+  size_t getPointLightCount() { return m_PointLights.size(); }
+  const std::vector<Light>& getPointLights() const { return m_PointLights; }
+  const std::vector<Light>& getSpotLights() const { return m_SpotLights; }
   /*void setLightPosition(size_t index,glm::vec3 position);
   void setLightColor(size_t index,glm::vec3 position);
   void setLightAttenuation(size_t index, float attenuation);*/
@@ -89,6 +141,7 @@ public:
 
   void createBox(const glm::vec3& position);
   void createLight(const glm::vec3& position, const glm::vec3& color,float attenuation, LightType lightType);
+  void scatterPointLights(uint32_t i_Count);//Random positions and colors inside the scene box
 
   //UI functions
   void DoLightUI(Light& light, std::string& lightName);
@@ -97,26 +150,69 @@ public:
 
  
   void SetDirty() { m_bIsDirty = true; }
+  void SetModelDirty(Model& i_Model);//Queues the model for the next transform update, Model does it when moved
+  const SceneGraph& GetSceneGraph() const { return m_SceneGraph; }
+
+  //Positive values pick coarser levels of detail earlier, each unit doubles the allowed screen space error
+  void SetLodBias(float i_Bias) { m_LodBias = i_Bias; m_LodsDirty = true; }
+  float GetLodBias() const { return m_LodBias; }
+  const std::vector<uint32_t>& GetModelsPerLod() const { return m_ModelsPerLod; }
+
+  void SetOcclusionCulling(bool i_Enabled) { m_OcclusionCulling = i_Enabled; m_VisibilityDirty = true; }
+  bool GetOcclusionCulling() const { return m_OcclusionCulling; }
+  void SetOccluder(Model& i_Model, bool i_Occluder);
 
 private:
 
-    typedef std::pair<Mesh*, MeshView> MeshWithView;
-    std::unordered_map<uint32_t, MeshWithView> m_MeshMap;
+    uint32_t m_FirstBakedView = 0;//Store mesh view of the first baked view, the baked indices are relative to it
 
 	bool m_bIsInit = false;
   bool m_bIsDirty = true;
+  bool m_QueuesDirty = true;//Models added, render queues have to be rebuilt even if nothing moved
 
   glm::vec3 m_SceneBoundMin;
   glm::vec3 m_SceneBoundMax;
   AABB m_SceneAABB;
+  SceneLoadTimings m_LoadTimings;
+
+  float m_LodBias = 0.0f;
+  bool m_LodsDirty = true;
+  glm::mat4 m_LodViewProj;//Camera the current levels were picked for
+  std::vector<uint32_t> m_ModelsPerLod;
+
+  SceneGraph m_SceneGraph;
+  std::vector<ModelHandle> m_NodeModels;//Per graph node, MODEL_HANDLE_NONE for nodes that only carry a transform
+  std::vector<Model*> m_DirtyModels;
+
+  //Scratch for the transform update, kept around so moving things every frame doesn't allocate
+  std::vector<uint32_t> m_ChangedNodes;
+  std::vector<ModelHandle> m_MovedModels;
+  std::vector<uint8_t> m_VisibilityMasks;
+  std::vector<glm::mat4> m_CullViews;
 	
-  std::vector <Texture*> m_Textures;
-	std::vector <std::unique_ptr<Model>> m_Models;
-
-  std::vector <std::reference_wrapper<Model>> m_OpaqueModels;
-  std::vector <std::reference_wrapper<Model>> m_TransparentModels;
-  std::vector<RenderBatch> m_OpaqueBatch;
-  std::vector<RenderBatch> m_TransparentBatch;
+  std::vector <Texture*> m_Textures;//In bindless texture array order, the materials index into it
+  ModelStore m_ModelStore;//Hot per model data, by handle
+  BVH m_BVH;
+  ModelHandle m_SelectedModel = MODEL_HANDLE_NONE;
+	std::vector <std::unique_ptr<Model>> m_Models;//Cold side, same handle
+
+  RenderQueue m_OpaqueQueue;
+  RenderQueue m_TransparentQueue;
+  RenderQueue m_ShadowQueue;
+  std::unordered_map<size_t, uint16_t> m_VariantKeys;//Shader variant id to the key the queues sort by
+
+  //Per pass visible lists out of the frustum cull, the render queues are built from them
+  FrustumCuller m_FrustumCuller;
+  bool m_VisibilityDirty = true;
+  std::vector<glm::mat4> m_CulledViews;//Main camera then shadow cameras, as of the last cull
+  std::vector<ModelHandle> m_VisibleOpaque;
+  std::vector<ModelHandle> m_VisibleTransparent;
+  std::vector<ModelHandle> m_VisibleShadow;
+  SceneVisibilityStats m_VisibilityStats;
+
+  OcclusionCuller m_OcclusionCuller;
+  bool m_OcclusionCulling = true;
+  std::vector<OcclusionOccluder> m_Occluders;//Biggest first, so the triangle budget goes to the ones hiding the most
 
 
 	std::vector <std::unique_ptr<Mesh>> m_Meshes;
@@ -133,17 +229,29 @@ private:
   Buffer* m_LightsUniformBuffer;
   UBODeferredLights m_DeferredLights;
   size_t m_DirLightCount = 0;
-  size_t m_SpotLightCount = 0;
-  size_t m_PointLightCount = 0;
+  std::vector<Light> m_PointLights;
+  std::vector<Light> m_SpotLights;
 
 
 
-  void prepareBatches();
-  void getBatches(std::vector<RenderBatch>& batchList, BatchType batchType);
+  void prepareRenderQueues();
+  void buildRenderQueue(RenderQueue& o_Queue, RenderQueuePass i_Pass, const std::vector<ModelHandle>& i_Visible);
+  void markInstancedModels();
+  bool updateVisibility();
 	void loadAssets(const std::string i_ScenePath);
-	void loadMaterials(const aiScene* i_aScene, const std::string i_SceneTexturesPath);
-	void loadMeshes(const aiScene* i_aScene);
-  void loadSceneRecursive(const aiNode* i_Node);
+	void importScene(const std::string i_ScenePath, SceneBakeData& o_BakeData);
+	void loadMaterials(const aiScene* i_aScene, std::vector<BakedMaterial>& o_Materials);
+	void loadMeshes(const aiScene* i_aScene, SceneBakeData& o_BakeData);
+  void optimizeMeshes(SceneBakeData& io_BakeData);
+  void generateLods(SceneBakeData& io_BakeData);
+  void updateLods();
+  bool updateTransforms();
+  void buildBVH(const BVHParallelFor& i_ParallelFor);
+  void collectOccluders();
+  void loadSceneRecursive(const aiNode* i_Node, uint32_t i_Parent, std::vector<BakedNode>& o_Nodes);
+  void createMaterials(const std::vector<BakedMaterial>& i_Materials, TextureDecodePipeline& i_TextureDecoder);
+  void createMeshes(const MeshStreams& i_Streams, const MeshView* i_MeshViews, uint32_t i_NMeshViews, const Meshlet* i_Meshlets, uint32_t i_NMeshlets);
+  void createModels(const std::vector<BakedNode>& i_Nodes);
   void Init(const std::string i_ScenePath);
   void SetInit(){ m_bIsInit = true; }
   void Free();
@@ -0,0 +1,379 @@
+#define NOMINMAX
+#include "SceneCache.h"
+#include "Core\ServiceLocator.h"
+#include "Core/BlobIO.h"
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SCENE_CACHE_ALIGNMENT 16
+
+enum eCacheSection
+{
+    eCacheSection_Positions,
+    eCacheSection_Colors,
+    eCacheSection_TexCoords,
+    eCacheSection_Normals,
+    eCacheSection_Tangents,
+    eCacheSection_BiTangents,
+    eCacheSection_Indices,
+    eCacheSection_MeshViews,
+    eCacheSection_Meshlets,
+    eCacheSection_Materials,
+    eCacheSection_Nodes,
+    eCacheSection_NSections
+};
+
+struct SceneCacheSection
+{
+    uint64_t m_Offset;
+    uint64_t m_Bytes;
+    uint64_t m_Count;
+};
+
+struct SceneCacheHeader
+{
+    uint32_t m_Magic;
+    uint32_t m_Version;
+    uint32_t m_ImportFlags;
+    uint32_t m_Padding;
+    uint64_t m_SourceSize;
+    int64_t m_SourceTime;
+    SceneCacheSection m_Sections[eCacheSection_NSections];
+};
+
+
+static bool getSourceStamp(const std::string& i_ScenePath, uint64_t& o_Size, int64_t& o_Time)
+{
+    std::error_code error;
+    o_Size = std::filesystem::file_size(i_ScenePath, error);
+    if (error)
+        return false;
+    auto writeTime = std::filesystem::last_write_time(i_ScenePath, error);
+    if (error)
+        return false;
+    o_Time = static_cast<int64_t>(writeTime.time_since_epoch().count());
+    return true;
+}
+
+MeshStreams SceneBakeData::getStreams() const
+{
+    MeshStreams streams;
+    streams.m_NVertices = static_cast<uint32_t>(m_Positions.size());
+    streams.m_Positions = m_Positions.data();
+    //Streams not covering every vertex can't be indexed safely so they are dropped
+    streams.m_Colors = m_Colors.size() == m_Positions.size() ? m_Colors.data() : nullptr;
+    streams.m_TexCoords = m_TexCoords.size() == m_Positions.size() ? m_TexCoords.data() : nullptr;
+    streams.m_Normals = m_Normals.size() == m_Positions.size() ? m_Normals.data() : nullptr;
+    streams.m_Tangents = m_Tangents.size() == m_Positions.size() ? m_Tangents.data() : nullptr;
+    streams.m_BiTangents = m_BiTangents.size() == m_Positions.size() ? m_BiTangents.data() : nullptr;
+    streams.m_Indices = m_Indices.data();
+    streams.m_NIndices = static_cast<uint32_t>(m_Indices.size());
+    return streams;
+}
+
+SceneCache::~SceneCache()
+{
+    Close();
+}
+
+std::string SceneCache::GetCachePath(const std::string& i_ScenePath)
+{
+    return i_ScenePath + SCENE_CACHE_EXTENSION;
+}
+
+bool SceneCache::Write(const std::string& i_ScenePath, uint32_t i_ImportFlags, const SceneBakeData& i_Data)
+{
+    SceneCacheHeader header{};
+    header.m_Magic = SCENE_CACHE_MAGIC;
+    header.m_Version = SCENE_CACHE_VERSION;
+    header.m_ImportFlags = i_ImportFlags;
+    if (!getSourceStamp(i_ScenePath, header.m_SourceSize, header.m_SourceTime))
+        return false;
+
+    std::vector<uint8_t> materialsBlob;
+    for (auto& material : i_Data.m_Materials)
+    {
+        writeString(materialsBlob, material.m_Name);
+        writeValue(materialsBlob, (uint8_t)material.m_Transparent);
+        writeValue(materialsBlob, material.m_Diffuse);
+        writeValue(materialsBlob, material.m_Ambient);
+        writeValue(materialsBlob, material.m_Specular);
+        writeValue(materialsBlob, (uint32_t)material.m_Textures.size());
+        for (auto& texture : material.m_Textures)
+        {
+            writeString(materialsBlob, texture.first);
+            writeString(materialsBlob, texture.second);
+        }
+    }
+    std::vector<uint8_t> nodesBlob;
+    for (auto& node : i_Data.m_Nodes)
+    {
+        writeString(nodesBlob, node.m_Name);
+        writeValue(nodesBlob, node.m_Parent);
+        writeValue(nodesBlob, node.m_MeshIndex);
+        writeValue(nodesBlob, node.m_Transform);
+    }
+
+    const std::pair<const void*, size_t> sectionData[eCacheSection_NSections] = {
+        { i_Data.m_Positions.data(), i_Data.m_Positions.size() * sizeof(glm::vec3) },
+        { i_Data.m_Colors.data(), i_Data.m_Colors.size() * sizeof(glm::vec3) },
+        { i_Data.m_TexCoords.data(), i_Data.m_TexCoords.size() * sizeof(glm::vec2) },
+        { i_Data.m_Normals.data(), i_Data.m_Normals.size() * sizeof(glm::vec3) },
+        { i_Data.m_Tangents.data(), i_Data.m_Tangents.size() * sizeof(glm::vec3) },
+        { i_Data.m_BiTangents.data(), i_Data.m_BiTangents.size() * sizeof(glm::vec3) },
+        { i_Data.m_Indices.data(), i_Data.m_Indices.size() * sizeof(uint32_t) },
+        { i_Data.m_MeshViews.data(), i_Data.m_MeshViews.size() * sizeof(MeshView) },
+        { i_Data.m_Meshlets.data(), i_Data.m_Meshlets.size() * sizeof(Meshlet) },
+        { materialsBlob.data(), materialsBlob.size() },
+        { nodesBlob.data(), nodesBlob.size() }
+    };
+    const uint64_t sectionCounts[eCacheSection_NSections] = {
+        i_Data.m_Positions.size(), i_Data.m_Colors.size(), i_Data.m_TexCoords.size(), i_Data.m_Normals.size(),
+        i_Data.m_Tangents.size(), i_Data.m_BiTangents.size(), i_Data.m_Indices.size(), i_Data.m_MeshViews.size(),
+        i_Data.m_Meshlets.size(), i_Data.m_Materials.size(), i_Data.m_Nodes.size()
+    };
+
+    //Written to a temporary file first so a half written cache is never picked up
+    std::string cachePath = GetCachePath(i_ScenePath);
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            LOGERROR("Can't write scene cache: " + cachePath);
+            return false;
+        }
+
+        const char padding[SCENE_CACHE_ALIGNMENT] = {};
+        uint64_t offset = sizeof(SceneCacheHeader);
+        file.write((const char*)&header, sizeof(header));
+        for (int i = 0; i < eCacheSection_NSections; i++)
+        {
+            uint64_t alignedOffset = (offset + SCENE_CACHE_ALIGNMENT - 1) & ~(uint64_t)(SCENE_CACHE_ALIGNMENT - 1);
+            file.write(padding, alignedOffset - offset);
+
+            header.m_Sections[i].m_Offset = alignedOffset;
+            header.m_Sections[i].m_Bytes = sectionData[i].second;
+            header.m_Sections[i].m_Count = sectionCounts[i];
+            if (sectionData[i].second)
+                file.write((const char*)sectionData[i].first, sectionData[i].second);
+            offset = alignedOffset + sectionData[i].second;
+        }
+        file.seekp(0);
+        file.write((const char*)&header, sizeof(header));
+        if (!file.good())
+        {
+            LOGERROR("Failed writing scene cache: " + cachePath);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, cachePath, error);
+    if (error)
+    {
+        LOGERROR("Can't move scene cache in place: " + cachePath);
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    LOGINFO("Baked scene written to: " + cachePath);
+    return true;
+}
+
+bool SceneCache::Open(const std::string& i_ScenePath, uint32_t i_ImportFlags)
+{
+    Close();
+
+    std::string cachePath = GetCachePath(i_ScenePath);
+    std::error_code error;
+    if (!std::filesystem::exists(cachePath, error))
+        return false;
+
+    if (!mapFile(cachePath))
+    {
+        LOGERROR("Can't map scene cache: " + cachePath);
+        return false;
+    }
+
+    SceneCacheHeader header{};
+    if (m_MappedSize < sizeof(header))
+    {
+        Close();
+        return false;
+    }
+    std::memcpy(&header, m_MappedData, sizeof(header));
+
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    bool sourceFound = getSourceStamp(i_ScenePath, sourceSize, sourceTime);
+    if (header.m_Magic != SCENE_CACHE_MAGIC || header.m_Version != SCENE_CACHE_VERSION || header.m_ImportFlags != i_ImportFlags ||
+        !sourceFound || header.m_SourceSize != sourceSize || header.m_SourceTime != sourceTime)
+    {
+        LOGINFO("Scene cache is stale: " + cachePath);
+        Close();
+        return false;
+    }
+
+    for (auto& section : header.m_Sections)
+    {
+        if (section.m_Offset + section.m_Bytes > m_MappedSize || section.m_Offset % SCENE_CACHE_ALIGNMENT)
+        {
+            LOGERROR("Scene cache is corrupted: " + cachePath);
+            Close();
+            return false;
+        }
+    }
+
+    auto sectionData = [&](eCacheSection i_Section) -> const void* {
+        return header.m_Sections[i_Section].m_Count ? m_MappedData + header.m_Sections[i_Section].m_Offset : nullptr;
+    };
+    auto vertexStream = [&](eCacheSection i_Section) -> const void* {
+        return header.m_Sections[i_Section].m_Count == header.m_Sections[eCacheSection_Positions].m_Count ? sectionData(i_Section) : nullptr;
+    };
+
+    m_Streams.m_NVertices = static_cast<uint32_t>(header.m_Sections[eCacheSection_Positions].m_Count);
+    m_Streams.m_Positions = (const glm::vec3*)sectionData(eCacheSection_Positions);
+    m_Streams.m_Colors = (const glm::vec3*)vertexStream(eCacheSection_Colors);
+    m_Streams.m_TexCoords = (const glm::vec2*)vertexStream(eCacheSection_TexCoords);
+    m_Streams.m_Normals = (const glm::vec3*)vertexStream(eCacheSection_Normals);
+    m_Streams.m_Tangents = (const glm::vec3*)vertexStream(eCacheSection_Tangents);
+    m_Streams.m_BiTangents = (const glm::vec3*)vertexStream(eCacheSection_BiTangents);
+    m_Streams.m_NIndices = static_cast<uint32_t>(header.m_Sections[eCacheSection_Indices].m_Count);
+    m_Streams.m_Indices = (const uint32_t*)sectionData(eCacheSection_Indices);
+
+    m_MeshViewCount = static_cast<uint32_t>(header.m_Sections[eCacheSection_MeshViews].m_Count);
+    m_MeshViews = (const MeshView*)sectionData(eCacheSection_MeshViews);
+    m_MeshletCount = static_cast<uint32_t>(header.m_Sections[eCacheSection_Meshlets].m_Count);
+    m_Meshlets = (const Meshlet*)sectionData(eCacheSection_Meshlets);
+
+    BlobReader materialsReader{ m_MappedData + header.m_Sections[eCacheSection_Materials].m_Offset, header.m_Sections[eCacheSection_Materials].m_Bytes };
+    m_Materials.resize(header.m_Sections[eCacheSection_Materials].m_Count);
+    for (auto& material : m_Materials)
+    {
+        material.m_Name = materialsReader.readString();
+        material.m_Transparent = materialsReader.read<uint8_t>() != 0;
+        material.m_Diffuse = materialsReader.read<glm::vec4>();
+        material.m_Ambient = materialsReader.read<glm::vec4>();
+        material.m_Specular = materialsReader.read<glm::vec4>();
+        uint32_t textureCount = materialsReader.read<uint32_t>();
+        for (uint32_t i = 0; i < textureCount && materialsReader.m_Valid; i++)
+        {
+            std::string shaderName = materialsReader.readString();
+            std::string fileName = materialsReader.readString();
+            material.m_Textures.emplace_back(shaderName, fileName);
+        }
+    }
+
+    BlobReader nodesReader{ m_MappedData + header.m_Sections[eCacheSection_Nodes].m_Offset, header.m_Sections[eCacheSection_Nodes].m_Bytes };
+    m_Nodes.resize(header.m_Sections[eCacheSection_Nodes].m_Count);
+    for (size_t i = 0; i < m_Nodes.size(); i++)
+    {
+        auto& node = m_Nodes[i];
+        node.m_Name = nodesReader.readString();
+        node.m_Parent = nodesReader.read<uint32_t>();
+        node.m_MeshIndex = nodesReader.read<uint32_t>();
+        node.m_Transform = nodesReader.read<glm::mat4>();
+        if ((node.m_MeshIndex != BAKED_NODE_NO_MESH && node.m_MeshIndex >= m_MeshViewCount) || (node.m_Parent != SCENE_GRAPH_NO_PARENT && node.m_Parent >= i))
+            nodesReader.m_Valid = false;
+    }
+
+    bool meshletsValid = true;
+    for (uint32_t i = 0; i < m_MeshViewCount; i++)
+        meshletsValid &= (uint64_t)m_MeshViews[i].m_FirstMeshlet + m_MeshViews[i].m_NMeshlets <= m_MeshletCount;
+
+    if (!materialsReader.m_Valid || !nodesReader.m_Valid || !meshletsValid || m_Streams.m_Positions == nullptr || m_Streams.m_Indices == nullptr)
+    {
+        LOGERROR("Scene cache is corrupted: " + cachePath);
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void SceneCache::Close()
+{
+    unmapFile();
+    m_Streams = MeshStreams();
+    m_MeshViews = nullptr;
+    m_MeshViewCount = 0;
+    m_Meshlets = nullptr;
+    m_MeshletCount = 0;
+    m_Materials.clear();
+    m_Nodes.clear();
+}
+
+bool SceneCache::mapFile(const std::string& i_Path)
+{
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(i_Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    m_FileHandle = file;
+    m_MappingHandle = mapping;
+    m_MappedData = (const uint8_t*)data;
+    m_MappedSize = static_cast<size_t>(size.QuadPart);
+#else
+    int file = open(i_Path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+    struct stat fileStat;
+    if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        close(file);
+        return false;
+    }
+    void* data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED)
+        return false;
+    m_MappedData = (const uint8_t*)data;
+    m_MappedSize = static_cast<size_t>(fileStat.st_size);
+#endif
+    return true;
+}
+
+void SceneCache::unmapFile()
+{
+    if (m_MappedData == nullptr)
+        return;
+#if defined(_WIN32)
+    UnmapViewOfFile(m_MappedData);
+    CloseHandle((HANDLE)m_MappingHandle);
+    CloseHandle((HANDLE)m_FileHandle);
+#else
+    munmap((void*)m_MappedData, m_MappedSize);
+#endif
+    m_MappedData = nullptr;
+    m_MappedSize = 0;
+    m_FileHandle = nullptr;
+    m_MappingHandle = nullptr;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "Renderer/Common/GLMInclude.h"
+#include "Renderer/Common/Mesh.h"
+#include "Core/SceneGraph.h"
+#include <vector>
+#include <string>
+
+//Baked scene container. Stores what Scene builds out of assimp (vertex streams, indices, mesh views, materials and node transforms)
+//so following loads of the same scene can map the file and skip the importer completely.
+#define SCENE_CACHE_MAGIC 0x43534242 //"BBSC"
+#define SCENE_CACHE_VERSION 6
+#define SCENE_CACHE_EXTENSION ".bbscene"
+
+struct BakedMaterial
+{
+    std::string m_Name;
+    bool m_Transparent = false;
+    glm::vec4 m_Diffuse;
+    glm::vec4 m_Ambient;
+    glm::vec4 m_Specular;
+    std::vector<std::pair<std::string, std::string>> m_Textures;//Shader texture name, texture file relative to the scene folder
+};
+
+#define BAKED_NODE_NO_MESH UINT32_MAX
+
+//Nodes are stored parents first, the transform is relative to the parent
+struct BakedNode
+{
+    std::string m_Name;
+    uint32_t m_Parent = SCENE_GRAPH_NO_PARENT;
+    uint32_t m_MeshIndex = BAKED_NODE_NO_MESH;
+    glm::mat4 m_Transform;
+};
+
+//CPU side copy of a scene coming from assimp, this is what gets written to disk
+struct SceneBakeData
+{
+    std::vector<glm::vec3> m_Positions;
+    std::vector<glm::vec3> m_Colors;
+    std::vector<glm::vec2> m_TexCoords;
+    std::vector<glm::vec3> m_Normals;
+    std::vector<glm::vec3> m_Tangents;
+    std::vector<glm::vec3> m_BiTangents;
+    std::vector<uint32_t> m_Indices;
+    std::vector<MeshView> m_MeshViews;
+    std::vector<Meshlet> m_Meshlets;
+    std::vector<BakedMaterial> m_Materials;
+    std::vector<BakedNode> m_Nodes;
+
+    MeshStreams getStreams() const;
+};
+
+class SceneCache
+{
+public:
+    SceneCache() {}
+    ~SceneCache();
+    SceneCache(const SceneCache&) = delete;
+    SceneCache& operator=(const SceneCache&) = delete;
+
+    static std::string GetCachePath(const std::string& i_ScenePath);
+
+    /**
+     * @brief Writes the baked version of a scene next to the source file
+     * @param i_ScenePath Path of the source scene, used to stamp the cache so it gets invalidated when the source changes
+     * @param i_ImportFlags Assimp post process flags used to generate the data
+     */
+    static bool Write(const std::string& i_ScenePath, uint32_t i_ImportFlags, const SceneBakeData& i_Data);
+
+    /**
+     * @brief Maps the baked version of a scene
+     * @return false if the cache is missing, corrupted or stale (source modified, different version or import flags)
+     */
+    bool Open(const std::string& i_ScenePath, uint32_t i_ImportFlags);
+    void Close();
+
+    //Streams point straight into the mapped file, they are only valid while the cache is open
+    const MeshStreams& GetStreams() const { return m_Streams; }
+    const MeshView* GetMeshViews() const { return m_MeshViews; }
+    uint32_t GetMeshViewCount() const { return m_MeshViewCount; }
+    const Meshlet* GetMeshlets() const { return m_Meshlets; }
+    uint32_t GetMeshletCount() const { return m_MeshletCount; }
+    const std::vector<BakedMaterial>& GetMaterials() const { return m_Materials; }
+    const std::vector<BakedNode>& GetNodes() const { return m_Nodes; }
+
+private:
+    bool mapFile(const std::string& i_Path);
+    void unmapFile();
+
+    const uint8_t* m_MappedData{ nullptr };
+    size_t m_MappedSize{ 0 };
+    void* m_FileHandle{ nullptr };
+    void* m_MappingHandle{ nullptr };
+
+    MeshStreams m_Streams;
+    const MeshView* m_MeshViews{ nullptr };
+    uint32_t m_MeshViewCount{ 0 };
+    const Meshlet* m_Meshlets{ nullptr };
+    uint32_t m_MeshletCount{ 0 };
+    std::vector<BakedMaterial> m_Materials;
+    std::vector<BakedNode> m_Nodes;
+};
@@ -0,0 +1,57 @@
+#include "SceneGraph.h"
+#include <stdexcept>
+
+uint32_t SceneGraph::addNode(uint32_t i_Parent, const glm::mat4& i_LocalTransform)
+{
+    if (i_Parent != SCENE_GRAPH_NO_PARENT && i_Parent >= m_Parents.size())
+        throw std::runtime_error("Scene graph: parent has to be added before its children");
+
+    m_Parents.push_back(i_Parent);
+    m_LocalTransforms.push_back(i_LocalTransform);
+    m_WorldTransforms.push_back(i_LocalTransform);
+    m_Dirty.push_back(1);
+    m_AnyDirty = true;
+    return static_cast<uint32_t>(m_Parents.size() - 1);
+}
+
+void SceneGraph::clear()
+{
+    m_Parents.clear();
+    m_LocalTransforms.clear();
+    m_WorldTransforms.clear();
+    m_Dirty.clear();
+    m_AnyDirty = false;
+}
+
+void SceneGraph::setLocalTransform(uint32_t i_Node, const glm::mat4& i_LocalTransform)
+{
+    m_LocalTransforms[i_Node] = i_LocalTransform;
+    m_Dirty[i_Node] = 1;
+    m_AnyDirty = true;
+}
+
+void SceneGraph::update(std::vector<uint32_t>& o_Changed)
+{
+    o_Changed.clear();
+    if (!m_AnyDirty)
+        return;
+
+    //Parents come first, so by the time we get to a node its parent flag and world transform are final
+    const uint32_t nNodes = size();
+    for (uint32_t i = 0; i < nNodes; i++)
+    {
+        const uint32_t parent = m_Parents[i];
+        if (parent != SCENE_GRAPH_NO_PARENT)
+            m_Dirty[i] |= m_Dirty[parent];
+        if (!m_Dirty[i])
+            continue;
+
+        m_WorldTransforms[i] = parent == SCENE_GRAPH_NO_PARENT ? m_LocalTransforms[i] : m_WorldTransforms[parent] * m_LocalTransforms[i];
+        o_Changed.push_back(i);
+    }
+
+    //Cleared afterwards, children read their parent flag during the pass
+    for (uint32_t node : o_Changed)
+        m_Dirty[node] = 0;
+    m_AnyDirty = false;
+}
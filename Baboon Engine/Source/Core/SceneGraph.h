@@ -0,0 +1,40 @@
+#pragma once
+#include "Renderer/Common/GLMInclude.h"
+#include <vector>
+#include <stdint.h>
+
+#define SCENE_GRAPH_NO_PARENT UINT32_MAX
+
+/**
+ * @brief Transform hierarchy kept as flat arrays in topological order
+ *
+ * A node can only be added once its parent is in, so parents always come before their children and every world matrix can
+ * be rebuilt in one forward pass. Touching a local transform flags the node, the pass pushes the flag down to the whole
+ * subtree and only recomputes what was flagged.
+ */
+class SceneGraph
+{
+public:
+    //Returns the index of the new node, i_Parent has to be an existing node or SCENE_GRAPH_NO_PARENT
+    uint32_t addNode(uint32_t i_Parent, const glm::mat4& i_LocalTransform);
+    void clear();
+
+    void setLocalTransform(uint32_t i_Node, const glm::mat4& i_LocalTransform);
+    const glm::mat4& getLocalTransform(uint32_t i_Node) const { return m_LocalTransforms[i_Node]; }
+    const glm::mat4& getWorldTransform(uint32_t i_Node) const { return m_WorldTransforms[i_Node]; }
+    uint32_t getParent(uint32_t i_Node) const { return m_Parents[i_Node]; }
+    uint32_t size() const { return static_cast<uint32_t>(m_Parents.size()); }
+
+    /**
+     * @brief Recomputes the world transform of every flagged node and everything under it
+     * @param o_Changed Nodes whose world transform changed, in topological order
+     */
+    void update(std::vector<uint32_t>& o_Changed);
+
+private:
+    std::vector<uint32_t> m_Parents;
+    std::vector<glm::mat4> m_LocalTransforms;
+    std::vector<glm::mat4> m_WorldTransforms;
+    std::vector<uint8_t> m_Dirty;
+    bool m_AnyDirty = false;
+};
@@ -6,4 +6,5 @@ Input* ServiceLocator::s_TheInput = nullptr;
 CameraManager* ServiceLocator::s_TheCamManager = nullptr;
 Logger* ServiceLocator::s_TheLogger = nullptr;
 ThreadPool* ServiceLocator::s_TheThreadPool = nullptr;
+ThreadPool* ServiceLocator::s_TheJobPool = nullptr;
 GUI* ServiceLocator::s_TheGUI = nullptr;
\ No newline at end of file
@@ -18,6 +18,7 @@ public:
 	static void Provide(CameraManager* i_CamMan) { s_TheCamManager = i_CamMan; }
   static void Provide(Logger* i_Logger) { s_TheLogger = i_Logger; }
   static void Provide(ThreadPool* i_tpool) { s_TheThreadPool = i_tpool; }
+  static void ProvideJobPool(ThreadPool* i_JobPool) { s_TheJobPool = i_JobPool; }
   static void Provide(GUI* gui) { s_TheGUI = gui; }
 
 	//One Getter for each service
@@ -26,7 +27,8 @@ public:
 	static Input* GetInput() { return s_TheInput; }
 	static CameraManager* GetCameraManager() { return s_TheCamManager; }
   static Logger* GetLogger() { return s_TheLogger; }
-  static ThreadPool* GetThreadPool() { return s_TheThreadPool; }
+  static ThreadPool* GetThreadPool() { return s_TheThreadPool; }//Scene loading, see SceneManager::LoadScene
+  static ThreadPool* GetJobPool() { return s_TheJobPool; }//Parallel stages of the main thread frame (culling, sorting, recording, warm up), see runJobs
   static GUI* GetGUI() { return s_TheGUI; }
 
 private:
@@ -36,6 +38,7 @@ private:
 	static CameraManager* s_TheCamManager;
   static Logger* s_TheLogger;
   static ThreadPool* s_TheThreadPool;
+  static ThreadPool* s_TheJobPool;
   static GUI* s_TheGUI;
 
 };
@@ -1,5 +1,8 @@
 #define NOMINMAX
 #include "aabb.h"
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#endif
 
 
 
@@ -64,26 +67,71 @@ void AABB::update(const glm::vec3* vertex_data, size_t nVertices, const uint32_t
     }
 }
 
-void AABB::transform(glm::mat4 &transform)
+void AABB::transform(const glm::mat4 &transform)
 {
+  //Center goes through the matrix, the half extents through its absolute value (Arvo), same as taking the 8 corners
+  glm::vec3 center = get_center();
+  glm::vec3 extents = get_scale() * 0.5f;
+  glm::mat3 linear(transform);
+  glm::vec3 worldCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+  glm::vec3 worldExtents = glm::abs(linear[0]) * extents.x + glm::abs(linear[1]) * extents.y + glm::abs(linear[2]) * extents.z;
+  min = worldCenter - worldExtents;
+  max = worldCenter + worldExtents;
+}
 
-  glm::vec3 right = glm::vec3(transform[0][0], transform[1][0], transform[2][0]);
-  glm::vec3 up = glm::vec3(transform[0][1], transform[1][1], transform[2][1]);
-  glm::vec3 forward = glm::vec3(transform[0][2], transform[1][2], transform[2][2]);
-  glm::vec3 translation = glm::vec3(transform[3]);
-
-  glm::vec3 xa = right * min.x;
-  glm::vec3 xb = right * max.x;
-
-  glm::vec3 ya = up * min.y;
-  glm::vec3 yb = up * max.y;
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+static inline __m128 loadVec3(const glm::vec3& v)
+{
+    return _mm_set_ps(0.0f, v.z, v.y, v.x);
+}
 
-  glm::vec3 za = -forward * min.z;
-  glm::vec3 zb = -forward * max.z;
-  min = glm::min(xa, xb) + glm::min(ya, yb) + glm::min(za, zb) + translation;
-  max = glm::max(xa, xb) + glm::max(ya, yb) + glm::max(za, zb) + translation;
+static inline glm::vec3 storeVec3(__m128 v)
+{
+    alignas(16) float values[4];
+    _mm_store_ps(values, v);
+    return glm::vec3(values[0], values[1], values[2]);
+}
 
+void AABB::transformBatch(const AABB* i_LocalBoxes, const glm::mat4* i_Transforms, AABB* o_Boxes, size_t i_Count)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    for (size_t i = 0; i < i_Count; i++)
+    {
+        //glm matrices are column major, each column is a register
+        const float* matrix = &i_Transforms[i][0][0];
+        const __m128 column0 = _mm_loadu_ps(matrix);
+        const __m128 column1 = _mm_loadu_ps(matrix + 4);
+        const __m128 column2 = _mm_loadu_ps(matrix + 8);
+        const __m128 column3 = _mm_loadu_ps(matrix + 12);
+
+        const __m128 boxMin = loadVec3(i_LocalBoxes[i].min);
+        const __m128 boxMax = loadVec3(i_LocalBoxes[i].max);
+        const __m128 center = _mm_mul_ps(_mm_add_ps(boxMin, boxMax), half);
+        const __m128 extents = _mm_mul_ps(_mm_sub_ps(boxMax, boxMin), half);
+
+        __m128 worldCenter = _mm_add_ps(_mm_mul_ps(column0, _mm_shuffle_ps(center, center, _MM_SHUFFLE(0, 0, 0, 0))), column3);
+        worldCenter = _mm_add_ps(worldCenter, _mm_mul_ps(column1, _mm_shuffle_ps(center, center, _MM_SHUFFLE(1, 1, 1, 1))));
+        worldCenter = _mm_add_ps(worldCenter, _mm_mul_ps(column2, _mm_shuffle_ps(center, center, _MM_SHUFFLE(2, 2, 2, 2))));
+
+        __m128 worldExtents = _mm_mul_ps(_mm_andnot_ps(signBit, column0), _mm_shuffle_ps(extents, extents, _MM_SHUFFLE(0, 0, 0, 0)));
+        worldExtents = _mm_add_ps(worldExtents, _mm_mul_ps(_mm_andnot_ps(signBit, column1), _mm_shuffle_ps(extents, extents, _MM_SHUFFLE(1, 1, 1, 1))));
+        worldExtents = _mm_add_ps(worldExtents, _mm_mul_ps(_mm_andnot_ps(signBit, column2), _mm_shuffle_ps(extents, extents, _MM_SHUFFLE(2, 2, 2, 2))));
+
+        o_Boxes[i].min = storeVec3(_mm_sub_ps(worldCenter, worldExtents));
+        o_Boxes[i].max = storeVec3(_mm_add_ps(worldCenter, worldExtents));
+    }
+}
+#else
+void AABB::transformBatch(const AABB* i_LocalBoxes, const glm::mat4* i_Transforms, AABB* o_Boxes, size_t i_Count)
+{
+    for (size_t i = 0; i < i_Count; i++)
+    {
+        o_Boxes[i] = i_LocalBoxes[i];
+        o_Boxes[i].transform(i_Transforms[i]);
+    }
 }
+#endif
 
 glm::vec3 AABB::get_scale() const
 {
@@ -35,7 +35,13 @@ class AABB
 	 * @brief Apply a given matrix transformation to the bounding box
 	 * @param transform The matrix transform to apply
 	 */
-	void transform(glm::mat4 &transform);
+	void transform(const glm::mat4 &transform);
+
+	/**
+	 * @brief Same as transform for many boxes at once, SSE when available
+	 * @param i_LocalBoxes Boxes to transform, o_Boxes gets the result at the same position (can't alias)
+	 */
+	static void transformBatch(const AABB* i_LocalBoxes, const glm::mat4* i_Transforms, AABB* o_Boxes, size_t i_Count);
 
 	/**
 	 * @brief Scale vector of the bounding box
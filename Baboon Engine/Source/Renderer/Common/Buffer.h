@@ -2,6 +2,14 @@
 
 #include <stdint.h>
 
+//Where a buffer lives, pick it by how the cpu touches the buffer after creation
+enum class BufferMemoryClass
+{
+    Static,//Written once at creation, device local memory filled through a staging copy
+    Dynamic,//Rewritten from the cpu every now and then, host visible memory the gpu reads directly
+    Readback//Written by the gpu to be read on the cpu, has to be asked for explicitly
+};
+
 class Buffer
 {
 public:
@@ -0,0 +1,73 @@
+#include "GeometryArena.h"
+#include <algorithm>
+
+RangeAllocator::RangeAllocator(uint32_t capacity) :
+    m_Capacity(capacity)
+{
+    if (capacity > 0)
+        m_FreeRanges.push_back({ 0, capacity });
+}
+
+bool RangeAllocator::allocate(uint32_t count, uint32_t& o_Offset, uint32_t alignment)
+{
+    if (count == 0)
+    {
+        o_Offset = 0;
+        return true;
+    }
+
+    for (auto it = m_FreeRanges.begin(); it != m_FreeRanges.end(); ++it)
+    {
+        uint32_t aligned = (it->m_Offset + alignment - 1) / alignment * alignment;
+        uint32_t padding = aligned - it->m_Offset;
+        if (it->m_Count < count + padding)
+            continue;
+
+        o_Offset = aligned;
+        m_Used += count;
+        if (padding > 0)
+        {
+            //Keep the padding in front as a free range of its own and carve from what follows it
+            Range tail{ aligned + count, it->m_Count - padding - count };
+            it->m_Count = padding;
+            if (tail.m_Count > 0)
+                m_FreeRanges.insert(it + 1, tail);
+            return true;
+        }
+
+        it->m_Offset += count;
+        it->m_Count -= count;
+        if (it->m_Count == 0)
+            m_FreeRanges.erase(it);
+        return true;
+    }
+    return false;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t count)
+{
+    if (count == 0)
+        return;
+
+    auto next = std::lower_bound(m_FreeRanges.begin(), m_FreeRanges.end(), offset, [](const Range& range, uint32_t value) { return range.m_Offset < value; });
+    auto inserted = m_FreeRanges.insert(next, { offset, count });
+    m_Used -= count;
+
+    //Merge with the following range
+    auto following = inserted + 1;
+    if (following != m_FreeRanges.end() && inserted->m_Offset + inserted->m_Count == following->m_Offset)
+    {
+        inserted->m_Count += following->m_Count;
+        m_FreeRanges.erase(following);
+    }
+    //And with the previous one
+    if (inserted != m_FreeRanges.begin())
+    {
+        auto previous = inserted - 1;
+        if (previous->m_Offset + previous->m_Count == inserted->m_Offset)
+        {
+            previous->m_Count += inserted->m_Count;
+            m_FreeRanges.erase(inserted);
+        }
+    }
+}
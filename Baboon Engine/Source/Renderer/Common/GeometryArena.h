@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+//Range of a geometry arena block handed to a mesh. Offsets are in elements (vertices or indices of m_IndexSize bytes) and
+//global to the block buffers, so they go straight into draw calls as vertexOffset / firstIndex
+struct GeometryAllocation
+{
+    uint32_t m_Block = 0;
+    uint32_t m_VertexOffset = 0;
+    uint32_t m_NVertices = 0;
+    uint32_t m_IndexOffset = 0;
+    uint32_t m_NIndices = 0;
+    uint32_t m_IndexSize = 4;//2 or 4 bytes, 16 bit and 32 bit indices share the block index buffer
+    bool m_Valid = false;
+};
+
+//First fit free-list over [0, capacity) in arbitrary units. Freed ranges merge with their neighbours so a freed scene
+//leaves one big hole instead of many small ones
+class RangeAllocator
+{
+public:
+    RangeAllocator(uint32_t capacity = 0);
+
+    //alignment is in units too, the offset handed back is a multiple of it
+    bool allocate(uint32_t count, uint32_t& o_Offset, uint32_t alignment = 1);
+    void free(uint32_t offset, uint32_t count);
+
+    uint32_t getCapacity() const { return m_Capacity; }
+    uint32_t getUsed() const { return m_Used; }
+    bool empty() const { return m_Used == 0; }
+
+private:
+    struct Range
+    {
+        uint32_t m_Offset;
+        uint32_t m_Count;
+    };
+    std::vector<Range> m_FreeRanges;//Sorted by offset
+    uint32_t m_Capacity;
+    uint32_t m_Used{ 0 };
+};
@@ -3,6 +3,8 @@
 #include "defines.h"
 #include "Core/ServiceLocator.h"
 #include "Core/Material.h"
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
 
 void Vertex::GetVertexDescription(VkVertexInputBindingDescription* o_Description)
 {
@@ -57,19 +59,12 @@ void Vertex::GetAttributesDescription(std::vector<VkVertexInputAttributeDescript
 
 Mesh::~Mesh()
 {
-    auto renderer = ServiceLocator::GetRenderer();
-    renderer->DeleteBuffer(m_IndicesBuffer);
-   
-    for (auto buffer : m_Buffers)
-    {
-        renderer->DeleteBuffer(buffer.second.first);
-    }
+    //Hands the whole vertex and index ranges back to the arena
+    ServiceLocator::GetRenderer()->FreeGeometry(m_Geometry);
 }
 
 
 
-
-
 void Mesh::setData( const std::unordered_map<std::string, AttributeDescription>& descriptions,
                     const std::vector<glm::vec3>& positions,  
                     const std::vector<uint32_t>& indices,
@@ -78,46 +73,240 @@ void Mesh::setData( const std::unordered_map<std::string, AttributeDescription>&
                     std::vector<glm::vec3>* normals,
                     std::vector<glm::vec3>* tangents,
                     std::vector<glm::vec3>* biTangents)
+{
+    MeshStreams streams;
+    streams.m_Positions = positions.data();
+    streams.m_NVertices = static_cast<uint32_t>(positions.size());
+    streams.m_Indices = indices.data();
+    streams.m_NIndices = static_cast<uint32_t>(indices.size());
+    if (colors && colors->size())
+        streams.m_Colors = colors->data();
+    if (texCoords && texCoords->size())
+        streams.m_TexCoords = texCoords->data();
+    if (normals && normals->size())
+        streams.m_Normals = normals->data();
+    if (tangents && tangents->size())
+        streams.m_Tangents = tangents->data();
+    if (biTangents && biTangents->size())
+        streams.m_BiTangents = biTangents->data();
+
+    setData(descriptions, streams);
+}
+
+void Mesh::setData(const std::unordered_map<std::string, AttributeDescription>& descriptions, const MeshStreams& streams,
+    VertexLayout layout, const MeshView* views, uint32_t nViews)
 {
     auto renderer = ServiceLocator::GetRenderer();
-    //assert(positions.size() > 0, "Cant have mesh with no positions");
-    m_Positions = std::move(positions);
-    m_Buffers.emplace("inPosition", std::make_pair(renderer->CreateVertexBuffer((void*)(m_Positions.data()), sizeof(glm::vec3) * m_Positions.size()), descriptions.find("inPosition")->second));
+    m_Layout = layout;
 
+    //Indices are local to their view, so 16 bits are enough as long as no view goes past 64K vertices
+    uint32_t indexSize = sizeof(uint32_t);
+    if (layout == VertexLayout::Compact && streams.m_NIndices > 0 &&
+        *std::max_element(streams.m_Indices, streams.m_Indices + streams.m_NIndices) <= UINT16_MAX)
+    {
+        indexSize = sizeof(uint16_t);
+    }
 
+    if (!renderer->AllocateGeometry(streams.m_NVertices, streams.m_NIndices, indexSize, m_Geometry))
+        throw std::runtime_error("Out of geometry arena space");
 
+    //Positions and indices are needed on the CPU for the bounding boxes, one bulk copy each
+    m_Positions.assign(streams.m_Positions, streams.m_Positions + streams.m_NVertices);
+    m_Indices.assign(streams.m_Indices, streams.m_Indices + streams.m_NIndices);
+    if (indexSize == sizeof(uint16_t))
+    {
+        std::vector<uint16_t> indices16(m_Indices.begin(), m_Indices.end());
+        m_IndicesBuffer = renderer->UploadGeometryIndices(m_Geometry, indices16.data());
+    }
+    else
+    {
+        m_IndicesBuffer = renderer->UploadGeometryIndices(m_Geometry, m_Indices.data());
+    }
+
+    if (layout == VertexLayout::Compact)
+    {
+        uploadCompactStreams(descriptions, streams, views, nViews);
+        return;
+    }
 
-    //assert(m_Indices.size() > 0, "Cant have mesh with no indices for now");
-    m_Indices =  std::move(indices);
-    m_IndicesBuffer = renderer->CreateIndexBuffer((void*)(m_Indices.data()), sizeof(uint32_t)* m_Indices.size());
+    auto createStreamBuffer = [&](const std::string& name, const void* data, size_t elementSize)
+    {
+        auto description = descriptions.find(name);
+        if (data == nullptr || streams.m_NVertices == 0 || description == descriptions.end())
+            return;
+        m_Buffers.emplace(name, std::make_pair(renderer->UploadGeometryStream(m_Geometry, name, data, static_cast<uint32_t>(elementSize)), description->second));
+    };
+    createStreamBuffer("inPosition", m_Positions.data(), sizeof(glm::vec3));
+    createStreamBuffer("inColor", streams.m_Colors, sizeof(glm::vec3));
+    createStreamBuffer("inTexCoord", streams.m_TexCoords, sizeof(glm::vec2));
+    createStreamBuffer("inNormal", streams.m_Normals, sizeof(glm::vec3));
+    createStreamBuffer("inTangent", streams.m_Tangents, sizeof(glm::vec3));
+    createStreamBuffer("inBiTangent", streams.m_BiTangents, sizeof(glm::vec3));
+}
 
+namespace
+{
+    //Octahedral mapping of a unit vector into [-1,1]^2, see "A Survey of Efficient Representations for Independent Unit Vectors"
+    glm::vec2 octEncode(glm::vec3 n)
+    {
+        float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        if (l1 <= 0.0f)
+            return glm::vec2(0.0f);
+        n /= l1;
+        glm::vec2 p(n.x, n.y);
+        if (n.z < 0.0f)
+        {
+            p = glm::vec2((1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                          (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+        }
+        return p;
+    }
 
+    int16_t toSnorm16(float v) { return static_cast<int16_t>(std::round(glm::clamp(v, -1.0f, 1.0f) * 32767.0f)); }
+    int8_t toSnorm8(float v) { return static_cast<int8_t>(std::round(glm::clamp(v, -1.0f, 1.0f) * 127.0f)); }
+    uint16_t toUnorm16(float v) { return static_cast<uint16_t>(std::round(glm::clamp(v, 0.0f, 1.0f) * 65535.0f)); }
 
-    if (colors && colors->size())
+    struct CompactPosition { uint16_t x, y, z, w; };
+    struct CompactNormal { int16_t x, y; };
+    struct CompactTangent { int8_t x, y, sign, pad; };
+}
+
+void Mesh::uploadCompactStreams(const std::unordered_map<std::string, AttributeDescription>& descriptions, const MeshStreams& streams, const MeshView* views, uint32_t nViews)
+{
+    auto renderer = ServiceLocator::GetRenderer();
+    const uint32_t nVertices = streams.m_NVertices;
+    if (nVertices == 0)
+        return;
+
+    auto uploadStream = [&](const std::string& name, const void* data, size_t elementSize)
+    {
+        auto description = descriptions.find(name);
+        if (description == descriptions.end())
+            return;
+        m_Buffers.emplace(name, std::make_pair(renderer->UploadGeometryStream(m_Geometry, name, data, static_cast<uint32_t>(elementSize)), description->second));
+    };
+
+    //Positions, each view range inside its own bounds so small meshes in a big scene keep their precision
     {
-        m_Colors = std::move(*colors);
-        m_Buffers.emplace("inColor", std::make_pair(renderer->CreateVertexBuffer((void*)(m_Colors.data()), sizeof(glm::vec3) * m_Colors.size()), descriptions.find("inColor")->second));
+        MeshView wholeMesh{ 0, streams.m_NIndices, 0, nVertices, 0 };
+        if (views == nullptr || nViews == 0)
+        {
+            wholeMesh.m_BoundsMin = wholeMesh.m_BoundsMax = streams.m_Positions[0];
+            for (uint32_t v = 1; v < nVertices; v++)
+            {
+                wholeMesh.m_BoundsMin = glm::min(wholeMesh.m_BoundsMin, streams.m_Positions[v]);
+                wholeMesh.m_BoundsMax = glm::max(wholeMesh.m_BoundsMax, streams.m_Positions[v]);
+            }
+            views = &wholeMesh;
+            nViews = 1;
+        }
+
+        std::vector<CompactPosition> positions(nVertices, CompactPosition{ 0, 0, 0, UINT16_MAX });
+        for (uint32_t i = 0; i < nViews; i++)
+        {
+            const MeshView& view = views[i];
+            if (view.m_LodError > 0.0f)
+                continue;//Simplified views index the vertices of their full detail view, they are quantized already
+            PositionDequantization dequantization = GetPositionDequantization(view);
+            glm::vec3 invScale(0.0f);
+            for (int c = 0; c < 3; c++)
+                invScale[c] = dequantization.m_Scale[c] > 0.0f ? 1.0f / dequantization.m_Scale[c] : 0.0f;
+
+            for (uint32_t v = view.m_VerticesMeshStart; v < view.m_VerticesMeshStart + view.m_NVertices; v++)
+            {
+                glm::vec3 normalized = (streams.m_Positions[v] - glm::vec3(dequantization.m_Offset)) * invScale;
+                positions[v] = { toUnorm16(normalized.x), toUnorm16(normalized.y), toUnorm16(normalized.z), UINT16_MAX };
+            }
+        }
+        uploadStream("inPosition", positions.data(), sizeof(CompactPosition));
     }
-    if (texCoords && texCoords->size())
+
+    if (streams.m_Colors)
     {
-        m_TexCoords = std::move(*texCoords);
-        m_Buffers.emplace("inTexCoord", std::make_pair(renderer->CreateVertexBuffer((void*)(m_TexCoords.data()), sizeof(glm::vec2) * m_TexCoords.size()), descriptions.find("inTexCoord")->second));
+        std::vector<uint32_t> colors(nVertices);
+        for (uint32_t v = 0; v < nVertices; v++)
+            colors[v] = glm::packUnorm4x8(glm::vec4(streams.m_Colors[v], 1.0f));
+        uploadStream("inColor", colors.data(), sizeof(uint32_t));
     }
-    if (normals && normals->size())
+
+    if (streams.m_TexCoords)
     {
-        m_Normals = std::move(*normals);
-        m_Buffers.emplace("inNormal", std::make_pair(renderer->CreateVertexBuffer((void*)(m_Normals.data()), sizeof(glm::vec3) * m_Normals.size()), descriptions.find("inNormal")->second));
+        std::vector<uint32_t> texCoords(nVertices);
+        for (uint32_t v = 0; v < nVertices; v++)
+            texCoords[v] = glm::packHalf2x16(streams.m_TexCoords[v]);
+        uploadStream("inTexCoord", texCoords.data(), sizeof(uint32_t));
     }
-    if (tangents && tangents->size())
+
+    if (streams.m_Normals)
     {
-        m_Tangents = std::move(*tangents);
-        m_Buffers.emplace("inTangent", std::make_pair(renderer->CreateVertexBuffer((void*)(m_Tangents.data()), sizeof(glm::vec3) * m_Tangents.size()), descriptions.find("inTangent")->second));
+        std::vector<CompactNormal> normals(nVertices);
+        for (uint32_t v = 0; v < nVertices; v++)
+        {
+            glm::vec2 oct = octEncode(streams.m_Normals[v]);
+            normals[v] = { toSnorm16(oct.x), toSnorm16(oct.y) };
+        }
+        uploadStream("inNormal", normals.data(), sizeof(CompactNormal));
     }
-    if (biTangents && biTangents->size())
+
+    //The bitangent is rebuilt in the shader as cross(N, T) * sign, only the handedness is stored
+    if (streams.m_Normals && streams.m_Tangents && streams.m_BiTangents)
+    {
+        std::vector<CompactTangent> tangents(nVertices);
+        for (uint32_t v = 0; v < nVertices; v++)
+        {
+            glm::vec2 oct = octEncode(streams.m_Tangents[v]);
+            float handedness = glm::dot(glm::cross(streams.m_Normals[v], streams.m_Tangents[v]), streams.m_BiTangents[v]) < 0.0f ? -1.0f : 1.0f;
+            tangents[v] = { toSnorm8(oct.x), toSnorm8(oct.y), toSnorm8(handedness), 0 };
+        }
+        uploadStream("inTangent", tangents.data(), sizeof(CompactTangent));
+    }
+}
+
+std::unordered_map<std::string, AttributeDescription> Mesh::describeStreams(const MeshStreams& streams, VertexLayout layout)
+{
+    std::unordered_map<std::string, AttributeDescription> descriptions;
+    if (layout == VertexLayout::Full)
     {
-        m_BiTangents = std::move(*biTangents);
-        m_Buffers.emplace("inBiTangent", std::make_pair(renderer->CreateVertexBuffer((void*)(m_BiTangents.data()), sizeof(glm::vec3) * m_BiTangents.size()), descriptions.find("inBiTangent")->second));
+        AttributeDescription avec3{ VK_FORMAT_R32G32B32_SFLOAT,12,0 };
+        AttributeDescription avec2{ VK_FORMAT_R32G32_SFLOAT,8,0 };
+        descriptions.emplace("inPosition", avec3);
+        if (streams.m_TexCoords)
+            descriptions.emplace("inTexCoord", avec2);
+        if (streams.m_Colors)
+            descriptions.emplace("inColor", avec3);
+        if (streams.m_Normals)
+            descriptions.emplace("inNormal", avec3);
+        if (streams.m_Tangents && streams.m_BiTangents)
+        {
+            descriptions.emplace("inTangent", avec3);
+            descriptions.emplace("inBiTangent", avec3);
+        }
+        return descriptions;
     }
+
+    descriptions.emplace("inPosition", AttributeDescription{ VK_FORMAT_R16G16B16A16_UNORM, sizeof(CompactPosition), 0 });
+    if (streams.m_TexCoords)
+        descriptions.emplace("inTexCoord", AttributeDescription{ VK_FORMAT_R16G16_SFLOAT, sizeof(uint32_t), 0 });
+    if (streams.m_Colors)
+        descriptions.emplace("inColor", AttributeDescription{ VK_FORMAT_R8G8B8A8_UNORM, sizeof(uint32_t), 0 });
+    if (streams.m_Normals)
+        descriptions.emplace("inNormal", AttributeDescription{ VK_FORMAT_R16G16_SNORM, sizeof(CompactNormal), 0 });
+    if (streams.m_Normals && streams.m_Tangents && streams.m_BiTangents)
+        descriptions.emplace("inTangent", AttributeDescription{ VK_FORMAT_R8G8B8A8_SNORM, sizeof(CompactTangent), 0 });
+    return descriptions;
+}
+
+PositionDequantization Mesh::GetPositionDequantization(const MeshView& view)
+{
+    return { glm::vec4(view.m_BoundsMin, 0.0f), glm::vec4(view.m_BoundsMax - view.m_BoundsMin, 0.0f) };
+}
+
+MeshView Mesh::toArenaView(const MeshView& localView) const
+{
+    MeshView view = localView;
+    view.m_IndicesMeshStart += m_Geometry.m_IndexOffset;
+    view.m_VerticesMeshStart += m_Geometry.m_VertexOffset;
+    return view;
 }
 
 bool Mesh::GetAttributeDescription(std::string name, AttributeDescription& attribute)const
@@ -149,4 +338,6 @@ void Mesh::computeShaderVariant(ShaderVariant& variant) const
         std::transform(attrib_name.begin(), attrib_name.end(), attrib_name.begin(), ::toupper);
         variant.add_define("HAS_" + attrib_name);
     }
+    if (m_Layout == VertexLayout::Compact)
+        variant.add_define("HAS_COMPACT_VERTICES");
 }
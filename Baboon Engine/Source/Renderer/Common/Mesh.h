@@ -1,11 +1,13 @@
 #pragma once
 
 #include "Renderer/Common/GLMInclude.h"
+#include "Renderer/Common/GeometryArena.h"
 #include "vulkan\vulkan.h"
 #include <vector>
 #include <string>
 #include <unordered_map>
 
+//Sub range of a mesh. Baked/imported views are relative to their mesh, Mesh::toArenaView makes them global to the geometry arena
 struct MeshView
 {
     uint32_t m_IndicesMeshStart;
@@ -13,6 +15,38 @@ struct MeshView
     uint32_t m_VerticesMeshStart;
     uint32_t m_NVertices;
     uint32_t m_MaterialIndex;
+    glm::vec3 m_BoundsMin{ 0.0f };//Local bounds of the view vertices, compact positions are quantized inside them
+    glm::vec3 m_BoundsMax{ 0.0f };
+    uint32_t m_FirstLod = 0;//Simplified versions of this view are m_NLods views starting at m_FirstLod in the same view list
+    uint32_t m_NLods = 0;
+    float m_LodError = 0.0f;//Model space error of a simplified view against the full detail one
+    uint32_t m_FirstMeshlet = 0;//Clusters of the view in the mesh meshlet list, only full detail views have them
+    uint32_t m_NMeshlets = 0;
+};
+
+//Small cluster of consecutive triangles of a view, the unit the cpu culls at below model granularity
+struct Meshlet
+{
+    glm::vec3 m_Center;//Bounding sphere, model space
+    float m_Radius;
+    glm::vec3 m_ConeAxis;//Average facing of the triangles, every triangle normal is within the cone around it
+    float m_ConeCutoff;//sin of the cone half angle opened towards the back, 1 means the cluster can't be backface culled
+    uint32_t m_IndicesMeshStart;//Mesh relative, same as MeshView before toArenaView
+    uint32_t m_NIndices;
+};
+
+//How the vertex streams of a mesh are stored on the gpu
+enum class VertexLayout
+{
+    Full,//32 bit floats for every attribute, 32 bit indices
+    Compact,//unorm16 positions inside the view bounds, octahedral snorm normals, tangents with the bitangent as a sign, half float uvs, 16 bit indices when they fit
+};
+
+//What the vertex shader needs to bring compact positions back into model space: position = offset + quantized * scale
+struct PositionDequantization
+{
+    glm::vec4 m_Offset;
+    glm::vec4 m_Scale;
 };
 
 struct Vertex {
@@ -28,6 +62,20 @@ struct Vertex {
 };
 
 
+//Raw views over the vertex streams of a mesh. Lets the caller hand over memory it owns (a mapped baked scene for example) without building vectors first
+struct MeshStreams
+{
+    const glm::vec3* m_Positions = nullptr;
+    const glm::vec3* m_Colors = nullptr;
+    const glm::vec2* m_TexCoords = nullptr;
+    const glm::vec3* m_Normals = nullptr;
+    const glm::vec3* m_Tangents = nullptr;
+    const glm::vec3* m_BiTangents = nullptr;
+    uint32_t m_NVertices = 0;
+    const uint32_t* m_Indices = nullptr;
+    uint32_t m_NIndices = 0;
+};
+
 struct AttributeDescription
 {
     VkFormat m_Format = VK_FORMAT_UNDEFINED;
@@ -55,6 +103,25 @@ public:
             std::vector<glm::vec3>* biTangents = nullptr
             );
 
+    /**
+     * @brief Same as above but uploading straight from the given streams, only positions and indices are kept on the CPU side
+     * @param layout Compact encodes the streams before uploading, descriptions have to come from describeStreams with the same layout
+     * @param views Compact quantizes the positions of each view inside its bounds, without views the whole mesh is one view
+     */
+    void setData(const std::unordered_map<std::string, AttributeDescription>& descriptions, const MeshStreams& streams,
+        VertexLayout layout = VertexLayout::Full, const MeshView* views = nullptr, uint32_t nViews = 0);
+
+    //Gpu formats of the attributes present in the streams for the given layout
+    static std::unordered_map<std::string, AttributeDescription> describeStreams(const MeshStreams& streams, VertexLayout layout);
+    static PositionDequantization GetPositionDequantization(const MeshView& view);
+
+    VertexLayout GetLayout() const { return m_Layout; }
+    VkIndexType GetIndexType() const { return m_Geometry.m_IndexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32; }
+
+    //Where the mesh landed in the renderer geometry arena, mesh views have to be offset by it before drawing
+    const GeometryAllocation& GetGeometry() const { return m_Geometry; }
+    MeshView toArenaView(const MeshView& localView) const;
+
 
     bool GetAttributeDescription(std::string name, AttributeDescription& attribute) const;
     void pushVertex(Vertex v);
@@ -63,22 +130,26 @@ public:
     const std::unordered_map<std::string, std::pair<Buffer*, AttributeDescription>>& GetVerticesBuffers()const { return m_Buffers; }
     const size_t GetVerticesSize() { return sizeof(m_Vertices[0]) * m_Vertices.size(); }
     const size_t GetIndicesSize() { return sizeof(m_Indices[0]) * m_Indices.size(); }
+    //CPU copies are indexed with mesh local offsets, not arena ones
     const uint32_t* GetIndicesData() const { return m_Indices.data(); };
     const glm::vec3* GetPositionsData() const { return m_Positions.data(); };
 
+    void setMeshlets(const Meshlet* meshlets, uint32_t nMeshlets) { m_Meshlets.assign(meshlets, meshlets + nMeshlets); }
+    const Meshlet* GetMeshletsData() const { return m_Meshlets.data(); }
+
     void computeShaderVariant(ShaderVariant& variant) const;
 private:
     std::vector<Vertex> m_Vertices;
     std::vector<uint32_t> m_Indices;
-    Buffer* m_IndicesBuffer;
+    Buffer* m_IndicesBuffer{ nullptr };
 
-    std::unordered_map<std::string, std::pair<Buffer*,AttributeDescription>> m_Buffers;
+    std::unordered_map<std::string, std::pair<Buffer*,AttributeDescription>> m_Buffers;//Buffers belong to the geometry arena
     std::vector<glm::vec3> m_Positions;
-    std::vector<glm::vec3> m_Colors;
-    std::vector<glm::vec2> m_TexCoords;
-    std::vector<glm::vec3> m_Normals;
-    std::vector<glm::vec3> m_Tangents;
-    std::vector<glm::vec3> m_BiTangents;
+    std::vector<Meshlet> m_Meshlets;
+    GeometryAllocation m_Geometry;
+    VertexLayout m_Layout{ VertexLayout::Full };
+
+    void uploadCompactStreams(const std::unordered_map<std::string, AttributeDescription>& descriptions, const MeshStreams& streams, const MeshView* views, uint32_t nViews);
 };
 
 
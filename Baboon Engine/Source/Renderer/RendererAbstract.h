@@ -3,10 +3,11 @@
 #include <chrono>
 #include <string>
 #include <vector>
+#include "Renderer/Common/Buffer.h"
+#include "Renderer/Common/GeometryArena.h"
 
 
 class Camera;
-class Buffer;
 class Texture;
 class RendererAbstract
 {
@@ -26,16 +27,22 @@ public:
 	virtual Texture* CreateTexture(void*  i_data, int i_Widht, int i_Height) = 0;
 	virtual void CreateMaterial(std::string i_MatName, int* iTexIndices, int iNumTextures) = 0;
 	virtual void DeleteTexture(Texture*) = 0;
-	virtual Buffer* CreateVertexBuffer(void*  i_data, size_t iBufferSize) = 0;
-	virtual Buffer* CreateIndexBuffer(void*  i_data, size_t iBufferSize) = 0;
+	virtual void WaitForUploads() {}//Blocks the calling (loading) thread till every texture and buffer created so far is on the gpu
+	virtual bool SupportsBindlessTextures() const { return false; }//Materials sample a single scene texture array by index instead of binding their own
+	virtual Buffer* CreateVertexBuffer(void*  i_data, size_t iBufferSize, BufferMemoryClass i_MemoryClass = BufferMemoryClass::Static) = 0;
+	virtual Buffer* CreateIndexBuffer(void*  i_data, size_t iBufferSize, BufferMemoryClass i_MemoryClass = BufferMemoryClass::Static) = 0;
 	virtual void DeleteBuffer(Buffer*) = 0;
 
+	//Scene geometry goes to a shared arena instead of a buffer per stream, the returned buffers are owned by the renderer
+	virtual bool AllocateGeometry(uint32_t i_NVertices, uint32_t i_NIndices, uint32_t i_IndexSize, GeometryAllocation& o_Allocation) = 0;
+	virtual Buffer* UploadGeometryStream(const GeometryAllocation& i_Allocation, const std::string& i_Attribute, const void* i_Data, uint32_t i_Stride) = 0;
+	virtual Buffer* UploadGeometryIndices(const GeometryAllocation& i_Allocation, const void* i_Indices) = 0;
+	virtual void FreeGeometry(const GeometryAllocation& i_Allocation) = 0;
+
 
   virtual void ReloadShader(std::string) = 0;
-  virtual Buffer* CreateStaticUniformBuffer( void* i_data, size_t iBufferSize) = 0;
-	virtual Buffer* CreateInstancedUniformBuffer( void*  i_data, size_t iBufferSize) = 0;
+  virtual Buffer* CreateStaticUniformBuffer( void* i_data, size_t iBufferSize, BufferMemoryClass i_MemoryClass = BufferMemoryClass::Dynamic) = 0;
 	virtual void DeleteStaticUniformBuffer() {}
-	virtual void DeleteInstancedUniformBuffer() {}
 	float GetDeltaTime() { return m_LastFrameTime; }
 
 protected:
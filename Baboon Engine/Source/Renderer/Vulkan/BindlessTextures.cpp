@@ -0,0 +1,82 @@
+#include "BindlessTextures.h"
+#include "Device.h"
+#include "VulkanTexture.h"
+#include "Core/ServiceLocator.h"
+#include "resources/Shader.h"
+#include "resources/DescriptorSetLayout.h"
+#include <algorithm>
+
+static DescriptorSetLayout& requestLayout(Device& device)
+{
+    ShaderResource resource{};
+    resource.type = ShaderResourceType::ImageSampler;
+    resource.mode = ShaderResourceMode::UpdateAfterBind;
+    resource.stages = VK_SHADER_STAGE_FRAGMENT_BIT;
+    resource.set = BINDLESS_TEXTURES_SET;
+    resource.binding = 0;
+    resource.array_size = BINDLESS_MAX_TEXTURES;
+    resource.name = BINDLESS_TEXTURES_NAME;
+    return device.getResourcesCache().request_descriptor_set_layout({ resource });
+}
+
+BindlessTextures::BindlessTextures(Device& device) :
+    m_Device(device),
+    m_DescriptorSetLayout(requestLayout(device))
+{
+    VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, BINDLESS_MAX_TEXTURES };
+    VkDescriptorPoolCreateInfo poolInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    if (vkCreateDescriptorPool(m_Device.get_handle(), &poolInfo, nullptr, &m_DescriptorPool) != VK_SUCCESS)
+    {
+        LOGERROR("Cannot create the bindless textures descriptor pool");
+        return;
+    }
+
+    VkDescriptorSetLayout layout = m_DescriptorSetLayout.getHandle();
+    VkDescriptorSetAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+    allocInfo.descriptorPool = m_DescriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+    if (vkAllocateDescriptorSets(m_Device.get_handle(), &allocInfo, &m_DescriptorSet) != VK_SUCCESS)
+        LOGERROR("Cannot allocate the bindless textures descriptor set");
+}
+
+BindlessTextures::~BindlessTextures()
+{
+    if (m_DescriptorPool)
+        vkDestroyDescriptorPool(m_Device.get_handle(), m_DescriptorPool, nullptr);
+}
+
+void BindlessTextures::update(const std::vector<Texture*>& textures)
+{
+    if (m_DescriptorSet == VK_NULL_HANDLE)
+        return;
+    if (textures.size() > BINDLESS_MAX_TEXTURES)
+        LOGERROR("The scene has more textures than BINDLESS_MAX_TEXTURES, the last ones won't be sampled");
+
+    m_TextureCount = (std::min)(static_cast<uint32_t>(textures.size()), (uint32_t)BINDLESS_MAX_TEXTURES);
+    if (m_TextureCount == 0)
+        return;//Partially bound, the elements of the last scene are never read again
+
+    std::vector<VkDescriptorImageInfo> imageInfos(m_TextureCount);
+    for (uint32_t i = 0; i < m_TextureCount; i++)
+    {
+        VulkanTexture* texture = (VulkanTexture*)textures[i];
+        imageInfos[i].sampler = texture->getSampler()->getHandle();
+        imageInfos[i].imageView = texture->getImageView()->getHandle();
+        imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+
+    m_Device.wait_idle();
+    VkWriteDescriptorSet write{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+    write.dstSet = m_DescriptorSet;
+    write.dstBinding = 0;
+    write.dstArrayElement = 0;
+    write.descriptorCount = m_TextureCount;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = imageInfos.data();
+    vkUpdateDescriptorSets(m_Device.get_handle(), 1, &write, 0, nullptr);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "Common.h"
+#include "Core/Material.h"
+#include <vector>
+
+class Device;
+class Texture;
+class DescriptorSetLayout;
+
+#define BINDLESS_TEXTURES_SET 1 //Descriptor set of the array in geo.frag and transparent.frag, binding 0
+#define BINDLESS_TEXTURES_NAME "sceneTextures"
+
+/**
+ * @brief Every scene texture in one partially bound, update after bind sampler array, written once per scene load
+ *
+ * The materials store the array index of each of their textures (-1 when they don't have it) and the fragment shaders sample
+ * through it, so the set is bound once per pass instead of a new descriptor set per material. Its layout is requested from
+ * the resources cache with the same resource the shader reflection gives the runtime array, pipeline layouts get the same
+ * VkDescriptorSetLayout. Only created when the device has descriptor indexing, see Device::isDescriptorIndexingEnabled.
+ */
+class BindlessTextures
+{
+public:
+    BindlessTextures(Device& device);
+    ~BindlessTextures();
+
+    BindlessTextures(const BindlessTextures&) = delete;
+    BindlessTextures& operator=(const BindlessTextures&) = delete;
+
+    //Texture i goes to array element i, waits for the gpu since frames in flight may read the old ones
+    void update(const std::vector<Texture*>& textures);
+
+    VkDescriptorSet getHandle() const { return m_DescriptorSet; }
+    uint32_t getTextureCount() const { return m_TextureCount; }
+
+private:
+    Device& m_Device;
+    DescriptorSetLayout& m_DescriptorSetLayout;
+    VkDescriptorPool m_DescriptorPool{ VK_NULL_HANDLE };
+    VkDescriptorSet m_DescriptorSet{ VK_NULL_HANDLE };
+    uint32_t m_TextureCount{ 0 };
+};
@@ -0,0 +1,140 @@
+#include "ClusterCuller.h"
+#include "VulkanBuffer.h"
+#include "Device.h"
+#include "Core/Scene.h"
+#include "Cameras/Camera.h"
+#include <cstring>
+#include <algorithm>
+
+//Gribb-Hartmann, planes of the clip volume in whatever space i_Matrix takes points from. Not normalized, the sphere test scales the radius instead
+static void extractFrustumPlanes(const glm::mat4& i_Matrix, glm::vec4 o_Planes[6])
+{
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(i_Matrix[0][i], i_Matrix[1][i], i_Matrix[2][i], i_Matrix[3][i]);
+
+    o_Planes[0] = rows[3] + rows[0];
+    o_Planes[1] = rows[3] - rows[0];
+    o_Planes[2] = rows[3] + rows[1];
+    o_Planes[3] = rows[3] - rows[1];
+    o_Planes[4] = rows[3] + rows[2];//-w < z, looser than the 0 < z of vulkan depth so it holds for both conventions
+    o_Planes[5] = rows[3] - rows[2];
+}
+
+//The cone bounds are angles, they only survive a transform that doesn't skew or mirror the triangles
+static bool canTestCones(const glm::mat4& i_Matrix)
+{
+    const glm::mat3 linear(i_Matrix);
+    const float scaleX = glm::length(linear[0]);
+    const float scaleY = glm::length(linear[1]);
+    const float scaleZ = glm::length(linear[2]);
+    const float maxScale = (std::max)(scaleX, (std::max)(scaleY, scaleZ));
+    const float minScale = (std::min)(scaleX, (std::min)(scaleY, scaleZ));
+    return glm::determinant(linear) > 0.0f && maxScale - minScale <= maxScale * 0.01f;
+}
+
+ClusterCuller::ClusterCuller(Device& device) :
+    m_Device(device)
+{
+}
+
+ClusterCuller::~ClusterCuller()
+{
+}
+
+void ClusterCuller::cull(Scene& scene, const Camera& camera)
+{
+    m_DrawRanges.clear();
+    m_Stats = ClusterCullStats();
+    if (!scene.IsInit())
+        return;
+
+    const ModelStore& models = scene.GetModelStore();
+    const uint32_t nModels = models.size();
+    m_DrawRanges.assign(nModels, ClusterDrawRange{ CLUSTER_CULL_NO_RANGE, 0 });
+
+    //Sized for everything surviving so the copy below never has to check
+    uint64_t maxIndices = 0;
+    for (ModelHandle model = 0; model < nModels; model++)
+    {
+        const MeshView& view = models.getDrawView(model).m_View;
+        if (models.hasFlag(model, ModelFlag_Visible) && !models.hasFlag(model, ModelFlag_Instanced) && view.m_NMeshlets >= CLUSTER_CULL_MIN_MESHLETS)
+            maxIndices += view.m_NIndices;
+    }
+    if (maxIndices == 0)
+        return;
+    if (maxIndices > m_Capacity)
+    {
+        m_Capacity = maxIndices + maxIndices / 2;
+        m_IndexBuffer = std::make_unique<VulkanBuffer>(m_Device, (VkDeviceSize)m_Capacity * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    }
+    uint32_t* compacted = (uint32_t*)m_IndexBuffer->map();
+
+    const glm::mat4 viewProj = camera.GetViewProjMatrix();
+    const glm::vec4 eye(camera.GetPosition(), 1.0f);
+    uint32_t written = 0;
+    const glm::mat4* worldMatrices = models.getWorldMatrices();
+    const uint8_t* flags = models.getFlags();
+    for (ModelHandle model = 0; model < nModels; model++)
+    {
+        const ModelMeshView& drawView = models.getDrawView(model);
+        const MeshView& view = drawView.m_View;
+        if (!(flags[model] & ModelFlag_Visible) || view.m_NMeshlets < CLUSTER_CULL_MIN_MESHLETS)
+            continue;//Outside the frustum altogether, the subpasses using the culled ranges don't draw it
+        if (flags[model] & ModelFlag_Instanced)
+            continue;//Drawn whole along with the other models of its instanced run
+
+        const glm::mat4& modelMatrix = worldMatrices[model];
+        glm::vec4 planes[6];
+        extractFrustumPlanes(viewProj * modelMatrix, planes);
+        float planeScales[6];
+        for (int p = 0; p < 6; p++)
+            planeScales[p] = glm::length(glm::vec3(planes[p]));
+        const glm::vec3 localEye = glm::vec3(glm::inverse(modelMatrix) * eye);
+        const bool testCones = CLUSTER_CULL_BACKFACES && !(flags[model] & ModelFlag_Transparent) && canTestCones(modelMatrix);
+
+        const Meshlet* meshlets = drawView.m_Mesh->GetMeshletsData() + view.m_FirstMeshlet;
+        const uint32_t* indices = drawView.m_Mesh->GetIndicesData();
+        ClusterDrawRange range;
+        range.m_FirstIndex = written;
+        for (uint32_t m = 0; m < view.m_NMeshlets; m++)
+        {
+            const Meshlet& meshlet = meshlets[m];
+            m_Stats.m_Meshlets++;
+
+            bool outside = false;
+            for (int p = 0; p < 6 && !outside; p++)
+                outside = glm::dot(glm::vec3(planes[p]), meshlet.m_Center) + planes[p].w < -meshlet.m_Radius * planeScales[p];
+            if (outside)
+            {
+                m_Stats.m_FrustumCulled++;
+                continue;
+            }
+
+            if (testCones && meshlet.m_ConeCutoff < 1.0f)
+            {
+                const glm::vec3 toCenter = meshlet.m_Center - localEye;
+                if (glm::dot(toCenter, meshlet.m_ConeAxis) >= meshlet.m_ConeCutoff * glm::length(toCenter) + meshlet.m_Radius)
+                {
+                    m_Stats.m_BackfaceCulled++;
+                    continue;
+                }
+            }
+
+            std::memcpy(compacted + written, indices + meshlet.m_IndicesMeshStart, meshlet.m_NIndices * sizeof(uint32_t));
+            written += meshlet.m_NIndices;
+        }
+        range.m_NIndices = written - range.m_FirstIndex;
+        m_DrawRanges[model] = range;
+    }
+    m_IndexBuffer->flush();
+    m_Stats.m_Indices = written;
+}
+
+bool ClusterCuller::getDrawRange(ModelHandle i_Model, ClusterDrawRange& o_Range) const
+{
+    if (i_Model >= m_DrawRanges.size() || m_DrawRanges[i_Model].m_FirstIndex == CLUSTER_CULL_NO_RANGE)
+        return false;
+    o_Range = m_DrawRanges[i_Model];
+    return true;
+}
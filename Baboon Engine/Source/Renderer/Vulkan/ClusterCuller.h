@@ -0,0 +1,65 @@
+#pragma once
+#include "Common.h"
+#include "Core/ModelStore.h"
+#include <memory>
+#include <vector>
+
+class Device;
+class VulkanBuffer;
+class Scene;
+class Camera;
+
+#define CLUSTER_CULL_MIN_MESHLETS 2 //Models with fewer meshlets are drawn whole straight from the geometry arena
+#define CLUSTER_CULL_BACKFACES 1 //Normal cone test for opaque models, transparent ones are always seen from both sides
+
+#define CLUSTER_CULL_NO_RANGE UINT32_MAX //m_FirstIndex of the models that weren't cluster culled
+
+//Where the surviving triangles of a model ended up in the compacted index buffer, 32 bit view local indices
+struct ClusterDrawRange
+{
+    uint32_t m_FirstIndex = 0;
+    uint32_t m_NIndices = 0;
+};
+
+struct ClusterCullStats
+{
+    uint32_t m_Meshlets = 0;
+    uint32_t m_FrustumCulled = 0;
+    uint32_t m_BackfaceCulled = 0;
+    uint32_t m_Indices = 0;//Written to the compacted buffer
+};
+
+/**
+ * @brief Per frame meshlet culling against the main camera, without mesh shaders
+ *
+ * Meshlets of every visible model big enough are tested against the frustum and their normal cone on the cpu, the index ranges of the
+ * survivors get copied one after the other into a host visible index buffer owned by the frame. Subpasses drawing with it bind
+ * that buffer and draw the model range instead of the arena one, vertices still come from the arena.
+ * Culling happens in model space (frustum planes out of viewProj * model and the eye moved into model space) so the baked
+ * meshlet bounds are used as they are.
+ */
+class ClusterCuller
+{
+public:
+    ClusterCuller(Device& device);
+    ~ClusterCuller();
+
+    ClusterCuller(const ClusterCuller&) = delete;
+    ClusterCuller& operator=(const ClusterCuller&) = delete;
+
+    //Rewrites the index buffer, only call it once the frame fence has been waited on
+    void cull(Scene& scene, const Camera& camera);
+
+    //false if the model isn't cluster culled and has to be drawn from the arena as usual
+    bool getDrawRange(ModelHandle i_Model, ClusterDrawRange& o_Range) const;
+
+    VulkanBuffer* getIndexBuffer() const { return m_IndexBuffer.get(); }
+    const ClusterCullStats& getStats() const { return m_Stats; }
+
+private:
+    Device& m_Device;
+    std::unique_ptr<VulkanBuffer> m_IndexBuffer;
+    uint64_t m_Capacity{ 0 };//In indices
+    std::vector<ClusterDrawRange> m_DrawRanges;//By model handle
+    ClusterCullStats m_Stats;
+};
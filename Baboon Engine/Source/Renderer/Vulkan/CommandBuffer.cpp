@@ -82,7 +82,10 @@ VkResult CommandBuffer::begin(VkCommandBufferUsageFlags flags, CommandBuffer* pr
     m_PipelineState.reset();
     m_ResourceBindingState.reset();
     m_DescriptorSet_Binding_State.clear();
+    m_ExternalDescriptorSets.clear();
+    m_ExternalSetsLayout = VK_NULL_HANDLE;
     m_CurrentVertexBindings.indexBuffer = VK_NULL_HANDLE;
+    m_CurrentVertexBindings.indexType = VK_INDEX_TYPE_UINT32;
     for (int i = 0; i < 10; i++)
         m_CurrentVertexBindings.vertexBuffer[i] = VK_NULL_HANDLE;
 
@@ -103,6 +106,8 @@ VkResult CommandBuffer::begin(VkCommandBufferUsageFlags flags, CommandBuffer* pr
         //Copiying state of the parent cmd
         m_ResourceBindingState = primary_cmd_buf->m_ResourceBindingState;
         m_PipelineState = primary_cmd_buf->m_PipelineState;
+        m_ExternalDescriptorSets = primary_cmd_buf->m_ExternalDescriptorSets;
+        m_ResourceBindingState.forceDirty();//Descriptor sets aren't inherited, the primary may have flushed these already
 
 
         inheritance.renderPass = m_CurrentRenderPass.render_pass->getHandle();
@@ -142,23 +147,10 @@ void CommandBuffer::beginRenderPass(const RenderTarget& render_target, const std
    m_PipelineState.reset();
    m_ResourceBindingState.reset();
    m_DescriptorSet_Binding_State.clear();
+   m_ExternalDescriptorSets.clear();
+   m_ExternalSetsLayout = VK_NULL_HANDLE;
 
-   std::vector<SubpassInfo> subpass_infos(subpasses.size());
-
-
-   auto subpass_info_it = subpass_infos.begin();
-   for (auto& subpass : subpasses)
-   {
-       subpass_info_it->input_attachments = subpass->getInputAttachments();
-       subpass_info_it->output_attachments = subpass->getOutputAttachments();
-       //subpass_info_it->color_resolve_attachments = subpass->get_color_resolve_attachments();
-       subpass_info_it->m_DisableDepthAttachment = subpass->getDisableDepthAttachment();
-       //subpass_info_it->depth_stencil_resolve_mode = subpass->get_depth_stencil_resolve_mode();
-       //subpass_info_it->depth_stencil_resolve_attachment = subpass->get_depth_stencil_resolve_attachment();
-
-       ++subpass_info_it;
-   }
-
+   std::vector<SubpassInfo> subpass_infos = getSubpassInfos(subpasses);
    
    m_CurrentRenderPass.render_pass = &(m_Pool.getDevice().getResourcesCache().request_render_pass(render_target.getAttachments(), load_store_infos, subpass_infos));
    m_CurrentRenderPass.framebuffer = &(m_Pool.getDevice().getResourcesCache().request_framebuffer(render_target, *m_CurrentRenderPass.render_pass));
@@ -187,6 +179,25 @@ void CommandBuffer::endRenderPass()
     vkCmdEndRenderPass(m_CommandBuffer);
 }
 
+std::vector<SubpassInfo> CommandBuffer::getSubpassInfos(const std::vector<std::unique_ptr<Subpass>>& subpasses)
+{
+    std::vector<SubpassInfo> subpass_infos(subpasses.size());
+
+    auto subpass_info_it = subpass_infos.begin();
+    for (auto& subpass : subpasses)
+    {
+        subpass_info_it->input_attachments = subpass->getInputAttachments();
+        subpass_info_it->output_attachments = subpass->getOutputAttachments();
+        //subpass_info_it->color_resolve_attachments = subpass->get_color_resolve_attachments();
+        subpass_info_it->m_DisableDepthAttachment = subpass->getDisableDepthAttachment();
+        //subpass_info_it->depth_stencil_resolve_mode = subpass->get_depth_stencil_resolve_mode();
+        //subpass_info_it->depth_stencil_resolve_attachment = subpass->get_depth_stencil_resolve_attachment();
+
+        ++subpass_info_it;
+    }
+    return subpass_infos;
+}
+
 void CommandBuffer::nextSubpass(VkSubpassContents contents)
 {
 
@@ -281,6 +292,15 @@ void CommandBuffer::draw_indexed(uint32_t index_count, uint32_t instance_count,
     vkCmdDrawIndexed(m_CommandBuffer, index_count, instance_count, first_index, vertex_offset, first_instance);
 }
 
+void CommandBuffer::draw_indexed_indirect(const VulkanBuffer& buffer, VkDeviceSize offset, uint32_t draw_count, uint32_t stride)
+{
+    flushPipelineState();
+
+    flushDescriptorState();
+
+    vkCmdDrawIndexedIndirect(m_CommandBuffer, buffer.getHandle(), offset, draw_count, stride);
+}
+
 
 void CommandBuffer::bindPipelineLayout(PipelineLayout& pipeline_layout)
 {
@@ -362,6 +382,11 @@ void CommandBuffer::copy_buffer_to_image(const VulkanBuffer& buffer, const Vulka
         regions.size(), regions.data());
 }
 
+void CommandBuffer::copy_buffer(const VulkanBuffer& src_buffer, const VulkanBuffer& dst_buffer, const std::vector<VkBufferCopy>& regions)
+{
+    vkCmdCopyBuffer(getHandle(), src_buffer.getHandle(), dst_buffer.getHandle(), regions.size(), regions.data());
+}
+
 void CommandBuffer::bind_vertex_buffer(uint32_t first_binding, const VulkanBuffer& buffer, const std::vector<VkDeviceSize>& offsets)
 {
     assert(first_binding < 10, "Fixed array of 10 for now, this will break!");
@@ -381,10 +406,11 @@ void CommandBuffer::bind_vertex_buffer(uint32_t first_binding, const VulkanBuffe
 
 void CommandBuffer::bind_index_buffer(VulkanBuffer& buffer, VkDeviceSize offset, VkIndexType index_type)
 {
-    if (m_CurrentVertexBindings.indexBuffer != buffer.getHandle())
+    if (m_CurrentVertexBindings.indexBuffer != buffer.getHandle() || m_CurrentVertexBindings.indexType != index_type)
     {
         vkCmdBindIndexBuffer(getHandle(), buffer.getHandle(), offset, index_type);
         m_CurrentVertexBindings.indexBuffer = buffer.getHandle();
+        m_CurrentVertexBindings.indexType = index_type;
     }
    
 }
@@ -393,6 +419,12 @@ void CommandBuffer::bind_image(const VulkanImageView& image_view, const VulkanSa
     m_ResourceBindingState.bind_image(image_view, sampler, set, binding, array_element);
 }
 
+void CommandBuffer::bind_descriptor_set(uint32_t set, VkDescriptorSet descriptor_set)
+{
+    m_ExternalDescriptorSets[set] = descriptor_set;
+    m_ExternalSetsLayout = VK_NULL_HANDLE;
+}
+
 void CommandBuffer::bind_input(const VulkanImageView& image_view, uint32_t set, uint32_t binding, uint32_t array_element)
 {
     m_ResourceBindingState.bind_input(image_view, set, binding, array_element);
@@ -471,7 +503,7 @@ void CommandBuffer::flushDescriptorState()
                 continue;
 
             // Make descriptor set layout bound for current set
-            m_DescriptorSetLayout_BindingState[descriptor_set_id] = &descriptor_set_layout;
+            m_DescriptorSet_Binding_State[descriptor_set_id] = &descriptor_set_layout;
 
             BindingMap<VkDescriptorBufferInfo> buffer_infos;
             BindingMap<VkDescriptorImageInfo>  image_infos;
@@ -585,6 +617,17 @@ void CommandBuffer::flushDescriptorState()
                 dynamic_offsets.data());
         }
     }
-    
+
+    // Sets written elsewhere only need binding again when the pipeline layout changes
+    if (!m_ExternalDescriptorSets.empty() && m_ExternalSetsLayout != pipeline_layout.getHandle())
+    {
+        m_ExternalSetsLayout = pipeline_layout.getHandle();
+        for (auto& set_it : m_ExternalDescriptorSets)
+        {
+            if (!pipeline_layout.hasDescriptorSetLayout(set_it.first))
+                continue;
+            vkCmdBindDescriptorSets(m_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout.getHandle(), set_it.first, 1, &set_it.second, 0, nullptr);
+        }
+    }
 }
 
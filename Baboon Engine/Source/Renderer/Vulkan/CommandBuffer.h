@@ -40,6 +40,7 @@ struct VertexBufferBinding
 {   
     VkBuffer vertexBuffer[10];
     VkBuffer indexBuffer;
+    VkIndexType indexType;//16 and 32 bit ranges share the arena index buffer, so the type has to be tracked too
 };
 
 class VulkanBuffer;
@@ -71,6 +72,8 @@ public:
 
     void beginRenderPass(const RenderTarget& render_target, const std::vector<LoadStoreInfo>& load_store_infos, const std::vector<VkClearValue>& clear_values, const std::vector<std::unique_ptr<Subpass>>& subpasses, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
     void endRenderPass();
+    //What the render pass of beginRenderPass is requested with for these subpasses
+    static std::vector<SubpassInfo> getSubpassInfos(const std::vector<std::unique_ptr<Subpass>>& subpasses);
 
     void nextSubpass(VkSubpassContents contents);
 
@@ -86,6 +89,7 @@ public:
 
     void draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance);
     void draw_indexed(uint32_t index_count, uint32_t instance_count, uint32_t first_index, int32_t vertex_offset, uint32_t first_instance);
+    void draw_indexed_indirect(const VulkanBuffer& buffer, VkDeviceSize offset, uint32_t draw_count, uint32_t stride);
 
     void bind_vertex_buffer(uint32_t first_binding, const VulkanBuffer& buffer, const std::vector<VkDeviceSize>& offsets);
    
@@ -98,8 +102,12 @@ public:
 
     void bind_input(const VulkanImageView& image_view, uint32_t set, uint32_t binding, uint32_t array_element);
 
+    //Descriptor set allocated and written by its owner (the bindless textures), bound as is instead of going through the resource binding state
+    void bind_descriptor_set(uint32_t set, VkDescriptorSet descriptor_set);
+
 
     void copy_buffer_to_image(const VulkanBuffer& buffer, const VulkanImage& image, const std::vector<VkBufferImageCopy>& regions);
+    void copy_buffer(const VulkanBuffer& src_buffer, const VulkanBuffer& dst_buffer, const std::vector<VkBufferCopy>& regions);
 
 
     void bindPipelineLayout(PipelineLayout& pipeline_layout);
@@ -109,6 +117,8 @@ public:
     inline void setRasterState(const RasterizationState& state_info) { m_PipelineState.setRasterizationState(state_info); }
     inline void setDepthStencilState(const DepthStencilState& state_info) { m_PipelineState.setDepthStencilState(state_info); }
     inline void setInputAssemblyState(const InputAssemblyState& state_info) { m_PipelineState.setInputAssemblyState(state_info); }
+    template <class T>
+    inline void setSpecializationConstant(uint32_t constant_id, const T& data) { m_PipelineState.setSpecializationConstant(constant_id, data); }//After bindPipelineLayout, which drops the constants of the previous layout
 
     inline const ColorBlendState& getColorBlendState() { return m_PipelineState.getColorBlendState(); }
     inline const RasterizationState& getRasterState( ) { return m_PipelineState.getRasterizationState(); }
@@ -143,11 +153,12 @@ private:
     State m_State{ State::Initial };
     PipelineState m_PipelineState;
     ResourceBindingState m_ResourceBindingState;//Buffers and textures bindings
-    std::unordered_map<uint32_t, DescriptorSetLayout*> m_DescriptorSetLayout_BindingState;
     RenderPassBinding m_CurrentRenderPass{ NULL,NULL };
 
     VertexBufferBinding m_CurrentVertexBindings{ VK_NULL_HANDLE,VK_NULL_HANDLE };
     std::unordered_map<uint32_t, DescriptorSetLayout*> m_DescriptorSet_Binding_State;
+    std::unordered_map<uint32_t, VkDescriptorSet> m_ExternalDescriptorSets;
+    VkPipelineLayout m_ExternalSetsLayout{ VK_NULL_HANDLE };//Pipeline layout they were last bound with
 
     std::vector<VkViewport> m_Viewports;
     std::vector<VkRect2D> m_Scissors;
@@ -4,9 +4,69 @@
 #include <set>
 #include "Core\ServiceLocator.h"
 #include "CommandPool.h"
+#include "BindlessTextures.h"
+#include <filesystem>
+#include <fstream>
 
 
 
+static bool isExtensionSupported(VkPhysicalDevice physDevice, const char* extension)
+{
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physDevice, nullptr, &extensionCount, extensions.data());
+    for (auto& properties : extensions)
+    {
+        if (strcmp(properties.extensionName, extension) == 0)
+            return true;
+    }
+    return false;
+}
+
+//Header every VkPipelineCache data blob starts with (VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+struct PipelineCacheHeader
+{
+    uint32_t m_HeaderSize;
+    uint32_t m_HeaderVersion;
+    uint32_t m_VendorID;
+    uint32_t m_DeviceID;
+    uint8_t m_PipelineCacheUUID[VK_UUID_SIZE];
+};
+
+//Data saved by a previous run, empty if there is none or it was made by another gpu or driver. Drivers are supposed to
+//ignore foreign data but some don't handle it well, checking first also makes the reason of a cold start visible
+static std::vector<uint8_t> readPipelineCache(VkPhysicalDevice physDevice)
+{
+    std::vector<uint8_t> data;
+    std::ifstream file(PIPELINE_CACHE_PATH, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return data;
+    data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read((char*)data.data(), data.size());
+
+    PipelineCacheHeader header{};
+    if (!file.good() || data.size() < sizeof(header))
+    {
+        LOGERROR("Pipeline cache is corrupted, starting a cold one");
+        data.clear();
+        return data;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physDevice, &properties);
+    if (header.m_HeaderSize < sizeof(header) || header.m_HeaderVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        header.m_VendorID != properties.vendorID || header.m_DeviceID != properties.deviceID ||
+        memcmp(header.m_PipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+    {
+        LOGINFO("Pipeline cache was made by another gpu or driver, starting a cold one");
+        data.clear();
+    }
+    return data;
+}
+
 const Queue& Device::getQueueByFlags(VkQueueFlags requiredFlags, uint32_t index) const
 {
     for (uint32_t famIndex = 0; famIndex < m_Queues.size(); ++famIndex)
@@ -57,16 +117,52 @@ Device::Device(VkPhysicalDevice physDevice, VkSurfaceKHR surface, const std::vec
         createInfo.pQueuePriorities = queuePriorities[familyIndex].data();
     }
 
-    VkPhysicalDeviceFeatures deviceFeatures = {};
+    //Indirect draws fall back to a call per command (or plain draws) on gpus without these
+    VkPhysicalDeviceFeatures supportedFeatures = {};
+    vkGetPhysicalDeviceFeatures(physDevice, &supportedFeatures);
+    VkPhysicalDeviceFeatures& deviceFeatures = m_EnabledFeatures;
     deviceFeatures.geometryShader = 1;
+    deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+
+    //Bindless textures need a runtime sized, partially bound, update after bind sampler array, otherwise materials bind their textures per draw
+    std::vector<const char*> enabledExtensions = deviceExtensions;
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledIndexing{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT };
+    if (isExtensionSupported(physDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+    {
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT };
+        VkPhysicalDeviceFeatures2 supportedFeatures2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+        supportedFeatures2.pNext = &indexingFeatures;
+        vkGetPhysicalDeviceFeatures2(physDevice, &supportedFeatures2);
+
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT };
+        VkPhysicalDeviceProperties2 properties2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+        properties2.pNext = &indexingProperties;
+        vkGetPhysicalDeviceProperties2(physDevice, &properties2);
+
+        m_DescriptorIndexing = supportedFeatures.shaderSampledImageArrayDynamicIndexing && indexingFeatures.runtimeDescriptorArray && indexingFeatures.descriptorBindingPartiallyBound &&
+            indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers >= BINDLESS_MAX_TEXTURES &&
+            indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages >= BINDLESS_MAX_TEXTURES;
+    }
+    if (m_DescriptorIndexing)
+    {
+        deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;//Materials are the same over a draw, so is the index
+        enabledIndexing.runtimeDescriptorArray = VK_TRUE;
+        enabledIndexing.descriptorBindingPartiallyBound = VK_TRUE;
+        enabledIndexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    }
+
     VkDeviceCreateInfo createInfo = {};
+    createInfo.pNext = m_DescriptorIndexing ? &enabledIndexing : nullptr;
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.queueCreateInfoCount = (uint32_t)queueCreateInfos.size();
     createInfo.pEnabledFeatures = &deviceFeatures;
 
-    createInfo.enabledExtensionCount = deviceExtensions.size();
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = enabledExtensions.size();
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     if (validationLayers.size()) {
         createInfo.enabledLayerCount = validationLayers.size();
@@ -120,6 +216,20 @@ Device::Device(VkPhysicalDevice physDevice, VkSurfaceKHR surface, const std::vec
     m_CommandPool = std::make_unique<CommandPool>(*this, getQueueByFlags(VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT, 0).getFamilyIndex()); //We get the first queue with graphics and compute
     m_FencePool = std::make_unique<FencePool>(*this);
 
+    std::vector<uint8_t> pipelineCacheData = readPipelineCache(m_PhysDevice);
+    VkPipelineCacheCreateInfo pipelineCacheInfo{ VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+    pipelineCacheInfo.initialDataSize = pipelineCacheData.size();
+    pipelineCacheInfo.pInitialData = pipelineCacheData.data();
+    if (vkCreatePipelineCache(m_Handle, &pipelineCacheInfo, nullptr, &m_PipelineCache) != VK_SUCCESS)
+    {
+        LOGERROR("Cant create the pipeline cache, pipelines will be created without it");
+        m_PipelineCache = VK_NULL_HANDLE;
+    }
+    else
+    {
+        m_PipelineCacheLoadedBytes = pipelineCacheData.size();
+        LOGINFO(m_PipelineCacheLoadedBytes ? "Pipeline cache loaded: " + std::to_string(m_PipelineCacheLoadedBytes) + " bytes" : std::string("Pipeline cache starts cold"));
+    }
 }
 
 
@@ -131,6 +241,12 @@ Device::~Device()
   
     m_ResourcesCache.clear();
 
+    if (m_PipelineCache != VK_NULL_HANDLE)
+    {
+        savePipelineCache();
+        vkDestroyPipelineCache(m_Handle, m_PipelineCache, nullptr);
+    }
+
     m_CommandPool.reset();//Manually reseting the pointer here
     m_FencePool.reset();
 
@@ -168,6 +284,92 @@ const Queue& Device::getResourceTransferQueue() const
     return getQueueByFlags(VK_QUEUE_GRAPHICS_BIT, 1);
 }
 
+const Queue& Device::getTransferQueue() const
+{
+    //Transfer only families map to the copy engines, they can run uploads while the graphics queue keeps rendering
+    for (uint32_t famIndex = 0; famIndex < m_Queues.size(); ++famIndex)
+    {
+        if (m_Queues[famIndex].empty())
+            continue;
+        VkQueueFlags flags = m_Queues[famIndex][0].getProperties().queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+        {
+            return m_Queues[famIndex][0];
+        }
+    }
+    return getResourceTransferQueue();
+}
+
+void Device::savePipelineCache() const
+{
+    if (m_PipelineCache == VK_NULL_HANDLE)
+        return;
+    size_t size = 0;
+    if (vkGetPipelineCacheData(m_Handle, m_PipelineCache, &size, nullptr) != VK_SUCCESS || size == 0)
+        return;
+    std::vector<uint8_t> data(size);
+    if (vkGetPipelineCacheData(m_Handle, m_PipelineCache, &size, data.data()) != VK_SUCCESS)
+        return;
+
+    //Written to a temporary file first so a half written cache is never picked up
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(PIPELINE_CACHE_PATH).parent_path(), error);
+    std::string tempPath = std::string(PIPELINE_CACHE_PATH) + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write((const char*)data.data(), size);
+        if (!file.good())
+        {
+            LOGERROR("Failed writing pipeline cache: " PIPELINE_CACHE_PATH);
+            return;
+        }
+    }
+    std::filesystem::rename(tempPath, PIPELINE_CACHE_PATH, error);
+    if (error)
+    {
+        LOGERROR("Can't move pipeline cache in place: " PIPELINE_CACHE_PATH);
+        std::filesystem::remove(tempPath, error);
+        return;
+    }
+    LOGINFO("Pipeline cache saved: " + std::to_string(size) + " bytes");
+}
+
+static std::string memoryPropertiesToString(VkMemoryPropertyFlags flags)
+{
+    std::string result;
+    if (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+        result += "DEVICE_LOCAL ";
+    if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        result += "HOST_VISIBLE ";
+    if (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+        result += "HOST_COHERENT ";
+    if (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)
+        result += "HOST_CACHED ";
+    if (flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+        result += "LAZILY_ALLOCATED ";
+    return result.empty() ? "NONE" : result;
+}
+
+void Device::logMemoryUsage() const
+{
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(m_PhysDevice, &memProperties);
+
+    VmaStats stats;
+    vmaCalculateStats(m_MemoryAllocator, &stats);
+
+    LOGINFO("Device memory usage per memory type:");
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+    {
+        const VmaStatInfo& info = stats.memoryType[i];
+        if (info.allocationCount == 0)
+            continue;
+        LOGINFO("\tType " + std::to_string(i) + " (heap " + std::to_string(memProperties.memoryTypes[i].heapIndex) + ", " + memoryPropertiesToString(memProperties.memoryTypes[i].propertyFlags) +
+            "): " + std::to_string(info.usedBytes) + " bytes in " + std::to_string(info.allocationCount) + " allocations");
+    }
+    LOGINFO("\tTotal: " + std::to_string(stats.total.usedBytes) + " bytes");
+}
+
 VkResult Device::wait_idle()const
 {
   return vkDeviceWaitIdle(m_Handle);
@@ -8,6 +8,8 @@
 #include <memory>
 #include "VulkanResources.h"
 
+#define PIPELINE_CACHE_PATH "./ShaderCache/pipelines.bbpso" //Next to the ShaderCache entries, the VkPipelineCache data of the last run
+
 
 class Device
 {
@@ -23,10 +25,18 @@ public:
     Device(Device&&) = delete;
     const Queue& getGraphicsQueue() const;
     const Queue& getResourceTransferQueue() const;
+    const Queue& getTransferQueue() const;//Dedicated transfer family queue if the gpu has one, resource transfer queue otherwise
     inline VkPhysicalDevice Device::get_physical_device() const{ return m_PhysDevice; }
     VkResult wait_idle() const;
+    void logMemoryUsage() const;//Bytes allocated per memory type, to check buffers and images end up where we expect
+    const VkPhysicalDeviceFeatures& getEnabledFeatures() const { return m_EnabledFeatures; }
+    bool isDescriptorIndexingEnabled() const { return m_DescriptorIndexing; }//Runtime sampler arrays, partially bound and update after bind
 
     inline VulkanResources& getResourcesCache() { return m_ResourcesCache; }
+    VkPipelineCache getPipelineCache() const { return m_PipelineCache; }
+    bool isPipelineCacheWarm() const { return m_PipelineCacheLoadedBytes > 0; }//Started from the data of a previous run
+    size_t getPipelineCacheLoadedBytes() const { return m_PipelineCacheLoadedBytes; }
+    void savePipelineCache() const;//Also done on destruction, call it whenever a batch of pipelines got created
     const inline VmaAllocator& getMemoryAllocator() const { return m_MemoryAllocator; }
 
     CommandBuffer& Device::requestCommandBuffer() { return m_CommandPool->request_command_buffer(); }
@@ -50,6 +60,10 @@ private:
     std::unique_ptr<FencePool> m_FencePool;
 
     VulkanResources m_ResourcesCache;
+    VkPipelineCache m_PipelineCache{ VK_NULL_HANDLE };
+    size_t m_PipelineCacheLoadedBytes{ 0 };
     VmaAllocator m_MemoryAllocator{ VK_NULL_HANDLE };
+    VkPhysicalDeviceFeatures m_EnabledFeatures{};
+    bool m_DescriptorIndexing{ false };
 
 };
\ No newline at end of file
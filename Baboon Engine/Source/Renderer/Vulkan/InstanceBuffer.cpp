@@ -0,0 +1,67 @@
+#include "InstanceBuffer.h"
+#include "VulkanBuffer.h"
+#include "Device.h"
+#include "Core/Scene.h"
+#include "Core/Model.h"
+#include <algorithm>
+
+InstanceBuffer::InstanceBuffer(Device& device) :
+    m_Device(device)
+{
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+}
+
+void InstanceBuffer::update(Scene& scene)
+{
+    const RenderQueue* queues[3] = { &scene.GetOpaqueQueue(), &scene.GetTransparentQueue(), &scene.GetShadowQueue() };
+    uint32_t nInstances = 0;
+    for (uint32_t pass = 0; pass < 3; pass++)
+    {
+        m_FirstInstance[pass] = nInstances;
+        nInstances += scene.IsInit() ? queues[pass]->size() : 0;
+    }
+
+    //Never empty, the subpasses bind it even when there is nothing to draw
+    if (!m_Buffer || nInstances > m_Capacity)
+    {
+        m_Capacity = (std::max)(1u, nInstances + nInstances / 2);
+        m_Buffer = std::make_unique<VulkanBuffer>(m_Device, (VkDeviceSize)m_Capacity * sizeof(InstanceUBO), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        m_IndirectBuffer = std::make_unique<VulkanBuffer>(m_Device, (VkDeviceSize)m_Capacity * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        m_IndirectCommands = (VkDrawIndexedIndirectCommand*)m_IndirectBuffer->map();
+    }
+    if (nInstances == 0)
+        return;
+
+    InstanceUBO* instances = (InstanceUBO*)m_Buffer->map();
+    const ModelStore& models = scene.GetModelStore();
+    const glm::mat4* worldMatrices = models.getWorldMatrices();
+    const uint32_t* materials = models.getMaterialIndices();
+    for (uint32_t pass = 0; pass < 3; pass++)
+    {
+        InstanceUBO* passInstances = instances + m_FirstInstance[pass];
+        for (const RenderQueueItem& item : queues[pass]->getItems())
+        {
+            const PositionDequantization dequantization = Mesh::GetPositionDequantization(models.getDrawView(item.m_Model).m_View);
+            passInstances->model = worldMatrices[item.m_Model];
+            passInstances->positionOffset = dequantization.m_Offset;
+            passInstances->positionScale = dequantization.m_Scale;
+            passInstances->info = glm::vec4(static_cast<float>(materials[item.m_Model]), 0.0f, 0.0f, 0.0f);
+            passInstances++;
+        }
+    }
+    m_Buffer->flush();
+}
+
+VkDeviceSize InstanceBuffer::getSize() const
+{
+    return (VkDeviceSize)m_Capacity * sizeof(InstanceUBO);
+}
+
+void InstanceBuffer::flushIndirectCommands() const
+{
+    if (m_IndirectBuffer)
+        m_IndirectBuffer->flush();
+}
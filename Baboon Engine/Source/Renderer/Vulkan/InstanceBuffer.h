@@ -0,0 +1,48 @@
+#pragma once
+#include "Common.h"
+#include "Core/RenderQueue.h"
+#include <memory>
+
+class Device;
+class VulkanBuffer;
+class Scene;
+
+#define INSTANCE_BUFFER_BINDING 7 //Set 0 binding of the instance data in geo.vert, transparent.vert and shadow.vert
+
+/**
+ * @brief Per draw data of every queued model plus room for the indirect commands drawing them, host visible, one per frame
+ *
+ * The opaque, transparent and shadow queues are written one after the other in queue order, so item i of a queue reads its
+ * InstanceUBO (world matrix, mesh view dequantization, material) at getFirstInstance(pass) + i. Consecutive items sharing
+ * state and mesh view become a single draw with that many instances, the vertex shaders pick their data with gl_InstanceIndex.
+ * The indirect buffer has one VkDrawIndexedIndirectCommand slot per item with the same numbering, filled by the subpasses
+ * while recording (a run never takes more commands than items, so every range of the queue writes its own slots only).
+ */
+class InstanceBuffer
+{
+public:
+    InstanceBuffer(Device& device);
+    ~InstanceBuffer();
+
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+    //Rewrites the instance data, only call it once the frame fence has been waited on
+    void update(Scene& scene);
+
+    uint32_t getFirstInstance(RenderQueuePass i_Pass) const { return m_FirstInstance[static_cast<uint32_t>(i_Pass)]; }
+    VulkanBuffer* getBuffer() const { return m_Buffer.get(); }
+    VkDeviceSize getSize() const;//Bytes to bind, the whole buffer
+
+    VulkanBuffer* getIndirectBuffer() const { return m_IndirectBuffer.get(); }
+    VkDrawIndexedIndirectCommand* getIndirectCommands() const { return m_IndirectCommands; }
+    void flushIndirectCommands() const;//Once the subpass writing them is done recording
+
+private:
+    Device& m_Device;
+    std::unique_ptr<VulkanBuffer> m_Buffer;
+    std::unique_ptr<VulkanBuffer> m_IndirectBuffer;
+    VkDrawIndexedIndirectCommand* m_IndirectCommands{ nullptr };//Mapped once here, recording threads write through it
+    uint32_t m_Capacity{ 0 };//In instances, same for the indirect commands
+    uint32_t m_FirstInstance[3]{};//By RenderQueuePass
+};
@@ -0,0 +1,174 @@
+#include "LightClusters.h"
+#include "VulkanBuffer.h"
+#include "Device.h"
+#include "Core/Scene.h"
+#include "Cameras/Camera.h"
+#include <cstring>
+#include <cfloat>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+//Slice of a view depth, the inverse of near * (far / near)^(slice / LIGHT_GRID_SLICES)
+static uint32_t getSlice(float i_Depth, float i_SliceScale, float i_SliceBias)
+{
+    const int slice = static_cast<int>(std::floor(std::log(i_Depth) * i_SliceScale + i_SliceBias));
+    return static_cast<uint32_t>((std::min)((std::max)(slice, 0), LIGHT_GRID_SLICES - 1));
+}
+
+static uint32_t getTile(float i_Ndc, uint32_t i_NTiles)
+{
+    const int tile = static_cast<int>(std::floor((i_Ndc * 0.5f + 0.5f) * i_NTiles));
+    return static_cast<uint32_t>((std::min)((std::max)(tile, 0), static_cast<int>(i_NTiles) - 1));
+}
+
+LightClusters::LightClusters(Device& device) :
+    m_Device(device)
+{
+    m_GridBuffer = std::make_unique<VulkanBuffer>(m_Device, getGridBufferSize(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+}
+
+LightClusters::~LightClusters()
+{
+}
+
+void LightClusters::update(Scene& scene, const Camera& camera, VkExtent2D extent)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    m_Stats = LightClusterStats();
+
+    static const std::vector<Light> noLights;
+    const std::vector<Light>& pointLights = scene.IsInit() ? scene.getPointLights() : noLights;
+    const std::vector<Light>& spotLights = scene.IsInit() ? scene.getSpotLights() : noLights;
+    const uint32_t nPointLights = static_cast<uint32_t>(pointLights.size());
+    const uint32_t nLights = nPointLights + static_cast<uint32_t>(spotLights.size());
+    m_Stats.m_Lights = nLights;
+
+    //Never empty, the subpasses bind them even when there are no lights
+    if (!m_LightBuffer || nLights > m_LightCapacity)
+    {
+        m_LightCapacity = (std::max)(1u, nLights + nLights / 2);
+        m_LightBuffer = std::make_unique<VulkanBuffer>(m_Device, getLightBufferSize(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        m_Reallocated = true;
+    }
+    uint8_t* lightData = m_LightBuffer->map();
+    LightBufferHeader lightHeader;
+    lightHeader.m_Counts = glm::uvec4(nPointLights, nLights - nPointLights, 0, 0);
+    memcpy(lightData, &lightHeader, sizeof(LightBufferHeader));
+    Light* lights = (Light*)(lightData + sizeof(LightBufferHeader));
+    if (!pointLights.empty())
+        memcpy(lights, pointLights.data(), pointLights.size() * sizeof(Light));
+    if (!spotLights.empty())
+        memcpy(lights + nPointLights, spotLights.data(), spotLights.size() * sizeof(Light));
+    m_LightBuffer->flush();
+
+    //Exponential slices, slice = log(depth / near) * slices / log(far / near)
+    const float nearPlane = camera.GetNear();
+    const float farPlane = camera.GetFar();
+    const float sliceScale = LIGHT_GRID_SLICES / std::log(farPlane / nearPlane);
+    const float sliceBias = -std::log(nearPlane) * sliceScale;
+    LightGridHeader gridHeader;
+    gridHeader.m_Grid = glm::vec4(LIGHT_GRID_TILES_X / (float)(std::max)(1u, extent.width), LIGHT_GRID_TILES_Y / (float)(std::max)(1u, extent.height), sliceScale, sliceBias);
+    gridHeader.m_GridSize = glm::uvec4(LIGHT_GRID_TILES_X, LIGHT_GRID_TILES_Y, LIGHT_GRID_SLICES, 0);
+
+    //Cluster range of every light, counting the lights of every cluster on the way
+    const glm::mat4& view = camera.GetViewMatrix();
+    const glm::mat4& proj = camera.GetProjMatrix();
+    m_Bounds.resize(nLights);
+    m_ClusterCursors.assign(LIGHT_GRID_CLUSTERS, 0);
+    for (uint32_t light = 0; light < nLights; light++)
+    {
+        LightBounds& bounds = m_Bounds[light];
+        const glm::vec4& lightPos = lights[light].lightPos;
+        const glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(lightPos), 1.0f));
+        const float radius = lightPos.w;
+        const float minDepth = -center.z - radius;
+        const float maxDepth = -center.z + radius;
+        bounds.m_Visible = radius > 0.0f && maxDepth >= nearPlane && minDepth <= farPlane;
+        if (!bounds.m_Visible)
+            continue;
+
+        glm::vec2 ndcMin(-1.0f);
+        glm::vec2 ndcMax(1.0f);
+        if (minDepth > nearPlane)//Every corner in front of the camera, otherwise the light covers the whole screen
+        {
+            ndcMin = glm::vec2(FLT_MAX);
+            ndcMax = glm::vec2(-FLT_MAX);
+            for (uint32_t corner = 0; corner < 8; corner++)
+            {
+                const glm::vec3 offset((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius, (corner & 4) ? radius : -radius);
+                const glm::vec4 clip = proj * glm::vec4(center + offset, 1.0f);
+                const glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                ndcMin = glm::min(ndcMin, ndc);
+                ndcMax = glm::max(ndcMax, ndc);
+            }
+            bounds.m_Visible = ndcMax.x >= -1.0f && ndcMin.x <= 1.0f && ndcMax.y >= -1.0f && ndcMin.y <= 1.0f;
+            if (!bounds.m_Visible)
+                continue;
+        }
+        bounds.m_Min = glm::uvec3(getTile(ndcMin.x, LIGHT_GRID_TILES_X), getTile(ndcMin.y, LIGHT_GRID_TILES_Y), getSlice((std::max)(minDepth, nearPlane), sliceScale, sliceBias));
+        bounds.m_Max = glm::uvec3(getTile(ndcMax.x, LIGHT_GRID_TILES_X), getTile(ndcMax.y, LIGHT_GRID_TILES_Y), getSlice((std::min)(maxDepth, farPlane), sliceScale, sliceBias));
+        m_Stats.m_BinnedLights++;
+
+        for (uint32_t z = bounds.m_Min.z; z <= bounds.m_Max.z; z++)
+            for (uint32_t y = bounds.m_Min.y; y <= bounds.m_Max.y; y++)
+                for (uint32_t x = bounds.m_Min.x; x <= bounds.m_Max.x; x++)
+                    m_ClusterCursors[(z * LIGHT_GRID_TILES_Y + y) * LIGHT_GRID_TILES_X + x]++;
+    }
+
+    //Prefix sum, every cluster gets its range of the index list and the cursors start at the front of it
+    uint8_t* gridData = m_GridBuffer->map();
+    memcpy(gridData, &gridHeader, sizeof(LightGridHeader));
+    glm::uvec2* clusters = (glm::uvec2*)(gridData + sizeof(LightGridHeader));
+    uint32_t nIndices = 0;
+    for (uint32_t cluster = 0; cluster < LIGHT_GRID_CLUSTERS; cluster++)
+    {
+        const uint32_t count = m_ClusterCursors[cluster];
+        clusters[cluster] = glm::uvec2(nIndices, count);
+        m_ClusterCursors[cluster] = nIndices;
+        m_Stats.m_MaxClusterLights = (std::max)(m_Stats.m_MaxClusterLights, count);
+        nIndices += count;
+    }
+    m_GridBuffer->flush();
+    m_Stats.m_Indices = nIndices;
+
+    if (!m_IndexBuffer || nIndices > m_IndexCapacity)
+    {
+        m_IndexCapacity = (std::max)(1u, nIndices + nIndices / 2);
+        m_IndexBuffer = std::make_unique<VulkanBuffer>(m_Device, getIndexBufferSize(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        m_Reallocated = true;
+    }
+    if (nIndices > 0)
+    {
+        //Lights go in increasing order within a cluster, so the point lights of a cluster come before its spot lights
+        uint32_t* indices = (uint32_t*)m_IndexBuffer->map();
+        for (uint32_t light = 0; light < nLights; light++)
+        {
+            const LightBounds& bounds = m_Bounds[light];
+            if (!bounds.m_Visible)
+                continue;
+            for (uint32_t z = bounds.m_Min.z; z <= bounds.m_Max.z; z++)
+                for (uint32_t y = bounds.m_Min.y; y <= bounds.m_Max.y; y++)
+                    for (uint32_t x = bounds.m_Min.x; x <= bounds.m_Max.x; x++)
+                        indices[m_ClusterCursors[(z * LIGHT_GRID_TILES_Y + y) * LIGHT_GRID_TILES_X + x]++] = light;
+        }
+        m_IndexBuffer->flush();
+    }
+
+    m_Stats.m_BinMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+VkDeviceSize LightClusters::getLightBufferSize() const
+{
+    return sizeof(LightBufferHeader) + (VkDeviceSize)m_LightCapacity * sizeof(Light);
+}
+
+VkDeviceSize LightClusters::getGridBufferSize() const
+{
+    return sizeof(LightGridHeader) + (VkDeviceSize)LIGHT_GRID_CLUSTERS * sizeof(glm::uvec2);
+}
+
+VkDeviceSize LightClusters::getIndexBufferSize() const
+{
+    return (VkDeviceSize)m_IndexCapacity * sizeof(uint32_t);
+}
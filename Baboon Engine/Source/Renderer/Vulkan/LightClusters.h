@@ -0,0 +1,93 @@
+#pragma once
+#include "Common.h"
+#include "Renderer/Common/GLMInclude.h"
+#include <memory>
+#include <vector>
+
+class Device;
+class VulkanBuffer;
+class Scene;
+class Camera;
+
+#define LIGHT_GRID_TILES_X 16 //Screen tiles of the cluster grid, about 16:9 so clusters stay close to square
+#define LIGHT_GRID_TILES_Y 9
+#define LIGHT_GRID_SLICES 24 //Depth slices, exponentially spaced between the camera near and far planes
+#define LIGHT_GRID_CLUSTERS (LIGHT_GRID_TILES_X * LIGHT_GRID_TILES_Y * LIGHT_GRID_SLICES)
+
+#define LIGHT_CLUSTERS_BINDING 8 //Set 0 bindings of the lights (this one), the cluster grid (+1) and the light indices (+2), light.frag and transparent.frag
+
+//Same layout as the ClusteredLights buffer, followed by the point lights and then the spot lights
+struct LightBufferHeader
+{
+    glm::uvec4 m_Counts;//x point lights, y spot lights
+};
+
+//Same layout as the LightClusters buffer, followed by one (first index, light count) pair per cluster
+struct LightGridHeader
+{
+    glm::vec4 m_Grid;//x, y tiles per pixel, z, w slice scale and bias over log(view depth)
+    glm::uvec4 m_GridSize;//Tiles x, y and slices
+};
+
+struct LightClusterStats
+{
+    uint32_t m_Lights = 0;
+    uint32_t m_BinnedLights = 0;//Touching at least one cluster
+    uint32_t m_Indices = 0;
+    uint32_t m_MaxClusterLights = 0;
+    float m_BinMicroseconds = 0.0f;
+};
+
+/**
+ * @brief Per frame clustered light culling against the main camera, on the cpu
+ *
+ * The view frustum is split in LIGHT_GRID_TILES_X x LIGHT_GRID_TILES_Y screen tiles and LIGHT_GRID_SLICES depth slices.
+ * Every point and spot light is a sphere of its radius, binned into the clusters its view space box covers: the depth slices
+ * from its nearest and farthest depth, the tiles from the projected corners of the box (the whole screen when it crosses
+ * the near plane). Clusters get their lights as a range of one flat index list, counted first then filled, so the shading
+ * passes loop over the few lights of the cluster of each pixel instead of over every light of the scene.
+ */
+class LightClusters
+{
+public:
+    LightClusters(Device& device);
+    ~LightClusters();
+
+    LightClusters(const LightClusters&) = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+    //Rewrites the lights, grid and indices, only call it once the frame fence has been waited on
+    void update(Scene& scene, const Camera& camera, VkExtent2D extent);
+
+    VulkanBuffer* getLightBuffer() const { return m_LightBuffer.get(); }
+    VkDeviceSize getLightBufferSize() const;
+    VulkanBuffer* getGridBuffer() const { return m_GridBuffer.get(); }
+    VkDeviceSize getGridBufferSize() const;
+    VulkanBuffer* getIndexBuffer() const { return m_IndexBuffer.get(); }
+    VkDeviceSize getIndexBufferSize() const;
+
+    const LightClusterStats& getStats() const { return m_Stats; }
+
+    //True once after an update that had to grow a buffer, commands recorded with the old one have to be recorded again
+    bool takeReallocated() { const bool reallocated = m_Reallocated; m_Reallocated = false; return reallocated; }
+
+private:
+    //Inclusive cluster coordinates a light touches
+    struct LightBounds
+    {
+        glm::uvec3 m_Min;
+        glm::uvec3 m_Max;
+        bool m_Visible;
+    };
+
+    Device& m_Device;
+    std::unique_ptr<VulkanBuffer> m_LightBuffer;
+    std::unique_ptr<VulkanBuffer> m_GridBuffer;
+    std::unique_ptr<VulkanBuffer> m_IndexBuffer;
+    uint32_t m_LightCapacity{ 0 };
+    uint32_t m_IndexCapacity{ 0 };
+    bool m_Reallocated{ false };
+    std::vector<LightBounds> m_Bounds;//By light, scratch
+    std::vector<uint32_t> m_ClusterCursors;//By cluster, scratch
+    LightClusterStats m_Stats;
+};
@@ -78,7 +78,7 @@ void PipelineState::reset()
     clearDirty();
     m_PipelineLayout = nullptr;
     m_RenderPass = nullptr;
-    //specialization_constantState.reset();
+    m_SpecializationConstantState.reset();
     m_VertexInputState = {};
     m_InputAssemblyState = {};
     m_RasterizationState = {};
@@ -95,6 +95,7 @@ void PipelineState::setPipelineLayout(PipelineLayout& pipeline_layout)
         if (m_PipelineLayout->getHandle() != pipeline_layout.getHandle())
         {
             m_PipelineLayout = &pipeline_layout;
+            m_SpecializationConstantState.reset();//Constants belong to the shaders of the layout, the new ones set their own
             m_Dirty = true;
         }
     }
@@ -124,17 +125,35 @@ void PipelineState::setRenderPass(const RenderPass& new_render_pass)
     }
 }
 
-/*
-void PipelineState::set_specialization_constant(uint32_t constant_id, const std::vector<uint8_t>& data)
+void SpecializationConstantState::reset()
 {
-    specialization_constantState.set_constant(constant_id, data);
+    m_State.clear();
+    m_Dirty = false;
+}
+
+bool SpecializationConstantState::isDirty() const
+{
+    return m_Dirty;
+}
 
-    if (specialization_constantState.is_dirty())
+void SpecializationConstantState::clearDirty()
+{
+    m_Dirty = false;
+}
+
+void SpecializationConstantState::setConstant(uint32_t constant_id, const std::vector<uint8_t>& value)
+{
+    auto data = m_State.find(constant_id);
+
+    if (data != m_State.end() && data->second == value)
     {
-        dirty = true;
+        return;
     }
+
+    m_Dirty = true;
+
+    m_State[constant_id] = value;
 }
-*/
 
 
 
@@ -231,12 +250,6 @@ const RenderPass* PipelineState::getrender_pass() const
 {
     return render_pass;
 }*/
-/*
-const SpecializationConstantState& PipelineState::getspecialization_constantState() const
-{
-    return specialization_constantState;
-}
-*/
 const VertexInputState& PipelineState::getVertexInputState() const
 {
     return m_VertexInputState;
@@ -279,11 +292,11 @@ uint32_t PipelineState::getSubpassIndex() const
 
 bool PipelineState::isDirty() const
 {
-    return m_Dirty;//|| specialization_constantState.is_dirty();
+    return m_Dirty || m_SpecializationConstantState.isDirty();
 }
 
 void PipelineState::clearDirty()
 {
     m_Dirty = false;
-    //specialization_constantState.clear_dirty();
+    m_SpecializationConstantState.clearDirty();
 }
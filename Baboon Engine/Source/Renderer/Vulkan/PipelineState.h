@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <map>
 
 #include "Common.h"
 
@@ -85,51 +86,39 @@ struct ColorBlendState
     std::vector<ColorBlendAttachmentState> m_Attachments;
 };
 
-/*
 /// Helper class to create specialization constants for a Vulkan pipeline. The state tracks a pipeline globally, and not per shader. Two shaders using the same constant_id will have the same data.
+/// Constants are 32 bit (bool, int and uint in glsl), so one spirv module serves every combination and only the pipelines are specialized
 class SpecializationConstantState
 {
 public:
     void reset();
 
-    bool is_dirty() const;
+    bool isDirty() const;
 
-    void clear_dirty();
+    void clearDirty();
 
     template <class T>
-    void setconstant(uint32_t constant_id, const T& data);
-
-    void setconstant(uint32_t constant_id, const std::vector<uint8_t>& data);
+    void setConstant(uint32_t constant_id, const T& data);
 
-    void setspecialization_constantState(const std::map<uint32_t, std::vector<uint8_t>>& state);
+    void setConstant(uint32_t constant_id, const std::vector<uint8_t>& data);
 
-    const std::map<uint32_t, std::vector<uint8_t>>& getspecialization_constantState() const;
+    const std::map<uint32_t, std::vector<uint8_t>>& getState() const { return m_State; }
 
 private:
-    bool dirty{ false };
+    bool m_Dirty{ false };
     // Map tracking state of the Specialization Constants
-    std::map<uint32_t, std::vector<uint8_t>> specialization_constantState;
+    std::map<uint32_t, std::vector<uint8_t>> m_State;
 };
 
 template <class T>
-inline void SpecializationConstantState::setconstant(std::uint32_t constant_id, const T& data)
-{
-    std::uint32_t value = static_cast<std::uint32_t>(data);
-
-    setconstant(constant_id,
-        { reinterpret_cast<const uint8_t*>(&value),
-         reinterpret_cast<const uint8_t*>(&value) + sizeof(T) });
-}
-
-template <>
-inline void SpecializationConstantState::setconstant<bool>(std::uint32_t constant_id, const bool& data_)
+inline void SpecializationConstantState::setConstant(std::uint32_t constant_id, const T& data)
 {
-    std::uint32_t value = static_cast<std::uint32_t>(data_);
+    std::uint32_t value = static_cast<std::uint32_t>(data);//VkBool32 for bools, glsl constants are never narrower
 
-    setconstant(constant_id,
+    setConstant(constant_id,
         { reinterpret_cast<const uint8_t*>(&value),
          reinterpret_cast<const uint8_t*>(&value) + sizeof(std::uint32_t) });
-}*/
+}
 
 class PipelineLayout;
 class RenderPass;
@@ -142,7 +131,8 @@ public:
 
     void setRenderPass(const RenderPass& render_pass);
 
-   // void setSpecializationConstant(uint32_t constant_id, const std::vector<uint8_t>& data);
+    template <class T>
+    void setSpecializationConstant(uint32_t constant_id, const T& data);
 
     void setVertexInputState(const VertexInputState& vertex_input_sate);
 
@@ -165,7 +155,7 @@ public:
     inline const RenderPass* getRenderPass() const { return m_RenderPass; }
 
 
-    //const SpecializationConstantState& getspecialization_constantState() const;
+    const SpecializationConstantState& getSpecializationConstantState() const { return m_SpecializationConstantState; }
 
     const VertexInputState& getVertexInputState() const;
 
@@ -193,7 +183,7 @@ private:
     PipelineLayout* m_PipelineLayout{ nullptr };
     const RenderPass* m_RenderPass{ nullptr };
 
-    //SpecializationConstantState specialization_constantState{};
+    SpecializationConstantState m_SpecializationConstantState{};
 
     VertexInputState m_VertexInputState{};
     InputAssemblyState m_InputAssemblyState{};
@@ -204,3 +194,14 @@ private:
     ColorBlendState m_ColorBlendState{};
     uint32_t m_SubpassIndex{ 0U };
 };
+
+template <class T>
+inline void PipelineState::setSpecializationConstant(uint32_t constant_id, const T& data)
+{
+    m_SpecializationConstantState.setConstant(constant_id, data);
+
+    if (m_SpecializationConstantState.isDirty())
+    {
+        m_Dirty = true;
+    }
+}
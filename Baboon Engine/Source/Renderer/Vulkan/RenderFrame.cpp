@@ -36,6 +36,9 @@ RenderFrame::RenderFrame(Device& device, std::unique_ptr<RenderTarget>&& renderT
 
     m_CameraUniformBuffer = (VulkanBuffer*) ServiceLocator::GetRenderer()->CreateStaticUniformBuffer(nullptr, sizeof(UBOCamera));
     m_ShadowsUniformBuffer = (VulkanBuffer*)ServiceLocator::GetRenderer()->CreateStaticUniformBuffer(nullptr, sizeof(UBOShadows));
+    m_ClusterCuller = std::make_unique<ClusterCuller>(device);
+    m_InstanceBuffer = std::make_unique<InstanceBuffer>(device);
+    m_LightClusters = std::make_unique<LightClusters>(device);
 }
 
 
@@ -95,6 +98,23 @@ void RenderFrame::reset()
         ServiceLocator::GetCameraManager()->FetchShadowsUBO(*m_ShadowsUniformBuffer);
         m_IsShadowsUniformDirty = false;
     }
+    if (m_IsClusterCullDirty)
+    {
+        auto camera = ServiceLocator::GetCameraManager()->GetCamera("mainCamera");
+        m_ClusterCuller->cull(*ServiceLocator::GetSceneManager()->GetCurrentScene(), *camera);
+        m_IsClusterCullDirty = false;
+    }
+    if (m_IsInstanceBufferDirty)
+    {
+        m_InstanceBuffer->update(*ServiceLocator::GetSceneManager()->GetCurrentScene());
+        m_IsInstanceBufferDirty = false;
+    }
+    if (m_IsLightClustersDirty)
+    {
+        auto camera = ServiceLocator::GetCameraManager()->GetCamera("mainCamera");
+        m_LightClusters->update(*ServiceLocator::GetSceneManager()->GetCurrentScene(), *camera, m_Target->getExtent());
+        m_IsLightClustersDirty = false;
+    }
 
     //reset command pools here 
     for (auto& command_pools_per_queue : m_CommandPools)
@@ -9,6 +9,9 @@
 #include <map>
 #include <memory>
 #include "resources/DescriptorSet.h"
+#include "ClusterCuller.h"
+#include "InstanceBuffer.h"
+#include "LightClusters.h"
 
 class Device;
 class RenderFrame
@@ -43,6 +46,12 @@ public:
     VulkanBuffer* getShadowsUniformBuffer() const { return m_ShadowsUniformBuffer; }
     void setCameraUniformDirty() { m_IsCameraUniformDirty = true; }
     void setShadowsUniformDirty() { m_IsShadowsUniformDirty = true; }
+    ClusterCuller& getClusterCuller() const { return *m_ClusterCuller; }
+    void setClusterCullDirty() { m_IsClusterCullDirty = true; }
+    InstanceBuffer& getInstanceBuffer() const { return *m_InstanceBuffer; }
+    void setInstanceBufferDirty() { m_IsInstanceBufferDirty = true; }
+    LightClusters& getLightClusters() const { return *m_LightClusters; }
+    void setLightClustersDirty() { m_IsLightClustersDirty = true; }
    
 private:
   
@@ -63,6 +72,12 @@ private:
     VulkanBuffer* m_CameraUniformBuffer;//This uniform buffer needs to be triple buffered otherwise artifacts appear trying to write at the same time one command buffer is reading from it
     bool m_IsShadowsUniformDirty{ true };
     VulkanBuffer* m_ShadowsUniformBuffer;
+    bool m_IsClusterCullDirty{ true };
+    std::unique_ptr<ClusterCuller> m_ClusterCuller;//Compacted indices are rewritten while recording, so one per frame like the uniforms above
+    bool m_IsInstanceBufferDirty{ true };
+    std::unique_ptr<InstanceBuffer> m_InstanceBuffer;//Same, the matrices have to match the draws recorded for this frame
+    bool m_IsLightClustersDirty{ true };
+    std::unique_ptr<LightClusters> m_LightClusters;//Binned against this frame's camera
 
 
     SemaphorePool m_SemaphorePool;
@@ -1,6 +1,8 @@
 #include "RenderPath.h"
 #include "resources/RenderTarget.h"
 #include "CommandBuffer.h"
+#include "PipelineState.h"
+#include "Device.h"
 
 RenderPath::RenderPath(std::vector<std::unique_ptr<Subpass>>&& subpasses):
     m_Subpasses{std::move(subpasses)}
@@ -39,3 +41,24 @@ void RenderPath::draw(CommandBuffer& command_buffer, RenderTarget& render_target
 
     
 }
+
+
+void RenderPath::collectPipelineStates(Device& device, const RenderTarget& render_target, ThreadPool* threadPool, std::vector<PipelineState>& o_States)
+{
+    if (m_Subpasses.empty())
+        return;
+
+    //The state beginRenderPass and nextSubpass leave before each subpass draws
+    auto& render_pass = device.getResourcesCache().request_render_pass(render_target.getAttachments(), m_LoadStore, CommandBuffer::getSubpassInfos(m_Subpasses));
+    for (uint32_t i = 0; i < m_Subpasses.size(); i++)
+    {
+        PipelineState pass_state;
+        pass_state.setRenderPass(render_pass);
+        pass_state.setSubpassIndex(i);
+        auto blend_state = pass_state.getColorBlendState();
+        blend_state.m_Attachments.resize(render_pass.getColorOutputCount(i));
+        pass_state.setColorBlendState(blend_state);
+
+        m_Subpasses[i]->collectPipelineStates(pass_state, threadPool, o_States);
+    }
+}
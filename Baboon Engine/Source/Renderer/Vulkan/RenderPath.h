@@ -8,6 +8,9 @@
 
 class CommandBuffer;
 class RenderTarget;
+class Device;
+class PipelineState;
+class ThreadPool;
 //In the examples, this is called Pipeline, but I renamed it to RenderPath to not get it confused with Resources/Pipeline. This is esentially a sequence of subpasses creating different RenderPaths (Deferred, forward.. )
 class RenderPath
 {
@@ -15,6 +18,8 @@ public:
     RenderPath(std::vector<std::unique_ptr<Subpass>>&& subpasses = {});
     void add_subpass(std::unique_ptr<Subpass>&& subpass);
     void draw(CommandBuffer& command_buffer, RenderTarget& render_target, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+    //Pipeline states the subpasses will flush drawing the current scene into a target with those attachments, see Subpass::collectPipelineStates
+    void collectPipelineStates(Device& device, const RenderTarget& render_target, ThreadPool* threadPool, std::vector<PipelineState>& o_States);
 
     std::vector<std::unique_ptr<Subpass>>& getSubPasses() { return m_Subpasses; }
     void setClearValue(std::vector<VkClearValue>& clearValues) { m_ClearValue = clearValues; }
@@ -42,26 +42,46 @@ void RendererVulkan::WaitToDestroy()
 void RendererVulkan::Update()
 {
     m_LogicalDevice->getResourcesCache().GarbageCollect();
+    m_UploadService->update();
 
     if (m_SceneLoaded)
     {
+        if (m_BindlessTextures)
+            m_BindlessTextures->update(ServiceLocator::GetSceneManager()->GetCurrentScene()->GetTextures());
         if (m_RenderPath)
         {
             auto& subpasses = m_RenderPath->getSubPasses();
             for (int i = 0; i < subpasses.size(); i++)
             {
                 subpasses[i]->invalidatePersistentCommands();
-                subpasses[i]->prepare();
-                
             }
         }
+        for (auto& frame : m_RenderContext->getRenderFrames())
+        {
+            frame->setClusterCullDirty();
+            frame->setInstanceBufferDirty();
+            frame->setLightClustersDirty();
+        }
         m_SceneLoaded = false;
+        m_LogicalDevice->logMemoryUsage();
+        m_GeometryArena->logUsage();
+        restartWarmUp();
+        warmUpPipelines();
     }
     if (m_Dirty)
     {
         reRecordCommands();
         m_Dirty = false;
     }
+    if (m_WarmUpFrames > 0 && --m_WarmUpFrames == 0)
+    {
+        m_LogicalDevice->getResourcesCache().setWarmedUp(true);
+        const ResourcesCacheStats stats = m_LogicalDevice->getResourcesCache().getStats();
+        LOGINFO("Warmed up with a " + std::string(m_LogicalDevice->isPipelineCacheWarm() ? "warm" : "cold") + " pipeline cache: " +
+            std::to_string(stats.m_Pipelines) + " pipelines in " + std::to_string(stats.m_PipelineMilliseconds) + " ms, " +
+            std::to_string(stats.m_Pipelines - (std::min)(stats.m_Pipelines, m_PreWarmedPipelines)) + " of them created by the frames");
+        m_LogicalDevice->savePipelineCache();//Every pipeline of the scene is in, a crash later on doesn't lose them
+    }
     
         
    
@@ -90,6 +110,7 @@ void RendererVulkan::ReloadShader(std::string shaderPath)
     LOGDEBUG("Reloading shader: " + shaderPath);
     m_ShaderSourcePool.reloadShader(shaderPath);
     reRecordCommands();
+    restartWarmUp();//Compiling the new source is expected
 }
 
 
@@ -105,6 +126,15 @@ int RendererVulkan::Init(std::vector<const char*>& required_extensions, GLFWwind
     createSurface(i_window);
     pickPhysicalDevice();
     m_LogicalDevice = std::make_unique<Device>(m_PhysicalDevice, m_Surface, m_VvalidationLayers, deviceExtensions);
+    m_UploadService = std::make_unique<UploadService>(*m_LogicalDevice);
+    m_GeometryArena = std::make_unique<VulkanGeometryArena>(*m_LogicalDevice, *m_UploadService);
+    if (m_LogicalDevice->isDescriptorIndexingEnabled())
+        m_BindlessTextures = std::make_unique<BindlessTextures>(*m_LogicalDevice);
+    else
+    {
+        uint32_t white = 0xffffffff;
+        m_PlaceholderTexture = CreateTexture(&white, 1, 1);//Uploaded with the first scene, which waits for its uploads
+    }
 
 
     int width, height;
@@ -115,7 +145,7 @@ int RendererVulkan::Init(std::vector<const char*>& required_extensions, GLFWwind
 
    
   
-    auto geoSubPass = std::make_unique<GeometrySubpass>(*m_RenderContext, "./Shaders/geo.vert", "./Shaders/geo.frag", m_ThreadCount);
+    auto geoSubPass = std::make_unique<GeometrySubpass>(*m_RenderContext, "./Shaders/geo.vert", "./Shaders/geo.frag");
     geoSubPass->setOutputAttachments({ 1,2,3 });
 
    
@@ -123,7 +153,7 @@ int RendererVulkan::Init(std::vector<const char*>& required_extensions, GLFWwind
     lightSubPass->setInputAttachments({ 1,2,3 });
     lightSubPass->setDisableDepthAttachment();//We can't read and write to depth!
 
-    auto transparentSubpass = std::make_unique<TransparentSubpass>(*m_RenderContext, "./Shaders/transparent.vert", "./Shaders/transparent.frag", m_ThreadCount);
+    auto transparentSubpass = std::make_unique<TransparentSubpass>(*m_RenderContext, "./Shaders/transparent.vert", "./Shaders/transparent.frag");
 
     m_RenderPath = std::make_unique<RenderPath>();
     m_RenderPath->add_subpass(std::move(geoSubPass));
@@ -191,6 +221,8 @@ int RendererVulkan::Init(std::vector<const char*>& required_extensions, GLFWwind
     ServiceLocator::GetSceneManager()->GetSubject().Register(this);
     ServiceLocator::GetCameraManager()->GetSubject().Register(this);
 
+    m_LogicalDevice->logMemoryUsage();
+
     return true;
     //return (result == VK_SUCCESS);
 
@@ -209,6 +241,10 @@ void RendererVulkan::DrawFrame()
 
   auto& command_buffer = m_RenderContext->begin();//Grab a command buffer from the render context
 
+  //Adding lights doesn't re-record anything, unless binning them outgrew the light buffers of this frame
+  if (m_RenderContext->getActiveFrame().getLightClusters().takeReallocated())
+      reRecordCommands();
+
 
 
    //Shadows should not depend on previous frames therefore doing it before all the swapchain sync stuff
@@ -314,6 +350,14 @@ void RendererVulkan::DrawFrame()
 
 void RendererVulkan::Destroy()	
 {
+    if (m_PlaceholderTexture)
+    {
+        DeleteTexture(m_PlaceholderTexture);
+        delete m_PlaceholderTexture;
+        m_PlaceholderTexture = nullptr;
+    }
+    m_UploadService.reset();
+    m_BindlessTextures.reset();
     m_RenderContext.reset();//Forcing the swapchain to be destroyed before the surface otherwise validation complains
     if (m_Surface != VK_NULL_HANDLE)
     {
@@ -385,8 +429,48 @@ void  RendererVulkan::pickPhysicalDevice()
 
 }
 
+void RendererVulkan::restartWarmUp()
+{
+    m_LogicalDevice->getResourcesCache().setWarmedUp(false);
+    m_WarmUpFrames = static_cast<uint32_t>(m_RenderContext->getRenderFrames().size()) + 1;
+}
+
+void RendererVulkan::warmUpPipelines()
+{
+    if (!ServiceLocator::GetSceneManager()->GetCurrentScene()->IsInit())
+        return;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    auto& resourcesCache = m_LogicalDevice->getResourcesCache();
+    const ResourcesCacheStats before = resourcesCache.getStats();
+
+    //Every frame render target has the same attachments, hence the same render pass
+    ThreadPool* jobPool = ServiceLocator::GetJobPool();
+    std::vector<PipelineState> pipelineStates;
+    if (m_RenderPath)
+        m_RenderPath->collectPipelineStates(*m_LogicalDevice, m_RenderContext->getActiveFrame().getRenderTarget(), jobPool, pipelineStates);
+    if (m_ShadowPath)
+        m_ShadowPath->collectPipelineStates(*m_LogicalDevice, *m_ShadowRT, jobPool, pipelineStates);
+    const uint32_t nCreated = resourcesCache.request_pipelines(pipelineStates, jobPool);
+
+    const ResourcesCacheStats after = resourcesCache.getStats();
+    m_PreWarmedPipelines = after.m_Pipelines;
+    const float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    LOGINFO("Scene warm up: " + std::to_string(after.m_ShaderCompiles - before.m_ShaderCompiles) + " shaders compiled, " +
+        std::to_string(after.m_ShaderCacheLoads - before.m_ShaderCacheLoads) + " read from disk, " + std::to_string(nCreated) + " new pipelines out of " +
+        std::to_string(pipelineStates.size()) + " states in " + std::to_string(milliseconds) + " ms");
+}
+
 void RendererVulkan::reRecordCommands()
 {
+    //Commands drawing from the compacted cluster indices or the instance matrices go stale with them
+    for (auto& frame : m_RenderContext->getRenderFrames())
+    {
+        frame->setClusterCullDirty();
+        frame->setInstanceBufferDirty();
+        frame->setLightClustersDirty();
+    }
+
     if (m_RenderPath)
     {
         auto& subpasses = m_RenderPath->getSubPasses();
@@ -398,28 +482,45 @@ void RendererVulkan::reRecordCommands()
 }
 
 
-Buffer* RendererVulkan::CreateVertexBuffer( void*  i_data, size_t iBufferSize)
+Buffer* RendererVulkan::createBuffer(void* i_data, size_t iBufferSize, VkBufferUsageFlags usage, BufferMemoryClass memoryClass)
 {
     Buffer* buffer;
 
-    m_Buffers.emplace_back(*m_LogicalDevice, iBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
-    buffer = &m_Buffers.back();
-    if(i_data)
-        buffer->update(i_data, iBufferSize);
+    switch (memoryClass)
+    {
+    case BufferMemoryClass::Static:
+        //Device local memory isn't mappable, the data goes in through the upload service
+        m_Buffers.emplace_back(*m_LogicalDevice, iBufferSize, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, 0, m_UploadService->getQueueFamilies());
+        buffer = &m_Buffers.back();
+        if (i_data)
+            m_UploadService->uploadBuffer(i_data, iBufferSize, m_Buffers.back());
+        break;
+    case BufferMemoryClass::Readback:
+        m_Buffers.emplace_back(*m_LogicalDevice, iBufferSize, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
+        buffer = &m_Buffers.back();
+        if (i_data)
+            buffer->update(i_data, iBufferSize);
+        break;
+    case BufferMemoryClass::Dynamic:
+    default:
+        m_Buffers.emplace_back(*m_LogicalDevice, iBufferSize, usage, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        buffer = &m_Buffers.back();
+        if (i_data)
+            buffer->update(i_data, iBufferSize);
+        break;
+    }
 
     return buffer;
-	
 }
 
-Buffer* RendererVulkan::CreateIndexBuffer( void*  i_data, size_t iBufferSize)
+Buffer* RendererVulkan::CreateVertexBuffer( void*  i_data, size_t iBufferSize, BufferMemoryClass i_MemoryClass)
 {
-    Buffer* buffer;
-    m_Buffers.emplace_back(*m_LogicalDevice, iBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
-    buffer = &m_Buffers.back();
-    if(i_data)
-        buffer->update(i_data, iBufferSize);
+    return createBuffer(i_data, iBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, i_MemoryClass);
+}
 
-    return buffer;
+Buffer* RendererVulkan::CreateIndexBuffer( void*  i_data, size_t iBufferSize, BufferMemoryClass i_MemoryClass)
+{
+    return createBuffer(i_data, iBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, i_MemoryClass);
 }
 
 
@@ -438,6 +539,31 @@ void RendererVulkan::DeleteBuffer(Buffer* buffer)
     }
 }
 
+void RendererVulkan::WaitForUploads()
+{
+    m_UploadService->wait(m_UploadService->flush());
+}
+
+bool RendererVulkan::AllocateGeometry(uint32_t i_NVertices, uint32_t i_NIndices, uint32_t i_IndexSize, GeometryAllocation& o_Allocation)
+{
+    return m_GeometryArena->allocate(i_NVertices, i_NIndices, i_IndexSize, o_Allocation);
+}
+
+Buffer* RendererVulkan::UploadGeometryStream(const GeometryAllocation& i_Allocation, const std::string& i_Attribute, const void* i_Data, uint32_t i_Stride)
+{
+    return m_GeometryArena->uploadStream(i_Allocation, i_Attribute, i_Data, i_Stride);
+}
+
+Buffer* RendererVulkan::UploadGeometryIndices(const GeometryAllocation& i_Allocation, const void* i_Indices)
+{
+    return m_GeometryArena->uploadIndices(i_Allocation, i_Indices);
+}
+
+void RendererVulkan::FreeGeometry(const GeometryAllocation& i_Allocation)
+{
+    m_GeometryArena->free(i_Allocation);
+}
+
 void RendererVulkan::DeleteTexture(Texture* texture)
 {
     VulkanTexture* vulkanTexture = (VulkanTexture*)texture;
@@ -466,22 +592,9 @@ void RendererVulkan::DeleteTexture(Texture* texture)
 
 
 
-Buffer* RendererVulkan::CreateStaticUniformBuffer( void*  i_data, size_t iBufferSize)
-{
-    Buffer* buffer;
-
-    m_Buffers.emplace_back(*m_LogicalDevice, iBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
-    buffer = &m_Buffers.back();
-    if(i_data)
-        buffer->update(i_data, iBufferSize);
-
-    return buffer;
-
-}
-Buffer* RendererVulkan::CreateInstancedUniformBuffer( void*  i_data, size_t iBufferSize)
+Buffer* RendererVulkan::CreateStaticUniformBuffer( void*  i_data, size_t iBufferSize, BufferMemoryClass i_MemoryClass)
 {
-	
-    return nullptr;
+    return createBuffer(i_data, iBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, i_MemoryClass);
 }
 
 void RendererVulkan::DeleteStaticUniformBuffer()
@@ -489,11 +602,6 @@ void RendererVulkan::DeleteStaticUniformBuffer()
 
 
 
-}
-void RendererVulkan::DeleteInstancedUniformBuffer()
-{
-
-
 }
 
 void RendererVulkan::UpdateTimesAndFPS(std::chrono::time_point<std::chrono::high_resolution_clock>  i_tStartTime)
@@ -537,11 +645,19 @@ void RendererVulkan::ObserverUpdate(int message, void* data)
     }
     else if (message == Subject::LIGHTDIRTY)
     {
-        m_Dirty = true;
+        //Light counts and positions are data, the recorded commands stay valid unless the shadow views change
         auto& renderFrames = m_RenderContext->getRenderFrames();
         for (auto& frame : renderFrames)
+        {
             frame->setShadowsUniformDirty();
-        m_Dirty = true;
+            frame->setLightClustersDirty();
+        }
+        auto scene = (Scene*)data;
+        if (scene->getDirLightCount() != m_RecordedDirLights)
+        {
+            m_RecordedDirLights = scene->getDirLightCount();
+            m_Dirty = true;
+        }
     }
 }
 
@@ -552,15 +668,11 @@ void RendererVulkan::ObserverUpdate(int message, void* data)
 Texture* RendererVulkan::CreateTexture(void* pPixels, int i_Widht, int i_Height)
 {
     VulkanTexture* texture = new VulkanTexture();
-    auto& command_buffer = m_LogicalDevice->requestCommandBuffer();
-    command_buffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, 0);
-
-
-
 
     VkExtent3D extent{ i_Widht,i_Height,1 };
 
-    m_Images.emplace_back(*m_LogicalDevice, extent, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    m_Images.emplace_back(*m_LogicalDevice, extent, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY,
+        VK_SAMPLE_COUNT_1_BIT, 1, 1, VK_IMAGE_TILING_OPTIMAL, 0, m_UploadService->getQueueFamilies());
 
     texture->setImage(&m_Images.back());
 
@@ -568,65 +680,9 @@ Texture* RendererVulkan::CreateTexture(void* pPixels, int i_Widht, int i_Height)
     texture->setImageView(&m_ImageViews.back());
 
     size_t size = i_Widht * i_Height * 4 * sizeof(unsigned char);//we are forcing 4 channels with the STBI_rgb_alpha flag
-    VulkanBuffer stage_buffer{ *m_LogicalDevice,
-                              size,
-                              VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                              VMA_MEMORY_USAGE_CPU_ONLY };
-
-
-    stage_buffer.update(pPixels, size);
-   
-
-    /////Lets upload image to the gpu
-    {
-        ImageMemoryBarrier memory_barrier{};
-        memory_barrier.old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
-        memory_barrier.new_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        memory_barrier.src_access_mask = 0;
-        memory_barrier.dst_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        memory_barrier.src_stage_mask = VK_PIPELINE_STAGE_HOST_BIT;
-        memory_barrier.dst_stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT;
-
-        command_buffer.imageBarrier(*texture->getImageView(), memory_barrier);
-    }
-
-    std::vector<VkBufferImageCopy> buffer_copy_regions(1);//TODO: We are assuming mipmaps = 1
-    auto& copy_region = buffer_copy_regions[0];
-    copy_region.bufferOffset = 0;//mipmap.offset;
-    copy_region.imageSubresource = texture->getImageView()->getSubresourceLayers();
-    // Update miplevel
-    copy_region.imageSubresource.mipLevel = 0;//mipmap.level;
-    VkExtent3D mipExtent{ i_Widht,i_Height,1 };
-    copy_region.imageExtent = mipExtent;//mipmap.extent;
-
-    command_buffer.copy_buffer_to_image(stage_buffer, *texture->getImage(), buffer_copy_regions);
-
-    //Transition image to readable by the shader
-    {
-        ImageMemoryBarrier memory_barrier{};
-        memory_barrier.old_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        memory_barrier.new_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        memory_barrier.src_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        memory_barrier.dst_access_mask = VK_ACCESS_SHADER_READ_BIT;
-        memory_barrier.src_stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        memory_barrier.dst_stage_mask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-
-        command_buffer.imageBarrier(*texture->getImageView(), memory_barrier);
-    }
-
-
-    command_buffer.end();
-
-    auto& queue = m_LogicalDevice->getResourceTransferQueue();
-
-    queue.submit(command_buffer, m_LogicalDevice->requestFence());
-
-    m_LogicalDevice->getFencePool().wait();
-    m_LogicalDevice->getFencePool().reset();
-    m_LogicalDevice->getCommandPool().reset_pool();
-    //m_LogicalDevice->wait_idle();
 
-    //!TODO END/////////////////////////////////////////////////////////////////////
+    //Copy gets batched with the rest of the scene uploads, WaitForUploads() before sampling it
+    m_UploadService->uploadImage(pPixels, size, *texture->getImageView());
 
 
     //I think this same sampler can be used for all the textures TODO: Make it shareable
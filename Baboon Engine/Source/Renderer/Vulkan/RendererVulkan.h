@@ -8,6 +8,9 @@
 #include "Device.h"
 #include "VulkanContext.h"
 #include "RenderPath.h"
+#include "UploadService.h"
+#include "VulkanGeometryArena.h"
+#include "BindlessTextures.h"
 #include <list>
 #include "Core/Observer.h"
 
@@ -28,13 +31,15 @@ public:
 	float GetMainRTHeight() override;
  
 
-	Buffer* CreateVertexBuffer( void*  i_data, size_t iBufferSize) override;
-  Buffer* CreateIndexBuffer( void*  i_data, size_t iBufferSize) override;
+	Buffer* CreateVertexBuffer( void*  i_data, size_t iBufferSize, BufferMemoryClass i_MemoryClass = BufferMemoryClass::Static) override;
+  Buffer* CreateIndexBuffer( void*  i_data, size_t iBufferSize, BufferMemoryClass i_MemoryClass = BufferMemoryClass::Static) override;
 	void DeleteBuffer(Buffer*) override;
-  Buffer* CreateStaticUniformBuffer( void*  i_data, size_t iBufferSize) override;
-  Buffer* CreateInstancedUniformBuffer( void*  i_data, size_t iBufferSize) override;
+  bool AllocateGeometry(uint32_t i_NVertices, uint32_t i_NIndices, uint32_t i_IndexSize, GeometryAllocation& o_Allocation) override;
+  Buffer* UploadGeometryStream(const GeometryAllocation& i_Allocation, const std::string& i_Attribute, const void* i_Data, uint32_t i_Stride) override;
+  Buffer* UploadGeometryIndices(const GeometryAllocation& i_Allocation, const void* i_Indices) override;
+  void FreeGeometry(const GeometryAllocation& i_Allocation) override;
+  Buffer* CreateStaticUniformBuffer( void*  i_data, size_t iBufferSize, BufferMemoryClass i_MemoryClass = BufferMemoryClass::Dynamic) override;
 	void DeleteStaticUniformBuffer() override;
-	void DeleteInstancedUniformBuffer() override;
   void ReloadShader(std::string) override;
 	void UpdateTimesAndFPS(std::chrono::time_point<std::chrono::high_resolution_clock>  i_tStartTime) override;
 
@@ -45,6 +50,8 @@ public:
   //This 3 to be implemented
   virtual Texture* CreateTexture(void* i_data, int i_Widht, int i_Height) override;
   virtual void DeleteTexture(Texture*) override;
+  void WaitForUploads() override;
+  bool SupportsBindlessTextures() const override { return m_BindlessTextures != nullptr; }
 
   virtual void CreateMaterial(std::string i_MatName, int* iTexIndices, int iNumTextures) override{ }
 
@@ -54,16 +61,25 @@ public:
   ShaderSourcePool& getShaderSourcePool() {
       return m_ShaderSourcePool;
   }
+  BindlessTextures* getBindlessTextures() { return m_BindlessTextures.get(); }//Null without descriptor indexing
+  Texture* getPlaceholderTexture() { return m_PlaceholderTexture; }//1x1 white bound to the slots a material has no texture for, null with bindless textures
 private:
 
     size_t m_ThreadCount = 1;
     bool m_SceneLoaded = false;
     bool m_Dirty = false;
+    size_t m_RecordedDirLights = 0;//Shadow views are recorded, only a change in the dir light count needs new commands
+    uint32_t m_WarmUpFrames = 0;//Left until the resources cache counts compiles as hitches, see restartWarmUp
+    uint32_t m_PreWarmedPipelines = 0;//In the cache once warmUpPipelines is done, the warm up frames should not add any
 
   std::unique_ptr<Instance> m_Instance{ nullptr };
   VkSurfaceKHR m_Surface{ VK_NULL_HANDLE };
 	VkPhysicalDevice m_PhysicalDevice = VK_NULL_HANDLE;
   std::unique_ptr<Device> m_LogicalDevice{ nullptr };
+  std::unique_ptr<UploadService> m_UploadService{ nullptr };
+  std::unique_ptr<VulkanGeometryArena> m_GeometryArena{ nullptr };
+  std::unique_ptr<BindlessTextures> m_BindlessTextures{ nullptr };
+  Texture* m_PlaceholderTexture{ nullptr };
   std::unique_ptr<VulkanContext> m_RenderContext{ nullptr };
   std::unique_ptr<RenderPath> m_RenderPath{ nullptr };
 
@@ -90,6 +106,9 @@ private:
   bool isDeviceSuitable(VkPhysicalDevice device);
   void pickPhysicalDevice();
   void reRecordCommands();
+  void restartWarmUp();//Every frame records once before compiles and pipeline creations count as after warm up
+  void warmUpPipelines();//Compiles the shaders and creates the pipelines the loaded scene draws with, in parallel, before its first frame records
+  Buffer* createBuffer(void* i_data, size_t iBufferSize, VkBufferUsageFlags usage, BufferMemoryClass memoryClass);
 
 	const std::vector<const char*> m_VvalidationLayers = {
 		"VK_LAYER_LUNARG_standard_validation"
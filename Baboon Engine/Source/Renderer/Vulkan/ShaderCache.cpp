@@ -0,0 +1,180 @@
+#include "ShaderCache.h"
+#include "glsl_compiler.h"
+#include "BindlessTextures.h"
+#include "Core/ServiceLocator.h"
+#include "Core/Material.h"
+#include "Core/BlobIO.h"
+#include <filesystem>
+#include <fstream>
+#include <cstdio>
+
+struct ShaderCacheHeader
+{
+    uint32_t m_Magic;
+    uint32_t m_Version;
+    uint64_t m_Key;
+    uint32_t m_SpirvWords;
+    uint32_t m_ResourceCount;
+};
+
+static void combineKey(uint64_t& io_Key, size_t i_Hash)
+{
+    io_Key ^= i_Hash + 0x9e3779b97f4a7c15ull + (io_Key << 6) + (io_Key >> 2);
+}
+
+static std::string toHex(uint64_t i_Value)
+{
+    char text[17];
+    snprintf(text, sizeof(text), "%016llx", (unsigned long long)i_Value);
+    return text;
+}
+
+uint64_t ShaderCache::GetKey(VkShaderStageFlagBits i_Stage, const ShaderSource& i_Source, const ShaderVariant& i_Variant)
+{
+    std::hash<std::string> hasher{};
+    uint64_t key = SHADER_CACHE_VERSION;
+    combineKey(key, i_Source.get_id());
+    combineKey(key, hasher(i_Variant.get_preamble()));
+    for (auto& process : i_Variant.get_processes())
+        combineKey(key, hasher(process));
+    combineKey(key, static_cast<size_t>(i_Stage));
+    combineKey(key, hasher(GLSLCompiler::get_version()));
+    combineKey(key, BINDLESS_MAX_TEXTURES);//Reflected as the size of runtime sampler arrays
+    return key;
+}
+
+std::string ShaderCache::GetCachePath(size_t i_SourceHash, uint64_t i_Key)
+{
+    return std::string(SHADER_CACHE_DIRECTORY) + toHex(i_SourceHash) + "_" + toHex(i_Key) + SHADER_CACHE_EXTENSION;
+}
+
+bool ShaderCache::Read(size_t i_SourceHash, uint64_t i_Key, std::vector<uint32_t>& o_Spirv, std::vector<ShaderResource>& o_Resources)
+{
+    std::string cachePath = GetCachePath(i_SourceHash, i_Key);
+    std::ifstream file(cachePath, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return false;
+    std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read((char*)data.data(), data.size());
+    if (!file.good())
+        return false;
+
+    BlobReader reader{ data.data(), data.size() };
+    ShaderCacheHeader header = reader.read<ShaderCacheHeader>();
+    if (!reader.m_Valid || header.m_Magic != SHADER_CACHE_MAGIC || header.m_Version != SHADER_CACHE_VERSION || header.m_Key != i_Key ||
+        header.m_SpirvWords == 0 || reader.m_Position + (size_t)header.m_SpirvWords * sizeof(uint32_t) > data.size())
+    {
+        LOGERROR("Shader cache entry is corrupted: " + cachePath);
+        return false;
+    }
+    o_Spirv.resize(header.m_SpirvWords);
+    std::memcpy(o_Spirv.data(), data.data() + reader.m_Position, o_Spirv.size() * sizeof(uint32_t));
+    reader.m_Position += o_Spirv.size() * sizeof(uint32_t);
+
+    o_Resources.clear();
+    for (uint32_t i = 0; i < header.m_ResourceCount && reader.m_Valid; i++)
+    {
+        ShaderResource resource{};
+        resource.stages = reader.read<uint32_t>();
+        resource.type = static_cast<ShaderResourceType>(reader.read<uint32_t>());
+        resource.mode = static_cast<ShaderResourceMode>(reader.read<uint32_t>());
+        resource.set = reader.read<uint32_t>();
+        resource.binding = reader.read<uint32_t>();
+        resource.location = reader.read<uint32_t>();
+        resource.input_attachment_index = reader.read<uint32_t>();
+        resource.vec_size = reader.read<uint32_t>();
+        resource.columns = reader.read<uint32_t>();
+        resource.array_size = reader.read<uint32_t>();
+        resource.offset = reader.read<uint32_t>();
+        resource.size = reader.read<uint32_t>();
+        resource.constant_id = reader.read<uint32_t>();
+        resource.name = reader.readString();
+        o_Resources.push_back(resource);
+    }
+    if (!reader.m_Valid)
+    {
+        LOGERROR("Shader cache entry is corrupted: " + cachePath);
+        o_Spirv.clear();
+        o_Resources.clear();
+        return false;
+    }
+    return true;
+}
+
+bool ShaderCache::Write(size_t i_SourceHash, uint64_t i_Key, const std::vector<uint32_t>& i_Spirv, const std::vector<ShaderResource>& i_Resources)
+{
+    ShaderCacheHeader header{};
+    header.m_Magic = SHADER_CACHE_MAGIC;
+    header.m_Version = SHADER_CACHE_VERSION;
+    header.m_Key = i_Key;
+    header.m_SpirvWords = static_cast<uint32_t>(i_Spirv.size());
+    header.m_ResourceCount = static_cast<uint32_t>(i_Resources.size());
+
+    std::vector<uint8_t> blob;
+    writeValue(blob, header);
+    blob.insert(blob.end(), (const uint8_t*)i_Spirv.data(), (const uint8_t*)(i_Spirv.data() + i_Spirv.size()));
+    for (auto& resource : i_Resources)
+    {
+        writeValue(blob, (uint32_t)resource.stages);
+        writeValue(blob, (uint32_t)resource.type);
+        writeValue(blob, (uint32_t)resource.mode);
+        writeValue(blob, resource.set);
+        writeValue(blob, resource.binding);
+        writeValue(blob, resource.location);
+        writeValue(blob, resource.input_attachment_index);
+        writeValue(blob, resource.vec_size);
+        writeValue(blob, resource.columns);
+        writeValue(blob, resource.array_size);
+        writeValue(blob, resource.offset);
+        writeValue(blob, resource.size);
+        writeValue(blob, resource.constant_id);
+        writeString(blob, resource.name);
+    }
+
+    //Written to a temporary file first so a half written entry is never picked up
+    std::error_code error;
+    std::filesystem::create_directories(SHADER_CACHE_DIRECTORY, error);
+    std::string cachePath = GetCachePath(i_SourceHash, i_Key);
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            LOGERROR("Can't write shader cache: " + cachePath);
+            return false;
+        }
+        file.write((const char*)blob.data(), blob.size());
+        if (!file.good())
+        {
+            LOGERROR("Failed writing shader cache: " + cachePath);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tempPath, cachePath, error);
+    if (error)
+    {
+        LOGERROR("Can't move shader cache in place: " + cachePath);
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
+
+void ShaderCache::Evict(size_t i_SourceHash)
+{
+    std::error_code error;
+    const std::string prefix = toHex(i_SourceHash) + "_";
+    std::vector<std::filesystem::path> stale;
+    for (auto& entry : std::filesystem::directory_iterator(SHADER_CACHE_DIRECTORY, error))
+    {
+        const std::string fileName = entry.path().filename().string();
+        if (fileName.compare(0, prefix.size(), prefix) == 0)
+            stale.push_back(entry.path());
+    }
+    for (auto& path : stale)
+        std::filesystem::remove(path, error);
+    if (!stale.empty())
+        LOGINFO("Shader cache dropped " + std::to_string(stale.size()) + " entries of a reloaded source");
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "Common.h"
+#include "resources/Shader.h"
+#include <vector>
+#include <string>
+
+class ShaderVariant;
+
+//Compiled shader container, the spirv of one (source, variant, stage) plus its reflection so loading it skips glslang and spirv-cross
+#define SHADER_CACHE_MAGIC 0x53534242 //"BBSS"
+#define SHADER_CACHE_VERSION 1 //Bump when ShaderModule reflection or the compile options change
+#define SHADER_CACHE_DIRECTORY "./ShaderCache/"
+#define SHADER_CACHE_EXTENSION ".bbspv"
+
+/**
+ * @brief Content addressed on disk cache of compiled shader modules
+ *
+ * Entries are keyed by the hash of the glsl source, the variant preamble and processes, the stage and the glslang version,
+ * so a source edit or a compiler update simply misses. They are named <source hash>_<key> so a reloaded source can drop
+ * the entries of its previous version. Entries are read when a module asks for them, never all up front.
+ */
+class ShaderCache
+{
+public:
+    static uint64_t GetKey(VkShaderStageFlagBits i_Stage, const ShaderSource& i_Source, const ShaderVariant& i_Variant);
+    static std::string GetCachePath(size_t i_SourceHash, uint64_t i_Key);
+
+    //false if the entry is missing or corrupted
+    static bool Read(size_t i_SourceHash, uint64_t i_Key, std::vector<uint32_t>& o_Spirv, std::vector<ShaderResource>& o_Resources);
+    static bool Write(size_t i_SourceHash, uint64_t i_Key, const std::vector<uint32_t>& i_Spirv, const std::vector<ShaderResource>& i_Resources);
+
+    //Deletes every entry compiled from a source with that hash
+    static void Evict(size_t i_SourceHash);
+};
@@ -10,12 +10,15 @@
 #include "VulkanTexture.h"
 #include "RendererVulkan.h"
 #include "Cameras/Camera.h"
+#include "Core/ParallelJobs.h"
+#include <set>
 
 
 Subpass::Subpass(VulkanContext& render_context, std::string vertex_shader, std::string fragment_shader):
     m_RenderContext(render_context),
     m_VertexShaderPath(vertex_shader),
-    m_FragmentShaderPath(fragment_shader)
+    m_FragmentShaderPath(fragment_shader),
+    m_ThreadPool(ServiceLocator::GetJobPool())
 {
     getVertexShader();
     getFragmentShader();
@@ -24,7 +27,6 @@ Subpass::Subpass(VulkanContext& render_context, std::string vertex_shader, std::
 
  Subpass::~Subpass()
 {
-    delete m_ThreadPool;
 }
 
  void Subpass::updateRenderTargetAttachments(RenderTarget& render_target)
@@ -75,88 +77,111 @@ std::shared_ptr<ShaderSource> Subpass::getFragmentShader()
     return pFragmentShader;
 }
 
-void Subpass::drawBatchList(std::vector<RenderBatch>& batches, CommandBuffer* primary_commandBuffer, std::vector<CommandBuffer*>& recordedCommands)
+void Subpass::drawQueue(const RenderQueue& queue, CommandBuffer* primary_commandBuffer, std::vector<CommandBuffer*>& recordedCommands)
 {
-    if (batches.size() == 0)
+    resetDrawStats();
+    if (queue.empty())
         return;
     auto& device = m_RenderContext.getDevice();
     auto& activeFrame = m_RenderContext.getActiveFrame();
-    size_t nBatches = batches.size();
-    size_t nCommandBuffers = 1;//batches.size();
-    size_t threadsToUse = m_ThreadPool->threads.size();
-    if (nBatches < threadsToUse)
-    {
-        threadsToUse = nBatches;
-    }
-    size_t nBatchesPerThread = nBatches / threadsToUse;
-    size_t remainderBatches = nBatches % threadsToUse;
-
+    size_t nCommandBuffers = 1;
 
-    size_t beginIndex = 0;
-
-
-    for (int i = 0; i < threadsToUse; i++)
+    std::vector<RenderDrawRange> ranges;
+    queue.split(static_cast<uint32_t>(m_ThreadPool->threads.size()), ranges);
+    for (int i = 0; i < ranges.size(); i++)
     {
-        size_t nBatches = nBatchesPerThread;
-        if (remainderBatches > 0)
-        {
-            nBatches++;
-            remainderBatches--;
-        }
-        size_t endIndex = beginIndex + nBatches;
+        size_t beginIndex = ranges[i].m_Begin;
+        size_t endIndex = ranges[i].m_End;
         auto persistentCommandsPerThread = m_PersistentCommandsPerFrame.getPersistentCommands(activeFrame.getHashId(), i, device, activeFrame);
 
         auto& command_buffers = persistentCommandsPerThread->getCommandBuffers(nCommandBuffers);
 
         recordedCommands.insert(recordedCommands.end(), command_buffers.begin(), command_buffers.end());
 
-        m_ThreadPool->threads[i]->addJob([this, command_buffers, &primary_commandBuffer, &batches, beginIndex, endIndex]() {recordCommandBuffers(command_buffers, primary_commandBuffer, batches, beginIndex, endIndex); });
-
-        beginIndex = endIndex;
+        m_ThreadPool->threads[i]->addJob([this, command_buffers, &primary_commandBuffer, &queue, beginIndex, endIndex]() {recordCommandBuffers(command_buffers, primary_commandBuffer, queue, beginIndex, endIndex); });
     }
     m_ThreadPool->wait();
+    activeFrame.getInstanceBuffer().flushIndirectCommands();
 }
 
 
-void Subpass::recordBatches(CommandBuffer* command_buffer, CommandBuffer* primary_commandBuffer, std::vector<RenderBatch>& batches, size_t beginIndex, size_t endIndex)
+void Subpass::recordQueue(CommandBuffer* command_buffer, CommandBuffer* primary_commandBuffer, const RenderQueue& queue, size_t beginIndex, size_t endIndex)
 {
-    for (int i = 0; i < (endIndex - beginIndex); i++)
+    if (beginIndex >= endIndex)
+        return;
+    const ModelStore& models = ServiceLocator::GetSceneManager()->GetCurrentScene()->GetModelStore();
+    const uint32_t* meshViews = models.getMeshViewIndices();
+    InstanceBuffer& instances = m_RenderContext.getActiveFrame().getInstanceBuffer();
+    const uint32_t firstInstance = instances.getFirstInstance(RenderQueue::getPass(queue[static_cast<uint32_t>(beginIndex)].m_Key));
+    const bool indirect = useIndirectDraws();
+    IndirectBatch batch;
+    bool bound = false;
+    uint32_t boundState = 0;
+    for (uint32_t i = static_cast<uint32_t>(beginIndex); i < endIndex;)
     {
-        auto& batch = batches[beginIndex + i];
-
-        if(batch.m_ModelsByDistance.size() == 0)
-          continue;
-       
-        bindModelPipelineLayout(command_buffer, batch.m_ModelsByDistance.begin()->second);//Here all the models in the batch same the same material so we can call this out here
-     
-        for (auto node_it = batch.m_ModelsByDistance.begin(); node_it != batch.m_ModelsByDistance.end(); node_it++)
+        const RenderQueueItem& item = queue[i];
+        const uint32_t state = RenderQueue::getState(item.m_Key);
+        if (!bound || state != boundState)
         {
-            const Model& model = node_it->second;
-            drawModel(model, command_buffer);
+            drawIndirectBatch(command_buffer, batch);//Recorded with the pipeline it was batched for
+            bindModelPipelineLayout(command_buffer, item.m_Model);//Same state, same shader variant and material as the models after it
+            bound = true;
+            boundState = state;
+        }
+        //Their instance data sits one after the other in the instance buffer, the whole run is a single draw
+        const uint32_t runEnd = queue.getInstanceRunEnd(i, static_cast<uint32_t>(endIndex), meshViews);
+        VkDrawIndexedIndirectCommand command;
+        bool clusterCulled;
+        if (getDrawCommand(item.m_Model, runEnd - i, firstInstance + i, command, clusterCulled))
+        {
+            m_Draws++;
+            if (!indirect)
+            {
+                bindModelGeometry(item.m_Model, clusterCulled, command_buffer);
+                command_buffer->draw_indexed(command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
+                m_DrawCalls++;
+            }
+            else
+            {
+                const Mesh& mesh = *models.getDrawView(item.m_Model).m_Mesh;
+                const VkIndexType indexType = clusterCulled ? VK_INDEX_TYPE_UINT32 : mesh.GetIndexType();
+                if (batch.m_NCommands == 0 || batch.m_Geometry != mesh.GetIndicesBuffer() || batch.m_ClusterCulled != clusterCulled || batch.m_IndexType != indexType)
+                {
+                    drawIndirectBatch(command_buffer, batch);
+                    batch.m_FirstCommand = firstInstance + i;//Slots from here to the end of the range are this batch's
+                    batch.m_Geometry = mesh.GetIndicesBuffer();
+                    batch.m_ClusterCulled = clusterCulled;
+                    batch.m_IndexType = indexType;
+                    bindModelGeometry(item.m_Model, clusterCulled, command_buffer);
+                }
+                instances.getIndirectCommands()[batch.m_FirstCommand + batch.m_NCommands++] = command;
+            }
         }
+        i = runEnd;
     }
+    drawIndirectBatch(command_buffer, batch);
 
 }
-void Subpass::recordCommandBuffers(std::vector<CommandBuffer*> command_buffers, CommandBuffer* primary_commandBuffer, std::vector<RenderBatch>& batches, size_t beginIndex, size_t endIndex)
+void Subpass::recordCommandBuffers(std::vector<CommandBuffer*> command_buffers, CommandBuffer* primary_commandBuffer, const RenderQueue& queue, size_t beginIndex, size_t endIndex)
 {
     assert(command_buffers.size() > 0, "Command buffers cant be empty!");
 
     auto scene = ServiceLocator::GetSceneManager()->GetCurrentScene();
     auto& renderTarget = m_RenderContext.getActiveFrame().getRenderTarget();//Grab the render target
 
-    size_t nBatches = endIndex - beginIndex;
-    size_t nBatchesPerCommand= nBatches / command_buffers.size();
-    size_t remainderBatches = nBatches % command_buffers.size();
+    size_t nDraws = endIndex - beginIndex;
+    size_t nDrawsPerCommand= nDraws / command_buffers.size();
+    size_t remainderDraws = nDraws % command_buffers.size();
     size_t localBeginIndex = beginIndex;
     for (CommandBuffer* command_buffer : command_buffers)
     {
-        size_t nBatches = nBatchesPerCommand;
-        if (remainderBatches > 0)
+        size_t nDraws = nDrawsPerCommand;
+        if (remainderDraws > 0)
         {
-            nBatches++;
-            remainderBatches--;
+            nDraws++;
+            remainderDraws--;
         }
-        size_t localEndIndex = localBeginIndex + nBatches;
+        size_t localEndIndex = localBeginIndex + nDraws;
 
         //Set viewport and scissors
         /*auto& extent = renderTarget.getExtent();
@@ -172,7 +197,7 @@ void Subpass::recordCommandBuffers(std::vector<CommandBuffer*> command_buffers,
         //command_buffer->setViewport(0, { viewport });
         //command_buffer->setScissor(0, { scissor });
   
-        recordBatches(command_buffer, primary_commandBuffer, batches, localBeginIndex, localEndIndex);
+        recordQueue(command_buffer, primary_commandBuffer, queue, localBeginIndex, localEndIndex);
 
         command_buffer->end();
 
@@ -182,32 +207,133 @@ void Subpass::recordCommandBuffers(std::vector<CommandBuffer*> command_buffers,
 
 }
 
-void Subpass::drawModel(const Model& model, CommandBuffer* command_buffer)
+bool Subpass::getDrawCommand(ModelHandle model, uint32_t nInstances, uint32_t firstInstance, VkDrawIndexedIndirectCommand& command, bool& clusterCulled)
 {
+    const ModelMeshView& drawView = ServiceLocator::GetSceneManager()->GetCurrentScene()->GetModelStore().getDrawView(model);
+
+    ClusterDrawRange clusterRange;
+    clusterCulled = m_UseClusterCulling && nInstances == 1 && m_RenderContext.getActiveFrame().getClusterCuller().getDrawRange(model, clusterRange);
+    if (clusterCulled && clusterRange.m_NIndices == 0)
+        return false;//Every meshlet culled
+
+    command.indexCount = clusterCulled ? clusterRange.m_NIndices : drawView.m_View.m_NIndices;
+    command.instanceCount = nInstances;
+    command.firstIndex = clusterCulled ? clusterRange.m_FirstIndex : drawView.m_View.m_IndicesMeshStart;
+    command.vertexOffset = drawView.m_View.m_VerticesMeshStart;
+    command.firstInstance = firstInstance;
+    return true;
+}
 
-    auto& device = m_RenderContext.getDevice();
-    auto renderVulkan =(RendererVulkan*) ServiceLocator::GetRenderer();
+void Subpass::drawIndirectBatch(CommandBuffer* command_buffer, IndirectBatch& batch)
+{
+    if (batch.m_NCommands == 0)
+        return;
+    const VulkanBuffer& indirectBuffer = *m_RenderContext.getActiveFrame().getInstanceBuffer().getIndirectBuffer();
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    if (m_RenderContext.getDevice().getEnabledFeatures().multiDrawIndirect)
+    {
+        command_buffer->draw_indexed_indirect(indirectBuffer, (VkDeviceSize)batch.m_FirstCommand * stride, batch.m_NCommands, stride);
+        m_DrawCalls++;
+    }
+    else
+    {
+        for (uint32_t i = 0; i < batch.m_NCommands; i++)
+            command_buffer->draw_indexed_indirect(indirectBuffer, (VkDeviceSize)(batch.m_FirstCommand + i) * stride, 1, stride);
+        m_DrawCalls += batch.m_NCommands;
+    }
+    batch.m_NCommands = 0;
+}
 
-    
+bool Subpass::useIndirectDraws() const
+{
+    return SUBPASS_INDIRECT_DRAWS && m_RenderContext.getDevice().getEnabledFeatures().drawIndirectFirstInstance;
+}
 
-    auto& pipeline_layout = command_buffer->getPipelineLayout();
+void Subpass::resetDrawStats()
+{
+    m_DrawCalls = 0;
+    m_Draws = 0;
+}
+
+void Subpass::bindModelGeometry(ModelHandle model, bool clusterCulled, CommandBuffer* command_buffer)
+{
+    auto scene = ServiceLocator::GetSceneManager()->GetCurrentScene();
+    const ModelStore& models = scene->GetModelStore();
+    const ModelMeshView& drawView = models.getDrawView(model);
+    const Mesh& mesh = *drawView.m_Mesh;
+    auto& clusterCuller = m_RenderContext.getActiveFrame().getClusterCuller();
 
-    RasterizationState rasterState{};
-    rasterState.m_CullMode = VK_CULL_MODE_NONE;
-    rasterState.m_FrontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    command_buffer->setRasterState(rasterState);
 
+    auto& pipeline_layout = command_buffer->getPipelineLayout();
 
+    command_buffer->setRasterState(getModelRasterState());
 
     auto vertex_input_resources = pipeline_layout.getResources(ShaderResourceType::Input, VK_SHADER_STAGE_VERTEX_BIT);
+    command_buffer->setVertexInputState(getVertexInputState(vertex_input_resources, mesh));
+
+    
+    //Bind Indices buffer
+    if (clusterCulled)
+        command_buffer->bind_index_buffer(*clusterCuller.getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+    else
+        command_buffer->bind_index_buffer(*((VulkanBuffer*)mesh.GetIndicesBuffer()), 0, mesh.GetIndexType());
 
-    VertexInputState vertex_input_state;
 
     for (auto& input_resource : vertex_input_resources)
+    {
+        const auto& buffer_iter = mesh.GetVerticesBuffers().find(input_resource.name);
+
+        if (buffer_iter != mesh.GetVerticesBuffers().end())
+        {
+            VulkanBuffer* vBuff = (VulkanBuffer*)buffer_iter->second.first;
+
+            // Bind vertex buffers only for the attribute locations defined
+            command_buffer->bind_vertex_buffer(input_resource.location, *vBuff, { 0 });
+        }
+    }
+    
+    if (ServiceLocator::GetRenderer()->SupportsBindlessTextures())
+        return;//Indices in the material, the array is bound for the whole pass
+
+    auto& descriptor_set_layout = pipeline_layout.getDescriptorSetLayout(0);
+
+    Material* material = scene->GetMaterial(models.getMaterialIndex(model));
+    VulkanTexture* placeholder = (VulkanTexture*)((RendererVulkan*)ServiceLocator::GetRenderer())->getPlaceholderTexture();
+
+    //Shaders sampling the material declare every slot, the material only decides which ones get sampled through the
+    //has*Texture constants (constant id = slot) and the missing ones get the placeholder so the descriptor set is complete
+    bool boundTexture = false;
+    for (uint32_t slot = 0; slot < MATERIAL_TEXTURE_SLOTS; slot++)
+    {
+        const char* slotName = Material::GetTextureSlotName(slot);
+        if (auto layout_binding = descriptor_set_layout.getLayoutBinding(slotName))
+        {
+            VulkanTexture* vulkanTex = (VulkanTexture*)material->GetTextureByName(slotName);
+            command_buffer->setSpecializationConstant(slot, vulkanTex != nullptr);
+            if (!vulkanTex)
+                vulkanTex = placeholder;
+            command_buffer->bind_image(*vulkanTex->getImageView(),
+                *vulkanTex->getSampler(),
+                0, layout_binding->binding, 0);
+            boundTexture = true;
+        }
+    }
+
+    if (!boundTexture)
+    {
+        command_buffer->forceResourceBindingDirty();//TODO: In case of empty shaders with no bindings at all, when flushing resourcesBinding is dirty won't be dirty hence not updating the descriptor set creating a validation error! Better way than forcing it?
+    }
+}
+
+VertexInputState Subpass::getVertexInputState(const std::vector<ShaderResource>& vertex_inputs, const Mesh& mesh)
+{
+    VertexInputState vertex_input_state;
+
+    for (auto& input_resource : vertex_inputs)
     {
         AttributeDescription attributeDescription;
 
-        if (!model.GetMesh().GetAttributeDescription(input_resource.name, attributeDescription))
+        if (!mesh.GetAttributeDescription(input_resource.name, attributeDescription))
         {
             continue;
         }
@@ -226,115 +352,113 @@ void Subpass::drawModel(const Model& model, CommandBuffer* command_buffer)
 
         vertex_input_state.m_Bindings.push_back(vertex_binding);
     }
+    return vertex_input_state;
+}
 
-    command_buffer->setVertexInputState(vertex_input_state);
-
-    
-    //Bind Indices buffer
-    command_buffer->bind_index_buffer(*((VulkanBuffer*)model.GetMesh().GetIndicesBuffer()), 0, VK_INDEX_TYPE_UINT32);
-
+RasterizationState Subpass::getModelRasterState()
+{
+    RasterizationState rasterState{};
+    rasterState.m_CullMode = VK_CULL_MODE_NONE;
+    rasterState.m_FrontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    return rasterState;
+}
 
-    for (auto& input_resource : vertex_input_resources)
+void Subpass::collectQueuePipelineStates(const RenderQueue& queue, const PipelineState& pass_state, ThreadPool* thread_pool, std::vector<PipelineState>& o_States)
+{
+    auto scene = ServiceLocator::GetSceneManager()->GetCurrentScene();
+    const ModelStore& models = scene->GetModelStore();
+
+    //recordQueue binds the layout of the first model of a state for all of them, then the vertex input of every mesh
+    std::unordered_map<uint32_t, uint32_t> stateIndices;
+    std::vector<ModelHandle> stateModels;
+    std::set<std::pair<uint32_t, const Mesh*>> meshes;
+    std::vector<std::pair<uint32_t, ModelHandle>> meshModels;//State index and the first model of the mesh
+    for (const RenderQueueItem& item : queue.getItems())
     {
-        const auto& buffer_iter = model.GetMesh().GetVerticesBuffers().find(input_resource.name);
-
-        if (buffer_iter != model.GetMesh().GetVerticesBuffers().end())
-        {
-            VulkanBuffer* vBuff = (VulkanBuffer*)buffer_iter->second.first;
-
-            // Bind vertex buffers only for the attribute locations defined
-            command_buffer->bind_vertex_buffer(input_resource.location, *vBuff, { 0 });
-        }
+        auto stateIt = stateIndices.emplace(RenderQueue::getState(item.m_Key), static_cast<uint32_t>(stateModels.size())).first;
+        if (stateIt->second == stateModels.size())
+            stateModels.push_back(item.m_Model);
+        if (meshes.emplace(stateIt->second, models.getDrawView(item.m_Model).m_Mesh).second)
+            meshModels.emplace_back(stateIt->second, item.m_Model);
     }
-    
-    auto& descriptor_set_layout = pipeline_layout.getDescriptorSetLayout(0);
 
-    auto textures = model.GetMaterial()->getTextures();
+    //The shader compiles, one state per job
+    std::vector<PipelineLayout*> layouts(stateModels.size());
+    runJobs(thread_pool, static_cast<uint32_t>(stateModels.size()), [&](uint32_t i) { layouts[i] = &requestModelPipelineLayout(stateModels[i]); });
 
-    if (textures->size() == 0)
-    {
-        command_buffer->forceResourceBindingDirty();//TODO: In case of empty shaders with no bindings at all, when flushing resourcesBinding is dirty won't be dirty hence not updating the descriptor set creating a validation error! Better way than forcing it?
-    }
-    else
+    const bool bindless = ServiceLocator::GetRenderer()->SupportsBindlessTextures();
+    for (auto& meshModel : meshModels)
     {
-        for (auto texture : *textures)
+        PipelineLayout& pipeline_layout = *layouts[meshModel.first];
+        PipelineState state = pass_state;
+        state.setPipelineLayout(pipeline_layout);
+        state.setRasterizationState(getModelRasterState());
+        state.setVertexInputState(getVertexInputState(pipeline_layout.getResources(ShaderResourceType::Input, VK_SHADER_STAGE_VERTEX_BIT), *models.getDrawView(meshModel.second).m_Mesh));
+        if (!bindless)//Same has*Texture constants bindModelGeometry sets
         {
-            if (auto layout_binding = descriptor_set_layout.getLayoutBinding(texture.first))
+            auto& descriptor_set_layout = pipeline_layout.getDescriptorSetLayout(0);
+            Material* material = scene->GetMaterial(models.getMaterialIndex(meshModel.second));
+            for (uint32_t slot = 0; slot < MATERIAL_TEXTURE_SLOTS; slot++)
             {
-                VulkanTexture* vulkanTex = (VulkanTexture*)texture.second;
-                if (vulkanTex)
-                {
-                    command_buffer->bind_image(*vulkanTex->getImageView(),
-                        *vulkanTex->getSampler(),
-                        0, layout_binding->binding, 0);
-                }
+                const char* slotName = Material::GetTextureSlotName(slot);
+                if (descriptor_set_layout.getLayoutBinding(slotName))
+                    state.setSpecializationConstant(slot, material->GetTextureByName(slotName) != nullptr);
             }
         }
+        o_States.push_back(state);
     }
+}
 
-    int nIndices = model.GetNIndices();
-    int indexStart = model.GetIndexStartPosition();
-    command_buffer->pushConstants(0, model.getModelMatrix());
-  
-    command_buffer->draw_indexed(nIndices, 1, indexStart, model.GetVertexStartPosition(), 0);
+void Subpass::bindSceneTextures(CommandBuffer& commandBuffer)
+{
+    auto renderer = (RendererVulkan*)ServiceLocator::GetRenderer();
+    if (BindlessTextures* bindlessTextures = renderer->getBindlessTextures())
+        commandBuffer.bind_descriptor_set(BINDLESS_TEXTURES_SET, bindlessTextures->getHandle());
+}
+
+void Subpass::bindLightClusters(CommandBuffer& commandBuffer)
+{
+    auto& lightClusters = m_RenderContext.getActiveFrame().getLightClusters();
+    commandBuffer.bind_buffer(*lightClusters.getLightBuffer(), 0, lightClusters.getLightBufferSize(), 0, LIGHT_CLUSTERS_BINDING, 0);
+    commandBuffer.bind_buffer(*lightClusters.getGridBuffer(), 0, lightClusters.getGridBufferSize(), 0, LIGHT_CLUSTERS_BINDING + 1, 0);
+    commandBuffer.bind_buffer(*lightClusters.getIndexBuffer(), 0, lightClusters.getIndexBufferSize(), 0, LIGHT_CLUSTERS_BINDING + 2, 0);
+}
+
+void Subpass::bindModelPipelineLayout(CommandBuffer* commandBuffer, ModelHandle model)
+{
+    commandBuffer->bindPipelineLayout(requestModelPipelineLayout(model));
 }
 
-void Subpass::bindModelPipelineLayout(CommandBuffer* commandBuffer, const Model& model)
+PipelineLayout& Subpass::requestModelPipelineLayout(ModelHandle model)
 {
+    const ShaderVariant& variant = ServiceLocator::GetSceneManager()->GetCurrentScene()->GetModel(model).getShaderVariant();
     auto pVertexShader = getVertexShader();
     auto pFragmentShader = getFragmentShader();
     auto& device = m_RenderContext.getDevice();
     std::vector<ShaderModule*> shader_modules;
     if (!m_VertexShaderPath.empty())
-        shader_modules.push_back(&device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_VERTEX_BIT, pVertexShader, model.getShaderVariant()));
+        shader_modules.push_back(&device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_VERTEX_BIT, pVertexShader, variant));
     if (!m_FragmentShaderPath.empty())
-        shader_modules.push_back(&device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_FRAGMENT_BIT, pFragmentShader, model.getShaderVariant()));
+        shader_modules.push_back(&device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_FRAGMENT_BIT, pFragmentShader, variant));
     
     
    
-    auto& pipeline_layout = device.getResourcesCache().request_pipeline_layout(shader_modules);
-    commandBuffer->bindPipelineLayout(pipeline_layout);
-    
-    
+    return device.getResourcesCache().request_pipeline_layout(shader_modules);
 }
 
 
 
 
 
-GeometrySubpass::GeometrySubpass(VulkanContext& render_context, std::string vertex_shader, std::string fragment_shader, size_t nThreads) :
+GeometrySubpass::GeometrySubpass(VulkanContext& render_context, std::string vertex_shader, std::string fragment_shader) :
     Subpass{ render_context,vertex_shader,fragment_shader }
 
 {
-    auto renderer = ServiceLocator::GetRenderer();
-    auto& device = render_context.getDevice();
-
-    m_ThreadPool = new ThreadPool();
-    m_ThreadPool->setThreadCount(nThreads);
+    m_UseClusterCulling = true;
 }
-void GeometrySubpass::prepare()//setup shaders, To be called when adding subpass to the pipeline
+void GeometrySubpass::collectPipelineStates(const PipelineState& pass_state, ThreadPool* thread_pool, std::vector<PipelineState>& o_States)
 {
-    //Warming up shaders so vkCreateShaderModule is called
-    auto& device = m_RenderContext.getDevice();
-    auto renderer = (RendererVulkan*)ServiceLocator::GetRenderer();
-
-
-    auto pVertexShader = getVertexShader();
-    auto pFragmentShader = getFragmentShader();
-
-    auto scene = ServiceLocator::GetSceneManager()->GetCurrentScene();
-    std::vector<RenderBatch>& batchesOpaque = scene->GetOpaqueBatches();
-    for (auto batch : batchesOpaque)
-    {
-        for (auto node_it = batch.m_ModelsByDistance.begin(); node_it != batch.m_ModelsByDistance.end(); node_it++)
-        {
-            Model& model = node_it->second;
-            auto& vert_module = device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_VERTEX_BIT, pVertexShader, model.getShaderVariant());
-            auto& frag_module = device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_FRAGMENT_BIT, pFragmentShader, model.getShaderVariant());
-
-        }
-    }
-
+    collectQueuePipelineStates(ServiceLocator::GetSceneManager()->GetCurrentScene()->GetOpaqueQueue(), pass_state, thread_pool, o_States);
 }
 
 void GeometrySubpass::draw(CommandBuffer& primary_commandBuffer)
@@ -349,11 +473,12 @@ void GeometrySubpass::draw(CommandBuffer& primary_commandBuffer)
     if (m_PersistentCommandsPerFrame.getDirty(activeFrame.getHashId())) {
 
         std::vector<CommandBuffer*>& recordedCommands = m_PersistentCommandsPerFrame.startRecording(activeFrame.getHashId());
-        std::vector<RenderBatch>& batchesOpaque = scene->GetOpaqueBatches();
-
-
         primary_commandBuffer.bind_buffer(*(m_RenderContext.getActiveFrame().getCameraUniformBuffer()), 0, sizeof(UBOCamera), 0, 1, 0);
-        drawBatchList(batchesOpaque, &primary_commandBuffer, recordedCommands);
+        primary_commandBuffer.bind_buffer(*((VulkanBuffer*)(scene->getMaterialsUniformBuffer())), 0, sizeof(UBOMaterial), 0, 6, 0);//Texture indices
+        auto& instances = activeFrame.getInstanceBuffer();
+        primary_commandBuffer.bind_buffer(*instances.getBuffer(), 0, instances.getSize(), 0, INSTANCE_BUFFER_BINDING, 0);
+        bindSceneTextures(primary_commandBuffer);
+        drawQueue(scene->GetOpaqueQueue(), &primary_commandBuffer, recordedCommands);
         m_PersistentCommandsPerFrame.clearDirty(activeFrame.getHashId());
 
     }
@@ -363,14 +488,6 @@ void GeometrySubpass::draw(CommandBuffer& primary_commandBuffer)
 }
 
 
-void GeometrySubpass::bindModelPipelineLayout(CommandBuffer* commandBuffer,const Model& model)
-{
-  Subpass::bindModelPipelineLayout(commandBuffer,model);
-  glm::vec4 matIndexVector;//Its a vector cause I couldn't make it work with a single float.. Probably the extra space will be useful at some point
-  matIndexVector.x = model.GetMaterial()->getMaterialIndex();
-  commandBuffer->pushConstants(sizeof(InstanceUBO::model), matIndexVector);//sizeof(InstanceUBO::model) is the offset since thats what you need to do with pushconstants
-
-}
 
 
 LightSubpass::LightSubpass(VulkanContext& render_context,  std::string vertex_shader, std::string fragment_shader):
@@ -412,23 +529,7 @@ void LightSubpass::draw(CommandBuffer& primary_command)
       /*command_buffer.setViewport(0, { viewport });
       command_buffer.setScissor(0, { scissor });*/
 
-      auto pVertexShader = getVertexShader();
-      auto pFragmentShader = getFragmentShader();
-      ShaderVariant lightVariant;
-      if (scene->getDirLightCount())
-        lightVariant.add_define("DIRLIGHTS " + std::to_string(scene->getDirLightCount()));
-      if (scene->getSpotLightCount())
-        lightVariant.add_define("SPOTLIGHTS " + std::to_string(scene->getSpotLightCount()));
-      if (scene->getPointLightCount())
-        lightVariant.add_define("POINTLIGHTS " + std::to_string(scene->getPointLightCount()));
-
-
-      auto& vert_module = device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_VERTEX_BIT, pVertexShader, lightVariant);
-      auto& frag_module = device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_FRAGMENT_BIT, pFragmentShader, lightVariant);
-      std::vector<ShaderModule*> shader_modules{ &vert_module, &frag_module };
-
-      auto& pipeline_layout = device.getResourcesCache().request_pipeline_layout(shader_modules);
-      command_buffer.bindPipelineLayout(pipeline_layout);
+      command_buffer.bindPipelineLayout(requestPipelineLayout());
 
       // Get image views of the attachments
 
@@ -454,11 +555,10 @@ void LightSubpass::draw(CommandBuffer& primary_command)
 
       command_buffer.bind_buffer(*((VulkanBuffer*)(scene->getMaterialsUniformBuffer())), 0, sizeof(UBOMaterial), 0, 5, 0);
 
+      bindLightClusters(command_buffer);
 
-      // Set cull mode to front as full screen triangle is clock-wise
-      RasterizationState rasterization_state;
-      rasterization_state.m_CullMode = VK_CULL_MODE_FRONT_BIT;
-      command_buffer.setRasterState(rasterization_state);
+
+      command_buffer.setRasterState(getRasterState());
 
 
       // Draw full screen triangle triangle
@@ -473,42 +573,75 @@ void LightSubpass::draw(CommandBuffer& primary_command)
 
 }
 
+void LightSubpass::collectPipelineStates(const PipelineState& pass_state, ThreadPool* thread_pool, std::vector<PipelineState>& o_States)
+{
+    PipelineState state = pass_state;
+    state.setPipelineLayout(requestPipelineLayout());
+    state.setRasterizationState(getRasterState());
+    o_States.push_back(state);
+}
+
+PipelineLayout& LightSubpass::requestPipelineLayout()
+{
+    auto& device = m_RenderContext.getDevice();
+    auto pVertexShader = getVertexShader();
+    auto pFragmentShader = getFragmentShader();
+    ShaderVariant lightVariant;//Light counts come from the light buffers, the variant never changes with them
+
+    auto& vert_module = device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_VERTEX_BIT, pVertexShader, lightVariant);
+    auto& frag_module = device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_FRAGMENT_BIT, pFragmentShader, lightVariant);
+    std::vector<ShaderModule*> shader_modules{ &vert_module, &frag_module };
+
+    return device.getResourcesCache().request_pipeline_layout(shader_modules);
+}
+
+RasterizationState LightSubpass::getRasterState()
+{
+    // Set cull mode to front as full screen triangle is clock-wise
+    RasterizationState rasterization_state;
+    rasterization_state.m_CullMode = VK_CULL_MODE_FRONT_BIT;
+    return rasterization_state;
+}
 
 
 
 
 
-TransparentSubpass::TransparentSubpass(VulkanContext& render_context, std::string vertex_shader, std::string fragment_shader, size_t nThreads) :
+
+TransparentSubpass::TransparentSubpass(VulkanContext& render_context, std::string vertex_shader, std::string fragment_shader) :
     Subpass{ render_context,vertex_shader,fragment_shader }
 
 {
-    
-
-    m_ThreadPool = new ThreadPool();
-    m_ThreadPool->setThreadCount(nThreads);
+    m_UseClusterCulling = true;
 }
-void TransparentSubpass::prepare()//setup shaders, To be called when adding subpass to the pipeline
+void TransparentSubpass::collectPipelineStates(const PipelineState& pass_state, ThreadPool* thread_pool, std::vector<PipelineState>& o_States)
 {
-    //Warming up shaders so vkCreateShaderModule is called
-    auto& device = m_RenderContext.getDevice();
-    auto renderer = (RendererVulkan*)ServiceLocator::GetRenderer();
-
-    auto pVertexShader = getVertexShader();
-    auto pFragmentShader = getFragmentShader();
+    PipelineState state = pass_state;
+    state.setColorBlendState(getColorBlendState());
+    state.setDepthStencilState(getDepthStencilState());
+    collectQueuePipelineStates(ServiceLocator::GetSceneManager()->GetCurrentScene()->GetTransparentQueue(), state, thread_pool, o_States);
+}
 
-    auto scene = ServiceLocator::GetSceneManager()->GetCurrentScene();
-    std::vector<RenderBatch>& batchesTransparent = scene->GetTransparentBatches();
-    for (auto batch : batchesTransparent)
-    {
-        for (auto node_it = batch.m_ModelsByDistance.begin(); node_it != batch.m_ModelsByDistance.end(); node_it++)
-        {
-            Model& model = node_it->second;
-            auto& vert_module = device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_VERTEX_BIT, pVertexShader, model.getShaderVariant());
-            auto& frag_module = device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_FRAGMENT_BIT, pFragmentShader, model.getShaderVariant());
+ColorBlendState TransparentSubpass::getColorBlendState() const
+{
+    // Enable alpha blending
+    ColorBlendAttachmentState color_blend_attachment{};
+    color_blend_attachment.m_BlendEnable = VK_TRUE;
+    color_blend_attachment.m_SrcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    color_blend_attachment.m_DstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    color_blend_attachment.m_SrcAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+
+    ColorBlendState color_blend_state{};
+    color_blend_state.m_Attachments.resize(getOutputAttachments().size());
+    color_blend_state.m_Attachments[0] = color_blend_attachment;
+    return color_blend_state;
+}
 
-        }
-    }
-  
+DepthStencilState TransparentSubpass::getDepthStencilState()
+{
+    DepthStencilState depth_stencil_state{};
+    depth_stencil_state.m_DepthWriteEnable = false;
+    return depth_stencil_state;
 }
 
 
@@ -524,31 +657,21 @@ void TransparentSubpass::draw(CommandBuffer& primary_commandBuffer)//TODO: Fix s
     if (m_PersistentCommandsPerFrame.getDirty(activeFrame.getHashId())) {
 
         std::vector<CommandBuffer*>& recordedCommands = m_PersistentCommandsPerFrame.startRecording(activeFrame.getHashId());
-        std::vector<RenderBatch>& batchesTransparent = scene->GetTransparentBatches();
         primary_commandBuffer.bind_buffer(*(m_RenderContext.getActiveFrame().getCameraUniformBuffer()), 0, sizeof(UBOCamera), 0, 1, 0);
         primary_commandBuffer.bind_buffer(*((VulkanBuffer*)(scene->getLightsUniformBuffer())), 0, sizeof(UBODeferredLights), 0, 4, 0);
         primary_commandBuffer.bind_buffer(*((VulkanBuffer*)(scene->getMaterialsUniformBuffer())), 0, sizeof(UBOMaterial), 0, 6, 0);
+        auto& instances = activeFrame.getInstanceBuffer();
+        primary_commandBuffer.bind_buffer(*instances.getBuffer(), 0, instances.getSize(), 0, INSTANCE_BUFFER_BINDING, 0);
+        bindSceneTextures(primary_commandBuffer);
+        bindLightClusters(primary_commandBuffer);
 
 
-        // Enable alpha blending
-        ColorBlendAttachmentState color_blend_attachment{};
-        color_blend_attachment.m_BlendEnable = VK_TRUE;
-        color_blend_attachment.m_SrcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-        color_blend_attachment.m_DstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-        color_blend_attachment.m_SrcAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-
-        ColorBlendState color_blend_state{};
-        color_blend_state.m_Attachments.resize(getOutputAttachments().size());
-        color_blend_state.m_Attachments[0] = color_blend_attachment;
-        primary_commandBuffer.setColorBlendState(color_blend_state);
-
-        DepthStencilState depth_stencil_state{};
-        depth_stencil_state.m_DepthWriteEnable = false;
-        primary_commandBuffer.setDepthStencilState(depth_stencil_state);
+        primary_commandBuffer.setColorBlendState(getColorBlendState());
+        primary_commandBuffer.setDepthStencilState(getDepthStencilState());
 
 
 
-        drawBatchList(batchesTransparent, &primary_commandBuffer, recordedCommands);
+        drawQueue(scene->GetTransparentQueue(), &primary_commandBuffer, recordedCommands);
         m_PersistentCommandsPerFrame.clearDirty(activeFrame.getHashId());
 
     }
@@ -558,41 +681,6 @@ void TransparentSubpass::draw(CommandBuffer& primary_commandBuffer)//TODO: Fix s
 }
 
 
-void TransparentSubpass::bindModelPipelineLayout(CommandBuffer* commandBuffer, const Model& model)
-{
-  auto pVertexShader = getVertexShader();
-  auto pFragmentShader = getFragmentShader();
-
-  
-  auto scene = ServiceLocator::GetSceneManager()->GetCurrentScene();
-  ShaderVariant lightVariant = model.getShaderVariant();
-  if (scene->getDirLightCount())
-    lightVariant.add_define("DIRLIGHTS " + std::to_string(scene->getDirLightCount()));
-  if (scene->getSpotLightCount())
-    lightVariant.add_define("SPOTLIGHTS " + std::to_string(scene->getSpotLightCount()));
-  if (scene->getPointLightCount())
-    lightVariant.add_define("POINTLIGHTS " + std::to_string(scene->getPointLightCount()));
-
-
-
-  auto& device = m_RenderContext.getDevice();
-  std::vector<ShaderModule*> shader_modules;
-  if (!m_VertexShaderPath.empty())
-    shader_modules.push_back(&device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_VERTEX_BIT, pVertexShader, lightVariant));
-  if (!m_FragmentShaderPath.empty())
-    shader_modules.push_back(&device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_FRAGMENT_BIT, pFragmentShader, lightVariant));
-
- 
-
-  PipelineLayout& pipeline_layout = device.getResourcesCache().request_pipeline_layout(shader_modules);
-  commandBuffer->bindPipelineLayout(pipeline_layout);
-
-  glm::vec4 matIndexVector;//Its a vector cause I couldn't make it work with a single float.. Probably the extra space will be useful at some point
-  matIndexVector.x = model.GetMaterial()->getMaterialIndex();
-  commandBuffer->pushConstants(sizeof(InstanceUBO::model), matIndexVector);//sizeof(InstanceUBO::model) is the offset since thats what you need to do with pushconstants
-
-}
-
 ShadowSubpass::ShadowSubpass(VulkanContext& render_context, std::string vertex_shader, std::string geo_shader, size_t nThreads /* = 1 */):
     Subpass(render_context,vertex_shader,""),
     m_GeoShaderPath(geo_shader)
@@ -600,9 +688,9 @@ ShadowSubpass::ShadowSubpass(VulkanContext& render_context, std::string vertex_s
     getGeoShader();
 }
 
-void ShadowSubpass::prepare()
+void ShadowSubpass::collectPipelineStates(const PipelineState& pass_state, ThreadPool* thread_pool, std::vector<PipelineState>& o_States)
 {
-
+    collectQueuePipelineStates(ServiceLocator::GetSceneManager()->GetCurrentScene()->GetShadowQueue(), pass_state, thread_pool, o_States);
 }
 
 void ShadowSubpass::draw(CommandBuffer& command_buffer)
@@ -613,20 +701,13 @@ void ShadowSubpass::draw(CommandBuffer& command_buffer)
         return;
 
     command_buffer.bind_buffer(*(m_RenderContext.getActiveFrame().getShadowsUniformBuffer()), 0, sizeof(UBOShadows), 0, 0, 0);
+    auto& instances = m_RenderContext.getActiveFrame().getInstanceBuffer();
+    command_buffer.bind_buffer(*instances.getBuffer(), 0, instances.getSize(), 0, INSTANCE_BUFFER_BINDING, 0);
 
-    auto& batches = scene->GetOpaqueBatches();
-    for (int i = 0; i < batches.size(); i++)
-    {
-        auto& batch = batches[i];
-        if (batch.m_ModelsByDistance.size() == 0)
-          continue;
-        bindModelPipelineLayout(&command_buffer, batch.m_ModelsByDistance.begin()->second);//Here all the models in the batch same the same material so we can call this out here
-        for (auto node_it = batch.m_ModelsByDistance.begin(); node_it != batch.m_ModelsByDistance.end(); node_it++)
-        {
-            const Model& model = node_it->second;
-            drawModel(model, &command_buffer);
-        }
-    }
+    const RenderQueue& queue = scene->GetShadowQueue();
+    resetDrawStats();
+    recordQueue(&command_buffer, &command_buffer, queue, 0, queue.size());
+    instances.flushIndirectCommands();
 }
 
 std::shared_ptr<ShaderSource> ShadowSubpass::getGeoShader()
@@ -645,25 +726,27 @@ std::shared_ptr<ShaderSource> ShadowSubpass::getGeoShader()
 }
 
 
-void ShadowSubpass::bindModelPipelineLayout(CommandBuffer* commandBuffer, const Model& model)
+PipelineLayout& ShadowSubpass::requestModelPipelineLayout(ModelHandle model)
 {
     auto pVertexShader = getVertexShader();
     auto pFragmentShader = getFragmentShader();
     auto pGeoShader = getGeoShader();
 
     ShaderVariant emptyVariant;
+    ShaderVariant vertexVariant;//Only the position is read, the rest of the mesh attributes don't matter here
+    if (ServiceLocator::GetSceneManager()->GetCurrentScene()->GetModelStore().getDrawView(model).m_Mesh->GetLayout() == VertexLayout::Compact)
+        vertexVariant.add_define("HAS_COMPACT_VERTICES");
 
     auto& device = m_RenderContext.getDevice();
     std::vector<ShaderModule*> shader_modules;
     if (!m_VertexShaderPath.empty())
-        shader_modules.push_back(&device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_VERTEX_BIT, pVertexShader, emptyVariant));
+        shader_modules.push_back(&device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_VERTEX_BIT, pVertexShader, vertexVariant));
     if (!m_FragmentShaderPath.empty())
         shader_modules.push_back(&device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_FRAGMENT_BIT, pFragmentShader, emptyVariant));
     
     if (!m_GeoShaderPath.empty())
         shader_modules.push_back(&device.getResourcesCache().request_shader_module(VK_SHADER_STAGE_GEOMETRY_BIT, pGeoShader, emptyVariant));
         
-    PipelineLayout& pipeline_layout = device.getResourcesCache().request_pipeline_layout(shader_modules);
-    commandBuffer->bindPipelineLayout(pipeline_layout);
+    return device.getResourcesCache().request_pipeline_layout(shader_modules);
 }
 
@@ -6,11 +6,33 @@
 #include <unordered_map>
 #include <memory>
 #include "PersistentCommand.h"
+#include "PipelineState.h"
 #include <Core/Scene.h>
 #include <mutex>
+#include <atomic>
+
+#define SUBPASS_INDIRECT_DRAWS 1 //Queues drawn with vkCmdDrawIndexedIndirect when the gpu can (drawIndirectFirstInstance), 0 for a vkCmdDrawIndexed per run
 
 //#include "Core/ThreadPool.hpp"
 class CommandBuffer;
+class PipelineLayout;
+
+//Indirect commands written since the last state or geometry change, drawn by a single vkCmdDrawIndexedIndirect
+struct IndirectBatch
+{
+    uint32_t m_FirstCommand = 0;
+    uint32_t m_NCommands = 0;
+    const Buffer* m_Geometry = nullptr;//Index buffer of the arena block, every mesh in a block shares its vertex streams too
+    bool m_ClusterCulled = false;//Indices come from the frame cluster culler buffer instead
+    VkIndexType m_IndexType = VK_INDEX_TYPE_UINT32;
+};
+
+//Last recording of the subpass
+struct SubpassDrawStats
+{
+    uint32_t m_DrawCalls = 0;//vkCmdDraw* calls
+    uint32_t m_Draws = 0;//Draws they made, one per instanced run
+};
 
 //Here is where the drawing actually happens!
 class VulkanContext;
@@ -24,6 +46,9 @@ public:
     virtual ~Subpass();
     virtual void prepare() = 0;
     virtual void draw(CommandBuffer& command_buffer) = 0;
+    //Pipeline states draw will flush for the current scene, starting from the state the render path leaves before the subpass draws.
+    //Shader modules and layouts are created on the way, on the pool when there are many
+    virtual void collectPipelineStates(const PipelineState& pass_state, ThreadPool* thread_pool, std::vector<PipelineState>& o_States) {}
 
     //const ShaderSource& getVertexShader() const { return *m_VertexShader; }
     //const ShaderSource& getFragmentShader() const{ return *m_FragmentShader;}
@@ -39,6 +64,7 @@ public:
 
     void invalidatePersistentCommands();
     void setReRecordCommands();
+    SubpassDrawStats getDrawStats() const { return { m_DrawCalls.load(), m_Draws.load() }; }
 
 
    
@@ -57,6 +83,10 @@ protected:
 
     bool m_DisableDepthAttachment{ false };
 
+    bool m_UseClusterCulling{ false };//Lone models draw the frame compacted cluster indices when they have them
+    std::atomic<uint32_t> m_DrawCalls{ 0 };//Counted by the recording threads, reset by resetDrawStats
+    std::atomic<uint32_t> m_Draws{ 0 };
+
 
     /// Default to no input attachments
     std::vector<uint32_t> m_InputAttachments = {};
@@ -64,18 +94,37 @@ protected:
     /// Default to swapchain output attachment
     std::vector<uint32_t> m_OutputAttachments = { 0 };
 
-    ThreadPool* m_ThreadPool;
+    ThreadPool* m_ThreadPool;//The shared job pool, drawQueue records one range per thread
 
     std::shared_ptr<ShaderSource> getVertexShader();
     std::shared_ptr<ShaderSource> getFragmentShader();
 
 
-    void drawBatchList(std::vector<RenderBatch>& batches, CommandBuffer* primary_command_buffer, std::vector<CommandBuffer*>& commands);
-    void recordBatches(CommandBuffer* commandBuffer, CommandBuffer* primary_command_buffer, std::vector<RenderBatch>& batches, size_t beginIndex, size_t endIndex);
-    void recordCommandBuffers(std::vector<CommandBuffer*> commandBuffers, CommandBuffer* primary_command_buffer, std::vector<RenderBatch>& batches, size_t beginIndex, size_t endIndex);
-    void drawModel(const Model& model, CommandBuffer* commandBuffer);
-
-    virtual  void bindModelPipelineLayout(CommandBuffer* commandBuffer, const Model& model);
+    //The queue is split in contiguous draw ranges, one per recording thread
+    void drawQueue(const RenderQueue& queue, CommandBuffer* primary_command_buffer, std::vector<CommandBuffer*>& commands);
+    //Binds the pipeline layout again only when the variant or material bits of the key change, runs of items sharing state and mesh view are drawn instanced.
+    //With indirect draws every run only writes its command, a state or geometry change draws the batch so far in one call
+    void recordQueue(CommandBuffer* commandBuffer, CommandBuffer* primary_command_buffer, const RenderQueue& queue, size_t beginIndex, size_t endIndex);
+    void recordCommandBuffers(std::vector<CommandBuffer*> commandBuffers, CommandBuffer* primary_command_buffer, const RenderQueue& queue, size_t beginIndex, size_t endIndex);
+    //nInstances models from firstInstance in the frame instance buffer, model being the first of them. Only a lone model takes its cluster culled range.
+    //false when there is nothing to draw
+    bool getDrawCommand(ModelHandle model, uint32_t nInstances, uint32_t firstInstance, VkDrawIndexedIndirectCommand& command, bool& clusterCulled);
+    //Vertex input, vertex and index buffers and material textures of the model, no textures when they are bindless
+    void bindModelGeometry(ModelHandle model, bool clusterCulled, CommandBuffer* commandBuffer);
+    static VertexInputState getVertexInputState(const std::vector<ShaderResource>& vertex_inputs, const Mesh& mesh);
+    static RasterizationState getModelRasterState();
+    //What recordQueue flushes for every state and mesh of the queue, the layouts of the states created in parallel first
+    void collectQueuePipelineStates(const RenderQueue& queue, const PipelineState& pass_state, ThreadPool* thread_pool, std::vector<PipelineState>& o_States);
+    void drawIndirectBatch(CommandBuffer* commandBuffer, IndirectBatch& batch);
+    bool useIndirectDraws() const;
+    void resetDrawStats();
+    //The scene texture array at BINDLESS_TEXTURES_SET once for the whole pass, when the device supports it
+    void bindSceneTextures(CommandBuffer& commandBuffer);
+    //Lights, cluster grid and light indices of the active frame at LIGHT_CLUSTERS_BINDING and the two after it
+    void bindLightClusters(CommandBuffer& commandBuffer);
+
+    void bindModelPipelineLayout(CommandBuffer* commandBuffer, ModelHandle model);
+    virtual PipelineLayout& requestModelPipelineLayout(ModelHandle model);
 };
 
 
@@ -91,12 +140,10 @@ class CommandPool;
 class GeometrySubpass: public Subpass
 {
 public:
-    GeometrySubpass(VulkanContext& render_context, std::string vertex_shader, std::string fragment_shader, size_t nThreads = 1);
-    void prepare() override;
+    GeometrySubpass(VulkanContext& render_context, std::string vertex_shader, std::string fragment_shader);
+    void prepare() override {}
     void draw(CommandBuffer& command_buffer) override;
-
-protected:
-    void bindModelPipelineLayout(CommandBuffer* commandBuffer, const Model& model) override;
+    void collectPipelineStates(const PipelineState& pass_state, ThreadPool* thread_pool, std::vector<PipelineState>& o_States) override;
 };
 
 class LightSubpass : public Subpass
@@ -105,15 +152,25 @@ public:
     LightSubpass(VulkanContext& render_context,  std::string vertex_shader, std::string fragment_shader);
     void prepare() override {}
     void draw(CommandBuffer& command_buffer) override;
+    void collectPipelineStates(const PipelineState& pass_state, ThreadPool* thread_pool, std::vector<PipelineState>& o_States) override;
+
+private:
+    PipelineLayout& requestPipelineLayout();
+    static RasterizationState getRasterState();
 };
 
 class TransparentSubpass : public Subpass
 {
 public:
-    TransparentSubpass(VulkanContext& render_context, std::string vertex_shader, std::string fragment_shader, size_t nThreads = 1);
-    void prepare() override;
+    TransparentSubpass(VulkanContext& render_context, std::string vertex_shader, std::string fragment_shader);
+    void prepare() override {}
     void draw(CommandBuffer& command_buffer) override;
-    void bindModelPipelineLayout(CommandBuffer* commandBuffer, const Model& model) override;
+    void collectPipelineStates(const PipelineState& pass_state, ThreadPool* thread_pool, std::vector<PipelineState>& o_States) override;
+
+private:
+    //Alpha blended over the lit image, depth tested but not written
+    ColorBlendState getColorBlendState() const;
+    static DepthStencilState getDepthStencilState();
 
 
 };
@@ -121,14 +178,15 @@ class ShadowSubpass : public Subpass
 {
 public:
     ShadowSubpass(VulkanContext& render_context, std::string vertex_shader, std::string geo_shader, size_t nThreads = 1);
-    void prepare() override;
+    void prepare() override {}
     void draw(CommandBuffer& command_buffer) override;
+    void collectPipelineStates(const PipelineState& pass_state, ThreadPool* thread_pool, std::vector<PipelineState>& o_States) override;
 
 private:
     std::weak_ptr<ShaderSource> m_GeoShader;
     std::string m_GeoShaderPath;
     std::shared_ptr<ShaderSource> getGeoShader();
-    void bindModelPipelineLayout(CommandBuffer* commandBuffer, const Model& model) override;
+    PipelineLayout& requestModelPipelineLayout(ModelHandle model) override;
 
 };
 
@@ -0,0 +1,305 @@
+#include "UploadService.h"
+#include "Device.h"
+#include "CommandPool.h"
+#include "CommandBuffer.h"
+#include "VulkanImage.h"
+#include "VulkanImageView.h"
+#include "Core\ServiceLocator.h"
+#include <chrono>
+#include <algorithm>
+#include <limits>
+
+#define UPLOAD_STAGING_ALIGNMENT 16 //Keeps buffer to image copies aligned to the texel size
+
+UploadService::UploadService(Device& device, VkDeviceSize ring_size) :
+    m_Device(device),
+    m_Queue(device.getTransferQueue()),
+    m_RingSize(ring_size)
+{
+    uint32_t graphicsFamily = m_Device.getGraphicsQueue().getFamilyIndex();
+    m_DedicatedQueue = m_Queue.getFamilyIndex() != graphicsFamily;
+    m_OwnsQueue = &m_Queue != &m_Device.getGraphicsQueue();
+    if (m_DedicatedQueue)
+    {
+        m_QueueFamilies = { graphicsFamily, m_Queue.getFamilyIndex() };
+    }
+
+    m_Ring = std::make_unique<VulkanBuffer>(m_Device, m_RingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+
+    m_Batches.resize(UPLOAD_MAX_BATCHES);
+    for (auto& batch : m_Batches)
+    {
+        batch.m_CommandPool = std::make_unique<CommandPool>(m_Device, m_Queue.getFamilyIndex());
+
+        VkFenceCreateInfo create_info{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+        if (vkCreateFence(m_Device.get_handle(), &create_info, nullptr, &batch.m_Fence) != VK_SUCCESS)
+        {
+            LOGERROR("Cant create upload Fence!!");
+        }
+    }
+
+    LOGINFO("Upload service using queue family " + std::to_string(m_Queue.getFamilyIndex()) + (m_DedicatedQueue ? " (dedicated transfer)" : " (shared with graphics)"));
+}
+
+UploadService::~UploadService()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        closeRecordingBatch();
+        for (auto index : m_InFlight)
+        {
+            UploadBatch& batch = m_Batches[index];
+            if (batch.m_State == BatchState::Closed)
+                submitBatch(batch);
+            vkWaitForFences(m_Device.get_handle(), 1, &batch.m_Fence, VK_TRUE, (std::numeric_limits<uint64_t>::max)());
+        }
+        retireBatches();
+    }
+
+    for (auto& batch : m_Batches)
+    {
+        batch.m_CommandPool.reset();
+        vkDestroyFence(m_Device.get_handle(), batch.m_Fence, nullptr);
+    }
+    m_Ring.reset();
+}
+
+uint64_t UploadService::uploadBuffer(const void* data, VkDeviceSize size, const VulkanBuffer& dst_buffer, VkDeviceSize dst_offset)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    VkDeviceSize stagingOffset = 0;
+    const VulkanBuffer& staging = stage(data, size, stagingOffset, lock);
+    UploadBatch& batch = m_Batches[m_RecordingBatch];
+
+    VkBufferCopy region{};
+    region.srcOffset = stagingOffset;
+    region.dstOffset = dst_offset;
+    region.size = size;
+    batch.m_CommandBuffer->copy_buffer(staging, dst_buffer, { region });
+
+    batch.m_Copies++;
+    m_UploadedBytes += size;
+    return batch.m_Value;
+}
+
+uint64_t UploadService::uploadImage(const void* data, VkDeviceSize size, const VulkanImageView& image_view)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    VkDeviceSize stagingOffset = 0;
+    const VulkanBuffer& staging = stage(data, size, stagingOffset, lock);
+    UploadBatch& batch = m_Batches[m_RecordingBatch];
+    CommandBuffer& command_buffer = *batch.m_CommandBuffer;
+
+    {
+        ImageMemoryBarrier memory_barrier{};
+        memory_barrier.old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        memory_barrier.new_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        memory_barrier.src_access_mask = 0;
+        memory_barrier.dst_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        memory_barrier.src_stage_mask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        memory_barrier.dst_stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+        command_buffer.imageBarrier(image_view, memory_barrier);
+    }
+
+    std::vector<VkBufferImageCopy> buffer_copy_regions(1);//TODO: We are assuming mipmaps = 1
+    auto& copy_region = buffer_copy_regions[0];
+    copy_region.bufferOffset = stagingOffset;
+    copy_region.imageSubresource = image_view.getSubresourceLayers();
+    copy_region.imageSubresource.mipLevel = 0;
+    copy_region.imageExtent = image_view.getImage()->getExtent();
+
+    command_buffer.copy_buffer_to_image(staging, *image_view.getImage(), buffer_copy_regions);
+
+    //Transfer queues don't know about shader stages, the batch fence is what makes the image safe to sample
+    {
+        ImageMemoryBarrier memory_barrier{};
+        memory_barrier.old_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        memory_barrier.new_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        memory_barrier.src_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        memory_barrier.dst_access_mask = 0;
+        memory_barrier.src_stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        memory_barrier.dst_stage_mask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+        command_buffer.imageBarrier(image_view, memory_barrier);
+    }
+
+    batch.m_Copies++;
+    m_UploadedBytes += size;
+    return batch.m_Value;
+}
+
+uint64_t UploadService::flush()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    closeRecordingBatch();
+    return m_LastValue;
+}
+
+void UploadService::update()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    //Whatever got queued since last frame goes out now even if nobody flushed
+    if (m_RecordingBatch >= 0 && m_Batches[m_RecordingBatch].m_Copies > 0)
+    {
+        closeRecordingBatch();
+    }
+    for (auto index : m_InFlight)
+    {
+        if (m_Batches[index].m_State == BatchState::Closed)
+            submitBatch(m_Batches[index]);
+    }
+    retireBatches();
+}
+
+bool UploadService::isComplete(uint64_t value)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    return m_CompletedValue >= value;
+}
+
+void UploadService::wait(uint64_t value)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    if (m_RecordingBatch >= 0 && m_Batches[m_RecordingBatch].m_Value <= value)
+    {
+        closeRecordingBatch();
+    }
+    while (m_CompletedValue < value)
+    {
+        retireBatches();
+        if (m_CompletedValue < value)
+            m_BatchRetired.wait_for(lock, std::chrono::milliseconds(1));
+    }
+}
+
+UploadService::UploadBatch& UploadService::getRecordingBatch(std::unique_lock<std::mutex>& lock)
+{
+    if (m_RecordingBatch >= 0)
+        return m_Batches[m_RecordingBatch];
+
+    for (;;)
+    {
+        for (size_t i = 0; i < m_Batches.size(); i++)
+        {
+            UploadBatch& batch = m_Batches[i];
+            if (batch.m_State != BatchState::Free)
+                continue;
+
+            batch.m_CommandPool->reset_pool();
+            batch.m_CommandBuffer = &batch.m_CommandPool->request_command_buffer();
+            batch.m_CommandBuffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+            batch.m_State = BatchState::Recording;
+            batch.m_Value = ++m_LastValue;
+            m_RecordingBatch = static_cast<int>(i);
+            return batch;
+        }
+        //Every batch is in flight, give the gpu some time
+        retireBatches();
+        if (std::none_of(m_Batches.begin(), m_Batches.end(), [](const UploadBatch& batch) { return batch.m_State == BatchState::Free; }))
+            m_BatchRetired.wait_for(lock, std::chrono::milliseconds(1));
+    }
+}
+
+const VulkanBuffer& UploadService::stage(const void* data, VkDeviceSize size, VkDeviceSize& o_Offset, std::unique_lock<std::mutex>& lock)
+{
+    for (;;)
+    {
+        UploadBatch& batch = getRecordingBatch(lock);
+
+        if (size > m_RingSize)
+        {
+            auto overflow = std::make_unique<VulkanBuffer>(m_Device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+            overflow->update((void*)data, size);
+            batch.m_OverflowBuffers.push_back(std::move(overflow));
+            o_Offset = 0;
+            return *batch.m_OverflowBuffers.back();
+        }
+
+        VkDeviceSize bytes = 0;
+        if (allocateRing(size, o_Offset, bytes))
+        {
+            batch.m_RingBytes += bytes;
+            m_Ring->update((void*)data, size, o_Offset);
+            return *m_Ring;
+        }
+
+        //Ring is full: send what we have and wait for older batches to hand their space back
+        if (batch.m_Copies > 0)
+            closeRecordingBatch();
+        retireBatches();
+        m_BatchRetired.wait_for(lock, std::chrono::milliseconds(1));
+    }
+}
+
+bool UploadService::allocateRing(VkDeviceSize size, VkDeviceSize& o_Offset, VkDeviceSize& o_Bytes)
+{
+    VkDeviceSize offset = (m_RingHead + UPLOAD_STAGING_ALIGNMENT - 1) & ~(VkDeviceSize)(UPLOAD_STAGING_ALIGNMENT - 1);
+    VkDeviceSize padding = offset - m_RingHead;
+    if (offset + size > m_RingSize)
+    {
+        //Not enough room till the end, waste the tail and wrap around
+        padding = m_RingSize - m_RingHead;
+        offset = 0;
+    }
+
+    if (m_RingUsed + padding + size > m_RingSize)
+        return false;
+
+    m_RingHead = offset + size;
+    m_RingUsed += padding + size;
+    o_Offset = offset;
+    o_Bytes = padding + size;
+    return true;
+}
+
+void UploadService::closeRecordingBatch()
+{
+    if (m_RecordingBatch < 0)
+        return;
+
+    UploadBatch& batch = m_Batches[m_RecordingBatch];
+    m_RecordingBatch = -1;
+    batch.m_CommandBuffer->end();//Empty batches still go out so their value completes in order
+    batch.m_State = BatchState::Closed;
+    m_InFlight.push_back(static_cast<uint32_t>(&batch - m_Batches.data()));
+
+    //The graphics queue is only submitted to from the render thread, any other queue is ours alone
+    if (m_OwnsQueue)
+        submitBatch(batch);
+}
+
+void UploadService::submitBatch(UploadBatch& batch)
+{
+    m_Queue.submit(*batch.m_CommandBuffer, batch.m_Fence);
+    batch.m_State = BatchState::Submitted;
+    m_SubmittedBatches++;
+}
+
+void UploadService::retireBatches()
+{
+    while (!m_InFlight.empty())
+    {
+        UploadBatch& batch = m_Batches[m_InFlight.front()];
+        if (batch.m_State != BatchState::Submitted || vkGetFenceStatus(m_Device.get_handle(), batch.m_Fence) != VK_SUCCESS)
+            break;
+
+        vkResetFences(m_Device.get_handle(), 1, &batch.m_Fence);
+        m_RingUsed -= batch.m_RingBytes;
+        m_CompletedValue = batch.m_Value;
+
+        batch.m_RingBytes = 0;
+        batch.m_Copies = 0;
+        batch.m_CommandBuffer = nullptr;
+        batch.m_OverflowBuffers.clear();
+        batch.m_State = BatchState::Free;
+        m_InFlight.pop_front();
+    }
+    if (m_RingUsed == 0)
+        m_RingHead = 0;
+
+    m_BatchRetired.notify_all();
+}
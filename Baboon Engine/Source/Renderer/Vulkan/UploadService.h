@@ -0,0 +1,117 @@
+#pragma once
+#include "Common.h"
+#include "VulkanBuffer.h"
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+class Device;
+class Queue;
+class CommandPool;
+class CommandBuffer;
+class VulkanImageView;
+
+#define UPLOAD_RING_SIZE (64 * 1024 * 1024)
+#define UPLOAD_MAX_BATCHES 4
+
+/**
+ * @brief Streams data into device local buffers and images without stalling the render thread
+ *
+ * Copies are staged through a persistent, mapped ring buffer and recorded into the current batch, so a whole scene worth of
+ * textures goes to the gpu in a handful of submissions. Each batch gets an increasing value (a poor man's timeline) that
+ * callers can test or wait for. The renderer calls update() once per frame to send whatever got queued and to poll the
+ * batch fences. Batches go out as soon as they close when we have a queue of our own, if we share the graphics queue they
+ * wait for update() so that queue is only ever touched from the render thread.
+ */
+class UploadService
+{
+public:
+    UploadService(Device& device, VkDeviceSize ring_size = UPLOAD_RING_SIZE);
+    ~UploadService();
+
+    UploadService(const UploadService&) = delete;
+    UploadService& operator=(const UploadService&) = delete;
+
+    /**
+     * @brief Queues a copy into a buffer created with TRANSFER_DST usage
+     * @return Value of the batch the copy went into
+     */
+    uint64_t uploadBuffer(const void* data, VkDeviceSize size, const VulkanBuffer& dst_buffer, VkDeviceSize dst_offset = 0);
+
+    /**
+     * @brief Queues a copy into mip 0 of an image, leaving it in SHADER_READ_ONLY_OPTIMAL
+     * @return Value of the batch the copy went into
+     */
+    uint64_t uploadImage(const void* data, VkDeviceSize size, const VulkanImageView& image_view);
+
+    //Closes the batch being recorded so it gets submitted, returns the value to wait for everything queued so far
+    uint64_t flush();
+
+    //Render thread only: closes and submits pending batches and retires the ones whose fence signaled
+    void update();
+
+    bool isComplete(uint64_t value);
+
+    //Blocks the calling thread until the batch is done, meant for loading threads, never call it from the render thread
+    void wait(uint64_t value);
+
+    //Families resources written by this service are shared with, pass it on creation so no ownership transfers are needed
+    const std::vector<uint32_t>& getQueueFamilies() const { return m_QueueFamilies; }
+
+    bool usesDedicatedQueue() const { return m_DedicatedQueue; }
+    uint64_t getUploadedBytes() const { return m_UploadedBytes; }
+    uint32_t getSubmittedBatches() const { return m_SubmittedBatches; }
+
+private:
+    enum class BatchState
+    {
+        Free,
+        Recording,
+        Closed,
+        Submitted,
+    };
+
+    struct UploadBatch
+    {
+        std::unique_ptr<CommandPool> m_CommandPool;
+        CommandBuffer* m_CommandBuffer{ nullptr };
+        VkFence m_Fence{ VK_NULL_HANDLE };
+        BatchState m_State{ BatchState::Free };
+        uint64_t m_Value{ 0 };
+        uint32_t m_Copies{ 0 };
+        VkDeviceSize m_RingBytes{ 0 };//Ring space (padding included) to give back once the batch retires
+        std::vector<std::unique_ptr<VulkanBuffer>> m_OverflowBuffers;//Staging for uploads that don't fit the ring
+    };
+
+    Device& m_Device;
+    const Queue& m_Queue;
+    bool m_DedicatedQueue{ false };
+    bool m_OwnsQueue{ false };//Not the graphics queue, so we can submit from any thread
+    std::vector<uint32_t> m_QueueFamilies;
+
+    std::unique_ptr<VulkanBuffer> m_Ring;
+    VkDeviceSize m_RingSize{ 0 };
+    VkDeviceSize m_RingHead{ 0 };
+    VkDeviceSize m_RingUsed{ 0 };
+
+    std::vector<UploadBatch> m_Batches;
+    std::deque<uint32_t> m_InFlight;//Closed and submitted batches, oldest first
+    int m_RecordingBatch{ -1 };
+    uint64_t m_LastValue{ 0 };
+    uint64_t m_CompletedValue{ 0 };
+
+    uint64_t m_UploadedBytes{ 0 };
+    uint32_t m_SubmittedBatches{ 0 };
+
+    std::mutex m_Mutex;
+    std::condition_variable m_BatchRetired;
+
+    UploadBatch& getRecordingBatch(std::unique_lock<std::mutex>& lock);
+    const VulkanBuffer& stage(const void* data, VkDeviceSize size, VkDeviceSize& o_Offset, std::unique_lock<std::mutex>& lock);
+    bool allocateRing(VkDeviceSize size, VkDeviceSize& o_Offset, VkDeviceSize& o_Bytes);
+    void closeRecordingBatch();
+    void submitBatch(UploadBatch& batch);
+    void retireBatches();
+};
@@ -7,7 +7,8 @@ VulkanBuffer::VulkanBuffer(Device& device,
     VkDeviceSize             size,
     VkBufferUsageFlags       buffer_usage,
     VmaMemoryUsage           memory_usage,
-    VmaAllocationCreateFlags flags):
+    VmaAllocationCreateFlags flags,
+    const std::vector<uint32_t>& queue_families):
     Buffer(size),
     m_Device(device)
 {
@@ -17,6 +18,13 @@ VulkanBuffer::VulkanBuffer(Device& device,
     buffer_info.usage = buffer_usage;
     buffer_info.size = size;
 
+    if (queue_families.size() > 1)
+    {
+        buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        buffer_info.queueFamilyIndexCount = static_cast<uint32_t>(queue_families.size());
+        buffer_info.pQueueFamilyIndices = queue_families.data();
+    }
+
     VmaAllocationCreateInfo memory_info{};
     memory_info.flags = flags;
     memory_info.usage = memory_usage;
@@ -2,6 +2,7 @@
 #include "Common.h"
 #include <vk_mem_alloc.h>
 #include "../Common/Buffer.h"
+#include <vector>
 
 class Device;
 class VulkanBuffer : public Buffer
@@ -11,7 +12,8 @@ public:
         VkDeviceSize             size,
         VkBufferUsageFlags       buffer_usage,
         VmaMemoryUsage           memory_usage,
-        VmaAllocationCreateFlags flags = VMA_ALLOCATION_CREATE_MAPPED_BIT);
+        VmaAllocationCreateFlags flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        const std::vector<uint32_t>& queue_families = {});//More than one family makes the buffer concurrent between them
 
    
 
@@ -0,0 +1,143 @@
+#include "VulkanGeometryArena.h"
+#include "VulkanBuffer.h"
+#include "UploadService.h"
+#include "Device.h"
+#include "Core\ServiceLocator.h"
+#include <algorithm>
+
+VulkanGeometryArena::VulkanGeometryArena(Device& device, UploadService& upload_service) :
+    m_Device(device),
+    m_UploadService(upload_service)
+{
+}
+
+VulkanGeometryArena::~VulkanGeometryArena()
+{
+    m_Blocks.clear();
+}
+
+bool VulkanGeometryArena::allocate(uint32_t n_vertices, uint32_t n_indices, uint32_t index_size, GeometryAllocation& o_Allocation)
+{
+    if (index_size != 2 && index_size != 4)
+        throw std::runtime_error("Geometry arena: indices have to be 16 or 32 bit");
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    const uint32_t unitsPerIndex = index_size / 2;
+    auto tryBlock = [&](uint32_t blockIndex) {
+        Block& block = *m_Blocks[blockIndex];
+        uint32_t vertexOffset = 0;
+        uint32_t indexUnitOffset = 0;
+        if (!block.m_Vertices.allocate(n_vertices, vertexOffset))
+            return false;
+        if (!block.m_Indices.allocate(n_indices * unitsPerIndex, indexUnitOffset, unitsPerIndex))
+        {
+            block.m_Vertices.free(vertexOffset, n_vertices);
+            return false;
+        }
+        o_Allocation.m_Block = blockIndex;
+        o_Allocation.m_VertexOffset = vertexOffset;
+        o_Allocation.m_NVertices = n_vertices;
+        o_Allocation.m_IndexOffset = indexUnitOffset / unitsPerIndex;
+        o_Allocation.m_NIndices = n_indices;
+        o_Allocation.m_IndexSize = index_size;
+        o_Allocation.m_Valid = true;
+        return true;
+    };
+
+    for (uint32_t i = 0; i < m_Blocks.size(); i++)
+    {
+        if (m_Blocks[i] && tryBlock(i))
+            return true;
+    }
+
+    //Nothing fits, open a new block (reusing a released slot if there is one)
+    auto freeSlot = std::find(m_Blocks.begin(), m_Blocks.end(), nullptr);
+    uint32_t blockIndex = static_cast<uint32_t>(freeSlot - m_Blocks.begin());
+    auto block = std::make_unique<Block>((std::max)(n_vertices, (uint32_t)GEOMETRY_ARENA_BLOCK_VERTICES), (std::max)(n_indices * unitsPerIndex / 2 + 1, (uint32_t)GEOMETRY_ARENA_BLOCK_INDICES));
+    if (freeSlot == m_Blocks.end())
+        m_Blocks.push_back(std::move(block));
+    else
+        *freeSlot = std::move(block);
+
+    LOGINFO("Geometry arena: opening block " + std::to_string(blockIndex));
+    return tryBlock(blockIndex);
+}
+
+void VulkanGeometryArena::free(const GeometryAllocation& allocation)
+{
+    if (!allocation.m_Valid)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (allocation.m_Block >= m_Blocks.size() || !m_Blocks[allocation.m_Block])
+        return;
+
+    Block& block = *m_Blocks[allocation.m_Block];
+    block.m_Vertices.free(allocation.m_VertexOffset, allocation.m_NVertices);
+    const uint32_t unitsPerIndex = allocation.m_IndexSize / 2;
+    block.m_Indices.free(allocation.m_IndexOffset * unitsPerIndex, allocation.m_NIndices * unitsPerIndex);
+
+    //Keep the first block around, it is going to be needed by the next scene anyway
+    if (allocation.m_Block > 0 && block.m_Vertices.empty() && block.m_Indices.empty())
+    {
+        m_Blocks[allocation.m_Block].reset();
+    }
+}
+
+VulkanBuffer* VulkanGeometryArena::uploadStream(const GeometryAllocation& allocation, const std::string& attribute, const void* data, uint32_t stride)
+{
+    VulkanBuffer* buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        Block& block = *m_Blocks[allocation.m_Block];
+
+        const std::string key = attribute + "/" + std::to_string(stride);
+        auto stream = block.m_Streams.find(key);
+        if (stream == block.m_Streams.end())
+        {
+            auto streamBuffer = std::make_unique<VulkanBuffer>(m_Device, (VkDeviceSize)block.m_Vertices.getCapacity() * stride,
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, 0, m_UploadService.getQueueFamilies());
+            stream = block.m_Streams.emplace(key, std::move(streamBuffer)).first;
+        }
+        buffer = stream->second.get();
+    }
+
+    if (data && allocation.m_NVertices > 0)
+        m_UploadService.uploadBuffer(data, (VkDeviceSize)allocation.m_NVertices * stride, *buffer, (VkDeviceSize)allocation.m_VertexOffset * stride);
+    return buffer;
+}
+
+VulkanBuffer* VulkanGeometryArena::uploadIndices(const GeometryAllocation& allocation, const void* indices)
+{
+    VulkanBuffer* buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        Block& block = *m_Blocks[allocation.m_Block];
+        if (!block.m_IndexBuffer)
+        {
+            block.m_IndexBuffer = std::make_unique<VulkanBuffer>(m_Device, (VkDeviceSize)block.m_Indices.getCapacity() * sizeof(uint16_t),
+                VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, 0, m_UploadService.getQueueFamilies());
+        }
+        buffer = block.m_IndexBuffer.get();
+    }
+
+    if (indices && allocation.m_NIndices > 0)
+        m_UploadService.uploadBuffer(indices, (VkDeviceSize)allocation.m_NIndices * allocation.m_IndexSize, *buffer, (VkDeviceSize)allocation.m_IndexOffset * allocation.m_IndexSize);
+    return buffer;
+}
+
+void VulkanGeometryArena::logUsage()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (uint32_t i = 0; i < m_Blocks.size(); i++)
+    {
+        if (!m_Blocks[i])
+            continue;
+        const Block& block = *m_Blocks[i];
+        LOGINFO("Geometry arena block " + std::to_string(i) + ": " +
+            std::to_string(block.m_Vertices.getUsed()) + "/" + std::to_string(block.m_Vertices.getCapacity()) + " vertices, " +
+            std::to_string(block.m_Indices.getUsed() * sizeof(uint16_t)) + "/" + std::to_string(block.m_Indices.getCapacity() * sizeof(uint16_t)) + " index bytes, " +
+            std::to_string(block.m_Streams.size()) + " attribute streams");
+    }
+}
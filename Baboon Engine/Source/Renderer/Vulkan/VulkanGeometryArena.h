@@ -0,0 +1,70 @@
+#pragma once
+#include "Common.h"
+#include "Renderer/Common/GeometryArena.h"
+#include <memory>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+
+class Device;
+class UploadService;
+class VulkanBuffer;
+
+#define GEOMETRY_ARENA_BLOCK_VERTICES (512 * 1024)
+#define GEOMETRY_ARENA_BLOCK_INDICES (2 * 1024 * 1024)//In 32 bit indices, twice as many 16 bit ones fit
+
+/**
+ * @brief Scene wide vertex and index storage
+ *
+ * Geometry lives in a few big blocks, each one with a buffer per vertex attribute and a single index buffer. Meshes get a
+ * vertex range and an index range out of a block, so every mesh in a block shares the same buffers and a pass only binds
+ * them once. A mesh bigger than the default block size gets a block of its own.
+ * The index buffer is handed out in 16 bit units so 16 and 32 bit index ranges can live side by side, each mesh binds it
+ * with its own index type. Attribute buffers are per name and stride, so full precision and compact meshes can share a block.
+ */
+class VulkanGeometryArena
+{
+public:
+    VulkanGeometryArena(Device& device, UploadService& upload_service);
+    ~VulkanGeometryArena();
+
+    VulkanGeometryArena(const VulkanGeometryArena&) = delete;
+    VulkanGeometryArena& operator=(const VulkanGeometryArena&) = delete;
+
+    bool allocate(uint32_t n_vertices, uint32_t n_indices, uint32_t index_size, GeometryAllocation& o_Allocation);
+
+    //Gives both ranges back, blocks other than the first one are released once empty
+    void free(const GeometryAllocation& allocation);
+
+    /**
+     * @brief Queues the upload of one vertex attribute into the allocation range
+     * @param stride Bytes per vertex, the block keeps a buffer per attribute and stride
+     * @return Block buffer holding the attribute
+     */
+    VulkanBuffer* uploadStream(const GeometryAllocation& allocation, const std::string& attribute, const void* data, uint32_t stride);
+
+    //indices are allocation.m_IndexSize bytes each
+    VulkanBuffer* uploadIndices(const GeometryAllocation& allocation, const void* indices);
+
+    void logUsage();
+
+private:
+    struct Block
+    {
+        Block(uint32_t vertex_capacity, uint32_t index_capacity) :
+            m_Vertices(vertex_capacity),
+            m_Indices(index_capacity * 2)
+        {}
+
+        RangeAllocator m_Vertices;
+        RangeAllocator m_Indices;//16 bit units
+        std::unordered_map<std::string, std::unique_ptr<VulkanBuffer>> m_Streams;//Attribute name and stride -> buffer
+        std::unique_ptr<VulkanBuffer> m_IndexBuffer;
+    };
+
+    Device& m_Device;
+    UploadService& m_UploadService;
+    std::vector<std::unique_ptr<Block>> m_Blocks;//Released blocks leave a null slot so block indices stay valid
+    std::mutex m_Mutex;
+};
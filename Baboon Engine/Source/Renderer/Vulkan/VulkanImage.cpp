@@ -109,7 +109,8 @@ VulkanImage::VulkanImage(const Device& device,
                         uint32_t mip_levels,
                         uint32_t array_layers,
                         VkImageTiling tiling,
-                        VkImageCreateFlags flags) :
+                        VkImageCreateFlags flags,
+                        const std::vector<uint32_t>& queue_families) :
     m_Device{ device },
     m_Extent{ extent },
     m_Format{ format },
@@ -131,6 +132,13 @@ VulkanImage::VulkanImage(const Device& device,
     imageInfo.usage = image_usage;
     imageInfo.samples = sample_count;
 
+    if (queue_families.size() > 1)
+    {
+        imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(queue_families.size());
+        imageInfo.pQueueFamilyIndices = queue_families.data();
+    }
+
 
     m_Subresource.mipLevel = imageInfo.mipLevels;
     m_Subresource.arrayLayer = imageInfo.arrayLayers;
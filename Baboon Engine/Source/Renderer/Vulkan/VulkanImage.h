@@ -1,6 +1,7 @@
 #pragma once
 #include "Common.h"
 #include <unordered_set>
+#include <vector>
 #include <vk_mem_alloc.h>
 
 class Device;
@@ -17,7 +18,8 @@ public:
         uint32_t mip_levels = 1, 
         uint32_t array_layers = 1,
         VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL,
-        VkImageCreateFlags    flags = 0);
+        VkImageCreateFlags    flags = 0,
+        const std::vector<uint32_t>& queue_families = {});//More than one family makes the image concurrent between them
     
     
     VulkanImage(const Device& device, VkImage handle, const VkExtent3D& extent, VkFormat format, VkImageUsageFlags image_usage);
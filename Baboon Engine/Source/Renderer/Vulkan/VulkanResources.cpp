@@ -3,6 +3,7 @@
 #include <glm/gtx/hash.hpp>
 #include "resources/DescriptorPool.h"
 #include "../../Core/Material.h"
+#include "../../Core/ParallelJobs.h"
 
 template <class T>
 void hash_combine(size_t& seed, const T& v)
@@ -68,6 +69,45 @@ T& request_resource(Device& device, std::mutex& resource_mutex, std::unordered_m
     return res;
 }
 
+//Same but creating outside of the lock, threads only wait for a resource another one is creating, not for any creation.
+//o_Created tells whether this call created it
+template <class T, class... A>
+T& request_resource(Device& device, std::mutex& resource_mutex, std::condition_variable& created_condition, std::unordered_set<std::size_t>& in_flight, std::unordered_map<std::size_t, T>& resources, bool& o_Created, A&... args)
+{
+    std::size_t hash{ 0U };
+    hash_param(hash, args...);
+    o_Created = false;
+
+    std::unique_lock<std::mutex> lock(resource_mutex);
+    created_condition.wait(lock, [&] { return in_flight.count(hash) == 0; });
+    auto res_it = resources.find(hash);
+    if (res_it != resources.end())
+    {
+        return res_it->second;
+    }
+    in_flight.insert(hash);
+    lock.unlock();
+
+    try
+    {
+        T resource(device, args...);
+        lock.lock();
+        res_it = resources.emplace(hash, std::move(resource)).first;
+    }
+    catch (...)
+    {
+        if (!lock.owns_lock())
+            lock.lock();
+        in_flight.erase(hash);
+        created_condition.notify_all();
+        throw;
+    }
+    in_flight.erase(hash);
+    created_condition.notify_all();
+    o_Created = true;
+    return res_it->second;
+}
+
 
 //Specializations
 
@@ -392,7 +432,14 @@ namespace std
                 hash_combine(result, render_pass->getHandle());
             }
 
-            //hash_combine(result, pipeline_state.get_specialization_constant_state());
+            for (auto& specialization_constant : pipeline_state.getSpecializationConstantState().getState())
+            {
+                hash_combine(result, specialization_constant.first);
+                for (uint8_t data_byte : specialization_constant.second)
+                {
+                    hash_combine(result, data_byte);
+                }
+            }
 
             hash_combine(result, pipeline_state.getSubpassIndex());
 
@@ -621,17 +668,63 @@ FrameBuffer& VulkanResources::request_framebuffer(const RenderTarget& render_tar
 
 ShaderModule& VulkanResources::request_shader_module(VkShaderStageFlagBits stage, const std::shared_ptr<ShaderSource>& glsl_source, const ShaderVariant& shader_variant)
 {
-    return request_resource(m_Device, m_ShaderModuleMutex, m_Shaders_Cache, stage, glsl_source, shader_variant);
+    bool created;
+    auto& shader_module = request_resource(m_Device, m_ShaderModuleMutex, m_ShaderModuleCreated, m_ShaderModulesInFlight, m_Shaders_Cache, created, stage, glsl_source, shader_variant);
+    if (created)//Not in the cache, it was just compiled or read from disk
+    {
+        if (shader_module.isFromDiskCache())
+            m_ShaderCacheLoads++;
+        else
+            m_ShaderCompiles++;
+        if (m_WarmedUp)
+        {
+            m_ShaderCompilesAfterWarmUp++;
+            LOGINFO("Shader module created after warm up: " + shader_module.getSourceName() + "\nPREAMBLE :" + shader_variant.get_preamble());
+        }
+    }
+    return shader_module;
 }
 
 PipelineLayout& VulkanResources::request_pipeline_layout(std::vector<ShaderModule*> shader_modules)
 {
-    return request_resource(m_Device, m_PipelineLayoutMutex, m_PipelinesLayout_Cache, shader_modules);
+    std::lock_guard<std::mutex> guard(m_PipelineLayoutMutex);
+    const size_t cached = m_PipelinesLayout_Cache.size();
+    auto& pipeline_layout = request_resource(m_Device, m_PipelinesLayout_Cache, shader_modules);
+    if (m_PipelinesLayout_Cache.size() != cached)
+        m_PipelineLayouts++;
+    return pipeline_layout;
 }
 
 Pipeline& VulkanResources::request_pipeline(const PipelineState& pipelineState)
 {
-    return request_resource(m_Device, m_PipelineMutex, m_Pipelines_Cache, pipelineState);
+    bool created;
+    auto start = std::chrono::high_resolution_clock::now();
+    auto& pipeline = request_resource(m_Device, m_PipelineMutex, m_PipelineCreated, m_PipelinesInFlight, m_Pipelines_Cache, created, pipelineState);
+    if (created)
+    {
+        m_PipelineMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+        m_Pipelines++;
+        if (m_WarmedUp)
+            m_PipelinesAfterWarmUp++;
+    }
+    return pipeline;
+}
+
+uint32_t VulkanResources::request_pipelines(const std::vector<PipelineState>& pipelineStates, ThreadPool* threadPool)
+{
+    std::unordered_set<std::size_t> hashes;
+    std::vector<const PipelineState*> unique_states;
+    for (auto& pipeline_state : pipelineStates)
+    {
+        std::size_t hash{ 0U };
+        hash_param(hash, pipeline_state);
+        if (hashes.insert(hash).second)
+            unique_states.push_back(&pipeline_state);
+    }
+
+    const uint32_t cached = m_Pipelines;
+    runJobs(threadPool, static_cast<uint32_t>(unique_states.size()), [&](uint32_t i) { request_pipeline(*unique_states[i]); });
+    return m_Pipelines - cached;
 }
 
 DescriptorSetLayout& VulkanResources::request_descriptor_set_layout(const std::vector<ShaderResource>& set_resources)
@@ -659,6 +752,30 @@ void VulkanResources::clear()
     m_DescriptorSetLayout_Cache.clear();
 }
 
+void VulkanResources::setWarmedUp(bool i_WarmedUp)
+{
+    m_WarmedUp = i_WarmedUp;
+    if (!i_WarmedUp)
+    {
+        m_ShaderCompilesAfterWarmUp = 0;
+        m_PipelinesAfterWarmUp = 0;
+    }
+}
+
+ResourcesCacheStats VulkanResources::getStats() const
+{
+    ResourcesCacheStats stats;
+    stats.m_ShaderCompiles = m_ShaderCompiles;
+    stats.m_ShaderCacheLoads = m_ShaderCacheLoads;
+    stats.m_PipelineLayouts = m_PipelineLayouts;
+    stats.m_Pipelines = m_Pipelines;
+    stats.m_PipelineMilliseconds = m_PipelineMicroseconds / 1000.0f;
+    stats.m_ShaderCompilesAfterWarmUp = m_ShaderCompilesAfterWarmUp;
+    stats.m_PipelinesAfterWarmUp = m_PipelinesAfterWarmUp;
+    stats.m_WarmedUp = m_WarmedUp;
+    return stats;
+}
+
 void VulkanResources::GarbageCollect()
 {
 
@@ -1,6 +1,9 @@
 #pragma once
 #include <unordered_map>
+#include <unordered_set>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 #include "Core/ServiceLocator.h"
 
@@ -19,6 +22,20 @@
 class Device;
 class PipelineState;
 class ShaderVariant;
+
+//Shader compiles and pipelines created so far, and since the renderer called the cache warm. Anything after warm up stalled a recording thread
+struct ResourcesCacheStats
+{
+    uint32_t m_ShaderCompiles = 0;
+    uint32_t m_ShaderCacheLoads = 0;//Modules read from the on disk ShaderCache instead of compiled
+    uint32_t m_PipelineLayouts = 0;
+    uint32_t m_Pipelines = 0;
+    float m_PipelineMilliseconds = 0.0f;//Spent creating them, see Device::isPipelineCacheWarm to tell a cold run from a warm one
+    uint32_t m_ShaderCompilesAfterWarmUp = 0;
+    uint32_t m_PipelinesAfterWarmUp = 0;
+    bool m_WarmedUp = false;
+};
+
 class VulkanResources
 {
 public:
@@ -31,6 +48,8 @@ public:
     ShaderModule& request_shader_module(VkShaderStageFlagBits stage, const std::shared_ptr<ShaderSource>& glsl_source, const ShaderVariant& shader_variant);
     PipelineLayout& request_pipeline_layout(std::vector<ShaderModule*> shader_modules);
     Pipeline& request_pipeline(const PipelineState& pipelineState);
+    //Creates the pipelines of the states not in the cache yet, duplicates skipped, spread over the pool. Returns how many it created
+    uint32_t request_pipelines(const std::vector<PipelineState>& pipelineStates, ThreadPool* threadPool);
     DescriptorSetLayout& request_descriptor_set_layout(const std::vector<ShaderResource>& set_resources);
 
     //A bit of a hack to let other classes call request_resource template function without having to create the specialization functions in their cpp so we can keep them all in vulkanResources.cpp
@@ -40,6 +59,10 @@ public:
     void clear();
     void GarbageCollect();
 
+    //Once every frame has recorded the scene, from then on shader compiles and pipeline creations are counted as hitches
+    void setWarmedUp(bool i_WarmedUp);
+    ResourcesCacheStats getStats() const;
+
 private:
     Device& m_Device;
     std::unordered_map<std::size_t, RenderPass> m_RenderPasses_Cache;
@@ -58,6 +81,21 @@ private:
     std::mutex m_FramebufferMutex;
     std::mutex m_DescriptorSetLayoutMutex;
 
+    //Shader modules and pipelines are created outside of their mutex, the hashes being created and signaled once they are in
+    std::unordered_set<std::size_t> m_ShaderModulesInFlight;
+    std::unordered_set<std::size_t> m_PipelinesInFlight;
+    std::condition_variable m_ShaderModuleCreated;
+    std::condition_variable m_PipelineCreated;
+
+    std::atomic<uint32_t> m_ShaderCompiles{ 0 };
+    std::atomic<uint32_t> m_ShaderCacheLoads{ 0 };
+    std::atomic<uint32_t> m_PipelineLayouts{ 0 };
+    std::atomic<uint32_t> m_Pipelines{ 0 };
+    std::atomic<uint64_t> m_PipelineMicroseconds{ 0 };
+    std::atomic<uint32_t> m_ShaderCompilesAfterWarmUp{ 0 };
+    std::atomic<uint32_t> m_PipelinesAfterWarmUp{ 0 };
+    std::atomic<bool> m_WarmedUp{ false };
+
     std::chrono::duration<int, std::milli> m_GarbageCollectorInterval;
     std::chrono::time_point<std::chrono::steady_clock> m_StartGarbageCollection;
 
@@ -63,6 +63,25 @@ inline EShLanguage FindShaderLanguage(VkShaderStageFlagBits stage)
 }
 
 
+//InitializeProcess builds glslang's global tables and FinalizeProcess throws them away, paying that on every compile
+//was most of the cost of small shaders. Initialized once, on the first compile so warm shader caches never do it
+struct GlslangProcess
+{
+	GlslangProcess() { glslang::InitializeProcess(); }
+	~GlslangProcess() { glslang::FinalizeProcess(); }
+};
+
+static void initialize_glslang()
+{
+	static GlslangProcess process;//Thread safe, the first compiling thread initializes and the others wait
+}
+
+const std::string &GLSLCompiler::get_version()
+{
+	static const std::string version = std::string(glslang::GetGlslVersionString()) + " " + glslang::GetEsslVersionString();
+	return version;
+}
+
 bool GLSLCompiler::compile_to_spirv(VkShaderStageFlagBits       stage,
                                     const std::vector<uint8_t> &glsl_source,
                                     const std::string &         entry_point,
@@ -70,8 +89,7 @@ bool GLSLCompiler::compile_to_spirv(VkShaderStageFlagBits       stage,
                                     std::vector<std::uint32_t> &spirv,
                                     std::string &               info_log)
 {
-	// Initialize glslang library.
-	glslang::InitializeProcess();
+	initialize_glslang();
 
 	EShMessages messages = static_cast<EShMessages>(EShMsgDefault | EShMsgVulkanRules | EShMsgSpvRules);
 
@@ -131,9 +149,6 @@ bool GLSLCompiler::compile_to_spirv(VkShaderStageFlagBits       stage,
 
 	info_log += logger.getAllMessages() + "\n";
 
-	// Shutdown glslang library.
-	glslang::FinalizeProcess();
-
 	return true;
 }
 
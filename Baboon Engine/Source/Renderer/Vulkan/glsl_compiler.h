@@ -48,5 +48,8 @@ class GLSLCompiler
 	                      const ShaderVariant &       shader_variant,
 	                      std::vector<std::uint32_t> &spirv,
 	                      std::string &               info_log);
+
+	/// glslang version, compiled spirv only stays valid for the compiler that made it, see ShaderCache
+	static const std::string &get_version();
 };
 
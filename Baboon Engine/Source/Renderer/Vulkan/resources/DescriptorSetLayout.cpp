@@ -3,6 +3,7 @@
 #include "../Device.h"
 #include "Shader.h"
 #include "Core/ServiceLocator.h"
+#include <algorithm>
 
 VkDescriptorType find_descriptor_type(ShaderResourceType resource_type, bool dynamic)
 {
@@ -54,7 +55,10 @@ DescriptorSetLayout::DescriptorSetLayout(const Device& device, const std::vector
     :m_Device(device)
     
 {
-    //TODO: Fix this
+    // When creating a descriptor set layout, if we give a structure to create_info.pNext, each binding needs to have a binding flag
+    // (pBindings[i] uses the flags in pBindingFlags[i])
+    std::vector<VkDescriptorBindingFlagsEXT> binding_flags;
+
     for (auto& resource : resource_set)
     {
         // Skip shader resources whitout a binding point
@@ -69,18 +73,16 @@ DescriptorSetLayout::DescriptorSetLayout(const Device& device, const std::vector
         // Convert from ShaderResourceType to VkDescriptorType.
         auto descriptor_type = find_descriptor_type(resource.type, resource.mode == ShaderResourceMode::Dynamic);
 
-        /*if (resource.mode == ShaderResourceMode::UpdateAfterBind)
+        // Update after bind resources are the bindless arrays, only the elements a draw reads need to be valid
+        if (resource.mode == ShaderResourceMode::UpdateAfterBind)
         {
-            binding_flags.push_back(VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT);
+            binding_flags.push_back(VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT);
         }
         else
         {
-            // When creating a descriptor set layout, if we give a structure to create_info.pNext, each binding needs to have a binding flag
-            // (pBindings[i] uses the flags in pBindingFlags[i])
-            // Adding 0 ensures the bindings that dont use any flags are mapped correctly.
             binding_flags.push_back(0);
         }
-        */
+
         // Convert ShaderResource to VkDescriptorSetLayoutBinding
         VkDescriptorSetLayoutBinding layout_binding{};
 
@@ -105,7 +107,8 @@ DescriptorSetLayout::DescriptorSetLayout(const Device& device, const std::vector
     create_info.pBindings = m_Bindings.data();
 
     // Handle update-after-bind extensions
-   /*if (std::find_if(resource_set.begin(), resource_set.end(),
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_create_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT };
+    if (std::find_if(resource_set.begin(), resource_set.end(),
         [](const ShaderResource& shader_resource) { return shader_resource.mode == ShaderResourceMode::UpdateAfterBind; }) != resource_set.end())
     {
         // Spec states you can't have ANY dynamic resources if you have one of the bindings set to update-after-bind
@@ -115,18 +118,17 @@ DescriptorSetLayout::DescriptorSetLayout(const Device& device, const std::vector
             throw std::runtime_error("Cannot create descriptor set layout, dynamic resources are not allowed if at least one resource is update-after-bind.");
         }
 
-        if (!validate_flags(device.get_gpu(), bindings, binding_flags))
+        if (!device.isDescriptorIndexingEnabled())
         {
-            throw std::runtime_error("Invalid binding set up, couldn't create descriptor set layout.");
+            throw std::runtime_error("Cannot create descriptor set layout, update-after-bind resources need descriptor indexing.");
         }
 
-        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_create_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT };
-        binding_flags_create_info.bindingCount = to_u32(binding_flags.size());
+        binding_flags_create_info.bindingCount = static_cast<uint32_t>(binding_flags.size());
         binding_flags_create_info.pBindingFlags = binding_flags.data();
 
         create_info.pNext = &binding_flags_create_info;
-        create_info.flags |= std::find(binding_flags.begin(), binding_flags.end(), VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT) != binding_flags.end() ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT : 0;
-    }*/
+        create_info.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    }
 
     // Create the Vulkan descriptor set layout handle
     VkResult result = vkCreateDescriptorSetLayout(m_Device.get_handle(), &create_info, nullptr, &m_DescriptorSetLayout);
@@ -31,25 +31,21 @@ Pipeline::Pipeline(const Device& device, const PipelineState& pipeline_state):
     std::vector<VkPipelineShaderStageCreateInfo> stage_create_infos;
 
 
-/*
     // Create specialization info from tracked state. This is shared by all shaders.
     std::vector<uint8_t>                  data{};
     std::vector<VkSpecializationMapEntry> map_entries{};
 
-    const auto specialization_constant_state = pipeline_state.get_specialization_constant_state().get_specialization_constant_state();
-
-    for (const auto specialization_constant : specialization_constant_state)
+    for (const auto& specialization_constant : pipeline_state.getSpecializationConstantState().getState())
     {
-        map_entries.push_back({ specialization_constant.first, to_u32(data.size()), specialization_constant.second.size() });
+        map_entries.push_back({ specialization_constant.first, static_cast<uint32_t>(data.size()), specialization_constant.second.size() });
         data.insert(data.end(), specialization_constant.second.begin(), specialization_constant.second.end());
     }
 
     VkSpecializationInfo specialization_info{};
-    specialization_info.mapEntryCount = to_u32(map_entries.size());
+    specialization_info.mapEntryCount = static_cast<uint32_t>(map_entries.size());
     specialization_info.pMapEntries = map_entries.data();
     specialization_info.dataSize = data.size();
     specialization_info.pData = data.data();
-    */
     
 
     for (const ShaderModule* shader_module : pipeline_state.getPipelineLayout().getShaderModules())
@@ -77,7 +73,7 @@ Pipeline::Pipeline(const Device& device, const PipelineState& pipeline_state):
             LOGERROR("Error creating shader!");
         }
 
-        //stage_create_info.pSpecializationInfo = &specialization_info;
+        stage_create_info.pSpecializationInfo = &specialization_info;
 
         stage_create_infos.push_back(stage_create_info);
         shader_modules.push_back(stage_create_info.module);
@@ -203,7 +199,7 @@ Pipeline::Pipeline(const Device& device, const PipelineState& pipeline_state):
     create_info.renderPass = pipeline_state.getRenderPass()->getHandle();
     create_info.subpass = pipeline_state.getSubpassIndex();
 
-    auto result = vkCreateGraphicsPipelines(device.get_handle(), nullptr, 1, &create_info, nullptr, &m_Handle);
+    auto result = vkCreateGraphicsPipelines(device.get_handle(), device.getPipelineCache(), 1, &create_info, nullptr, &m_Handle);
 
     if (result != VK_SUCCESS)
     {
@@ -1,6 +1,8 @@
 #include "Shader.h"
 #include "../Device.h"
 #include "../glsl_compiler.h"
+#include "../ShaderCache.h"
+#include "../BindlessTextures.h"
 #include "Core/ServiceLocator.h"
 #include "Core/Material.h"
 __pragma(warning(push, 0))
@@ -47,6 +49,13 @@ ShaderModule::ShaderModule(const Device& device,
         m_EntryPoint = "main";//TODO: Maybe don't hardcode this?
         assert(srcPtr->get_data().size(), "Source code for shadermodule can't be empty!");
 
+        m_HashId = ShaderCache::GetKey(m_Stage, *srcPtr, shader_variant);
+        if (ShaderCache::Read(srcPtr->get_id(), m_HashId, m_Spirv, m_Resources))
+        {
+            m_FromDiskCache = true;
+            return;
+        }
+
         std::string infoLog;
         GLSLCompiler compiler;
         LOGINFO("Compiling shader: " + m_SourceName + "ID: " + std::to_string(shaderSource->get_id()) + "\nPREAMBLE :" + shader_variant.get_preamble()) ;
@@ -61,6 +70,8 @@ ShaderModule::ShaderModule(const Device& device,
         }
 
         readShaderResources();
+        if (success)
+            ShaderCache::Write(srcPtr->get_id(), m_HashId, m_Spirv, m_Resources);
     }
 }
 
@@ -70,6 +81,8 @@ m_Stage(other.m_Stage),
 m_Source(other.m_Source),
 m_Spirv(other.m_Spirv),
 m_ShaderModule(other.m_ShaderModule),
+m_HashId(other.m_HashId),
+m_FromDiskCache(other.m_FromDiskCache),
 m_EntryPoint(other.m_EntryPoint),
 m_Resources(other.m_Resources),
 m_SourceName(other.m_SourceName)
@@ -95,7 +108,9 @@ void ShaderModule::readShaderResources()
     readOutputs(&compiler);
     readSamplers(&compiler);
     readUniforms(&compiler);
+    readStorageBuffers(&compiler);
     readPushConstants(&compiler);
+    readSpecializationConstants(&compiler);
 
 }
 
@@ -171,6 +186,12 @@ void ShaderModule::readSamplers(spirv_cross::CompilerGLSL* compiler)
 
         const auto& spirv_type = compiler->get_type_from_variable(resource.id);
         shader_resource.array_size = spirv_type.array.size() ? spirv_type.array[0] : 1;
+        if (spirv_type.array.size() && spirv_type.array[0] == 0)
+        {
+            //Runtime sized, the bindless scene textures: partially bound and written after binding, see BindlessTextures
+            shader_resource.array_size = BINDLESS_MAX_TEXTURES;
+            shader_resource.mode = ShaderResourceMode::UpdateAfterBind;
+        }
 
         shader_resource.set = compiler->get_decoration(resource.id, spv::DecorationDescriptorSet);
         shader_resource.binding = compiler->get_decoration(resource.id, spv::DecorationBinding);
@@ -197,6 +218,39 @@ void ShaderModule::readUniforms(spirv_cross::CompilerGLSL* compiler)
 
     }
 }
+
+void ShaderModule::readSpecializationConstants(spirv_cross::CompilerGLSL* compiler)
+{
+    auto specializationConstants = compiler->get_specialization_constants();
+    for (auto& resource : specializationConstants)
+    {
+        ShaderResource shader_resource{};
+        shader_resource.type = ShaderResourceType::SpecializationConstant;
+        shader_resource.stages = m_Stage;
+        shader_resource.name = compiler->get_name(resource.id);
+        shader_resource.constant_id = resource.constant_id;
+        m_Resources.push_back(shader_resource);
+    }
+}
+void ShaderModule::readStorageBuffers(spirv_cross::CompilerGLSL* compiler)
+{
+    auto shaderStorageBuffers = compiler->get_shader_resources().storage_buffers;
+    for (auto& resource : shaderStorageBuffers)
+    {
+        ShaderResource shader_resource{};
+        shader_resource.type = ShaderResourceType::BufferStorage;
+        shader_resource.stages = m_Stage;
+        shader_resource.name = resource.name;
+
+        const auto& spirv_type = compiler->get_type_from_variable(resource.id);
+        size_t array_size = 0;//Runtime sized arrays (the instance matrices) count as empty
+        shader_resource.size = compiler->get_declared_struct_size_runtime_array(spirv_type, array_size);
+        shader_resource.array_size = spirv_type.array.size() ? spirv_type.array[0] : 1;
+        shader_resource.set = compiler->get_decoration(resource.id, spv::DecorationDescriptorSet);
+        shader_resource.binding = compiler->get_decoration(resource.id, spv::DecorationBinding);
+        m_Resources.push_back(shader_resource);
+    }
+}
 void ShaderModule::readPushConstants(spirv_cross::CompilerGLSL* compiler)
 {
     auto pushConstantBuffers = compiler->get_shader_resources().push_constant_buffers;
@@ -246,9 +300,15 @@ std::weak_ptr<ShaderSource> ShaderSourcePool::getShaderSource(std::string shader
 
 void ShaderSourcePool::reloadShader(std::string shaderPath)
 {
+    auto it = m_ShaderSources.find(shaderPath);
+    const size_t previousHash = it != m_ShaderSources.end() ? it->second->get_id() : 0;
 
     m_ShaderSources.erase(shaderPath);
-    getShaderSource(shaderPath);
+    auto source = getShaderSource(shaderPath).lock();
+
+    //Entries of the old source can never hit again, the new one fills the cache as its variants get compiled
+    if (previousHash != 0 && source && source->get_id() != previousHash)
+        ShaderCache::Evict(previousHash);
 
     /*std::vector<std::string> paths;
     for (int i = 0;i<m_ShaderSources.size();i++)
@@ -135,6 +135,7 @@ public:
     const std::vector<ShaderResource>& get_resources() const { return m_Resources; }
     const std::string& getSourceName() { return m_SourceName; }
     bool isStillValid();
+    bool isFromDiskCache() const { return m_FromDiskCache; }//Loaded from the ShaderCache, glslang and reflection skipped
 private:
     const Device& m_Device;
     VkShaderStageFlagBits m_Stage;
@@ -144,7 +145,8 @@ private:
     std::vector<uint32_t> m_Spirv;
 
     VkShaderModule m_ShaderModule{ VK_NULL_HANDLE };
-    size_t m_HashId;
+    size_t m_HashId{ 0 };//Content key of the compile, see ShaderCache::GetKey
+    bool m_FromDiskCache{ false };
     std::string m_SourceName;
     std::vector<ShaderResource> m_Resources;
 
@@ -154,7 +156,9 @@ private:
     void readOutputs(spirv_cross::CompilerGLSL* compiler);
     void readSamplers(spirv_cross::CompilerGLSL* compiler);
     void readUniforms(spirv_cross::CompilerGLSL* compiler);
+    void readStorageBuffers(spirv_cross::CompilerGLSL* compiler);
     void readPushConstants(spirv_cross::CompilerGLSL* compiler);
+    void readSpecializationConstants(spirv_cross::CompilerGLSL* compiler);
 
 };
 
@@ -369,6 +369,62 @@ void VulkanImGUI::RenderStatsWindow(bool* pOpen)
     const glm::vec3 camForward = cam->GetForward();
 		ImGui::Text("Scene cam Pos = (%.2f,%.2f,%.2f)",camPos.x,camPos.y,camPos.z);
     ImGui::Text("Scene cam Forward = (%.2f,%.2f,%.2f)", camForward.x, camForward.y, camForward.z);
+
+    Scene* scene = ServiceLocator::GetSceneManager()->GetCurrentScene();
+    if (scene && scene->IsInit())
+    {
+      float lodBias = scene->GetLodBias();
+      if (ImGui::SliderFloat("LOD bias", &lodBias, -2.0f, 4.0f))
+        scene->SetLodBias(lodBias);
+      const auto& modelsPerLod = scene->GetModelsPerLod();
+      for (size_t lod = 0; lod < modelsPerLod.size(); lod++)
+        ImGui::Text("LOD %d: %d models", (int)lod, (int)modelsPerLod[lod]);
+
+      const SceneVisibilityStats& visibility = scene->GetVisibilityStats();
+      ImGui::Text("Models: %d, frustum culled %d", (int)visibility.m_Models, (int)(visibility.m_Models - visibility.m_OpaqueVisible - visibility.m_TransparentVisible - visibility.m_Occlusion.m_Occluded));
+      ImGui::Text("Visible opaque %d, transparent %d", (int)visibility.m_OpaqueVisible, (int)visibility.m_TransparentVisible);
+      ImGui::Text("Shadow casters visible %d (%d shadow cameras)", (int)visibility.m_ShadowVisible, (int)visibility.m_ShadowViews);
+      const OcclusionStats& occlusion = visibility.m_Occlusion;
+      bool occlusionCulling = scene->GetOcclusionCulling();
+      if (ImGui::Checkbox("Occlusion culling", &occlusionCulling))
+        scene->SetOcclusionCulling(occlusionCulling);
+      ImGui::Text("Occluded %d of %d tested (%.1f%%)", (int)occlusion.m_Occluded, (int)occlusion.m_Tested, occlusion.m_Tested ? 100.0f * occlusion.m_Occluded / occlusion.m_Tested : 0.0f);
+      ImGui::Text("Occluders %d, %d triangles, raster %.1f us, test %.1f us", (int)occlusion.m_Occluders, (int)occlusion.m_Triangles, occlusion.m_RasterMicroseconds, occlusion.m_TestMicroseconds);
+      ImGui::Text("Render queues: %d opaque, %d transparent, %d shadow draws, built in %.1f us", (int)scene->GetOpaqueQueue().size(), (int)scene->GetTransparentQueue().size(), (int)scene->GetShadowQueue().size(), visibility.m_QueueMicroseconds);
+      ImGui::Text("Instancing: %d draw calls, %d instanced drawing %d models", visibility.m_Draws, visibility.m_InstancedDraws, visibility.m_InstancedModels);
+      ImGui::Text("Frustum cull %.1f us (%s), last pick %.1f us", visibility.m_CullMicroseconds, visibility.m_CulledWithBVH ? "BVH" : "SIMD", visibility.m_PickMicroseconds);
+
+      const ClusterCullStats& clusterStats = pRenderer->m_RenderContext->getCurrentFrame().getClusterCuller().getStats();
+      ImGui::Text("Meshlets: %d, frustum culled %d, backface culled %d", (int)clusterStats.m_Meshlets, (int)clusterStats.m_FrustumCulled, (int)clusterStats.m_BackfaceCulled);
+      ImGui::Text("Cluster culled triangles drawn: %d", (int)(clusterStats.m_Indices / 3));
+      const LightClusterStats& lightStats = pRenderer->m_RenderContext->getCurrentFrame().getLightClusters().getStats();
+      ImGui::Text("Lights: %d, %d binned into %d clusters, %d indices, at most %d per cluster, %.1f us", (int)lightStats.m_Lights, (int)lightStats.m_BinnedLights,
+        LIGHT_GRID_CLUSTERS, (int)lightStats.m_Indices, (int)lightStats.m_MaxClusterLights, lightStats.m_BinMicroseconds);
+      if (pRenderer->m_RenderPath)
+      {
+        auto& subpasses = pRenderer->m_RenderPath->getSubPasses();
+        for (size_t i = 0; i < subpasses.size(); i++)
+        {
+          const SubpassDrawStats drawStats = subpasses[i]->getDrawStats();
+          if (drawStats.m_Draws)
+            ImGui::Text("Subpass %d: %d draws in %d draw calls", (int)i, (int)drawStats.m_Draws, (int)drawStats.m_DrawCalls);
+        }
+      }
+      if (pRenderer->m_BindlessTextures)
+        ImGui::Text("Bindless textures: %d of %d", (int)pRenderer->m_BindlessTextures->getTextureCount(), BINDLESS_MAX_TEXTURES);
+      else
+        ImGui::Text("Bindless textures: unsupported, binding per material");
+      const ResourcesCacheStats cacheStats = pRenderer->m_LogicalDevice->getResourcesCache().getStats();
+      ImGui::Text("Shader compiles: %d (%d from disk), pipeline layouts %d, pipelines %d", (int)cacheStats.m_ShaderCompiles, (int)cacheStats.m_ShaderCacheLoads,
+        (int)cacheStats.m_PipelineLayouts, (int)cacheStats.m_Pipelines);
+      ImGui::Text("Pipeline cache %s (%d KB loaded), pipelines took %.1f ms, %.2f ms each", pRenderer->m_LogicalDevice->isPipelineCacheWarm() ? "warm" : "cold",
+        (int)(pRenderer->m_LogicalDevice->getPipelineCacheLoadedBytes() / 1024), cacheStats.m_PipelineMilliseconds,
+        cacheStats.m_Pipelines ? cacheStats.m_PipelineMilliseconds / cacheStats.m_Pipelines : 0.0f);
+      if (cacheStats.m_WarmedUp)
+        ImGui::Text("After warm up: %d shader compiles, %d pipelines", (int)cacheStats.m_ShaderCompilesAfterWarmUp, (int)cacheStats.m_PipelinesAfterWarmUp);
+      else
+        ImGui::Text("After warm up: still warming up");
+    }
 	}
 	ImGui::End();
 }
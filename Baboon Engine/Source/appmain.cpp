@@ -262,7 +262,13 @@ int main() {
   ThreadPool threadPool;
   ServiceLocator::Provide(&threadPool);
   
-  threadPool.setThreadCount(2);
+  //threads[0] runs scene loads, the rest decode textures while a scene is loading
+  threadPool.setThreadCount((std::max)(2u, std::thread::hardware_concurrency()));
+
+  //Only ever used from the main thread, which takes jobs too. Every parallel frame stage shares it instead of owning threads
+  ThreadPool jobPool;
+  ServiceLocator::ProvideJobPool(&jobPool);
+  jobPool.setThreadCount((std::max)(2u, std::thread::hardware_concurrency()) - 1);
 
 	
 	
@@ -1,16 +1,20 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#ifdef BINDLESS_TEXTURES
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
 
-#ifdef HAS_BASETEXTURE
+#ifdef BINDLESS_TEXTURES
+layout (set=1, binding=0) uniform sampler2D sceneTextures[];//Every scene texture, the material says which ones
+#else
+//Every slot is bound (a placeholder when the material has no texture), the constants say which ones to sample, see MATERIAL_TEXTURE_SLOTS
+layout (constant_id = 0) const bool hasBaseTexture = false;
+layout (constant_id = 1) const bool hasOpacityTexture = false;
+layout (constant_id = 2) const bool hasSpecularTexture = false;
+layout (constant_id = 3) const bool hasNormalTexture = false;
 layout (set=0, binding=0) uniform sampler2D baseTexture;
-#endif
-#ifdef HAS_OPACITYTEXTURE
 layout (set=0, binding=2) uniform sampler2D opacityTexture;
-#endif
-#ifdef HAS_SPECULARTEXTURE
 layout (set=0, binding=3) uniform sampler2D specularTexture;
-#endif
-#ifdef HAS_NORMALTEXTURE
 layout (set=0, binding=5) uniform sampler2D normalTexture;
 #endif
 
@@ -21,12 +25,23 @@ layout(set = 0, binding = 1) uniform UniformBufferObject {
 	vec3 camPos;
 } ubo;
 
-layout (push_constant) uniform PushConstantMaterialId {
-	layout(offset = 64) vec4 info;
-} pushConstantMaterialId;
-
+#ifdef BINDLESS_TEXTURES
+struct Material
+{
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	ivec4 textures;//base, opacity, specular, normal index in sceneTextures, -1 when missing
+};
+
+layout(set = 0, binding = 6) uniform MaterialsInfo
+{
+    Material materials[128];
+}materialUniform;
+#endif
 
 layout(location = 3) in vec3 fragPos;
+layout(location = 7) flat in float fragMaterial;
 #ifdef HAS_INCOLOR
 layout(location = 0) in vec3 fragColor;
 #endif
@@ -60,20 +75,35 @@ void main() {
 		vec3 N = normalize(fragNormal);
 		
 		#ifdef HAS_INTEXCOORD
-			#ifdef HAS_BASETEXTURE
-			texColor = texture(baseTexture, fragTexCoord);
-			#endif
-			#ifdef HAS_OPACITYTEXTURE
-			opacity = texture(opacityTexture, fragTexCoord);
-			#endif
-			#ifdef HAS_SPECULARTEXTURE
-			spec = texture(specularTexture, fragTexCoord).rgb;
-			#endif
-			#ifdef HAS_NORMALTEXTURE
+			#ifdef BINDLESS_TEXTURES
+			ivec4 textures = materialUniform.materials[int(fragMaterial)].textures;
+			if (textures.x >= 0)
+				texColor = texture(sceneTextures[textures.x], fragTexCoord);
+			if (textures.y >= 0)
+				opacity = texture(sceneTextures[textures.y], fragTexCoord);
+			if (textures.z >= 0)
+				spec = texture(sceneTextures[textures.z], fragTexCoord).rgb;
 				#ifdef HAS_INTANGENT
+				if (textures.w >= 0)
+				{
+					vec3 normalFromMap = 2.0 * texture(sceneTextures[textures.w], fragTexCoord).rgb -1.0;
+					N = normalize(TBN * normalFromMap);
+				}
+				#endif
+			#else
+			if (hasBaseTexture)
+				texColor = texture(baseTexture, fragTexCoord);
+			if (hasOpacityTexture)
+				opacity = texture(opacityTexture, fragTexCoord);
+			if (hasSpecularTexture)
+				spec = texture(specularTexture, fragTexCoord).rgb;
+			#ifdef HAS_INTANGENT
+			if (hasNormalTexture)
+			{
 				vec3 normalFromMap = 2.0 * texture(normalTexture, fragTexCoord).rgb -1.0;
 				N = normalize(TBN * normalFromMap);
-				#endif
+			}
+			#endif
 			#endif
 		#endif
 		
@@ -82,7 +112,7 @@ void main() {
 
 		outColor = vec4(texColor.rgb,spec.r);
 		
-		outNormal = vec4(N,pushConstantMaterialId.info.x/128.0f);//w is material id
+		outNormal = vec4(N,fragMaterial/128.0f);//w is material id
 	#elif defined HAS_INCOLOR
 	outColor = vec4(fragColor,0.5);
 	outNormal = vec4(1.0);
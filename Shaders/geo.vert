@@ -5,12 +5,19 @@ layout(set = 0, binding = 1) uniform UniformBufferObject {
     mat4 proj;
 	vec3 camPos;
 } ubo;
-layout (push_constant) uniform PushConstants {
+struct Instance {
 	mat4 model;
-} pushConstants;
+	vec4 positionOffset;//Compact vertices dequantization
+	vec4 positionScale;
+	vec4 info;//x material index
+};
+layout(std430, set = 0, binding = 7) readonly buffer InstanceBuffer {
+	Instance instances[];//Per draw data of the queued models, see InstanceBuffer
+} instanceBuffer;
 
 layout(location = 0) in vec3 inPosition;
 layout (location = 3) out vec3 fragPos;
+layout (location = 7) flat out float fragMaterial;
 
 #ifdef HAS_INCOLOR
 layout(location = 1) in vec3 inColor;
@@ -22,22 +29,46 @@ layout(location = 1) out vec2 fragTexCoord;
 #endif
 
 #ifdef HAS_INNORMAL
+#ifdef HAS_COMPACT_VERTICES
+layout(location = 3) in vec2 inNormal;//Octahedral
+#else
 layout(location = 3) in vec3 inNormal;
+#endif
 layout(location = 2) out vec3 fragNormal;
 #endif
 
 #ifdef HAS_INTANGENT
+#ifdef HAS_COMPACT_VERTICES
+layout(location = 4) in vec3 inTangent;//Octahedral tangent in xy, bitangent sign in z
+#else
 layout(location = 4) in vec3 inTangent;
 layout(location = 5) in vec3 inBiTangent;
+#endif
 layout (location = 4) out mat3 TBN;
 #endif
 
-
+#ifdef HAS_COMPACT_VERTICES
+vec3 octDecode(vec2 e)
+{
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0)
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(v);
+}
+#endif
 
 
 
 void main() {
-	vec4 worldPos = pushConstants.model * vec4(inPosition, 1.0);
+	Instance instance = instanceBuffer.instances[gl_InstanceIndex];
+	#ifdef HAS_COMPACT_VERTICES
+	vec3 position = instance.positionOffset.xyz + inPosition * instance.positionScale.xyz;
+	#else
+	vec3 position = inPosition;
+	#endif
+	mat4 model = instance.model;
+	fragMaterial = instance.info.x;
+	vec4 worldPos = model * vec4(position, 1.0);
 	fragPos = worldPos.xyz;
 	
     gl_Position = ubo.proj * ubo.view * worldPos;
@@ -50,14 +81,26 @@ void main() {
 	#endif
 	
 	#ifdef HAS_INNORMAL
-	mat3 normalMatrix = mat3(transpose(inverse(pushConstants.model)));//TODO: pass normal matrix as ubo uniform...
-	fragNormal =  normalMatrix *inNormal;
+	#ifdef HAS_COMPACT_VERTICES
+	vec3 normal = octDecode(inNormal);
+	#else
+	vec3 normal = inNormal;
+	#endif
+	mat3 normalMatrix = mat3(transpose(inverse(model)));//TODO: pass normal matrix as ubo uniform...
+	fragNormal =  normalMatrix *normal;
 	#endif
 	
 	#ifdef HAS_INTANGENT
-	vec3 T = normalize(vec3(pushConstants.model * vec4(normalMatrix * inTangent,   0.0)));
-	vec3 B = normalize(vec3(pushConstants.model * vec4(normalMatrix * inBiTangent, 0.0)));
-	vec3 N = normalize(vec3(pushConstants.model * vec4(fragNormal,    0.0)));
+	#ifdef HAS_COMPACT_VERTICES
+	vec3 tangent = octDecode(inTangent.xy);
+	vec3 biTangent = cross(normal, tangent) * inTangent.z;
+	#else
+	vec3 tangent = inTangent;
+	vec3 biTangent = inBiTangent;
+	#endif
+	vec3 T = normalize(vec3(model * vec4(normalMatrix * tangent,   0.0)));
+	vec3 B = normalize(vec3(model * vec4(normalMatrix * biTangent, 0.0)));
+	vec3 N = normalize(vec3(model * vec4(fragNormal,    0.0)));
 	TBN = mat3(T, B, N);
 	#endif
 	
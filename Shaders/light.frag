@@ -25,16 +25,33 @@ struct Light
 };
 layout(set = 0, binding = 4) uniform LightsInfo
 {
-    Light pointLights[15];
-	Light spotLights[15];
+	uvec4 counts;//x dir lights
 	Light dirLights[2];
 }lightUniform;
 
+//Point and spot lights binned per frame in view space clusters, see LightClusters
+layout(std430, set = 0, binding = 8) readonly buffer ClusteredLights
+{
+	uvec4 counts;//x point lights, y spot lights, the spot lights go right after the point lights
+	Light lights[];
+}clusteredLights;
+layout(std430, set = 0, binding = 9) readonly buffer LightClusters
+{
+	vec4 grid;//x, y tiles per pixel, z, w slice scale and bias over log(view depth)
+	uvec4 gridSize;//tiles x, y and slices
+	uvec2 clusters[];//first index in lightIndices, light count
+}lightClusters;
+layout(std430, set = 0, binding = 10) readonly buffer LightIndices
+{
+	uint lightIndices[];
+}lightIndices;
+
 struct Material
 {
 	vec4 ambient;
 	vec4 diffuse;
 	vec4 specular;
+	ivec4 textures;//base, opacity, specular, normal index in the bindless array, -1 when missing
 };
 layout(set = 0, binding = 5) uniform MaterialsInfo
 {
@@ -42,18 +59,26 @@ layout(set = 0, binding = 5) uniform MaterialsInfo
 }materialUniform;
 
 
+uvec2 getLightCluster(vec2 fragCoord, float viewDepth)
+{
+	uvec2 tile = min(uvec2(fragCoord * lightClusters.grid.xy), lightClusters.gridSize.xy - 1u);
+	float slice = log(max(viewDepth, 0.0001)) * lightClusters.grid.z + lightClusters.grid.w;
+	uint z = uint(clamp(slice, 0.0, float(lightClusters.gridSize.z - 1u)));
+	return lightClusters.clusters[(z * lightClusters.gridSize.y + tile.y) * lightClusters.gridSize.x + tile.x];
+}
 vec3 pointLight(uint lightIndex,uint matIndex, vec3 position, vec3 N, vec3 world_to_cam,vec3 albedo,float spec)
 {
 	Material theMaterial = materialUniform.materials[int(matIndex)];
-	vec3 lightPos =lightUniform.pointLights[lightIndex].lightPos.xyz;
-	vec3 world_to_light = lightPos.xyz - position;
+	Light light = clusteredLights.lights[lightIndex];
+	vec3 world_to_light = light.lightPos.xyz - position;
 	float dist = length(world_to_light);
-	float atten = 1.0 / (dist *lightUniform.pointLights[lightIndex].lightColor.w);
+	float window = clamp(1.0 - pow(dist / light.lightPos.w, 4.0), 0.0, 1.0);//Smoothly down to 0 at the radius, nothing past the clusters it was binned in
+	float atten = window * window / (dist * light.lightColor.w);
 	world_to_light = normalize(world_to_light);
 	float ndotl = clamp(dot(N, world_to_light), 0.0, 1.0);
 	vec3 R = normalize(reflect(-world_to_light, N));
 	float specular = pow(max(dot(R, world_to_cam), 0.0), theMaterial.specular.a);
-	return max(vec3(0.0),(ndotl * albedo.rgb* theMaterial.diffuse.rgb + specular * spec* theMaterial.specular.rgb) *atten * lightUniform.pointLights[lightIndex].lightColor.rgb);
+	return max(vec3(0.0),(ndotl * albedo.rgb* theMaterial.diffuse.rgb + specular * spec* theMaterial.specular.rgb) *atten * light.lightColor.rgb);
 }
 vec3 spotLight(uint lightIndex,uint matIndex, vec3 position, vec3 N, vec3 world_to_cam, vec3 albedo,float spec)
 {
@@ -96,23 +121,18 @@ void main()
 	vec3 lightContribution =theMaterial.ambient.rgb;
 	//vec3 lightContribution = vec3(0.4);
 	
-#ifdef DIRLIGHTS
-	for(int i = 0;i<DIRLIGHTS;i++)
+	for(uint i = 0u;i<lightUniform.counts.x;i++)
 	{
 		lightContribution += dirLight(i,int(matIndex),N, world_to_cam, albedo,spec);
 	}
-#endif
-#ifdef SPOTLIGHTS
-	for(int i = 0;i<SPOTLIGHTS;i++)
-	{
-		lightContribution += spotLight(i,int(matIndex),fragPos.xyz,N, world_to_cam, albedo,spec);
-	}
-#endif
-#ifdef POINTLIGHTS
-	for(int i = 0;i<POINTLIGHTS;i++)
+	uvec2 cluster = getLightCluster(gl_FragCoord.xy, -(ubo.view * vec4(fragPos, 1.0)).z);
+	for(uint i = 0u;i<cluster.y;i++)
 	{
-		lightContribution += pointLight(i,int(matIndex),fragPos.xyz,N, world_to_cam, albedo,spec);
+		uint lightIndex = lightIndices.lightIndices[cluster.x + i];
+		if (lightIndex < clusteredLights.counts.x)
+			lightContribution += pointLight(lightIndex,int(matIndex),fragPos.xyz,N, world_to_cam, albedo,spec);
+		else
+			lightContribution += spotLight(lightIndex,int(matIndex),fragPos.xyz,N, world_to_cam, albedo,spec);
 	}
-#endif
     o_color = vec4(lightContribution, 1.0);
 }
\ No newline at end of file
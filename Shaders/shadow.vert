@@ -5,12 +5,24 @@ layout(location = 0) in vec3 inPosition;
 layout (location = 0) out int outInstanceIndex;
 
 
-layout (push_constant) uniform PushConstants {
+struct Instance {
 	mat4 model;
-} pushConstants;
+	vec4 positionOffset;
+	vec4 positionScale;
+	vec4 info;
+};
+layout(std430, set = 0, binding = 7) readonly buffer InstanceBuffer {
+	Instance instances[];
+} instanceBuffer;
 
 
 void main()
 {
-    gl_Position = pushConstants.model * vec4(inPosition, 1.0);
+    Instance instance = instanceBuffer.instances[gl_InstanceIndex];
+#ifdef HAS_COMPACT_VERTICES
+    vec3 position = instance.positionOffset.xyz + inPosition * instance.positionScale.xyz;
+#else
+    vec3 position = inPosition;
+#endif
+    gl_Position = instance.model * vec4(position, 1.0);
 }
\ No newline at end of file
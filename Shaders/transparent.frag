@@ -1,16 +1,20 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#ifdef BINDLESS_TEXTURES
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
 
-#ifdef HAS_BASETEXTURE
+#ifdef BINDLESS_TEXTURES
+layout (set=1, binding=0) uniform sampler2D sceneTextures[];//Every scene texture, the material says which ones
+#else
+//Every slot is bound (a placeholder when the material has no texture), the constants say which ones to sample, see MATERIAL_TEXTURE_SLOTS
+layout (constant_id = 0) const bool hasBaseTexture = false;
+layout (constant_id = 1) const bool hasOpacityTexture = false;
+layout (constant_id = 2) const bool hasSpecularTexture = false;
+layout (constant_id = 3) const bool hasNormalTexture = false;
 layout (set=0, binding=0) uniform sampler2D baseTexture;
-#endif
-#ifdef HAS_OPACITYTEXTURE
 layout (set=0, binding=2) uniform sampler2D opacityTexture;
-#endif
-#ifdef HAS_SPECULARTEXTURE
 layout (set=0, binding=3) uniform sampler2D specularTexture;
-#endif
-#ifdef HAS_NORMALTEXTURE
 layout (set=0, binding=5) uniform sampler2D normalTexture;
 #endif
 
@@ -29,16 +33,33 @@ struct Light
 };
 layout(set = 0, binding = 4) uniform LightsInfo
 {
-    Light pointLights[15];
-	Light spotLights[15];
+	uvec4 counts;//x dir lights
 	Light dirLights[2];
 }lightUniform;
 
+//Point and spot lights binned per frame in view space clusters, see LightClusters
+layout(std430, set = 0, binding = 8) readonly buffer ClusteredLights
+{
+	uvec4 counts;//x point lights, y spot lights, the spot lights go right after the point lights
+	Light lights[];
+}clusteredLights;
+layout(std430, set = 0, binding = 9) readonly buffer LightClusters
+{
+	vec4 grid;//x, y tiles per pixel, z, w slice scale and bias over log(view depth)
+	uvec4 gridSize;//tiles x, y and slices
+	uvec2 clusters[];//first index in lightIndices, light count
+}lightClusters;
+layout(std430, set = 0, binding = 10) readonly buffer LightIndices
+{
+	uint lightIndices[];
+}lightIndices;
+
 struct Material
 {
 	vec4 ambient;
 	vec4 diffuse;
 	vec4 specular;
+	ivec4 textures;//base, opacity, specular, normal index in the bindless array, -1 when missing
 };
 
 layout(set = 0, binding = 6) uniform MaterialsInfo
@@ -47,12 +68,8 @@ layout(set = 0, binding = 6) uniform MaterialsInfo
 }materialUniform;
 
 
-layout (push_constant) uniform PushConstantMaterialId {
-	layout(offset = 64) vec4 info;
-} pushConstantMaterialId;
-
-
 layout(location = 3) in vec3 fragPos;
+layout(location = 7) flat in float fragMaterial;
 #ifdef HAS_INCOLOR
 layout(location = 0) in vec3 fragColor;
 #endif
@@ -72,18 +89,26 @@ layout(location = 0) out vec4 outColor;
 
 
 
+uvec2 getLightCluster(vec2 fragCoord, float viewDepth)
+{
+	uvec2 tile = min(uvec2(fragCoord * lightClusters.grid.xy), lightClusters.gridSize.xy - 1u);
+	float slice = log(max(viewDepth, 0.0001)) * lightClusters.grid.z + lightClusters.grid.w;
+	uint z = uint(clamp(slice, 0.0, float(lightClusters.gridSize.z - 1u)));
+	return lightClusters.clusters[(z * lightClusters.gridSize.y + tile.y) * lightClusters.gridSize.x + tile.x];
+}
 vec3 pointLight(uint lightIndex,uint matIndex, vec3 position, vec3 N, vec3 world_to_cam,vec3 albedo,float spec)
 {
 	Material theMaterial = materialUniform.materials[int(matIndex)];
-	vec3 lightPos =lightUniform.pointLights[lightIndex].lightPos.xyz;
-	vec3 world_to_light = lightPos.xyz - position;
+	Light light = clusteredLights.lights[lightIndex];
+	vec3 world_to_light = light.lightPos.xyz - position;
 	float dist = length(world_to_light);
-	float atten = 1.0 / (dist *lightUniform.pointLights[lightIndex].lightColor.w);
+	float window = clamp(1.0 - pow(dist / light.lightPos.w, 4.0), 0.0, 1.0);//Smoothly down to 0 at the radius, nothing past the clusters it was binned in
+	float atten = window * window / (dist * light.lightColor.w);
 	world_to_light = normalize(world_to_light);
 	float ndotl = clamp(dot(N, world_to_light), 0.0, 1.0);
 	vec3 R = normalize(reflect(-world_to_light, N));
 	float specular = pow(max(dot(R, world_to_cam), 0.0), theMaterial.specular.a);
-	return max(vec3(0.0),(ndotl * albedo.rgb* theMaterial.diffuse.rgb + specular * spec* theMaterial.specular.rgb) *atten * lightUniform.pointLights[lightIndex].lightColor.rgb);
+	return max(vec3(0.0),(ndotl * albedo.rgb* theMaterial.diffuse.rgb + specular * spec* theMaterial.specular.rgb) *atten * light.lightColor.rgb);
 }
 vec3 spotLight(uint lightIndex,uint matIndex, vec3 position, vec3 N, vec3 world_to_cam, vec3 albedo,float spec)
 {
@@ -116,48 +141,58 @@ void main() {
 	vec3 N = normalize(fragNormal);
 
 	#ifdef HAS_INTEXCOORD
-		#ifdef HAS_BASETEXTURE
-		albedo = texture(baseTexture, fragTexCoord);
-		#endif
-		#ifdef HAS_OPACITYTEXTURE
-		opacity = texture(opacityTexture, fragTexCoord);
-		#endif
-		#ifdef HAS_SPECULARTEXTURE
-		spec = texture(specularTexture, fragTexCoord).rgb;
-		#endif
-		#ifdef HAS_NORMALTEXTURE
+		#ifdef BINDLESS_TEXTURES
+		ivec4 textures = materialUniform.materials[int(fragMaterial)].textures;
+		if (textures.x >= 0)
+			albedo = texture(sceneTextures[textures.x], fragTexCoord);
+		if (textures.y >= 0)
+			opacity = texture(sceneTextures[textures.y], fragTexCoord);
+		if (textures.z >= 0)
+			spec = texture(sceneTextures[textures.z], fragTexCoord).rgb;
 			#ifdef HAS_INTANGENT
+			if (textures.w >= 0)
+			{
+				vec3 normalFromMap = 2.0 * texture(sceneTextures[textures.w], fragTexCoord).rgb -1.0;
+				N = normalize(TBN * normalFromMap);
+			}
+			#endif
+		#else
+		if (hasBaseTexture)
+			albedo = texture(baseTexture, fragTexCoord);
+		if (hasOpacityTexture)
+			opacity = texture(opacityTexture, fragTexCoord);
+		if (hasSpecularTexture)
+			spec = texture(specularTexture, fragTexCoord).rgb;
+		#ifdef HAS_INTANGENT
+		if (hasNormalTexture)
+		{
 			vec3 normalFromMap = 2.0 * texture(normalTexture, fragTexCoord).rgb -1.0;
 			N = normalize(TBN * normalFromMap);
-			#endif
+		}
+		#endif
 		#endif
 	#endif
 		
 		
 	vec3 world_to_cam = normalize(ubo.camPos-fragPos.xyz);
-	float matIndex = pushConstantMaterialId.info.x;
+	float matIndex = fragMaterial;
 	Material theMaterial = materialUniform.materials[int(matIndex)];
 	vec3 lightContribution =theMaterial.ambient.rgb;
 
 	
-	#ifdef DIRLIGHTS
-		for(int i = 0;i<DIRLIGHTS;i++)
+		for(uint i = 0u;i<lightUniform.counts.x;i++)
 		{
 			lightContribution += dirLight(i,int(matIndex),N, world_to_cam, albedo.rgb,spec.r);
 		}
-	#endif
-	#ifdef SPOTLIGHTS
-		for(int i = 0;i<SPOTLIGHTS;i++)
-		{
-			lightContribution += spotLight(i,int(matIndex),fragPos.xyz,N, world_to_cam, albedo.rgb,spec.r);
-		}
-	#endif
-	#ifdef POINTLIGHTS
-		for(int i = 0;i<POINTLIGHTS;i++)
+		uvec2 cluster = getLightCluster(gl_FragCoord.xy, -(ubo.view * vec4(fragPos, 1.0)).z);
+		for(uint i = 0u;i<cluster.y;i++)
 		{
-			lightContribution += pointLight(i,int(matIndex),fragPos.xyz,N, world_to_cam, albedo.rgb,spec.r);
+			uint lightIndex = lightIndices.lightIndices[cluster.x + i];
+			if (lightIndex < clusteredLights.counts.x)
+				lightContribution += pointLight(lightIndex,int(matIndex),fragPos.xyz,N, world_to_cam, albedo.rgb,spec.r);
+			else
+				lightContribution += spotLight(lightIndex,int(matIndex),fragPos.xyz,N, world_to_cam, albedo.rgb,spec.r);
 		}
-	#endif
     outColor = vec4(lightContribution, opacity.r);
 		
 #elif defined HAS_INCOLOR